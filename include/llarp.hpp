@@ -14,8 +14,16 @@ namespace llarp
     ~Context();
 
     int num_nethreads   = 1;
+    /// datagrams per recvmmsg/sendmmsg, 0 disables batched udp io
+    size_t net_batch    = 0;
+    /// queued outbound datagrams that force an immediate flush
+    size_t net_flush    = 0;
+    /// event loop implementation, empty for the platform default
+    std::string net_backend;
     bool singleThreaded = false;
     std::vector< std::thread > netio_threads;
+    /// event loops run by netio_threads, in addition to mainloop
+    std::vector< llarp_ev_loop * > netloops;
     llarp_crypto crypto      = {};
     llarp_router *router     = nullptr;
     llarp_threadpool *worker = nullptr;
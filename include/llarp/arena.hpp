@@ -0,0 +1,175 @@
+#ifndef LLARP_ARENA_HPP
+#define LLARP_ARENA_HPP
+
+#include <llarp/buffer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace llarp
+{
+  /// bump allocator for the messages we decode while handling one inbound
+  /// message. nothing is freed on its own, a Scope destroys everything made
+  /// since it was opened, newest first. never touches the heap, New returns
+  /// nullptr once it is full
+  struct Arena
+  {
+    static constexpr size_t Capacity   = 16 * 1024;
+    static constexpr size_t MaxObjects = 64;
+
+    /// rewinds the arena to where it was when constructed
+    struct Scope
+    {
+      Scope(Arena& a) : arena(a), used(a.m_Used), objects(a.m_Objects)
+      {
+      }
+
+      ~Scope()
+      {
+        arena.Rewind(used, objects);
+      }
+
+      Scope(const Scope&) = delete;
+      Scope&
+      operator=(const Scope&) = delete;
+
+     private:
+      Arena& arena;
+      size_t used;
+      size_t objects;
+    };
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena&
+    operator=(const Arena&) = delete;
+
+    ~Arena()
+    {
+      Rewind(0, 0);
+    }
+
+    /// the arena for the calling thread, parsers share it with a Scope each
+    static Arena&
+    ThisThread();
+
+    /// sz bytes aligned to align, nullptr if they don't fit
+    void*
+    Alloc(size_t sz, size_t align = alignof(std::max_align_t));
+
+    /// make a T destroyed with the enclosing Scope, nullptr if it won't fit
+    template < typename T, typename... Args >
+    T*
+    New(Args&&... args)
+    {
+      if(m_Objects == MaxObjects)
+      {
+        ++overflows;
+        return nullptr;
+      }
+      void* ptr = Alloc(sizeof(T), alignof(T));
+      if(ptr == nullptr)
+        return nullptr;
+      T* obj             = new(ptr) T(std::forward< Args >(args)...);
+      m_Dtors[m_Objects] = {obj, &Destroy< T >};
+      ++m_Objects;
+      return obj;
+    }
+
+    /// was ptr allocated from us
+    bool
+    Owns(const void* ptr) const
+    {
+      const byte_t* p = static_cast< const byte_t* >(ptr);
+      return p >= m_Data && p < m_Data + Capacity;
+    }
+
+    size_t
+    Used() const
+    {
+      return m_Used;
+    }
+
+    /// allocations that did not fit
+    uint64_t overflows = 0;
+
+   private:
+    template < typename T >
+    static void
+    Destroy(void* ptr)
+    {
+      static_cast< T* >(ptr)->~T();
+    }
+
+    /// destroy objects made after the first objects and free everything
+    /// after used
+    void
+    Rewind(size_t used, size_t objects);
+
+    struct Dtor
+    {
+      void* obj;
+      void (*destroy)(void*);
+    };
+
+    alignas(std::max_align_t) byte_t m_Data[Capacity];
+    size_t m_Used = 0;
+    Dtor m_Dtors[MaxObjects];
+    size_t m_Objects = 0;
+  };
+
+  /// allocator for containers in objects made by an Arena, uses the heap
+  /// when there is no arena or it is full
+  template < typename T >
+  struct ArenaAllocator
+  {
+    typedef T value_type;
+
+    ArenaAllocator(Arena* a = nullptr) : arena(a)
+    {
+    }
+
+    template < typename U >
+    ArenaAllocator(const ArenaAllocator< U >& other) : arena(other.arena)
+    {
+    }
+
+    T*
+    allocate(size_t n)
+    {
+      void* ptr = nullptr;
+      if(arena)
+        ptr = arena->Alloc(n * sizeof(T), alignof(T));
+      if(ptr == nullptr)
+        ptr = ::operator new(n * sizeof(T));
+      return static_cast< T* >(ptr);
+    }
+
+    void
+    deallocate(T* ptr, size_t)
+    {
+      if(arena == nullptr || !arena->Owns(ptr))
+        ::operator delete(ptr);
+    }
+
+    Arena* arena;
+  };
+
+  template < typename T, typename U >
+  bool
+  operator==(const ArenaAllocator< T >& a, const ArenaAllocator< U >& b)
+  {
+    return a.arena == b.arena;
+  }
+
+  template < typename T, typename U >
+  bool
+  operator!=(const ArenaAllocator< T >& a, const ArenaAllocator< U >& b)
+  {
+    return a.arena != b.arena;
+  }
+}  // namespace llarp
+
+#endif
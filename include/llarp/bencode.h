@@ -14,6 +14,18 @@
  * we utilize llarp_buffer which provides memory management
  */
 
+/// how many digits i is in decimal
+size_t
+bencode_size_uint(uint64_t i);
+
+/// encoded size of a string of sz bytes
+size_t
+bencode_size_bytestring(size_t sz);
+
+/// encoded size of an integer
+size_t
+bencode_size_uint64(uint64_t i);
+
 bool
 bencode_write_bytestring(llarp_buffer_t* buff, const void* data, size_t sz);
 
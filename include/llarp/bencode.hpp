@@ -54,6 +54,22 @@ namespace llarp
     return true;
   }
 
+  /// like BEncodeMaybeReadDictEntry but item borrows its value from buf
+  /// instead of copying it
+  template < typename Item_t >
+  bool
+  BEncodeMaybeReadDictBorrowed(const char* k, Item_t& item, bool& read,
+                               llarp_buffer_t key, llarp_buffer_t* buf)
+  {
+    if(llarp_buffer_eq(key, k))
+    {
+      if(!item.BDecodeBorrowed(buf))
+        return false;
+      read = true;
+    }
+    return true;
+  }
+
   template < typename Int_t >
   bool
   BEncodeMaybeReadDictInt(const char* k, Int_t& i, bool& read,
@@ -167,6 +183,63 @@ namespace llarp
         && BEncodeWriteList(list.begin(), list.end(), buf);
   }
 
+  /// pull style reader, values are read in order from the buffer and strings
+  /// are views into it. nothing is copied or allocated. a read that fails
+  /// leaves the buffer where it was and sets failed
+  struct BencodeReader
+  {
+    /// how deep Skip goes into nested lists and dicts
+    static constexpr size_t MaxDepth = 32;
+
+    BencodeReader(llarp_buffer_t* buf) : buffer(buf)
+    {
+    }
+
+    /// the type of the next value, 'i', 's', 'l', 'd' or 'e' for the end of
+    /// a list or dict. 0 if we are out of buffer
+    char
+    Peek() const;
+
+    bool
+    ReadInteger(uint64_t& i);
+
+    bool
+    ReadString(llarp_buffer_t& str);
+
+    bool
+    EnterDict()
+    {
+      return Enter('d');
+    }
+
+    bool
+    EnterList()
+    {
+      return Enter('l');
+    }
+
+    /// in a list, true if there is another item to read. false once we read
+    /// past the end of the list, or if it doesn't have one
+    bool
+    NextItem();
+
+    /// in a dict, read the next key. false once we read past the end of the
+    /// dict, or if there was a problem
+    bool
+    NextKey(llarp_buffer_t& key);
+
+    /// read past the next value without looking at it
+    bool
+    Skip(size_t depth = 0);
+
+    llarp_buffer_t* buffer;
+    bool failed = false;
+
+   private:
+    bool
+    Enter(char type);
+  };
+
   /// bencode serializable message
   struct IBEncodeMessage
   {
@@ -181,23 +254,20 @@ namespace llarp
     virtual bool
     BDecode(llarp_buffer_t* buf)
     {
-      dict_reader r;
-      r.user   = this;
-      r.on_key = &OnKey;
-      return bencode_read_dict(buf, &r);
+      BencodeReader reader(buf);
+      llarp_buffer_t key;
+      if(!reader.EnterDict())
+        return false;
+      while(reader.NextKey(key))
+      {
+        if(!DecodeKey(key, buf))
+          return false;
+      }
+      return !reader.failed;
     }
 
     // TODO: check for shadowed values elsewhere
     uint64_t version = 0;
-
-    static bool
-    OnKey(dict_reader* r, llarp_buffer_t* k)
-    {
-      if(k)
-        return static_cast< IBEncodeMessage* >(r->user)->DecodeKey(*k,
-                                                                   r->buffer);
-      return true;
-    }
   };
 
 }  // namespace llarp
@@ -0,0 +1,55 @@
+#ifndef LLARP_BUFFER_POOL_HPP
+#define LLARP_BUFFER_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+namespace llarp
+{
+  struct BufferPoolStats
+  {
+    /// bytes handed out right now
+    size_t inuse = 0;
+    /// most bytes ever handed out at once
+    size_t highwater = 0;
+    /// bytes taken from the system for the freelists
+    size_t reserved = 0;
+    /// limit on reserved plus oversized allocations, 0 for no limit
+    size_t cap = 0;
+    uint64_t allocs   = 0;
+    /// allocations refused because of the cap
+    uint64_t failures = 0;
+
+    friend std::ostream &
+    operator<<(std::ostream &out, const BufferPoolStats &st)
+    {
+      return out << "inuse=" << st.inuse << " highwater=" << st.highwater
+                 << " reserved=" << st.reserved << " cap=" << st.cap
+                 << " allocs=" << st.allocs << " failures=" << st.failures;
+    }
+  };
+
+  /// fixed size blocks for packet sized buffers, kept on per thread
+  /// freelists that spill to and refill from a shared depot so buffers
+  /// freed on another thread than they were allocated on get reused
+  struct BufferPool
+  {
+    /// get a block of at least sz bytes, nullptr if that would go over cap
+    static void *
+    Alloc(size_t sz);
+
+    /// give back a block from Alloc, nullptr is ignored
+    static void
+    Free(void *ptr);
+
+    /// limit memory held by the pool, 0 for no limit
+    static void
+    SetCap(size_t bytes);
+
+    static BufferPoolStats
+    Stats();
+  };
+}  // namespace llarp
+
+#endif
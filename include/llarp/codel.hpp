@@ -8,10 +8,11 @@
 #include <llarp/threading.hpp>
 
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <deque>
 #include <functional>
-
-#include <queue>
+#include <list>
 #include <string>
 
 namespace llarp
@@ -30,30 +31,169 @@ namespace llarp
       {
       }
     };
-    template < typename T, typename GetTime >
-    struct CoDelCompareTime
+
+    /// plain fifo with the same Put and Process as CoDelQueue, for queues
+    /// whose items must all be delivered
+    template < typename T, typename Mutex_t = std::mutex,
+               typename Lock_t = std::lock_guard< std::mutex > >
+    struct FIFOQueue
     {
-      bool
-      operator()(const T& left, const T& right) const
+      FIFOQueue(const std::string& name) : m_name(name)
+      {
+      }
+
+      size_t
+      Size()
+      {
+        Lock_t lock(m_QueueMutex);
+        return m_Queue.size();
+      }
+
+      void
+      Put(T i)
       {
-        return GetTime()(left) < GetTime()(right);
+        Lock_t lock(m_QueueMutex);
+        m_Queue.push_back(i);
       }
+
+      /// move everything into result in fifo order
+      template < typename Queue_t >
+      void
+      Process(Queue_t& result)
+      {
+        Lock_t lock(m_QueueMutex);
+        for(auto& item : m_Queue)
+          result.push(item);
+        m_Queue.clear();
+      }
+
+      Mutex_t m_QueueMutex;
+      std::deque< T > m_Queue;
+      std::string m_name;
     };
 
+    /// drops items by deleting them
     template < typename T >
-    struct CoDelComparePriority
+    struct CoDelDelete
     {
+      void
+      operator()(T& item) const
+      {
+        delete item;
+      }
+    };
+
+    /// codel (rfc 8289) control state for one fifo, dequeues drop items that
+    /// sat longer than target for a whole interval, dropping faster the
+    /// longer that keeps up
+    struct CoDelState
+    {
+      /// when the sojourn time went and stayed above target, plus interval
+      llarp_time_t firstAboveTime = 0;
+      /// when to drop next while in the dropping state
+      llarp_time_t dropNext = 0;
+      /// drops since entering the dropping state
+      size_t count     = 0;
+      size_t lastCount = 0;
+      bool dropping    = false;
+      /// total items dropped
+      uint64_t dropped = 0;
+
+      /// pop the next item to deliver into out, returns false if q ran dry
+      template < typename T, typename GetTime, typename Drop >
       bool
-      operator()(const T& left, const T& right) const
+      Dequeue(std::deque< T >& q, llarp_time_t now, llarp_time_t target,
+              llarp_time_t interval, T& out, Drop& drop)
       {
-        return left < right;
+        bool okToDrop;
+        if(!Pop< T, GetTime >(q, now, target, interval, out, okToDrop))
+        {
+          dropping = false;
+          return false;
+        }
+        if(dropping)
+        {
+          if(!okToDrop)
+            dropping = false;
+          while(dropping && now >= dropNext)
+          {
+            drop(out);
+            ++dropped;
+            ++count;
+            if(!Pop< T, GetTime >(q, now, target, interval, out, okToDrop))
+            {
+              dropping = false;
+              return false;
+            }
+            if(okToDrop)
+              dropNext = ControlLaw(dropNext, interval);
+            else
+              dropping = false;
+          }
+        }
+        else if(okToDrop)
+        {
+          drop(out);
+          ++dropped;
+          bool more = Pop< T, GetTime >(q, now, target, interval, out, okToDrop);
+          dropping  = true;
+          // start near the old drop rate if we were dropping recently
+          size_t delta = count - lastCount;
+          if(delta > 1
+             && (now < dropNext || now - dropNext < 16 * interval))
+            count = delta;
+          else
+            count = 1;
+          dropNext  = ControlLaw(now, interval);
+          lastCount = count;
+          if(!more)
+          {
+            dropping = false;
+            return false;
+          }
+        }
+        return true;
+      }
+
+     private:
+      llarp_time_t
+      ControlLaw(llarp_time_t t, llarp_time_t interval) const
+      {
+        return t + llarp_time_t(interval / std::sqrt(double(count ? count : 1)));
+      }
+
+      template < typename T, typename GetTime >
+      bool
+      Pop(std::deque< T >& q, llarp_time_t now, llarp_time_t target,
+          llarp_time_t interval, T& out, bool& okToDrop)
+      {
+        okToDrop = false;
+        if(q.empty())
+        {
+          firstAboveTime = 0;
+          return false;
+        }
+        out = q.front();
+        q.pop_front();
+        llarp_time_t queued  = GetTime()(out);
+        llarp_time_t sojourn = now > queued ? now - queued : 0;
+        // never drop the last item, there is no standing queue to shrink
+        if(sojourn < target || q.empty())
+          firstAboveTime = 0;
+        else if(firstAboveTime == 0)
+          firstAboveTime = now + interval;
+        else if(now >= firstAboveTime)
+          okToDrop = true;
+        return true;
       }
     };
 
-    template < typename T, typename GetTime, typename PutTime, typename Compare,
+    /// fifo with codel active queue management, items are timestamped with
+    /// PutTime when queued and read back with GetTime when processed
+    template < typename T, typename GetTime, typename PutTime,
                typename Mutex_t    = std::mutex,
                typename Lock_t     = std::lock_guard< std::mutex >,
-               llarp_time_t dropMs = 5, llarp_time_t initialIntervalMs = 100 >
+               llarp_time_t targetMs = 5, llarp_time_t intervalMs = 100 >
     struct CoDelQueue
     {
       CoDelQueue(const std::string& name) : m_name(name)
@@ -67,65 +207,238 @@ namespace llarp
         return m_Queue.size();
       }
 
+      /// items dropped so far
+      uint64_t
+      Dropped()
+      {
+        Lock_t lock(m_QueueMutex);
+        return m_State.dropped;
+      }
+
       void
       Put(T i)
       {
         Lock_t lock(m_QueueMutex);
-        // llarp::LogInfo("CoDelQueue::Put - adding item, queue now has ",
-        // m_Queue.size(), " items at ", getTime(*item));
         PutTime()(i);
-        m_Queue.push(i);
-        if(firstPut == 0)
-          firstPut = GetTime()(i);
+        m_Queue.push_back(i);
       }
 
+      /// move everything that is not dropped into result in fifo order
       template < typename Queue_t >
       void
       Process(Queue_t& result)
       {
-        llarp_time_t lowest = 0xFFFFFFFFFFFFFFFFUL;
-        // auto start          = llarp_time_now_ms();
-        // llarp::LogInfo("CoDelQueue::Process - start at ", start);
+        Process(result, CoDelDelete< T >());
+      }
+
+      template < typename Queue_t, typename Drop_t >
+      void
+      Process(Queue_t& result, Drop_t drop)
+      {
+        auto now = llarp_time_now_ms();
         Lock_t lock(m_QueueMutex);
-        auto start = firstPut;
-        while(m_Queue.size())
+        T item;
+        while(m_State.Dequeue< T, GetTime >(m_Queue, now, targetMs, intervalMs,
+                                            item, drop))
+          result.push(item);
+        if(m_State.dropping)
+          llarp::LogDebug(m_name, " dropping, ", m_State.dropped,
+                          " dropped so far");
+      }
+
+      Mutex_t m_QueueMutex;
+      std::deque< T > m_Queue;
+      CoDelState m_State;
+      std::string m_name;
+    };
+
+    /// flow queued codel (rfc 8290), items are hashed by GetFlow into
+    /// separate codel fifos served by deficit round robin with GetSize bytes
+    /// of credit, so one busy flow only grows its own queue and delay
+    template < typename T, typename GetTime, typename PutTime,
+               typename GetFlow, typename GetSize,
+               typename Mutex_t    = std::mutex,
+               typename Lock_t     = std::lock_guard< std::mutex >,
+               llarp_time_t targetMs = 5, llarp_time_t intervalMs = 100,
+               size_t NumFlows = 1024, size_t Quantum = 1500 >
+    struct FQCoDelQueue
+    {
+      /// drop from the fattest flow when more than limit items are queued
+      FQCoDelQueue(const std::string& name, size_t limit = 10240)
+          : m_name(name), m_Limit(limit)
+      {
+      }
+
+      size_t
+      Size()
+      {
+        Lock_t lock(m_QueueMutex);
+        return m_Size;
+      }
+
+      /// items dropped so far, both by codel and for going over the limit
+      uint64_t
+      Dropped()
+      {
+        Lock_t lock(m_QueueMutex);
+        uint64_t dropped = m_OverLimit;
+        for(const auto& flow : m_Flows)
+          dropped += flow.state.dropped;
+        return dropped;
+      }
+
+      void
+      Put(T i)
+      {
+        Lock_t lock(m_QueueMutex);
+        PutTime()(i);
+        Flow& flow = m_Flows[Hash(GetFlow()(i)) % NumFlows];
+        flow.queue.push_back(i);
+        ++m_Size;
+        if(!flow.active)
+        {
+          flow.active = true;
+          flow.credit = Quantum;
+          m_NewFlows.push_back(&flow);
+        }
+        if(m_Size > m_Limit)
+          DropFattest();
+      }
+
+      /// move up to max items (0 for all) that are not dropped into result,
+      /// returns how many were moved
+      template < typename Queue_t >
+      size_t
+      Process(Queue_t& result, size_t max = 0)
+      {
+        return Process(result, CoDelDelete< T >(), max);
+      }
+
+      template < typename Queue_t, typename Drop_t >
+      size_t
+      Process(Queue_t& result, Drop_t drop, size_t max)
+      {
+        auto now = llarp_time_now_ms();
+        Lock_t lock(m_QueueMutex);
+        size_t moved = 0;
+        T item;
+        while(max == 0 || moved < max)
         {
-          // llarp::LogInfo("CoDelQueue::Process - queue has ", m_Queue.size());
-          const auto& item = m_Queue.top();
-          auto dlt         = start - GetTime()(item);
-          // llarp::LogInfo("CoDelQueue::Process - dlt ", dlt);
-          lowest = std::min(dlt, lowest);
-          if(m_Queue.size() == 1)
+          bool isNew;
+          Flow* flow;
+          if(m_NewFlows.size())
           {
-            // llarp::LogInfo("CoDelQueue::Process - single item: lowest ",
-            // lowest, " dropMs: ", dropMs);
-            if(lowest > dropMs)
-            {
-              // drop
-              nextTickInterval += initialIntervalMs / std::sqrt(++dropNum);
-              delete item;
-              m_Queue.pop();
-              break;
-            }
+            flow  = m_NewFlows.front();
+            isNew = true;
+          }
+          else if(m_OldFlows.size())
+          {
+            flow  = m_OldFlows.front();
+            isNew = false;
+          }
+          else
+            break;
+          auto& list = isNew ? m_NewFlows : m_OldFlows;
+          if(flow->credit <= 0)
+          {
+            // used up its turn, to the back of the line
+            flow->credit += Quantum;
+            list.pop_front();
+            m_OldFlows.push_back(flow);
+            continue;
+          }
+          size_t before = flow->queue.size();
+          bool got = flow->state.template Dequeue< T, GetTime >(
+              flow->queue, now, targetMs, intervalMs, item, drop);
+          m_Size -= before - flow->queue.size();
+          if(!got)
+          {
+            list.pop_front();
+            // an emptied new flow goes through the old list once so a flow
+            // can't stay new by sending one item at a time
+            if(isNew && m_OldFlows.size())
+              m_OldFlows.push_back(flow);
             else
+              flow->active = false;
+            continue;
+          }
+          flow->credit -= int64_t(GetSize()(item));
+          result.push(item);
+          ++moved;
+        }
+        return moved;
+      }
+
+      /// drop every queued item pred returns true for
+      template < typename Pred >
+      size_t
+      RemoveIf(Pred pred)
+      {
+        Lock_t lock(m_QueueMutex);
+        size_t removed = 0;
+        for(auto& flow : m_Flows)
+        {
+          auto itr = flow.queue.begin();
+          while(itr != flow.queue.end())
+          {
+            if(pred(*itr))
             {
-              nextTickInterval = initialIntervalMs;
-              dropNum          = 0;
+              CoDelDelete< T >()(*itr);
+              itr = flow.queue.erase(itr);
+              ++removed;
             }
+            else
+              ++itr;
           }
-          // llarp::LogInfo("CoDelQueue::Process - passing");
-          result.push(item);
-          m_Queue.pop();
         }
-        firstPut = 0;
+        m_Size -= removed;
+        return removed;
+      }
+
+     private:
+      struct Flow
+      {
+        std::deque< T > queue;
+        CoDelState state;
+        /// bytes this flow may still send this round
+        int64_t credit = 0;
+        /// on the new or old list
+        bool active = false;
+      };
+
+      static size_t
+      Hash(size_t key)
+      {
+        // spread pointer like keys over the low bits
+        key ^= key >> 17;
+        key *= 0xed5ad4bbU;
+        key ^= key >> 11;
+        return key;
+      }
+
+      void
+      DropFattest()
+      {
+        Flow* fattest = nullptr;
+        for(auto& flow : m_Flows)
+        {
+          if(fattest == nullptr || flow.queue.size() > fattest->queue.size())
+            fattest = &flow;
+        }
+        CoDelDelete< T >()(fattest->queue.front());
+        fattest->queue.pop_front();
+        --m_Size;
+        ++m_OverLimit;
       }
 
-      llarp_time_t firstPut         = 0;
-      size_t dropNum                = 0;
-      llarp_time_t nextTickInterval = initialIntervalMs;
-      Mutex_t m_QueueMutex;
-      std::priority_queue< T, std::vector< T >, Compare > m_Queue;
       std::string m_name;
+      size_t m_Limit;
+      Mutex_t m_QueueMutex;
+      std::array< Flow, NumFlows > m_Flows;
+      std::list< Flow* > m_NewFlows;
+      std::list< Flow* > m_OldFlows;
+      size_t m_Size        = 0;
+      uint64_t m_OverLimit = 0;
     };
   }  // namespace util
 }  // namespace llarp
@@ -178,33 +178,6 @@ struct iwp_async_frame
   byte_t buf[1500];
 };
 
-// TODO: remove
-struct FramePutTime
-{
-  void
-  operator()(iwp_async_frame *frame) const
-  {
-    frame->created = llarp_time_now_ms();
-  }
-};
-struct FrameGetTime
-{
-  llarp_time_t
-  operator()(const iwp_async_frame *frame) const
-  {
-    return frame->created;
-  }
-};
-
-struct FrameCompareTime
-{
-  bool
-  operator()(const iwp_async_frame *left, iwp_async_frame *right) const
-  {
-    return left->created < right->created;
-  }
-};
-
 /// synchronously decrypt a frame
 bool
 iwp_decrypt_frame(struct iwp_async_frame *frame);
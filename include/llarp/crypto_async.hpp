@@ -0,0 +1,66 @@
+#ifndef LLARP_CRYPTO_ASYNC_HPP
+#define LLARP_CRYPTO_ASYNC_HPP
+
+#include <llarp/crypto_async.h>
+#include <llarp/buffer_pool.hpp>
+
+#include <new>
+
+namespace llarp
+{
+  /// a frame from the buffer pool, nullptr if the pool is at its cap
+  inline iwp_async_frame *
+  AllocIWPFrame()
+  {
+    void *ptr = BufferPool::Alloc(sizeof(iwp_async_frame));
+    if(ptr == nullptr)
+      return nullptr;
+    return new(ptr) iwp_async_frame;
+  }
+
+  /// give a frame from AllocIWPFrame back to the buffer pool
+  inline void
+  FreeIWPFrame(iwp_async_frame *frame)
+  {
+    BufferPool::Free(frame);
+  }
+}  // namespace llarp
+
+struct FramePutTime
+{
+  void
+  operator()(iwp_async_frame *frame) const
+  {
+    frame->created = llarp_time_now_ms();
+  }
+};
+
+struct FrameGetTime
+{
+  llarp_time_t
+  operator()(const iwp_async_frame *frame) const
+  {
+    return frame->created;
+  }
+};
+
+/// frames are queued per session
+struct FrameGetFlow
+{
+  size_t
+  operator()(const iwp_async_frame *frame) const
+  {
+    return reinterpret_cast< size_t >(frame->user);
+  }
+};
+
+struct FrameGetSize
+{
+  size_t
+  operator()(const iwp_async_frame *frame) const
+  {
+    return frame->sz;
+  }
+};
+
+#endif
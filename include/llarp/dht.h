@@ -45,7 +45,8 @@ struct llarp_router_lookup_job
 void
 llarp_dht_allow_transit(struct llarp_dht_context* ctx);
 
-/// put router as a dht peer
+/// put router we have a session with as a dht peer, it is never evicted
+/// to make room for others
 void
 llarp_dht_put_peer(struct llarp_dht_context* ctx, struct llarp_rc* rc);
 
@@ -1,94 +1,369 @@
 #ifndef LLARP_DHT_BUCKET_HPP
 #define LLARP_DHT_BUCKET_HPP
 
-#include <llarp/dht/kademlia.hpp>
+#include <llarp/crypto.h>
 #include <llarp/dht/key.hpp>
-#include <map>
+
+#include <algorithm>
+#include <list>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 namespace llarp
 {
   namespace dht
   {
+    /// kademlia routing table, bucket i holds keys sharing exactly i leading
+    /// bits with us and the last bucket holds everything closer. a full last
+    /// bucket splits in two, any other full bucket evicts its least recently
+    /// seen entry that is not pinned. closest queries only look at the
+    /// buckets that can hold the answer. k of 0 never splits or evicts, for
+    /// storage rather than routing
     template < typename Val_t >
     struct Bucket
     {
-      typedef std::map< Key_t, Val_t, XorMetric > BucketStorage_t;
+      /// entries per bucket
+      static constexpr size_t DefaultK = 20;
+      /// bits in a key, the most buckets we split into
+      static constexpr size_t KeyBits = 256;
+
+      Bucket(const Key_t& us, size_t k = DefaultK)
+          : m_Us(us), m_K(k), m_Buckets(1)
+      {
+      }
 
-      Bucket(const Key_t& us) : nodes(XorMetric(us)){};
+      /// number of leading bits a and b have in common
+      static size_t
+      PrefixLen(const Key_t& a, const Key_t& b)
+      {
+        for(size_t idx = 0; idx < KeyBits / 8; ++idx)
+        {
+          byte_t x = a.data()[idx] ^ b.data()[idx];
+          if(x == 0)
+            continue;
+          size_t bits = idx * 8;
+          while((x & 0x80) == 0)
+          {
+            x <<= 1;
+            ++bits;
+          }
+          return bits;
+        }
+        return KeyBits;
+      }
+
+      size_t
+      Size() const
+      {
+        return m_Items.size();
+      }
+
+      size_t
+      NumBuckets() const
+      {
+        return m_Buckets.size();
+      }
 
       bool
-      GetRandomNodeExcluding(Key_t& result,
-                             const std::set< Key_t >& exclude) const
+      HasNode(const Key_t& key) const
+      {
+        return m_Entries.find(key) != m_Entries.end();
+      }
+
+      /// returns nullptr if we don't have key
+      const Val_t*
+      GetNode(const Key_t& key) const
+      {
+        auto itr = m_Entries.find(key);
+        if(itr == m_Entries.end())
+          return nullptr;
+        return &itr->second.val;
+      }
+
+      /// visit every entry starting at the start'th, stops early when visit
+      /// returns false
+      template < typename Visit >
+      void
+      ForEach(Visit visit, size_t start = 0) const
       {
-        std::vector< Key_t > candidates;
-        for(const auto& item : nodes)
+        size_t num = m_Items.size();
+        for(size_t idx = 0; idx < num; ++idx)
         {
-          if(exclude.find(item.first) == exclude.end())
-            candidates.push_back(item.first);
+          if(!visit(m_Items[(start + idx) % num]->second.val))
+            return;
         }
-        if(candidates.size() == 0)
-          return false;
-        result = candidates[llarp_randint() % candidates.size()];
-        return true;
+      }
+
+      /// remove every entry pred returns true for
+      template < typename Pred >
+      size_t
+      RemoveIf(Pred pred)
+      {
+        size_t removed = 0;
+        size_t idx     = 0;
+        while(idx < m_Items.size())
+        {
+          if(pred(m_Items[idx]->second.val))
+          {
+            // Erase moves the last item into idx
+            Erase(m_Entries.find(m_Items[idx]->first));
+            ++removed;
+          }
+          else
+            ++idx;
+        }
+        return removed;
       }
 
       bool
-      FindClosest(const Key_t& target, Key_t& result) const
+      GetRandomNodeExcluding(Key_t& result,
+                             const std::set< Key_t >& exclude) const
       {
-        Key_t mindist;
-        mindist.Fill(0xff);
-        for(const auto& item : nodes)
+        size_t num = m_Items.size();
+        if(num == 0)
+          return false;
+        // probe forward from a random slot to the first one not excluded
+        size_t start = llarp_randint() % num;
+        for(size_t idx = 0; idx < num; ++idx)
         {
-          auto curDist = item.first ^ target;
-          if(curDist < mindist)
+          const Key_t& key = m_Items[(start + idx) % num]->first;
+          if(exclude.find(key) == exclude.end())
           {
-            mindist = curDist;
-            result  = item.first;
+            result = key;
+            return true;
           }
         }
-        return nodes.size() > 0;
+        return false;
+      }
+
+      bool
+      FindClosest(const Key_t& target, Key_t& result) const
+      {
+        return FindCloseExcluding(target, result, {});
       }
 
       bool
       FindCloseExcluding(const Key_t& target, Key_t& result,
                          const std::set< Key_t >& exclude) const
       {
-        Key_t maxdist;
-        maxdist.Fill(0xff);
+        bool found = false;
         Key_t mindist;
-        mindist.Fill(0xff);
-        for(const auto& item : nodes)
+        VisitByDistance(target, [&](size_t from, size_t to) -> bool {
+          for(size_t idx = from; idx <= to; ++idx)
+          {
+            for(const auto& key : m_Buckets[idx])
+            {
+              if(exclude.find(key) != exclude.end())
+                continue;
+              auto curDist = key ^ target;
+              if(!found || curDist < mindist)
+              {
+                found   = true;
+                mindist = curDist;
+                result  = key;
+              }
+            }
+          }
+          return found;
+        });
+        return found;
+      }
+
+      /// put up to k keys closest to target in result, closest first
+      bool
+      FindClosestK(const Key_t& target, size_t k, std::vector< Key_t >& result,
+                   const std::set< Key_t >& exclude = {}) const
+      {
+        result.clear();
+        if(k == 0)
+          return false;
+        std::vector< Key_t > group;
+        VisitByDistance(target, [&](size_t from, size_t to) -> bool {
+          group.clear();
+          for(size_t idx = from; idx <= to; ++idx)
+          {
+            for(const auto& key : m_Buckets[idx])
+            {
+              if(exclude.find(key) == exclude.end())
+                group.push_back(key);
+            }
+          }
+          size_t want = std::min(k - result.size(), group.size());
+          std::partial_sort(group.begin(), group.begin() + want, group.end(),
+                            [&target](const Key_t& a, const Key_t& b) {
+                              return (a ^ target) < (b ^ target);
+                            });
+          result.insert(result.end(), group.begin(), group.begin() + want);
+          return result.size() == k;
+        });
+        return result.size() > 0;
+      }
+
+      /// add or update val, either way it becomes the most recently seen.
+      /// pinned entries are never evicted and stay until DelNode, a full
+      /// bucket with nothing left to evict takes a pinned val over k and
+      /// drops any other
+      void
+      PutNode(const Val_t& val, bool pinned = false)
+      {
+        auto itr = m_Entries.find(val.ID);
+        if(itr != m_Entries.end())
         {
-          if(exclude.find(item.first) != exclude.end())
-            continue;
-          auto curDist = item.first ^ target;
-          if(curDist < mindist)
+          Entry& ent = itr->second;
+          ent.val    = val;
+          if(pinned)
+            ent.pinned = true;
+          auto& lru = m_Buckets[ent.bucket];
+          lru.splice(lru.end(), lru, ent.lru);
+          return;
+        }
+        size_t idx = BucketFor(val.ID);
+        while(m_K && m_Buckets[idx].size() >= m_K)
+        {
+          if(idx + 1 == m_Buckets.size() && idx + 1 < KeyBits)
           {
-            mindist = curDist;
-            result  = item.first;
+            Split();
+            idx = BucketFor(val.ID);
+            continue;
           }
+          auto evict = OldestUnpinned(idx);
+          if(evict != m_Entries.end())
+            Erase(evict);
+          else if(pinned)
+            break;
+          else
+            return;
+        }
+        auto& lru = m_Buckets[idx];
+        lru.push_back(val.ID);
+        Entry ent;
+        ent.val    = val;
+        ent.pinned = pinned;
+        ent.bucket = idx;
+        ent.pos    = m_Items.size();
+        ent.lru    = std::prev(lru.end());
+        auto put   = m_Entries.emplace(val.ID, ent);
+        m_Items.push_back(&*put.first);
+      }
+
+      void
+      DelNode(const Key_t& key)
+      {
+        auto itr = m_Entries.find(key);
+        if(itr != m_Entries.end())
+          Erase(itr);
+      }
+
+     private:
+      typedef std::list< Key_t > LRU_t;
+
+      struct Entry
+      {
+        Val_t val;
+        /// never evicted
+        bool pinned;
+        /// which bucket we are in
+        size_t bucket;
+        /// index in m_Items
+        size_t pos;
+        typename LRU_t::iterator lru;
+      };
+
+      typedef std::unordered_map< Key_t, Entry, Key_t::Hash > Storage_t;
+
+      size_t
+      BucketFor(const Key_t& key) const
+      {
+        return std::min(PrefixLen(key, m_Us), m_Buckets.size() - 1);
+      }
+
+      /// the least recently seen entry in bucket idx we may evict, end if
+      /// they are all pinned
+      typename Storage_t::iterator
+      OldestUnpinned(size_t idx)
+      {
+        for(const auto& key : m_Buckets[idx])
+        {
+          auto itr = m_Entries.find(key);
+          if(!itr->second.pinned)
+            return itr;
         }
-        return mindist < maxdist;
+        return m_Entries.end();
       }
 
+      /// calls visit(from, to) with ranges of buckets in order of distance
+      /// from target, stops when visit returns true. every key in a range is
+      /// closer to target than every key in the ranges after it
+      template < typename Visit >
       void
-      PutNode(const Val_t& val)
+      VisitByDistance(const Key_t& target, Visit visit) const
       {
-        nodes[val.ID] = val;
+        size_t last = m_Buckets.size() - 1;
+        size_t idx  = BucketFor(target);
+        // keys in target's bucket differ from it below its prefix length
+        if(visit(idx, idx))
+          return;
+        // keys deeper than target all first differ from it at that same bit
+        if(idx < last && visit(idx + 1, last))
+          return;
+        // shallower keys get further the shorter their prefix is
+        while(idx--)
+        {
+          if(visit(idx, idx))
+            return;
+        }
       }
 
+      /// move everything deeper than the last bucket's prefix to a new one
       void
-      DelNode(const Key_t& key)
+      Split()
       {
-        auto itr = nodes.find(key);
-        if(itr != nodes.end())
-          nodes.erase(itr);
+        size_t depth = m_Buckets.size() - 1;
+        m_Buckets.emplace_back();
+        auto& from = m_Buckets[depth];
+        auto& to   = m_Buckets.back();
+        auto itr   = from.begin();
+        while(itr != from.end())
+        {
+          auto next = std::next(itr);
+          if(PrefixLen(*itr, m_Us) > depth)
+          {
+            Entry& ent = m_Entries.find(*itr)->second;
+            ent.bucket = depth + 1;
+            // splice keeps lru order and ent.lru valid
+            to.splice(to.end(), from, itr);
+          }
+          itr = next;
+        }
       }
 
-      BucketStorage_t nodes;
+      void
+      Erase(typename Storage_t::iterator itr)
+      {
+        Entry& ent = itr->second;
+        m_Buckets[ent.bucket].erase(ent.lru);
+        // fill the hole in m_Items with the last item
+        auto moved           = m_Items.back();
+        m_Items[ent.pos]     = moved;
+        moved->second.pos    = ent.pos;
+        m_Items.pop_back();
+        m_Entries.erase(itr);
+      }
+
+      Key_t m_Us;
+      size_t m_K;
+      Storage_t m_Entries;
+      /// every entry by index, for random picks and iteration
+      std::vector< typename Storage_t::value_type* > m_Items;
+      /// each bucket's keys, least recently seen first
+      std::vector< LRU_t > m_Buckets;
     };
+
+    template < typename Val_t >
+    constexpr size_t Bucket< Val_t >::DefaultK;
+    template < typename Val_t >
+    constexpr size_t Bucket< Val_t >::KeyBits;
   }  // namespace dht
 }  // namespace llarp
-#endif
\ No newline at end of file
+#endif
@@ -5,19 +5,28 @@
 #include <llarp/router.h>
 #include <llarp/dht/bucket.hpp>
 #include <llarp/dht/key.hpp>
+#include <llarp/dht/lookup_cache.hpp>
 #include <llarp/dht/message.hpp>
 #include <llarp/dht/node.hpp>
 #include <llarp/dht/search_job.hpp>
 #include <llarp/service/IntroSet.hpp>
 
+#include <functional>
+#include <memory>
 #include <set>
 
 namespace llarp
 {
+  struct ILinkMessage;
+
   namespace dht
   {
     struct Context
     {
+      /// hands msg for peer to the router, which frees it
+      typedef std::function< void(const Key_t&, const ILinkMessage*) >
+          SendFunc;
+
       Context();
       ~Context();
 
@@ -34,16 +43,17 @@ namespace llarp
                           bool iterateive            = false,
                           std::set< Key_t > excludes = {});
 
+      /// look up a router by asking our closest peers, replies to whoasked
+      /// if that isn't us
       void
       LookupRouter(const Key_t& target, const Key_t& whoasked,
-                   uint64_t whoaskedTX, const Key_t& askpeer,
-                   llarp_router_lookup_job* job = nullptr,
+                   uint64_t whoaskedTX, llarp_router_lookup_job* job = nullptr,
                    bool iterative = false, std::set< Key_t > excludes = {});
 
       void
       LookupIntroSet(const service::Address& addr, const Key_t& whoasked,
-                     uint64_t whoaskedTX, const Key_t& askpeer,
-                     bool interative = false, std::set< Key_t > excludes = {});
+                     uint64_t whoaskedTX, bool iterative = false,
+                     std::set< Key_t > excludes = {});
 
       void
       LookupTag(const service::Tag& tag, const Key_t& whoasked,
@@ -60,12 +70,28 @@ namespace llarp
 
       void
       LookupIntroSetForPath(const service::Address& addr, uint64_t txid,
-                            const llarp::PathID_t& path, const Key_t& askpeer);
+                            const llarp::PathID_t& path);
+
+      /// a peer answered a router lookup request, rc is nullptr if it
+      /// didn't have it. an rc that isn't the target's or isn't signed
+      /// counts as a miss
+      void
+      RouterLookupReply(const SearchJob& job, const llarp_rc* rc);
+
+      /// a peer answered an introset lookup request, introsets for other
+      /// addresses or already expired are ignored
+      void
+      IntroSetLookupReply(const SearchJob& job,
+                          const std::vector< service::IntroSet >& introsets);
+
+      /// deliver a router lookup result, sending it on to the requester
+      void
+      FoundRouter(const SearchJob& job, const llarp_rc* rc);
 
       void
       LookupIntroSetRelayed(const Key_t& requester, uint64_t txid,
                             const service::Address& addr, bool recursive,
-                            std::vector< IMessage* >& reply);
+                            MessageList& reply);
 
       std::set< service::IntroSet >
       FindRandomIntroSetsWithTag(const service::Tag& tag, size_t max = 2);
@@ -73,7 +99,7 @@ namespace llarp
       void
       LookupRouterRelayed(const Key_t& requester, uint64_t txid,
                           const Key_t& target, bool recursive,
-                          std::vector< IMessage* >& replies);
+                          MessageList& replies);
 
       bool
       RelayRequestForPath(const llarp::PathID_t& localPath,
@@ -87,6 +113,15 @@ namespace llarp
       void
       Init(const Key_t& us, llarp_router* router);
 
+      /// set up without a router, messages to peers go to send and found
+      /// rcs are checked with crypto
+      void
+      Init(const Key_t& us, llarp_crypto* crypto, SendFunc send);
+
+      /// time out requests, a timed out lookup request counts as a miss
+      void
+      CleanupTX();
+
       const llarp::service::IntroSet*
       GetIntroSetByServiceAddress(const llarp::service::Address& addr) const;
 
@@ -100,6 +135,8 @@ namespace llarp
       queue_router_lookup(void* user);
 
       llarp_router* router = nullptr;
+      llarp_crypto* crypto = nullptr;
+      SendFunc sendToPeer;
       // for router contacts
       Bucket< RCNode >* nodes = nullptr;
 
@@ -107,6 +144,9 @@ namespace llarp
       Bucket< ISNode >* services = nullptr;
       bool allowTransit          = false;
 
+      LookupCache< std::shared_ptr< llarp_rc > > routerCache;
+      LookupCache< std::vector< service::IntroSet > > introSetCache;
+
       const Key_t&
       OurKey() const
       {
@@ -117,8 +157,55 @@ namespace llarp
       void
       ScheduleCleanupTimer();
 
+      /// rc is target's and signed by it
+      bool
+      ValidRouter(const Key_t& target, const llarp_rc* rc);
+
+      typedef std::shared_ptr< IterativeLookup > Lookup_ptr;
+      typedef std::unordered_multimap< Key_t, Lookup_ptr, Key_t::Hash >
+          Lookups_t;
+
+      /// answer job from the cache, join a lookup already running for its
+      /// target with the same excludes and iterative flag, or ask the
+      /// closest peers for it
       void
-      CleanupTX();
+      StartLookup(const SearchJob& job, IterativeLookup::Kind kind,
+                  bool iterative);
+
+      /// returns true if job was answered from the cache
+      bool
+      LookupFromCache(const SearchJob& job, IterativeLookup::Kind kind);
+
+      /// keep alpha requests in flight, finishing as not found once no
+      /// peers are left to ask
+      void
+      ContinueLookup(const Lookup_ptr& lookup);
+
+      void
+      AskPeer(const Key_t& peer, const Lookup_ptr& lookup);
+
+      /// a request answered without a result or timed out
+      void
+      LookupMissed(const Lookup_ptr& lookup);
+
+      /// deliver to every waiter, rc is nullptr for not found
+      void
+      FinishRouterLookup(const Lookup_ptr& lookup, const llarp_rc* rc);
+
+      void
+      FinishIntroSetLookup(const Lookup_ptr& lookup,
+                           const std::vector< service::IntroSet >& introsets);
+
+      /// stop other lookups from joining lookup
+      void
+      RemoveLookup(const Lookup_ptr& lookup);
+
+      Lookups_t&
+      LookupsFor(IterativeLookup::Kind kind)
+      {
+        return kind == IterativeLookup::eRouter ? routerLookups
+                                                : introSetLookups;
+      }
 
       uint64_t ids;
 
@@ -151,6 +238,10 @@ namespace llarp
       };  // namespace dht
 
       std::unordered_map< TXOwner, SearchJob, TXOwnerHash > pendingTX;
+      /// lookups in flight by target, more than one per target if they
+      /// differ in excludes or iterative flag
+      Lookups_t routerLookups;
+      Lookups_t introSetLookups;
       Key_t ourKey;
     };  // namespace llarp
   }     // namespace dht
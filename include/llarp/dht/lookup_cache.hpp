@@ -0,0 +1,155 @@
+#ifndef LLARP_DHT_LOOKUP_CACHE_HPP
+#define LLARP_DHT_LOOKUP_CACHE_HPP
+
+#include <llarp/dht/key.hpp>
+#include <llarp/time.h>
+
+#include <list>
+#include <ostream>
+#include <unordered_map>
+
+namespace llarp
+{
+  namespace dht
+  {
+    struct LookupCacheStats
+    {
+      /// gets answered with a cached result
+      uint64_t hits = 0;
+      /// gets answered with a cached not found
+      uint64_t negativeHits = 0;
+      uint64_t misses       = 0;
+
+      /// fraction of gets answered from the cache
+      double
+      HitRate() const
+      {
+        uint64_t total = hits + negativeHits + misses;
+        return total ? double(hits + negativeHits) / total : 0.0;
+      }
+
+      friend std::ostream &
+      operator<<(std::ostream &out, const LookupCacheStats &st)
+      {
+        return out << "hits=" << st.hits << " negative=" << st.negativeHits
+                   << " misses=" << st.misses << " rate=" << st.HitRate();
+      }
+    };
+
+    /// lookup results by target, both found and not found, until they
+    /// expire. when full the least recently used entry goes first
+    template < typename Val_t >
+    struct LookupCache
+    {
+      static constexpr size_t DefaultMax = 1024;
+      /// how long we believe nobody has something
+      static constexpr llarp_time_t NegativeTTL = 10000;
+
+      struct Entry
+      {
+        Val_t val;
+        bool found;
+        llarp_time_t expires;
+        typename std::list< Key_t >::iterator lru;
+      };
+
+      LookupCache(size_t max = DefaultMax) : m_Max(max)
+      {
+      }
+
+      /// returns nullptr if we have nothing unexpired for key
+      const Entry *
+      Get(const Key_t &key, llarp_time_t now)
+      {
+        auto itr = m_Entries.find(key);
+        if(itr == m_Entries.end() || itr->second.expires <= now)
+        {
+          ++stats.misses;
+          return nullptr;
+        }
+        Entry &ent = itr->second;
+        m_LRU.splice(m_LRU.end(), m_LRU, ent.lru);
+        if(ent.found)
+          ++stats.hits;
+        else
+          ++stats.negativeHits;
+        return &ent;
+      }
+
+      /// remember val for key until expires
+      void
+      Put(const Key_t &key, const Val_t &val, llarp_time_t expires)
+      {
+        Insert(key, val, true, expires);
+      }
+
+      /// remember nobody had key
+      void
+      PutMissing(const Key_t &key, llarp_time_t now)
+      {
+        Insert(key, Val_t(), false, now + NegativeTTL);
+      }
+
+      void
+      Expire(llarp_time_t now)
+      {
+        auto itr = m_Entries.begin();
+        while(itr != m_Entries.end())
+        {
+          if(itr->second.expires <= now)
+          {
+            m_LRU.erase(itr->second.lru);
+            itr = m_Entries.erase(itr);
+          }
+          else
+            ++itr;
+        }
+      }
+
+      size_t
+      Size() const
+      {
+        return m_Entries.size();
+      }
+
+      LookupCacheStats stats;
+
+     private:
+      void
+      Insert(const Key_t &key, const Val_t &val, bool found,
+             llarp_time_t expires)
+      {
+        auto itr = m_Entries.find(key);
+        if(itr == m_Entries.end())
+        {
+          if(m_Entries.size() >= m_Max)
+          {
+            m_Entries.erase(m_LRU.front());
+            m_LRU.pop_front();
+          }
+          m_LRU.push_back(key);
+          Entry ent;
+          ent.lru = std::prev(m_LRU.end());
+          itr     = m_Entries.emplace(key, ent).first;
+        }
+        else
+          m_LRU.splice(m_LRU.end(), m_LRU, itr->second.lru);
+        itr->second.val     = val;
+        itr->second.found   = found;
+        itr->second.expires = expires;
+      }
+
+      size_t m_Max;
+      std::unordered_map< Key_t, Entry, Key_t::Hash > m_Entries;
+      /// least recently used first
+      std::list< Key_t > m_LRU;
+    };
+
+    template < typename Val_t >
+    constexpr size_t LookupCache< Val_t >::DefaultMax;
+    template < typename Val_t >
+    constexpr llarp_time_t LookupCache< Val_t >::NegativeTTL;
+  }  // namespace dht
+}  // namespace llarp
+
+#endif
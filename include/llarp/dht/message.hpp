@@ -1,6 +1,7 @@
 #ifndef LLARP_DHT_MESSAGE_HPP
 #define LLARP_DHT_MESSAGE_HPP
 #include <llarp/dht.h>
+#include <llarp/arena.hpp>
 #include <llarp/bencode.hpp>
 #include <llarp/dht/key.hpp>
 #include <llarp/path_types.hpp>
@@ -12,6 +13,12 @@ namespace llarp
   {
     constexpr size_t MAX_MSG_SIZE = 2048;
 
+    struct IMessage;
+
+    /// dht messages carried together, decoded ones and their list live in
+    /// the parse arena when the list has one
+    typedef std::vector< IMessage*, ArenaAllocator< IMessage* > > MessageList;
+
     struct IMessage : public llarp::IBEncodeMessage
     {
       virtual ~IMessage(){};
@@ -22,19 +29,22 @@ namespace llarp
       }
 
       virtual bool
-      HandleMessage(llarp_dht_context* dht,
-                    std::vector< IMessage* >& replies) const = 0;
+      HandleMessage(llarp_dht_context* dht, MessageList& replies) const = 0;
 
       Key_t From;
       PathID_t pathID;
     };
 
+    /// decode one message, made in arena when there is one
     IMessage*
-    DecodeMessage(const Key_t& from, llarp_buffer_t* buf, bool relayed = false);
+    DecodeMessage(const Key_t& from, llarp_buffer_t* buf, bool relayed = false,
+                  Arena* arena = nullptr);
 
+    /// decode a list of messages into dst, from dst's arena if it has one
+    /// otherwise the caller owns what was added
     bool
     DecodeMesssageList(const Key_t& from, llarp_buffer_t* buf,
-                       std::vector< IMessage* >& dst, bool relayed = false);
+                       MessageList& dst, bool relayed = false);
   }  // namespace dht
 }  // namespace llarp
 
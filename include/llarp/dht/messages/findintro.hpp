@@ -43,8 +43,7 @@ namespace llarp
       DecodeKey(llarp_buffer_t key, llarp_buffer_t* val);
 
       bool
-      HandleMessage(llarp_dht_context* ctx,
-                    std::vector< IMessage* >& replies) const;
+      HandleMessage(llarp_dht_context* ctx, MessageList& replies) const;
     };
   }  // namespace dht
 }  // namespace llarp
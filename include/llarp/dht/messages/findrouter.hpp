@@ -26,8 +26,7 @@ namespace llarp
       DecodeKey(llarp_buffer_t key, llarp_buffer_t* val);
 
       virtual bool
-      HandleMessage(llarp_dht_context* ctx,
-                    std::vector< IMessage* >& replies) const;
+      HandleMessage(llarp_dht_context* ctx, MessageList& replies) const;
 
       Key_t K;
       bool iterative   = false;
@@ -46,8 +45,7 @@ namespace llarp
       /// the path of the result
       /// TODO: smart path expiration logic needs to be implemented
       virtual bool
-      HandleMessage(llarp_dht_context* ctx,
-                    std::vector< IMessage* >& replies) const;
+      HandleMessage(llarp_dht_context* ctx, MessageList& replies) const;
     };
   }  // namespace dht
 }  // namespace llarp
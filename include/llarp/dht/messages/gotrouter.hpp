@@ -31,8 +31,7 @@ namespace llarp
       DecodeKey(llarp_buffer_t key, llarp_buffer_t* val);
 
       virtual bool
-      HandleMessage(llarp_dht_context* ctx,
-                    std::vector< IMessage* >& replies) const;
+      HandleMessage(llarp_dht_context* ctx, MessageList& replies) const;
 
       std::vector< llarp_rc > R;
       uint64_t txid    = 0;
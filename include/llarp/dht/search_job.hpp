@@ -6,6 +6,7 @@
 #include <functional>
 #include <llarp/dht/key.hpp>
 #include <llarp/service/IntroSet.hpp>
+#include <memory>
 #include <set>
 #include <vector>
 
@@ -13,6 +14,8 @@ namespace llarp
 {
   namespace dht
   {
+    struct IterativeLookup;
+
     /// TODO: this should be made into a templated type
     struct SearchJob
     {
@@ -55,6 +58,51 @@ namespace llarp
       uint64_t requesterTX;
       Key_t target;
       std::set< Key_t > exclude;
+      /// set if this is one request of an iterative lookup
+      std::shared_ptr< IterativeLookup > lookup;
+    };
+
+    /// state of one lookup, shared by every request it has in flight. we
+    /// ask the closest peers we know alpha at a time and take the first
+    /// answer that has a result, each peer that misses or times out is
+    /// replaced with the next closest one until the shortlist runs out.
+    /// lookups for a target already being looked up the same way, iterative
+    /// or not and skipping the same peers, wait on that one
+    struct IterativeLookup
+    {
+      enum Kind
+      {
+        eRouter,
+        eIntroSet
+      };
+
+      /// requests in flight at once for lookups we started
+      static const size_t Alpha = 3;
+      /// most peers one lookup will ask
+      static const size_t ShortlistSize = 8;
+      /// how long a peer gets to answer before we move on
+      static const uint64_t RequestTimeout = 5000;
+
+      Kind kind;
+      Key_t target;
+      /// ask peers for an iterative rather than recursive lookup
+      bool iterative = false;
+      /// peers the lookup was started without
+      std::set< Key_t > exclude;
+      /// requests in flight at once, 1 while only relaying for someone else
+      /// so a recursive lookup does not fan out again at every hop
+      size_t alpha = Alpha;
+      /// peers to ask, closest first
+      std::vector< Key_t > shortlist;
+      /// index of the next peer in shortlist to ask
+      size_t next     = 0;
+      size_t inflight = 0;
+      /// peers that answered without a result
+      size_t misses = 0;
+      /// the result, or that there is none, was delivered
+      bool done = false;
+      /// everyone waiting on the result
+      std::vector< SearchJob > waiters;
     };
   }  // namespace dht
 }  // namespace llarp
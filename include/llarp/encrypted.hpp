@@ -4,11 +4,13 @@
 #include <llarp/bencode.h>
 #include <llarp/buffer.h>
 #include <sodium.h>
+#include <cstring>
 #include <vector>
 
 namespace llarp
 {
-  /// encrypted buffer base type
+  /// encrypted buffer base type. owns a copy of its data unless it was
+  /// made to borrow someone else's, crypto works in place either way
   struct Encrypted
   {
     Encrypted(Encrypted&&) = delete;
@@ -26,8 +28,7 @@ namespace llarp
     Encrypted&
     operator=(llarp_buffer_t buf)
     {
-      if(_data)
-        delete[] _data;
+      Release();
       _sz   = buf.sz;
       _data = new byte_t[_sz];
       memcpy(_data, buf.base, _sz);
@@ -35,6 +36,37 @@ namespace llarp
       return *this;
     }
 
+    /// point at buf without copying it, buf must outlive us or Own() must be
+    /// called before it goes away
+    void
+    Borrow(llarp_buffer_t buf)
+    {
+      Release();
+      _sz     = buf.sz;
+      _data   = buf.base;
+      m_Owned = false;
+      UpdateBuffer();
+    }
+
+    /// copy borrowed data so we no longer depend on where it came from
+    void
+    Own()
+    {
+      if(m_Owned || _data == nullptr)
+        return;
+      byte_t* borrowed = _data;
+      _data            = new byte_t[_sz];
+      memcpy(_data, borrowed, _sz);
+      m_Owned = true;
+      UpdateBuffer();
+    }
+
+    bool
+    IsBorrowed() const
+    {
+      return !m_Owned;
+    }
+
     void
     Fill(byte_t fill)
     {
@@ -58,12 +90,20 @@ namespace llarp
         return false;
       if(strbuf.sz == 0)
         return false;
-      if(_data)
-        delete[] _data;
-      _sz   = strbuf.sz;
-      _data = new byte_t[_sz];
-      memcpy(_data, strbuf.base, _sz);
-      UpdateBuffer();
+      *this = strbuf;
+      return true;
+    }
+
+    /// decode without copying, we borrow from buf, see Borrow
+    bool
+    BDecodeBorrowed(llarp_buffer_t* buf)
+    {
+      llarp_buffer_t strbuf;
+      if(!bencode_read_string(buf, &strbuf))
+        return false;
+      if(strbuf.sz == 0)
+        return false;
+      Borrow(strbuf);
       return true;
     }
 
@@ -105,8 +145,21 @@ namespace llarp
       m_Buffer.cur  = data();
       m_Buffer.sz   = size();
     }
+
+    /// free our data if it is ours, we own nothing after
+    void
+    Release()
+    {
+      if(_data && m_Owned)
+        delete[] _data;
+      _data   = nullptr;
+      _sz     = 0;
+      m_Owned = true;
+    }
+
     byte_t* _data = nullptr;
     size_t _sz    = 0;
+    bool m_Owned  = true;
     llarp_buffer_t m_Buffer;
   };
 }  // namespace llarp
@@ -33,8 +33,7 @@ namespace llarp
     EncryptedFrame&
     operator=(const EncryptedFrame& other)
     {
-      if(_data)
-        delete[] _data;
+      Release();
       _sz   = other._sz;
       _data = new byte_t[_sz];
       memcpy(_data, other._data, _sz);
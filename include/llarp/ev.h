@@ -31,6 +31,11 @@ struct llarp_ev_loop;
 void
 llarp_ev_loop_alloc(struct llarp_ev_loop **ev);
 
+/// allocate a named backend ("epoll", "io_uring"), falls back to the
+/// platform default when it is unknown or can't be set up
+void
+llarp_ev_loop_alloc_backend(struct llarp_ev_loop **ev, const char *backend);
+
 // deallocator
 void
 llarp_ev_loop_free(struct llarp_ev_loop **ev);
@@ -44,10 +49,23 @@ llarp_ev_loop_run_single_process(struct llarp_ev_loop *ev,
                                  struct llarp_threadpool *tp,
                                  struct llarp_logic *logic);
 
+/// run event loop without a logic attached, for extra network io threads
+/// returns once llarp_ev_loop_stop is called
+int
+llarp_ev_loop_run_io(struct llarp_ev_loop *ev);
+
 /// stop event loop and wait for it to complete all jobs
 void
 llarp_ev_loop_stop(struct llarp_ev_loop *ev);
 
+/// set batched UDP io parameters for sockets added after this call
+/// batch is the number of datagrams moved per syscall, 0 disables batching
+/// flush is how many queued outbound datagrams force an immediate send from
+/// the sending thread, 0 means flush only once per event loop iteration
+void
+llarp_ev_loop_set_udp_batch(struct llarp_ev_loop *ev, size_t batch,
+                            size_t flush);
+
 /// UDP handling configuration
 struct llarp_udp_io
 {
@@ -65,6 +83,13 @@ int
 llarp_ev_add_udp(struct llarp_ev_loop *ev, struct llarp_udp_io *udp,
                  const struct sockaddr *src);
 
+/// add UDP handler bound to an address shared with other UDP handlers
+/// (SO_REUSEPORT), the kernel spreads datagrams between them
+/// returns -1 if the platform can't share the address
+int
+llarp_ev_add_udp_shared(struct llarp_ev_loop *ev, struct llarp_udp_io *udp,
+                        const struct sockaddr *src);
+
 /// schedule UDP packet
 int
 llarp_ev_udp_sendto(struct llarp_udp_io *udp, const struct sockaddr *to,
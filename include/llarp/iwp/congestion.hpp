@@ -0,0 +1,141 @@
+#pragma once
+
+#include "llarp/types.h"
+
+#include <deque>
+#include <iostream>
+
+/// snapshot of a session's transmit state
+struct iwp_session_stats
+{
+  llarp_time_t srtt   = 0;
+  llarp_time_t rttvar = 0;
+  llarp_time_t rto    = 0;
+  llarp_time_t minrtt = 0;
+  /// estimated bottleneck bandwidth in bytes per second
+  uint64_t btlbw = 0;
+  /// congestion window in bytes
+  size_t cwnd = 0;
+  /// bytes sent and not yet acked
+  size_t inflight = 0;
+  /// messages waiting for window
+  size_t pending     = 0;
+  uint64_t delivered = 0;
+  uint64_t retransmits = 0;
+  uint64_t timeouts    = 0;
+  /// inbound frames dropped because decryption fell behind
+  uint64_t rxdropped = 0;
+  const char *mode   = "";
+
+  friend std::ostream &
+  operator<<(std::ostream &out, const iwp_session_stats &st)
+  {
+    return out << "srtt=" << st.srtt << " rttvar=" << st.rttvar
+               << " rto=" << st.rto << " minrtt=" << st.minrtt
+               << " btlbw=" << st.btlbw << " cwnd=" << st.cwnd
+               << " inflight=" << st.inflight << " pending=" << st.pending
+               << " delivered=" << st.delivered
+               << " retransmits=" << st.retransmits
+               << " timeouts=" << st.timeouts << " rxdropped=" << st.rxdropped
+               << " mode=" << st.mode;
+  }
+};
+
+/// rtt estimation (rfc 6298) and a delay based congestion window modeled on
+/// bbr, the window tracks bottleneck bandwidth times min rtt instead of
+/// reacting to loss
+struct congestion_control
+{
+  static constexpr llarp_time_t InitialRTO = 1000;
+  static constexpr llarp_time_t MinRTO     = 200;
+  static constexpr llarp_time_t MaxRTO     = 5000;
+  /// how long a min rtt sample is trusted
+  static constexpr llarp_time_t MinRTTWindow = 10000;
+  static constexpr size_t MinWindow          = 4 * 1024;
+  static constexpr size_t InitialWindow      = 32 * 1024;
+  static constexpr size_t MaxWindow          = 4 * 1024 * 1024;
+
+  enum Mode
+  {
+    eStartup,
+    eDrain,
+    eProbeBW
+  };
+
+  Mode mode = eStartup;
+
+  llarp_time_t srtt   = 0;
+  llarp_time_t rttvar = 0;
+  llarp_time_t rto    = InitialRTO;
+  /// rto before backoff
+  llarp_time_t baseRTO = InitialRTO;
+
+  llarp_time_t minRTT      = 0;
+  llarp_time_t minRTTStamp = 0;
+
+  /// delivery rate samples for the windowed max, bytes per second
+  std::deque< std::pair< llarp_time_t, uint64_t > > bwSamples;
+  uint64_t btlBw = 0;
+
+  size_t cwnd     = InitialWindow;
+  size_t inflight = 0;
+  /// total bytes acked
+  uint64_t delivered = 0;
+
+  /// round trip counting, a round ends when something sent after it
+  /// started gets acked
+  uint64_t roundDelivered = 0;
+  uint64_t rounds         = 0;
+  /// startup exits once bandwidth stops growing for a few rounds
+  uint64_t fullBw      = 0;
+  int fullBwRounds     = 0;
+  size_t cycleIndex    = 0;
+
+  uint64_t retransmits = 0;
+  uint64_t timeouts    = 0;
+
+  /// true if bytes more can go out now
+  bool
+  can_send(size_t bytes) const
+  {
+    return inflight == 0 || inflight + bytes <= cwnd;
+  }
+
+  void
+  on_send(size_t bytes)
+  {
+    inflight += bytes;
+  }
+
+  /// rtt measured from a packet that was never retransmitted
+  void
+  on_rtt_sample(llarp_time_t rtt, llarp_time_t now);
+
+  /// a message sent at sentAt when deliveredAtSend bytes had been delivered
+  /// was fully acked
+  void
+  on_delivered(size_t bytes, llarp_time_t sentAt, uint64_t deliveredAtSend,
+               llarp_time_t now);
+
+  /// a message was resent after acks showed missing fragments
+  void
+  on_retransmit()
+  {
+    ++retransmits;
+  }
+
+  /// nothing was heard for a whole rto
+  void
+  on_timeout();
+
+  void
+  fill_stats(iwp_session_stats &st) const;
+
+ private:
+  /// bandwidth delay product in bytes
+  size_t
+  bdp() const;
+
+  void
+  update_window();
+};
@@ -2,6 +2,7 @@
 
 #include <llarp/codel.hpp>
 #include <llarp/crypto.hpp>
+#include "congestion.hpp"
 #include "frame_header.hpp"
 #include "inbound_message.hpp"
 #include "llarp/logger.hpp"
@@ -11,6 +12,8 @@
 #include "sendqueue.hpp"
 #include "transit_message.hpp"
 
+#include <atomic>
+#include <deque>
 #include <queue>
 #include <unordered_map>
 
@@ -43,19 +46,22 @@ struct frame_state
   byte_t txflags         = 0;
   uint64_t rxids         = 0;
   uint64_t txids         = 0;
-  llarp_time_t lastEvent = 0;
+  /// bumped by handshake and data paths, read by the session tickers
+  std::atomic< llarp_time_t > lastEvent{0};
   std::unordered_map< uint64_t, llarp::ShortHash > rxIDs;
   std::unordered_map< llarp::ShortHash, transit_message *,
                       llarp::ShortHash::Hash >
       rx;
   std::unordered_map< uint64_t, transit_message * > tx;
+  /// ids of messages in tx waiting for congestion window
+  std::deque< uint64_t > txPending;
+  congestion_control cc;
 
   // typedef std::queue< sendbuf_t * > sendqueue_t;
 
-  typedef llarp::util::CoDelQueue<
-      InboundMessage *, InboundMessage::GetTime, InboundMessage::PutTime,
-      InboundMessage::OrderCompare, llarp::util::DummyMutex,
-      llarp::util::DummyLock >
+  /// reassembled messages we already acked, these must never be dropped
+  typedef llarp::util::FIFOQueue< InboundMessage *, llarp::util::DummyMutex,
+                                  llarp::util::DummyLock >
       recvqueue_t;
 
   llarp_link_session *parent = nullptr;
@@ -109,6 +115,13 @@ struct frame_state
   void
   retransmit(llarp_time_t now);
 
+  /// send queued messages while the congestion window allows
+  void
+  flush_tx(llarp_time_t now);
+
+  void
+  get_stats(iwp_session_stats &st) const;
+
   // get next frame to encrypt and transmit
   bool
   next_frame(llarp_buffer_t *buf);
@@ -12,8 +12,9 @@ struct InboundMessage
   std::vector< byte_t > msg;
   llarp_time_t queued = 0;
 
-  InboundMessage(uint64_t id, const std::vector< byte_t > &m)
-      : msgid(id), msg(m)
+  /// takes over the reassembled message, relays are forwarded in place
+  InboundMessage(uint64_t id, std::vector< byte_t > &&m)
+      : msgid(id), msg(std::move(m))
   {
   }
 
@@ -1,26 +1,32 @@
 #pragma once
 
 #include <llarp/buffer.h>
+#include <llarp/buffer_pool.hpp>
 #include <llarp/time.h>
+#include <new>
 #include <queue>
 
+/// outbound packet, header and data share one pooled block
 struct sendbuf_t
 {
-  sendbuf_t(size_t s) : sz(s)
+  /// nullptr if the buffer pool is at its cap
+  static sendbuf_t *
+  alloc(size_t s)
   {
-    _buf = new byte_t[s];
+    void *ptr = llarp::BufferPool::Alloc(sizeof(sendbuf_t) + s);
+    if(ptr == nullptr)
+      return nullptr;
+    return new(ptr) sendbuf_t(s);
   }
 
-  ~sendbuf_t()
+  static void
+  operator delete(void *ptr)
   {
-    if(_buf)
-      delete[] _buf;
+    llarp::BufferPool::Free(ptr);
   }
 
   size_t sz;
 
-  byte_t priority = 255;
-
   size_t
   size() const
   {
@@ -30,14 +36,14 @@ struct sendbuf_t
   byte_t *
   data()
   {
-    return _buf;
+    return reinterpret_cast< byte_t * >(this + 1);
   }
 
   llarp_buffer_t
   Buffer()
   {
     llarp_buffer_t buf;
-    buf.base = _buf;
+    buf.base = data();
     buf.sz   = sz;
     buf.cur  = buf.base;
     return buf;
@@ -61,17 +67,10 @@ struct sendbuf_t
     }
   };
 
-  struct Compare
-  {
-    bool
-    operator()(const sendbuf_t *left, const sendbuf_t *right) const
-    {
-      return left->priority < right->priority;
-    }
-  };
-
   llarp_time_t timestamp = 0;
 
  private:
-  byte_t *_buf = nullptr;
+  sendbuf_t(size_t s) : sz(s)
+  {
+  }
 };
@@ -3,9 +3,9 @@
 #include <llarp/codel.hpp>
 #include <llarp/iwp/sendbuf.hpp>
 
-typedef llarp::util::CoDelQueue<
-    sendbuf_t *, sendbuf_t::GetTime, sendbuf_t::PutTime, sendbuf_t::Compare,
-    llarp::util::DummyMutex, llarp::util::DummyLock >
+/// never drops, codel runs on the link shard's queue of encrypted frames
+typedef llarp::util::FIFOQueue< sendbuf_t *, llarp::util::DummyMutex,
+                                llarp::util::DummyLock >
     sendqueue_t;
 
 #endif
\ No newline at end of file
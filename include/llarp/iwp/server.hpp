@@ -7,15 +7,30 @@
 
 #include <algorithm>
 #include <fstream>
+#include <memory>
+#include <vector>
+
+namespace llarp
+{
+  namespace util
+  {
+    /// frames are dropped back into the buffer pool
+    template <>
+    struct CoDelDelete< iwp_async_frame * >
+    {
+      void
+      operator()(iwp_async_frame *frame) const
+      {
+        llarp::FreeIWPFrame(frame);
+      }
+    };
+  }  // namespace util
+}  // namespace llarp
 
 struct llarp_link
 {
-  /*
   typedef std::mutex mtx_t;
   typedef std::unique_lock< mtx_t > lock_t;
-  */
-  typedef llarp::util::DummyMutex mtx_t;
-  typedef llarp::util::DummyLock lock_t;
 
   llarp_router *router;
   llarp_crypto *crypto;
@@ -24,7 +39,6 @@ struct llarp_link
   llarp_async_iwp *iwp;
   llarp_threadpool *worker;
   llarp_link *parent = nullptr;
-  llarp_udp_io udp;
   llarp::Addr addr;
   char keyfile[255];
   uint32_t timeout_job_id;
@@ -41,8 +55,35 @@ struct llarp_link
                               llarp::Addr::Hash >
       LinkMap_t;
 
-  LinkMap_t m_sessions;
-  mtx_t m_sessions_Mutex;
+  /// frames waiting to be encrypted and sent, one codel flow per session
+  typedef llarp::util::FQCoDelQueue< iwp_async_frame *, FrameGetTime,
+                                     FramePutTime, FrameGetFlow, FrameGetSize >
+      OutboundFrameQueue_t;
+
+  /// one event loop's socket and the sessions it owns
+  struct Shard
+  {
+    llarp_ev_loop *netloop = nullptr;
+    llarp_udp_io udp;
+    LinkMap_t sessions;
+    mtx_t mutex;
+
+    OutboundFrameQueue_t outboundFrames;
+    /// true while a worker job is draining outboundFrames
+    std::atomic< bool > encrypting;
+    /// held by the worker while it has frames out of the queue
+    mtx_t encryptMutex;
+
+    Shard() : outboundFrames("iwp_outbound"), encrypting(false)
+    {
+    }
+  };
+
+  /// extra event loops to shard this link over, set before configure
+  std::vector< llarp_ev_loop * > shardloops;
+
+  /// shard 0 lives on netloop, the rest on shardloops
+  std::vector< std::unique_ptr< Shard > > m_shards;
 
   typedef std::unordered_map< llarp::PubKey, llarp::Addr, llarp::PubKey::Hash >
       SessionMap_t;
@@ -94,6 +135,15 @@ struct llarp_link
   bool
   has_session_via(const llarp::Addr &dst);
 
+  /// the shard that owns sessions with remote address addr, whose socket
+  /// the kernel hands datagrams from addr to
+  Shard &
+  shard_for(const llarp::Addr &addr);
+
+  /// bind one more shard socket on loop, returns false on failure
+  bool
+  add_shard(llarp_ev_loop *loop, bool shared);
+
   llarp_link_session *
   find_session(const llarp::Addr &addr);
 
@@ -110,12 +160,35 @@ struct llarp_link
   static void
   handle_logic_pump(void *user);
 
+  /// feed a datagram to the session for src under its shard's lock
+  void
+  recv_from(const llarp::Addr &src, const void *buf, size_t sz);
+
+  /// logic job for a handshake datagram handed over by a shard thread
+  static void
+  handle_handshake_packet(void *user);
+
   void
   PumpLogic();
 
   void
   RemoveSession(llarp_link_session *s);
 
+  /// queue a frame from session s to be encrypted and sent
+  void
+  put_outbound_frame(llarp_link_session *s, iwp_async_frame *frame);
+
+  /// start a worker on s's shard if it has frames waiting
+  void
+  pump_crypto_outbound(llarp_link_session *s);
+
+  /// drop frames queued by s, blocks while a worker is sending for its shard
+  void
+  purge_outbound_frames(llarp_link_session *s);
+
+  static void
+  handle_crypto_outbound(void *user);
+
   uint8_t *
   pubkey();
 
@@ -2,10 +2,13 @@
 
 #include <atomic>
 #include <llarp/codel.hpp>
+#include <mutex>
+#include <queue>
+#include <vector>
 #include "frame_state.hpp"
 #include "llarp/buffer.h"
 #include "llarp/crypto.hpp"
-#include "llarp/crypto_async.h"
+#include "llarp/crypto_async.hpp"
 #include "llarp/net.hpp"
 #include "llarp/router_contact.h"
 #include "llarp/time.h"
@@ -23,6 +26,8 @@ struct llarp_link_session
   static constexpr llarp_time_t SESSION_TIMEOUT     = 10000;
   static constexpr llarp_time_t KEEP_ALIVE_INTERVAL = SESSION_TIMEOUT / 4;
   static constexpr size_t MAX_PAD                   = 128;
+  /// inbound frames we buffer before dropping when crypto falls behind
+  static constexpr size_t MAX_INBOUND_BACKLOG = 1024;
 
   llarp_link_session(llarp_link *l, const byte_t *seckey, const llarp::Addr &a);
 
@@ -54,6 +59,10 @@ struct llarp_link_session
   CheckRCValid();
   bool
   IsEstablished();
+  /// true until the session start is sent, handshake states are only
+  /// touched on the logic thread
+  bool
+  IsHandshaking() const;
   void
   send_LIM();
   bool
@@ -94,13 +103,18 @@ struct llarp_link_session
   void
   TickLogic(llarp_time_t now);
 
-  // this is called from net thread
+  // called from a shard thread once the session start is sent, from the
+  // logic thread while handshaking
   void
   recv(const void *buf, size_t sz);
 
   llarp_router *
   Router();
 
+  /// rtt and congestion window state, logic thread only
+  iwp_session_stats
+  get_stats() const;
+
   llarp_udp_io *udp    = nullptr;
   llarp_crypto *crypto = nullptr;
   llarp_async_iwp *iwp = nullptr;
@@ -122,16 +136,18 @@ struct llarp_link_session
   uint32_t frames            = 0;
   std::atomic< bool > working;
 
-  llarp::util::CoDelQueue< iwp_async_frame *, FrameGetTime, FramePutTime,
-                           FrameCompareTime >
-      outboundFrames;
-  /*
-  std::mutex m_EncryptedFramesMutex;
-  std::queue< iwp_async_frame > encryptedFrames;
-  */
-  llarp::util::CoDelQueue< iwp_async_frame *, FrameGetTime, FramePutTime,
-                           FrameCompareTime >
-      decryptedFrames;
+  /// frames from the net thread waiting for a crypto worker
+  std::mutex m_InboundFramesMutex;
+  std::vector< iwp_async_frame * > inboundFrames;
+  /// true while a worker owns inboundFrames, guarded by m_InboundFramesMutex
+  bool decrypting = false;
+  /// decrypted frames in the order they arrived, drained on the logic thread
+  std::mutex m_DecryptedFramesMutex;
+  std::queue< iwp_async_frame * > decryptedFrames;
+  /// frames received but not processed yet
+  std::atomic< size_t > inboundBacklog;
+  /// frames dropped because the backlog was full
+  std::atomic< uint64_t > inboundDropped;
 
   llarp::Addr addr;
   iwp_async_intro intro;
@@ -158,19 +174,26 @@ struct llarp_link_session
     eTimeout
   };
 
-  State state;
+  /// written on the logic thread, read by shard threads in recv
+  std::atomic< State > state;
   void
   EnterState(State st);
 
   void
   add_outbound_message(uint64_t id, transit_message *msg);
-  void
-  EncryptOutboundFrames();
   iwp_async_frame *
   alloc_frame(const void *buf, size_t sz);
   void
   decrypt_frame(const void *buf, size_t sz);
 
+  /// true while a crypto worker may still touch this session
+  bool
+  crypto_busy();
+
+  /// worker job that decrypts queued inbound frames in order
+  static void
+  handle_decrypt_inbound(void *user);
+
   static void
   handle_frame_decrypt(iwp_async_frame *f);
 
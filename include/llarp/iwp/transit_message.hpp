@@ -6,7 +6,6 @@
 #include "xmit.hpp"
 
 #include <bitset>
-#include <unordered_map>
 #include <vector>
 
 struct transit_message
@@ -14,13 +13,21 @@ struct transit_message
   xmit msginfo;
   std::bitset< 32 > status = {};
 
-  typedef std::vector< byte_t > fragment_t;
-
-  std::unordered_map< byte_t, fragment_t > frags;
-  fragment_t lastfrag;
+  /// fragment buffers from the buffer pool, indexed by fragment number
+  std::vector< byte_t * > frags;
+  byte_t *lastfrag  = nullptr;
+  size_t lastfragsz = 0;
+  /// false if the buffer pool could not hold the whole message
+  bool allocated = true;
   llarp_time_t lastAck        = 0;
   llarp_time_t lastRetransmit = 0;
   llarp_time_t started;
+  /// when the xmit first went out, 0 while waiting for the window
+  llarp_time_t sentAt = 0;
+  /// session's delivered byte count when we were sent
+  uint64_t deliveredAtSend = 0;
+  /// set once anything was resent, acks after that can't be rtt samples
+  bool retransmitted = false;
 
   void
   clear();
@@ -36,6 +43,12 @@ struct transit_message
   // inbound
   transit_message(const xmit &x);
 
+  ~transit_message();
+
+  transit_message(const transit_message &) = delete;
+  transit_message &
+  operator=(const transit_message &) = delete;
+
   /// ack packets based off a bitmask
   void
   ack(uint32_t bitmask);
@@ -44,10 +57,14 @@ struct transit_message
   should_send_ack(llarp_time_t now) const;
 
   bool
-  should_resend_frags(llarp_time_t now) const;
+  should_resend_frags(llarp_time_t now, llarp_time_t rto) const;
 
   bool
-  should_resend_xmit(llarp_time_t now) const;
+  should_resend_xmit(llarp_time_t now, llarp_time_t rto) const;
+
+  /// bytes this message puts on the wire, without framing
+  size_t
+  wire_size() const;
   bool
   completed() const;
 
@@ -0,0 +1,52 @@
+#ifndef LLARP_KEY_POOL_HPP
+#define LLARP_KEY_POOL_HPP
+
+#include <llarp/crypto.hpp>
+#include <llarp/threading.hpp>
+#include <llarp/threadpool.h>
+
+#include <atomic>
+#include <vector>
+
+namespace llarp
+{
+  /// ephemeral encryption keypairs generated ahead of time on a worker so
+  /// path builds don't wait on keygen. must outlive any refill it started
+  struct KeyPool
+  {
+    /// keys we try to keep around, a path build takes 2 per hop
+    static constexpr size_t DefaultTarget = 64;
+
+    KeyPool(llarp_crypto* crypto, size_t target = DefaultTarget);
+
+    /// get a pre-generated key or make one now if we ran out
+    /// threadsafe
+    void
+    Take(SecretKey& key);
+
+    /// generate keys on worker if we are below half our target and aren't
+    /// already, threadsafe
+    void
+    MaybeRefill(llarp_threadpool* worker);
+
+    size_t
+    Size();
+
+    /// keys taken from the pool so far
+    std::atomic< uint64_t > hits;
+    /// keys generated on the spot because the pool was empty
+    std::atomic< uint64_t > misses;
+
+   private:
+    static void
+    HandleRefill(void* user);
+
+    llarp_crypto* m_Crypto;
+    size_t m_Target;
+    std::mutex m_Access;
+    std::vector< SecretKey > m_Keys;
+    std::atomic< bool > m_Refilling;
+  };
+}  // namespace llarp
+
+#endif
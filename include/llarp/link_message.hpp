@@ -1,6 +1,7 @@
 #ifndef LLARP_LINK_MESSAGE_HPP
 #define LLARP_LINK_MESSAGE_HPP
 
+#include <llarp/arena.hpp>
 #include <llarp/bencode.hpp>
 #include <llarp/router_id.hpp>
 
@@ -14,6 +15,12 @@ struct llarp_link_session_iter;
 namespace llarp
 {
   struct ILinkMessage;
+  struct RelayView;
+
+  namespace path
+  {
+    struct TransitHop;
+  }
 
   typedef std::queue< ILinkMessage* > SendQueue;
 
@@ -34,10 +41,6 @@ namespace llarp
   struct InboundMessageParser
   {
     InboundMessageParser(llarp_router* router);
-    dict_reader reader;
-
-    static bool
-    OnKey(dict_reader* r, llarp_buffer_t* buf);
 
     /// start processig message from a link session
     bool
@@ -52,10 +55,19 @@ namespace llarp
     RouterID
     GetCurrentFrom();
 
+    /// make an empty message of type in arena to decode into
+    bool
+    CreateMessage(byte_t type, Arena& arena);
+
+    /// the transit hop to forward buf through in place, nullptr if buf is
+    /// not a relay message we can forward without a full decode
+    path::TransitHop*
+    GetForwardingHop(llarp_buffer_t buf, RelayView& view);
+
    private:
-    bool firstkey;
     llarp_router* router;
     llarp_link_session* from;
+    /// in the thread's arena, only valid while in ProcessFrom
     ILinkMessage* msg = nullptr;
   };
 }  // namespace llarp
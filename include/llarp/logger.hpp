@@ -1,12 +1,14 @@
 #ifndef LLARP_LOGGER_HPP
 #define LLARP_LOGGER_HPP
 #include <llarp/time.h>
+#include <cstring>
 #include <ctime>
 #include <iomanip>
 #include <iostream>
 #include <llarp/threading.hpp>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #ifdef _WIN32
 #define VC_EXTRALEAN
 #include <windows.h>
@@ -15,6 +17,11 @@
 #include <android/log.h>
 #endif
 
+/// log calls below this level are compiled out, 0 for debug keeps them all
+#ifndef LLARP_MIN_LOG_LEVEL
+#define LLARP_MIN_LOG_LEVEL 0
+#endif
+
 namespace llarp
 {
   // probably will need to move out of llarp namespace for c api
@@ -26,27 +33,154 @@ namespace llarp
     eLogError
   };
 
+  /// one log call on its way to the log thread. arguments that are cheap to
+  /// copy are stored raw and formatted there, anything else is formatted
+  /// into data by the caller
+  struct LogRecord
+  {
+    static constexpr size_t Size = 480;
+
+    enum ArgType : uint8_t
+    {
+      eArgInt,
+      eArgUInt,
+      eArgDouble,
+      eArgChar,
+      eArgBool,
+      eArgText
+    };
+
+    LogLevel level;
+    const char* tag;
+    int line;
+    llarp_time_t when;
+    /// calls from the same site dropped by rate limiting before this one
+    uint32_t suppressed;
+    uint16_t used;
+    /// arguments didn't all fit
+    bool truncated;
+    uint8_t data[Size];
+
+    /// append type and value if they both fit
+    void
+    Put(ArgType type, const void* val, size_t sz)
+    {
+      if(used + 1 + sz > Size)
+      {
+        truncated = true;
+        return;
+      }
+      data[used++] = type;
+      memcpy(data + used, val, sz);
+      used += sz;
+    }
+
+    /// append as much of str as fits
+    void
+    PutText(const char* str, size_t len);
+
+    /// format val now with its operator<<
+    template < typename T >
+    void
+    Format(const T& val)
+    {
+      size_t start = used;
+      uint16_t len = 0;
+      Put(eArgText, &len, sizeof(len));
+      if(truncated)
+        return;
+      std::ostream& out = BeginFormat();
+      out << val;
+      EndFormat(start);
+    }
+
+   private:
+    /// a thread local stream writing into our free space
+    std::ostream&
+    BeginFormat();
+
+    /// set the length of the text put at start
+    void
+    EndFormat(size_t start);
+  };
+
+  /// lets a log call site through Burst times per Interval and counts what
+  /// it holds back
+  struct LogLimiter
+  {
+    static constexpr llarp_time_t Interval = 1000;
+    static constexpr uint32_t Burst        = 10;
+
+    /// true if the call at now may log, suppressed is set to how many calls
+    /// were held back since the last one that did
+    bool
+    Allow(llarp_time_t now, uint32_t& suppressed)
+    {
+      llarp_time_t start = windowStart.load(std::memory_order_relaxed);
+      if(now - start >= Interval
+         && windowStart.compare_exchange_strong(start, now))
+        count.store(0, std::memory_order_relaxed);
+      if(count.fetch_add(1, std::memory_order_relaxed) < Burst)
+      {
+        suppressed = held.exchange(0, std::memory_order_relaxed);
+        return true;
+      }
+      held.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    std::atomic< llarp_time_t > windowStart = {0};
+    std::atomic< uint32_t > count           = {0};
+    std::atomic< uint32_t > held            = {0};
+  };
+
+  struct LogRing;
+
   struct Logger
   {
     std::string nodeName;
     LogLevel minlevel = eLogInfo;
     std::ostream& out;
     std::mutex access;
-    Logger() : Logger(std::cout, "unnamed")
-    {
-#ifdef _WIN32
-      DWORD mode_flags;
-      HANDLE fd1 = GetStdHandle(STD_OUTPUT_HANDLE);
-      GetConsoleMode(fd1, &mode_flags);
-      // since release SDKs don't have ANSI escape support yet
-      mode_flags |= 0x0004;
-      SetConsoleMode(fd1, mode_flags);
-#endif
-    }
+    /// log calls dropped because the log thread fell behind
+    std::atomic< uint64_t > dropped;
 
-    Logger(std::ostream& o, const std::string& name) : nodeName(name), out(o)
-    {
-    }
+    Logger();
+
+    Logger(std::ostream& o, const std::string& name);
+
+    /// writes out everything still queued
+    ~Logger();
+
+    /// a record to fill in for a call at lvl then Commit, nullptr if it is
+    /// dropped. starts the log thread on first use
+    LogRecord*
+    Claim(LogLevel lvl);
+
+    /// hand rec to the log thread, or write it now if it was not queued
+    void
+    Commit(LogRecord* rec);
+
+    /// wait until everything logged before this call is written
+    void
+    Flush();
+
+   private:
+    /// make the ring and start the log thread if nobody did yet
+    LogRing*
+    Start();
+
+    void
+    Run(LogRing* ring);
+
+    /// format and write rec, holds access
+    void
+    Write(const LogRecord& rec, bool flush);
+
+    /// made with the log thread on first use
+    std::atomic< LogRing* > m_Ring;
+    std::atomic< bool > m_Stopped;
+    std::thread m_Thread;
   };
 
   extern Logger _glog;
@@ -54,20 +188,129 @@ namespace llarp
   void
   SetLogLevel(LogLevel lvl);
 
+  /// block until what was logged so far is written
+  void
+  LogFlush();
+
   /** internal */
-  template < typename TArg >
+  template < typename T >
+  struct _LogArgKind
+  {
+    typedef typename std::decay< T >::type type;
+
+    static constexpr bool isChar = std::is_same< type, char >::value
+        || std::is_same< type, signed char >::value
+        || std::is_same< type, unsigned char >::value;
+
+    static constexpr bool isText = std::is_same< type, const char* >::value
+        || std::is_same< type, char* >::value
+        || std::is_same< type, std::string >::value;
+  };
+
+  /** internal */
+  inline const char*
+  _LogText(const char* str, size_t& len)
+  {
+    if(str == nullptr)
+      str = "(null)";
+    len = strlen(str);
+    return str;
+  }
+
+  /** internal */
+  inline const char*
+  _LogText(const std::string& str, size_t& len)
+  {
+    len = str.size();
+    return str.data();
+  }
+
+  /** internal */
+  template < typename T >
   void
-  LogAppend(std::stringstream& ss, TArg&& arg) noexcept
+  _LogPut(LogRecord& rec, const T& arg, std::true_type)
   {
-    ss << std::forward< TArg >(arg);
+    typedef _LogArgKind< T > Kind;
+    if(std::is_same< T, bool >::value)
+      rec.Put(LogRecord::eArgBool, &arg, 1);
+    else if(Kind::isChar)
+      rec.Put(LogRecord::eArgChar, &arg, 1);
+    else if(std::is_floating_point< T >::value)
+    {
+      double d = arg;
+      rec.Put(LogRecord::eArgDouble, &d, sizeof(d));
+    }
+    else if(std::is_signed< T >::value)
+    {
+      int64_t i = arg;
+      rec.Put(LogRecord::eArgInt, &i, sizeof(i));
+    }
+    else
+    {
+      uint64_t i = arg;
+      rec.Put(LogRecord::eArgUInt, &i, sizeof(i));
+    }
   }
+
+  /** internal */
+  template < typename T >
+  void
+  _LogPut(LogRecord& rec, const T& arg, std::false_type)
+  {
+    rec.Format(arg);
+  }
+
+  /** internal */
+  template < typename T >
+  typename std::enable_if< _LogArgKind< T >::isText >::type
+  _LogPut(LogRecord& rec, const T& arg)
+  {
+    size_t len;
+    const char* str = _LogText(arg, len);
+    rec.PutText(str, len);
+  }
+
+  /** internal */
+  template < typename T >
+  typename std::enable_if< !_LogArgKind< T >::isText >::type
+  _LogPut(LogRecord& rec, const T& arg)
+  {
+    _LogPut(rec, arg, std::is_arithmetic< T >());
+  }
+
+  /** internal */
+  inline void
+  _LogPutAll(LogRecord&)
+  {
+  }
+
   /** internal */
   template < typename TArg, typename... TArgs >
   void
-  LogAppend(std::stringstream& ss, TArg&& arg, TArgs&&... args) noexcept
+  _LogPutAll(LogRecord& rec, const TArg& arg, const TArgs&... args)
   {
-    LogAppend(ss, std::forward< TArg >(arg));
-    LogAppend(ss, std::forward< TArgs >(args)...);
+    _LogPut(rec, arg);
+    _LogPutAll(rec, args...);
+  }
+
+  /** internal */
+  template < typename... TArgs >
+  void
+  _LogEmit(Logger& log, LogLevel lvl, const char* fname, int lineno,
+           llarp_time_t now, uint32_t suppressed, const TArgs&... args) noexcept
+  {
+    LogRecord* rec = log.Claim(lvl);
+    if(rec == nullptr)
+      return;
+    rec->level      = lvl;
+    rec->tag        = fname;
+    rec->line       = lineno;
+    rec->when       = now;
+    rec->suppressed = suppressed;
+    rec->used       = 0;
+    rec->truncated  = false;
+    _LogPutAll(*rec, args...);
+    log.Commit(rec);
   }
 
   /** internal */
@@ -77,81 +320,80 @@ namespace llarp
   {
     if(_glog.minlevel > lvl)
       return;
+    _LogEmit(_glog, lvl, fname, lineno, llarp_time_now_ms(), 0, args...);
+  }
 
-    std::stringstream ss;
-#ifdef ANDROID
-    switch(lvl)
-    {
-      case eLogDebug:
-        ss << "[DBG] ";
-        break;
-      case eLogInfo:
-        ss << "[NFO] ";
-        break;
-      case eLogWarn:
-        ss << "[WRN] ";
-        break;
-      case eLogError:
-        ss << "[ERR] ";
-        break;
-    }
-#else
-    switch(lvl)
-    {
-      case eLogDebug:
-        ss << (char)27 << "[0m";
-        ss << "[DBG] ";
-        break;
-      case eLogInfo:
-        ss << (char)27 << "[1m";
-        ss << "[NFO] ";
-        break;
-      case eLogWarn:
-        ss << (char)27 << "[1;33m";
-        ss << "[WRN] ";
-        break;
-      case eLogError:
-        ss << (char)27 << "[1;31m";
-        ss << "[ERR] ";
-        break;
-    }
-#endif
-    std::string tag = fname;
-    ss << _glog.nodeName << " " << llarp_time_now_ms() << " " << tag << ":"
-       << lineno;
-    ss << "\t";
-    LogAppend(ss, std::forward< TArgs >(args)...);
-#ifndef ANDROID
-    ss << (char)27 << "[0;0m";
-#else
-    {
-      std::unique_lock< std::mutex > lock(_glog.access);
-#ifdef ANDROID
-      __android_log_write(ANDROID_LOG_INFO, "LOKINET", ss.str().c_str());
-#else
-      _glog.out << ss.str() << std::endl;
-#ifdef SHADOW_TESTNET
-      _glog.out << "\n" << std::flush;
-#endif
-#endif
-    }
+  /** internal, drops calls over the rate site allows */
+  template < typename... TArgs >
+  void
+  _LogLimited(LogLimiter& site, LogLevel lvl, const char* fname, int lineno,
+              TArgs&&... args) noexcept
+  {
+    if(_glog.minlevel > lvl)
+      return;
+    llarp_time_t now    = llarp_time_now_ms();
+    uint32_t suppressed = 0;
+    if(site.Allow(now, suppressed))
+      _LogEmit(_glog, lvl, fname, lineno, now, suppressed, args...);
+  }
+
+  /** internal, never defined, only named in sizeof so compiled out calls
+   * still count as using their arguments */
+  template < typename... TArgs >
+  char
+  _LogArgs(TArgs&&... args);
+
+  /** internal */
+  inline void
+  _LogElided(size_t)
+  {
   }
 }  // namespace llarp
 
+/// a LogLimiter for the call site this is expanded at
+#define LLARP_LOG_SITE             \
+  []() -> llarp::LogLimiter& {     \
+    static llarp::LogLimiter site; \
+    return site;                   \
+  }()
+
+#if LLARP_MIN_LOG_LEVEL > 0
+#define LogDebug(x, ...) _LogElided(sizeof(llarp::_LogArgs(x, ##__VA_ARGS__)))
+#define LogDebugTag(tag, x, ...) \
+  _LogElided(sizeof(llarp::_LogArgs(tag, x, ##__VA_ARGS__)))
+#else
 #define LogDebug(x, ...) \
   _Log(llarp::eLogDebug, LOG_TAG, __LINE__, x, ##__VA_ARGS__)
-#define LogInfo(x, ...) \
-  _Log(llarp::eLogInfo, LOG_TAG, __LINE__, x, ##__VA_ARGS__)
-#define LogWarn(x, ...) \
-  _Log(llarp::eLogWarn, LOG_TAG, __LINE__, x, ##__VA_ARGS__)
-#define LogError(x, ...) \
-  _Log(llarp::eLogError, LOG_TAG, __LINE__, x, ##__VA_ARGS__)
 #define LogDebugTag(tag, x, ...) \
   _Log(llarp::eLogDebug, tag, __LINE__, x, ##__VA_ARGS__)
+#endif
+
+#if LLARP_MIN_LOG_LEVEL > 1
+#define LogInfo(x, ...) _LogElided(sizeof(llarp::_LogArgs(x, ##__VA_ARGS__)))
+#define LogInfoTag(tag, x, ...) \
+  _LogElided(sizeof(llarp::_LogArgs(tag, x, ##__VA_ARGS__)))
+#else
+#define LogInfo(x, ...) \
+  _Log(llarp::eLogInfo, LOG_TAG, __LINE__, x, ##__VA_ARGS__)
 #define LogInfoTag(tag, x, ...) \
   _Log(llarp::eLogInfo, tag, __LINE__, x, ##__VA_ARGS__)
+#endif
+
+#if LLARP_MIN_LOG_LEVEL > 2
+#define LogWarn(x, ...) _LogElided(sizeof(llarp::_LogArgs(x, ##__VA_ARGS__)))
 #define LogWarnTag(tag, x, ...) \
-  _Log(llarp::eLogWarn, tag, __LINE__, x, ##__VA_ARGS__)
+  _LogElided(sizeof(llarp::_LogArgs(tag, x, ##__VA_ARGS__)))
+#else
+#define LogWarn(x, ...)                                             \
+  _LogLimited(LLARP_LOG_SITE, llarp::eLogWarn, LOG_TAG, __LINE__, x, \
+              ##__VA_ARGS__)
+#define LogWarnTag(tag, x, ...)                                 \
+  _LogLimited(LLARP_LOG_SITE, llarp::eLogWarn, tag, __LINE__, x, \
+              ##__VA_ARGS__)
+#endif
+
+#define LogError(x, ...) \
+  _Log(llarp::eLogError, LOG_TAG, __LINE__, x, ##__VA_ARGS__)
 #define LogErrorTag(tag, x, ...) \
   _Log(llarp::eLogError, tag, __LINE__, x, ##__VA_ARGS__)
 
@@ -11,7 +11,11 @@ namespace llarp
   {
     struct DHTMessage : public IMessage
     {
-      std::vector< llarp::dht::IMessage* > M;
+      DHTMessage(Arena* arena = nullptr) : M(arena)
+      {
+      }
+
+      llarp::dht::MessageList M;
       uint64_t V = 0;
 
       ~DHTMessage();
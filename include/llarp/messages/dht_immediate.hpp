@@ -8,13 +8,16 @@ namespace llarp
 {
   struct DHTImmeidateMessage : public ILinkMessage
   {
-    DHTImmeidateMessage(const RouterID& from) : ILinkMessage(from)
+    /// when decoding into an arena msgs and what is decoded into it are
+    /// made there too
+    DHTImmeidateMessage(const RouterID& from, Arena* arena = nullptr)
+        : ILinkMessage(from), msgs(arena)
     {
     }
 
     ~DHTImmeidateMessage();
 
-    std::vector< llarp::dht::IMessage* > msgs;
+    llarp::dht::MessageList msgs;
 
     bool
     DecodeKey(llarp_buffer_t key, llarp_buffer_t* buf);
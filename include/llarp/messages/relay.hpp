@@ -12,6 +12,7 @@ namespace llarp
   struct RelayUpstreamMessage : public ILinkMessage
   {
     PathID_t pathid;
+    /// borrowed from the buffer we were decoded from
     Encrypted X;
     TunnelNonce Y;
 
@@ -32,6 +33,7 @@ namespace llarp
   struct RelayDownstreamMessage : public ILinkMessage
   {
     PathID_t pathid;
+    /// borrowed from the buffer we were decoded from
     Encrypted X;
     TunnelNonce Y;
     RelayDownstreamMessage();
@@ -47,6 +49,30 @@ namespace llarp
     bool
     HandleMessage(llarp_router* router) const;
   };
+
+  /// encoded size of a relay message with a payload of sz bytes
+  size_t
+  RelayMessageSize(size_t sz);
+
+  /// a relay message parsed where it lies, everything points into the buffer
+  /// it came from so a transit hop can forward it by rewriting it in place
+  struct RelayView
+  {
+    /// 'u' for upstream or 'd' for downstream
+    byte_t type;
+    byte_t* pathid;
+    byte_t* Y;
+    llarp_buffer_t X;
+
+    /// a relay message with the same contents, for when it has to be queued
+    ILinkMessage*
+    NewMessage() const;
+  };
+
+  /// parse buf as a relay message laid out the way BEncode writes it, returns
+  /// false on anything else and leaves the full decode to deal with it
+  bool
+  ParseRelayInPlace(llarp_buffer_t buf, RelayView& view);
 }  // namespace llarp
 
 #endif
@@ -252,6 +252,17 @@ namespace llarp
   bool
   GetBestNetIF(std::string& ifname, int af = AF_INET);
 
+  /// which of num sockets sharing a port gets datagrams from addr once
+  /// SteerReusePort is attached to their group
+  size_t
+  ReusePortIndex(const Addr& addr, size_t num);
+
+  /// make the kernel hand datagrams to the sockets in fd's SO_REUSEPORT
+  /// group by ReusePortIndex, in the order they were bound. returns false
+  /// if it can't, the kernel then picks by its own hash
+  bool
+  SteerReusePort(int fd, size_t num);
+
 }  // namespace llarp
 
 #endif
@@ -3,6 +3,7 @@
 #include <llarp/common.h>
 #include <llarp/crypto.h>
 #include <llarp/router_contact.h>
+#include <llarp/threadpool.h>
 
 /**
  * nodedb.h
@@ -29,6 +30,14 @@ llarp_nodedb_ensure_dir(const char *dir);
 ssize_t
 llarp_nodedb_load_dir(struct llarp_nodedb *n, const char *dir);
 
+/// load entire nodedb from fs skiplist at dir, files are read on disk and
+/// signatures checked on worker, blocks until done
+/// both must be real threadpools, not same process ones
+ssize_t
+llarp_nodedb_load_dir_parallel(struct llarp_nodedb *n, const char *dir,
+                               struct llarp_threadpool *disk,
+                               struct llarp_threadpool *worker);
+
 /// store entire nodedb to fs skiplist at dir
 ssize_t
 llarp_nodedb_store_dir(struct llarp_nodedb *n, const char *dir);
@@ -0,0 +1,131 @@
+#ifndef LLARP_OUTBOUND_QUEUE_HPP
+#define LLARP_OUTBOUND_QUEUE_HPP
+
+#include <llarp/buffer.h>
+#include <llarp/router_id.hpp>
+
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace llarp
+{
+  /// encoded link messages waiting on a session to their router, bounded
+  /// per router and overall. relay traffic may only use part of the room so
+  /// control traffic has space left, and is dropped first when full
+  struct OutboundQueue
+  {
+    enum MessageClass
+    {
+      /// path builds, dht and everything else we originate
+      eControl,
+      /// relayed path traffic
+      eRelay
+    };
+
+    static constexpr size_t DefaultPeerMessages  = 128;
+    static constexpr size_t DefaultPeerBytes     = 256 * 1024;
+    static constexpr size_t DefaultTotalMessages = 8192;
+    static constexpr size_t DefaultTotalBytes    = 16 * 1024 * 1024;
+
+    /// relay traffic gets this many quarters of each limit
+    static constexpr size_t RelayQuarters = 3;
+
+    /// send an encoded message, false if it didn't go out
+    typedef std::function< bool(llarp_buffer_t) > Send_t;
+
+    OutboundQueue(size_t peerMessages  = DefaultPeerMessages,
+                  size_t peerBytes     = DefaultPeerBytes,
+                  size_t totalMessages = DefaultTotalMessages,
+                  size_t totalBytes    = DefaultTotalBytes);
+
+    /// queue a copy of buf for remote, false if it was dropped
+    bool
+    Push(const RouterID& remote, llarp_buffer_t buf, MessageClass cls);
+
+    /// send everything queued for remote in order and forget about it
+    /// returns how many messages were sent
+    size_t
+    Flush(const RouterID& remote, Send_t send);
+
+    /// drop everything queued for remote
+    void
+    Discard(const RouterID& remote);
+
+    /// are we waiting on a session to remote, true from the first Push
+    /// until Flush or Discard even once evictions emptied its queue
+    bool
+    Has(const RouterID& remote) const;
+
+    /// true when relay traffic to remote would be dropped, senders should
+    /// back off
+    bool
+    Congested(const RouterID& remote, size_t sz = 0) const;
+
+    size_t
+    Messages() const
+    {
+      return m_Messages;
+    }
+
+    size_t
+    Bytes() const
+    {
+      return m_Bytes;
+    }
+
+    /// messages accepted so far
+    uint64_t queued = 0;
+    /// messages dropped, on arrival or evicted, and discarded
+    uint64_t dropped = 0;
+    /// messages handed to send on flush
+    uint64_t flushed = 0;
+
+   private:
+    struct Entry
+    {
+      std::vector< byte_t > data;
+      MessageClass cls;
+    };
+
+    struct Peer
+    {
+      std::deque< Entry > entries;
+      size_t bytes = 0;
+    };
+
+    typedef std::unordered_map< RouterID, Peer, RouterID::Hash > Peers_t;
+
+    /// would sz more bytes fit in peer's own limits with room for cls
+    bool
+    FitsPeer(const Peer* peer, size_t sz, MessageClass cls) const;
+
+    /// would sz more bytes fit in the overall limits with room for cls
+    bool
+    FitsTotal(size_t sz, MessageClass cls) const;
+
+    /// would sz more bytes fit in peer with room for cls
+    bool
+    Fits(const Peer* peer, size_t sz, MessageClass cls) const;
+
+    /// drop the oldest relay message in peer, false if it has none. peer
+    /// stays even if emptied, a session to it is still on its way
+    bool
+    EvictRelay(Peer& peer);
+
+    /// drop relay messages until a control message of sz fits in peer
+    bool
+    MakeRoom(Peer& peer, size_t sz);
+
+    size_t m_PeerMessages;
+    size_t m_PeerBytes;
+    size_t m_TotalMessages;
+    size_t m_TotalBytes;
+    size_t m_Messages = 0;
+    size_t m_Bytes    = 0;
+    Peers_t m_Peers;
+  };
+}  // namespace llarp
+
+#endif
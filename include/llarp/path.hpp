@@ -17,6 +17,7 @@
 #include <llarp/service/Intro.hpp>
 #include <llarp/threading.hpp>
 
+#include <array>
 #include <functional>
 #include <list>
 #include <map>
@@ -184,6 +185,28 @@ namespace llarp
       // handle data in downstream direction
       bool
       HandleDownstream(llarp_buffer_t X, const TunnelNonce& Y, llarp_router* r);
+
+      /// true if upstream relay messages end here
+      bool
+      IsEndpoint(const RouterID& us) const
+      {
+        return info.upstream == us;
+      }
+
+      /// rewrite a parsed relay message's path id and nonce for the next hop,
+      /// returns the nonce to decrypt its payload with
+      TunnelNonce
+      NextHopInPlace(RelayView& view) const;
+
+      /// decrypt a parsed relay message where it lies and rewrite it for the
+      /// next hop, the buffer it was parsed from is then the message to send
+      void
+      RelayInPlace(RelayView& view, llarp_crypto* crypto) const;
+
+      /// forward a relay message without decoding it, buf is what view was
+      /// parsed from. a pooled copy is decrypted on the workers and sent on
+      bool
+      ForwardInPlace(llarp_buffer_t buf, RelayView& view, llarp_router* r);
     };
 
     /// configuration for a single hop when building a path
@@ -210,6 +233,79 @@ namespace llarp
       PathHopConfig();
     };
 
+    /// bytes per second over the last full window
+    struct RateMeter
+    {
+      static constexpr llarp_time_t Window = 1000;
+
+      void
+      Add(size_t sz, llarp_time_t now);
+
+      /// bytes per second, 0 if we have been idle for a window
+      uint64_t
+      Rate(llarp_time_t now) const;
+
+      uint64_t total = 0;
+
+     private:
+      llarp_time_t m_WindowStart = 0;
+      uint64_t m_WindowBytes     = 0;
+      uint64_t m_LastRate        = 0;
+    };
+
+    /// what we measured on a path we made
+    struct PathStats
+    {
+      /// smoothed latency this many times the best we saw is degraded
+      static constexpr uint64_t DegradedFactor = 3;
+      /// and at least this many ms over it
+      static constexpr llarp_time_t DegradedMargin = 200;
+      /// how long we stay off a path after the router pushed back on it
+      static constexpr llarp_time_t BackoffTime = 1000;
+
+      /// last round trip time from a latency probe in ms
+      llarp_time_t latency = 0;
+      /// latency smoothed over recent probes
+      llarp_time_t smoothedLatency = 0;
+      /// lowest latency seen
+      llarp_time_t bestLatency = 0;
+      RateMeter tx;
+      RateMeter rx;
+      uint64_t txMessages = 0;
+      uint64_t rxMessages = 0;
+      /// sends the router refused because its queue was full
+      uint64_t txRefused = 0;
+      llarp_time_t lastRefused = 0;
+
+      void
+      OnLatency(llarp_time_t sample);
+
+      /// the router would not take a message for this path
+      void
+      OnRefused(llarp_time_t now);
+
+      /// true if we should let the router catch up before sending more
+      bool
+      Backoff(llarp_time_t now) const;
+
+      void
+      OnSend(size_t sz, llarp_time_t now);
+
+      void
+      OnRecv(size_t sz, llarp_time_t now);
+
+      /// bytes sent that are likely still on their way
+      uint64_t
+      InFlight(llarp_time_t now) const;
+
+      /// true if latency has gone up a lot since the path was built
+      bool
+      Degraded() const;
+    };
+
+    std::ostream&
+    operator<<(std::ostream& out, const PathStats& stats);
+
     /// A path we made
     struct Path : public IHopHandler, public llarp::routing::IMessageHandler
     {
@@ -224,6 +320,11 @@ namespace llarp
 
       llarp_time_t buildStarted;
       PathStatus status;
+      /// what our path set uses us for
+      PathRole role = ePathSpare;
+      /// when our path set wants us replaced
+      llarp_time_t refreshAt = 0;
+      PathStats stats;
 
       Path(llarp_path_hops* path);
 
@@ -311,6 +412,79 @@ namespace llarp
       ePathBuildReject
     };
 
+    /// transit hops by path id and the router on one side of them, split
+    /// over shards by path id that each have their own reader writer lock
+    /// so relaying on many paths doesn't serialise on one lock
+    struct TransitHopTable
+    {
+      static constexpr size_t NumShards = 16;
+
+      /// index hop by both path ids on both sides, returns false and
+      /// indexes nothing if a hop is already indexed under any of its keys
+      bool
+      Put(TransitHop* hop);
+
+      /// unindex hop, does not delete it
+      void
+      Remove(TransitHop* hop);
+
+      /// the hop on path id whose upstream, or downstream, is remote, don't
+      /// hold on to it past the current router tick
+      TransitHop*
+      Get(const PathID_t& id, const RouterID& remote, bool upstream);
+
+      bool
+      Has(const TransitHopInfo& info);
+
+     private:
+      struct Key
+      {
+        PathID_t id;
+        RouterID remote;
+        bool upstream;
+
+        bool
+        operator==(const Key& other) const
+        {
+          return upstream == other.upstream && id == other.id
+              && remote == other.remote;
+        }
+
+        struct Hash
+        {
+          std::size_t
+          operator()(const Key& k) const
+          {
+            std::size_t idx0, idx1;
+            memcpy(&idx0, k.id, sizeof(std::size_t));
+            memcpy(&idx1, k.remote, sizeof(std::size_t));
+            return idx0 ^ idx1 ^ k.upstream;
+          }
+        };
+      };
+
+      struct Shard
+      {
+        util::SharedMutex mutex;
+        std::unordered_map< Key, TransitHop*, Key::Hash > hops;
+      };
+
+      Shard&
+      ShardFor(const PathID_t& id)
+      {
+        // the hash uses the front of the id, shard on the back
+        return m_Shards[id[PATHIDSIZE - 1] % NumShards];
+      }
+
+      bool
+      Index(const PathID_t& id, TransitHop* hop);
+
+      void
+      Unindex(const PathID_t& id, TransitHop* hop);
+
+      std::array< Shard, NumShards > m_Shards;
+    };
+
     struct PathContext
     {
       PathContext(llarp_router* router);
@@ -347,7 +521,8 @@ namespace llarp
       bool
       HandleRelayCommit(const LR_CommitMessage* msg);
 
-      void
+      /// returns false if a hop with the same path ids is already there
+      bool
       PutTransitHop(TransitHop* hop);
 
       IHopHandler*
@@ -356,6 +531,10 @@ namespace llarp
       IHopHandler*
       GetByDownstream(const RouterID& id, const PathID_t& path);
 
+      /// transit hop only lookup for relay forwarding, see TransitHopTable::Get
+      TransitHop*
+      GetTransitHop(const RouterID& id, const PathID_t& path, bool upstream);
+
       PathSet*
       GetLocalPathSet(const PathID_t& id);
 
@@ -375,10 +554,6 @@ namespace llarp
       void
       AddOwnPath(PathSet* set, Path* p);
 
-      typedef std::multimap< PathID_t, TransitHop* > TransitHopsMap_t;
-
-      typedef std::pair< std::mutex, TransitHopsMap_t > SyncTransitMap_t;
-
       // maps path id -> pathset owner of path
       typedef std::map< PathID_t, PathSet* > OwnedPathsMap_t;
 
@@ -404,8 +579,13 @@ namespace llarp
 
      private:
       llarp_router* m_Router;
-      SyncTransitMap_t m_TransitPaths;
-      SyncTransitMap_t m_Paths;
+      TransitHopTable m_TransitPaths;
+      /// transit hops by when they expire
+      std::mutex m_TransitExpiryMutex;
+      std::multimap< llarp_time_t, TransitHop* > m_TransitExpiry;
+      /// expired hops, freed on the next tick so lookups made before they
+      /// were removed stay valid
+      std::vector< TransitHop* > m_RetiredHops;
       SyncOwnedPathsMap_t m_OurPaths;
       std::list< llarp_pathbuilder_context* > m_PathBuilders;
       bool m_AllowTransit;
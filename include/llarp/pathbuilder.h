@@ -48,7 +48,8 @@ struct llarp_pathbuild_job
   struct llarp_pathbuilder_context* context;
   // path hop selection
   llarp_pathbuilder_select_hop_func selectHop;
-  // called when the path build started
+  // called when the path build started or failed to, the job is not used
+  // after this
   llarp_pathbuilder_hook pathBuildStarted;
   // path
   struct llarp_path_hops hops;
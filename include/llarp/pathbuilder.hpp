@@ -11,10 +11,10 @@ struct llarp_pathbuilder_context : public llarp::path::PathSet
   struct llarp_dht_context* dht;
   llarp::SecretKey enckey;
   size_t numHops;
-  /// construct
+  /// construct, numSpares built paths are kept ready to take over
   llarp_pathbuilder_context(llarp_router* p_router,
                             struct llarp_dht_context* p_dht, size_t numPaths,
-                            size_t numHops);
+                            size_t numHops, size_t numSpares = 0);
 
   virtual ~llarp_pathbuilder_context(){};
 
@@ -10,6 +10,7 @@
 #include <llarp/service/lookup.hpp>
 #include <map>
 #include <tuple>
+#include <vector>
 
 namespace llarp
 {
@@ -27,15 +28,40 @@ namespace llarp
       ePathTimeout,
       ePathExpired
     };
+
+    /// what a path set uses one of its paths for
+    enum PathRole
+    {
+      /// handed out for traffic and published in introductions
+      ePathActive,
+      /// built ahead of need, promoted when an active path goes away
+      ePathSpare,
+      /// replaced by a fresher path, left to run out its lifetime
+      ePathRetired
+    };
+
     // forward declare
     struct Path;
 
-    /// a set of paths owned by an entity
+    /// a set of paths owned by an entity. besides the active paths it keeps
+    /// spares built ahead of time, which are promoted the moment an active
+    /// path expires. active paths are replaced a little before they expire,
+    /// at a random point so they don't all go at once
     struct PathSet
     {
+      /// replace active paths at least this long before they expire
+      static constexpr llarp_time_t RefreshMargin = 60 * 1000;
+
       /// construct
       /// @params numPaths the number of paths to maintain
-      PathSet(size_t numPaths);
+      /// @params numSpares the number of spare paths to keep built
+      PathSet(size_t numPaths, size_t numSpares = 0);
+
+      void
+      SetNumSpares(size_t numSpares)
+      {
+        m_NumSpares = numSpares;
+      }
 
       /// tick owned paths
       void
@@ -47,6 +73,11 @@ namespace llarp
       virtual void
       HandlePathBuilt(Path* path);
 
+      /// called when a path we built is confirmed, puts it in service or
+      /// keeps it as a spare then calls HandlePathBuilt
+      void
+      PathConfirmed(Path* path);
+
       void
       AddPath(Path* path);
 
@@ -59,6 +90,9 @@ namespace llarp
       size_t
       NumInStatus(PathStatus st) const;
 
+      size_t
+      NumInRole(PathRole role) const;
+
       /// return true if we should build another path
       bool
       ShouldBuildMore() const;
@@ -81,12 +115,20 @@ namespace llarp
       Path*
       GetEstablishedPathClosestTo(const RouterID& router) const;
 
+      /// pick a path to send on, lower latency and less in flight make a
+      /// path more likely. degraded paths and ones the router pushed back on
+      /// are avoided
       Path*
-      PickRandomEstablishedPath() const;
+      PickEstablishedPath() const;
 
+      /// like PickEstablishedPath but only paths ending at router
       Path*
       GetPathByRouter(const RouterID& router) const;
 
+      /// call visit with every path, for stats
+      void
+      ForEachPath(std::function< void(const Path*) > visit) const;
+
       bool
       GetCurrentIntroductions(
           std::set< llarp::service::Introduction >& intros) const;
@@ -109,10 +151,51 @@ namespace llarp
         return self->SelectHop(db, prev, cur, hopno);
       }
 
+     protected:
+      /// bytes in flight that weigh as much as doubling a path's latency
+      static constexpr uint64_t LoadUnit = 16 * 1024;
+
+      /// latency assumed for paths when none of them was probed yet
+      static constexpr llarp_time_t DefaultLatency = 500;
+
+      /// probed latency of path, 0 if no probe came back yet
+      static llarp_time_t
+      Latency(const Path* path);
+
+      /// how likely path is to be picked, with unprobed as its latency if
+      /// it has none
+      static double
+      Weight(const Path* path, llarp_time_t now, llarp_time_t unprobed);
+
+      static Path*
+      PickWeighted(const std::vector< Path* >& candidates, llarp_time_t now);
+
+      /// an active path we hand out
+      static bool
+      IsUsable(const Path* path);
+
+      /// established, not degraded and not due for refresh yet
+      static bool
+      IsFresh(const Path* path, llarp_time_t now);
+
+      /// the freshest spare we could promote, nullptr if none
+      Path*
+      GetBestSpare(llarp_time_t now) const;
+
+      /// promote spares until we have enough active paths
+      void
+      PromoteSpares(llarp_time_t now);
+
+      /// retire active paths that are degraded or due for refresh if a spare
+      /// can take over
+      void
+      RotatePaths(llarp_time_t now);
+
      private:
       typedef std::pair< RouterID, PathID_t > PathInfo_t;
       typedef std::map< PathInfo_t, Path* > PathMap_t;
       size_t m_NumPaths;
+      size_t m_NumSpares;
       PathMap_t m_Paths;
     };
 
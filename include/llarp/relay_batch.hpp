@@ -0,0 +1,182 @@
+#ifndef LLARP_RELAY_BATCH_HPP
+#define LLARP_RELAY_BATCH_HPP
+
+#include <llarp/buffer.h>
+#include <llarp/crypto.hpp>
+#include <llarp/link_message.hpp>
+#include <llarp/logic.h>
+#include <llarp/path.h>
+#include <llarp/router_id.hpp>
+#include <llarp/threadpool.h>
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace llarp
+{
+  namespace path
+  {
+    /// an encoded relay message waiting for its onion layers, header and
+    /// message share one pooled block
+    struct RelayJob
+    {
+      struct Layer
+      {
+        SharedSecret key;
+        TunnelNonce nonce;
+      };
+
+      /// room for a message of up to sz bytes, nullptr if the buffer pool is
+      /// at its cap
+      static RelayJob*
+      New(size_t sz);
+
+      /// copy of msg, nullptr if the buffer pool is at its cap
+      static RelayJob*
+      Copy(llarp_buffer_t msg);
+
+      /// msg, a relay message of at most maxsz bytes, encoded with its X as
+      /// the payload. nullptr if the pool is at its cap or it didn't encode
+      static RelayJob*
+      Encode(const ILinkMessage& msg, size_t maxsz);
+
+      static void
+      operator delete(void* ptr);
+
+      byte_t*
+      data()
+      {
+        return reinterpret_cast< byte_t* >(this + 1);
+      }
+
+      /// the whole message
+      llarp_buffer_t
+      Buffer();
+
+      /// set the part of the message that layers apply to
+      void
+      SetPayload(size_t offset, size_t size);
+
+      /// xchacha20 the payload with key and nonce after the layers before it
+      bool
+      AddLayer(const SharedSecret& key, const TunnelNonce& nonce);
+
+      /// apply every layer, called on a worker
+      void
+      Apply(llarp_crypto* crypto);
+
+      /// size of the message
+      size_t sz;
+      /// bytes we have room for
+      size_t capacity;
+      size_t payloadOffset = 0;
+      size_t payloadSize   = 0;
+      size_t numLayers     = 0;
+      std::array< Layer, MAXHOPS > layers;
+
+     private:
+      RelayJob(size_t s) : sz(s), capacity(s)
+      {
+      }
+    };
+
+    /// does the onion crypto for relay messages on the worker pool instead
+    /// of the logic thread. messages are collected per next hop for up to
+    /// Window ms or MaxBatch messages, a batch is split over the workers and
+    /// sent once all of it is done. a next hop has one batch in flight at a
+    /// time so its messages go out in the order they were queued
+    struct RelayBatcher
+    {
+      /// send a finished message to a router, called in the logic thread
+      typedef std::function< void(const RouterID&, llarp_buffer_t) > Send_t;
+
+      static constexpr size_t MaxBatch     = 64;
+      static constexpr size_t ChunkSize    = 8;
+      static constexpr llarp_time_t Window = 2;
+
+      RelayBatcher(llarp_logic* logic, llarp_threadpool* worker,
+                   llarp_crypto* crypto, Send_t send);
+
+      /// must not be destroyed while batches are in flight
+      ~RelayBatcher();
+
+      /// take ownership of job and send it to next when its layers are done
+      /// must be called in the logic thread
+      void
+      Queue(const RouterID& next, RelayJob* job);
+
+      /// start a batch for every next hop without one in flight
+      void
+      Flush();
+
+      /// messages queued or in flight
+      size_t
+      Pending() const
+      {
+        return m_Pending;
+      }
+
+      /// batches started so far
+      uint64_t batches = 0;
+      /// messages sent so far
+      uint64_t relayed = 0;
+
+     private:
+      struct Batch;
+
+      /// the part of a batch one worker does
+      struct Chunk
+      {
+        Batch* batch;
+        size_t begin;
+        size_t end;
+      };
+
+      struct Batch
+      {
+        RelayBatcher* self;
+        RouterID next;
+        std::vector< RelayJob* > jobs;
+        std::vector< Chunk > chunks;
+        std::atomic< size_t > remaining;
+      };
+
+      struct Peer
+      {
+        std::vector< RelayJob* > pending;
+        bool busy = false;
+      };
+
+      typedef std::unordered_map< RouterID, Peer, RouterID::Hash > Peers_t;
+
+      void
+      Dispatch(const RouterID& next, Peer& peer);
+
+      void
+      Finish(Batch* batch);
+
+      static void
+      HandleChunk(void* user);
+
+      static void
+      HandleBatchDone(void* user);
+
+      static void
+      HandleWindow(void* user, uint64_t orig, uint64_t left);
+
+      llarp_logic* m_Logic;
+      llarp_threadpool* m_Worker;
+      llarp_crypto* m_Crypto;
+      Send_t m_Send;
+      Peers_t m_Peers;
+      size_t m_Pending     = 0;
+      uint32_t m_WindowJob = 0;
+      bool m_WindowSet     = false;
+    };
+  }  // namespace path
+}  // namespace llarp
+
+#endif
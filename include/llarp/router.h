@@ -20,6 +20,12 @@ llarp_init_router(struct llarp_threadpool *worker,
 void
 llarp_free_router(struct llarp_router **router);
 
+/// add an extra network event loop for inbound links to shard over
+/// must be called before llarp_configure_router
+void
+llarp_router_add_netloop(struct llarp_router *router,
+                         struct llarp_ev_loop *netloop);
+
 bool
 llarp_router_try_connect(struct llarp_router *router, struct llarp_rc *remote,
                          uint16_t numretries);
@@ -14,6 +14,8 @@ struct llarp_rc;
 
 #define MAX_RC_SIZE (1024)
 #define NICKLEN (32)
+/// how long an rc is good for after last_updated
+#define RC_LIFETIME (60 * 60 * 1000)
 
 bool
 llarp_rc_bdecode(struct llarp_rc *rc, llarp_buffer_t *buf);
@@ -3,6 +3,7 @@
 
 #include <llarp/buffer.h>
 #include <llarp/router.h>
+#include <llarp/arena.hpp>
 #include <llarp/bencode.hpp>
 #include <llarp/path_types.hpp>
 
@@ -28,12 +29,9 @@ namespace llarp
                          const PathID_t& from, llarp_router* r);
 
      private:
-      static bool
-      OnKey(dict_reader* r, llarp_buffer_t* key);
-      bool firstKey;
-      char key;
-      dict_reader reader;
-      IMessage* msg;
+      /// make an empty message of type in arena to decode into
+      IMessage*
+      CreateMessage(byte_t type, Arena& arena) const;
     };
   }  // namespace routing
 }  // namespace llarp
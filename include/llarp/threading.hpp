@@ -9,4 +9,85 @@
 #include <condition_variable>
 #include <thread>
 #endif
+#include <atomic>
+
+namespace llarp
+{
+  namespace util
+  {
+    /// reader writer lock for read mostly data, readers only touch an atomic
+    /// counter. writers wait out the readers and hold new ones off while
+    /// waiting so they can't be starved
+    struct SharedMutex
+    {
+      void
+      lock_shared()
+      {
+        for(;;)
+        {
+          while(m_WriterWaiting.load(std::memory_order_relaxed))
+            std::this_thread::yield();
+          int readers = m_State.load(std::memory_order_relaxed);
+          if(readers >= 0
+             && m_State.compare_exchange_weak(readers, readers + 1,
+                                              std::memory_order_acquire))
+            return;
+          std::this_thread::yield();
+        }
+      }
+
+      void
+      unlock_shared()
+      {
+        m_State.fetch_sub(1, std::memory_order_release);
+      }
+
+      void
+      lock()
+      {
+        m_Writer.lock();
+        m_WriterWaiting.store(true, std::memory_order_relaxed);
+        int idle = 0;
+        while(!m_State.compare_exchange_weak(idle, -1,
+                                             std::memory_order_acquire))
+        {
+          idle = 0;
+          std::this_thread::yield();
+        }
+        m_WriterWaiting.store(false, std::memory_order_relaxed);
+      }
+
+      void
+      unlock()
+      {
+        m_State.store(0, std::memory_order_release);
+        m_Writer.unlock();
+      }
+
+     private:
+      /// number of readers, -1 while a writer holds it
+      std::atomic< int > m_State{0};
+      std::atomic< bool > m_WriterWaiting{false};
+      /// one writer at a time
+      std::mutex m_Writer;
+    };
+
+    /// holds a SharedMutex for reading
+    struct SharedLock
+    {
+      SharedLock(SharedMutex& mtx) : m_Mutex(mtx)
+      {
+        m_Mutex.lock_shared();
+      }
+
+      ~SharedLock()
+      {
+        m_Mutex.unlock_shared();
+      }
+
+     private:
+      SharedMutex& m_Mutex;
+    };
+  }  // namespace util
+}  // namespace llarp
 #endif
\ No newline at end of file
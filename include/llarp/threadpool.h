@@ -1,5 +1,6 @@
 #ifndef LLARP_THREADPOOL_H
 #define LLARP_THREADPOOL_H
+#include <stddef.h>
 
 struct llarp_threadpool;
 
@@ -41,6 +42,11 @@ void
 llarp_threadpool_queue_job(struct llarp_threadpool *tp,
                            struct llarp_thread_job j);
 
+/// queue many jobs at once, wakes workers once instead of per job
+void
+llarp_threadpool_queue_jobs(struct llarp_threadpool *tp,
+                            const struct llarp_thread_job *jobs, size_t num);
+
 void
 llarp_threadpool_stop(struct llarp_threadpool *tp);
 void
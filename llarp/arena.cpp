@@ -0,0 +1,38 @@
+#include <llarp/arena.hpp>
+
+namespace llarp
+{
+  constexpr size_t Arena::Capacity;
+  constexpr size_t Arena::MaxObjects;
+
+  Arena&
+  Arena::ThisThread()
+  {
+    static thread_local Arena arena;
+    return arena;
+  }
+
+  void*
+  Arena::Alloc(size_t sz, size_t align)
+  {
+    size_t start = (m_Used + align - 1) & ~(align - 1);
+    if(start > Capacity || Capacity - start < sz)
+    {
+      ++overflows;
+      return nullptr;
+    }
+    m_Used = start + sz;
+    return m_Data + start;
+  }
+
+  void
+  Arena::Rewind(size_t used, size_t objects)
+  {
+    while(m_Objects > objects)
+    {
+      --m_Objects;
+      m_Dtors[m_Objects].destroy(m_Dtors[m_Objects].obj);
+    }
+    m_Used = used;
+  }
+}  // namespace llarp
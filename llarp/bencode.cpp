@@ -1,18 +1,74 @@
-#include <llarp/bencode.h>
+#include <llarp/bencode.hpp>
+
+#include <cstring>
+
+/// write i in decimal into the end of buf, returns where it starts
+static char*
+bencode_uint_to_ascii(uint64_t i, char* end)
+{
+  do
+  {
+    *--end = '0' + (i % 10);
+    i /= 10;
+  } while(i);
+  return end;
+}
+
+size_t
+bencode_size_uint(uint64_t i)
+{
+  size_t digits = 1;
+  while(i >= 10)
+  {
+    i /= 10;
+    ++digits;
+  }
+  return digits;
+}
+
+size_t
+bencode_size_bytestring(size_t sz)
+{
+  return bencode_size_uint(sz) + 1 + sz;
+}
+
+size_t
+bencode_size_uint64(uint64_t i)
+{
+  return bencode_size_uint(i) + 2;
+}
 
 bool
 bencode_write_bytestring(llarp_buffer_t* buff, const void* data, size_t sz)
 {
-  if(!llarp_buffer_writef(buff, "%ld:", sz))
+  char num[20];
+  char* end   = num + sizeof(num);
+  char* start = bencode_uint_to_ascii(sz, end);
+  size_t len  = end - start;
+  if(llarp_buffer_size_left(*buff) < len + 1 + sz)
     return false;
-  return llarp_buffer_write(buff, data, sz);
+  memcpy(buff->cur, start, len);
+  buff->cur += len;
+  *buff->cur++ = ':';
+  memcpy(buff->cur, data, sz);
+  buff->cur += sz;
+  return true;
 }
 
 bool
 bencode_write_uint64(llarp_buffer_t* buff, uint64_t i)
 {
-  return llarp_buffer_writef(buff, "i%lu", i)
-      && llarp_buffer_write(buff, "e", 1);
+  char num[20];
+  char* end   = num + sizeof(num);
+  char* start = bencode_uint_to_ascii(i, end);
+  size_t len  = end - start;
+  if(llarp_buffer_size_left(*buff) < len + 2)
+    return false;
+  *buff->cur++ = 'i';
+  memcpy(buff->cur, start, len);
+  buff->cur += len;
+  *buff->cur++ = 'e';
+  return true;
 }
 
 bool
@@ -36,56 +92,60 @@ bencode_end(llarp_buffer_t* buff)
 bool
 bencode_write_version_entry(llarp_buffer_t* buff)
 {
-  return llarp_buffer_writef(buff, "1:vi%de", LLARP_PROTO_VERSION);
+  return llarp_buffer_write(buff, "1:v", 3)
+      && bencode_write_uint64(buff, LLARP_PROTO_VERSION);
 }
 
-bool
-bencode_read_integer(struct llarp_buffer_t* buffer, uint64_t* result)
+/// read the decimal number at buffer->cur ending in term and skip past
+/// term, buffer is left as is on failure
+static bool
+bencode_read_uint(llarp_buffer_t* buffer, byte_t term, uint64_t* result)
 {
-  size_t len;
-  if(*buffer->cur != 'i')
+  const byte_t* end = buffer->base + buffer->sz;
+  const byte_t* ptr = buffer->cur;
+  uint64_t num      = 0;
+  while(ptr != end && *ptr >= '0' && *ptr <= '9')
+  {
+    uint64_t digit = *ptr - '0';
+    // overflow
+    if(num > (UINT64_MAX - digit) / 10)
+      return false;
+    num = (num * 10) + digit;
+    ++ptr;
+  }
+  // no digits or no terminator
+  if(ptr == buffer->cur || ptr == end || *ptr != term)
     return false;
+  buffer->cur = const_cast< byte_t* >(ptr) + 1;
+  *result     = num;
+  return true;
+}
 
-  char numbuf[32];
-
-  buffer->cur++;
-
-  len =
-      llarp_buffer_read_until(buffer, 'e', (byte_t*)numbuf, sizeof(numbuf) - 1);
-  if(!len)
+bool
+bencode_read_integer(struct llarp_buffer_t* buffer, uint64_t* result)
+{
+  if(llarp_buffer_size_left(*buffer) < 3 || *buffer->cur != 'i')
     return false;
-
   buffer->cur++;
-
-  numbuf[len] = 0;
-  *result     = strtoul(numbuf, nullptr, 10);
-  return true;
+  if(bencode_read_uint(buffer, 'e', result))
+    return true;
+  buffer->cur--;
+  return false;
 }
 
 bool
 bencode_read_string(llarp_buffer_t* buffer, llarp_buffer_t* result)
 {
-  size_t len, slen;
-  int num;
-  char numbuf[10];
-
-  len =
-      llarp_buffer_read_until(buffer, ':', (byte_t*)numbuf, sizeof(numbuf) - 1);
-  if(!len)
-    return false;
-
-  numbuf[len] = 0;
-  num         = atoi(numbuf);
-  if(num < 0)
+  byte_t* start = buffer->cur;
+  uint64_t slen;
+  if(!bencode_read_uint(buffer, ':', &slen))
     return false;
 
-  slen = num;
-
-  buffer->cur++;
-
-  len = llarp_buffer_size_left(*buffer);
-  if(len < slen)
+  if(llarp_buffer_size_left(*buffer) < slen)
+  {
+    buffer->cur = start;
     return false;
+  }
 
   result->base = buffer->cur;
   result->cur  = buffer->cur;
@@ -137,3 +197,107 @@ bencode_read_list(llarp_buffer_t* buff, struct list_reader* r)
   r->buffer->cur++;
   return r->on_item(r, false);
 }
+
+namespace llarp
+{
+  char
+  BencodeReader::Peek() const
+  {
+    if(llarp_buffer_size_left(*buffer) == 0)
+      return 0;
+    byte_t ch = *buffer->cur;
+    if(ch >= '0' && ch <= '9')
+      return 's';
+    return ch;
+  }
+
+  bool
+  BencodeReader::ReadInteger(uint64_t& i)
+  {
+    if(bencode_read_integer(buffer, &i))
+      return true;
+    failed = true;
+    return false;
+  }
+
+  bool
+  BencodeReader::ReadString(llarp_buffer_t& str)
+  {
+    if(bencode_read_string(buffer, &str))
+      return true;
+    failed = true;
+    return false;
+  }
+
+  bool
+  BencodeReader::Enter(char type)
+  {
+    if(Peek() != type)
+    {
+      failed = true;
+      return false;
+    }
+    buffer->cur++;
+    return true;
+  }
+
+  bool
+  BencodeReader::NextItem()
+  {
+    switch(Peek())
+    {
+      case 'e':
+        buffer->cur++;
+        return false;
+      case 0:
+        failed = true;
+        return false;
+      default:
+        return true;
+    }
+  }
+
+  bool
+  BencodeReader::NextKey(llarp_buffer_t& key)
+  {
+    return NextItem() && ReadString(key);
+  }
+
+  bool
+  BencodeReader::Skip(size_t depth)
+  {
+    if(depth > MaxDepth)
+    {
+      failed = true;
+      return false;
+    }
+    uint64_t i;
+    llarp_buffer_t str;
+    switch(Peek())
+    {
+      case 'i':
+        return ReadInteger(i);
+      case 's':
+        return ReadString(str);
+      case 'l':
+        buffer->cur++;
+        while(NextItem())
+        {
+          if(!Skip(depth + 1))
+            return false;
+        }
+        return !failed;
+      case 'd':
+        buffer->cur++;
+        while(NextKey(str))
+        {
+          if(!Skip(depth + 1))
+            return false;
+        }
+        return !failed;
+      default:
+        failed = true;
+        return false;
+    }
+  }
+}  // namespace llarp
@@ -0,0 +1,218 @@
+#include <llarp/buffer_pool.hpp>
+#include <llarp/threading.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+
+namespace llarp
+{
+  namespace
+  {
+    /// block sizes, enough for acks, fragments and whole frames
+    constexpr size_t ClassSizes[] = {256, 1024, 2048};
+    constexpr size_t NumClasses = sizeof(ClassSizes) / sizeof(ClassSizes[0]);
+    /// marks a block that was too big for any class
+    constexpr uint32_t Oversized = ~0U;
+    /// blocks carved out of the system per refill
+    constexpr size_t SlabBlocks = 32;
+    /// blocks a thread keeps before spilling half to the depot
+    constexpr size_t CacheMax = 256;
+    /// blocks moved between a thread and the depot at once
+    constexpr size_t Batch = 64;
+
+    /// in front of every block, keeps the payload 16 byte aligned
+    struct alignas(16) Header
+    {
+      uint32_t cls;
+      size_t size;
+    };
+
+    struct Depot
+    {
+      std::mutex mtx;
+      std::vector< void * > blocks;
+    };
+
+    Depot depots[NumClasses];
+    std::atomic< size_t > inuse(0);
+    std::atomic< size_t > highwater(0);
+    std::atomic< size_t > reserved(0);
+    std::atomic< size_t > cap(0);
+    std::atomic< uint64_t > allocs(0);
+    std::atomic< uint64_t > failures(0);
+
+    size_t
+    block_size(size_t cls)
+    {
+      return sizeof(Header) + ClassSizes[cls];
+    }
+
+    /// reserve bytes against the cap
+    bool
+    reserve(size_t bytes)
+    {
+      size_t limit = cap.load(std::memory_order_relaxed);
+      size_t cur   = reserved.load(std::memory_order_relaxed);
+      do
+      {
+        if(limit && cur + bytes > limit)
+        {
+          ++failures;
+          return false;
+        }
+      } while(!reserved.compare_exchange_weak(cur, cur + bytes));
+      return true;
+    }
+
+    void
+    track_alloc(size_t sz)
+    {
+      ++allocs;
+      size_t now = inuse.fetch_add(sz, std::memory_order_relaxed) + sz;
+      size_t top = highwater.load(std::memory_order_relaxed);
+      while(now > top && !highwater.compare_exchange_weak(top, now))
+        ;
+    }
+
+    struct ThreadCache
+    {
+      std::vector< void * > lists[NumClasses];
+
+      ~ThreadCache()
+      {
+        for(size_t cls = 0; cls < NumClasses; ++cls)
+        {
+          std::unique_lock< std::mutex > lock(depots[cls].mtx);
+          auto &blocks = depots[cls].blocks;
+          blocks.insert(blocks.end(), lists[cls].begin(), lists[cls].end());
+        }
+      }
+
+      bool
+      refill(size_t cls)
+      {
+        auto &list = lists[cls];
+        {
+          std::unique_lock< std::mutex > lock(depots[cls].mtx);
+          auto &blocks = depots[cls].blocks;
+          size_t n     = std::min(Batch, blocks.size());
+          list.insert(list.end(), blocks.end() - n, blocks.end());
+          blocks.resize(blocks.size() - n);
+        }
+        if(list.size())
+          return true;
+        // carve a new slab, never given back to the system
+        size_t bsz = block_size(cls);
+        if(!reserve(bsz * SlabBlocks))
+          return false;
+        uint8_t *slab = static_cast< uint8_t * >(malloc(bsz * SlabBlocks));
+        if(slab == nullptr)
+        {
+          reserved -= bsz * SlabBlocks;
+          ++failures;
+          return false;
+        }
+        for(size_t idx = 0; idx < SlabBlocks; ++idx)
+          list.push_back(slab + (idx * bsz));
+        return true;
+      }
+
+      void
+      spill(size_t cls)
+      {
+        auto &list = lists[cls];
+        std::unique_lock< std::mutex > lock(depots[cls].mtx);
+        auto &blocks = depots[cls].blocks;
+        size_t n     = list.size() / 2;
+        blocks.insert(blocks.end(), list.end() - n, list.end());
+        list.resize(list.size() - n);
+      }
+    };
+
+    ThreadCache &
+    cache()
+    {
+      static thread_local ThreadCache c;
+      return c;
+    }
+  }  // namespace
+
+  void *
+  BufferPool::Alloc(size_t sz)
+  {
+    size_t cls = 0;
+    while(cls < NumClasses && ClassSizes[cls] < sz)
+      ++cls;
+    Header *hdr;
+    if(cls == NumClasses)
+    {
+      // too big to pool, still counts against the cap
+      size_t total = sizeof(Header) + sz;
+      if(!reserve(total))
+        return nullptr;
+      hdr = static_cast< Header * >(malloc(total));
+      if(hdr == nullptr)
+      {
+        reserved -= total;
+        ++failures;
+        return nullptr;
+      }
+      hdr->cls  = Oversized;
+      hdr->size = sz;
+    }
+    else
+    {
+      auto &c    = cache();
+      auto &list = c.lists[cls];
+      if(list.empty() && !c.refill(cls))
+        return nullptr;
+      hdr = static_cast< Header * >(list.back());
+      list.pop_back();
+      hdr->cls  = cls;
+      hdr->size = ClassSizes[cls];
+    }
+    track_alloc(hdr->size);
+    return hdr + 1;
+  }
+
+  void
+  BufferPool::Free(void *ptr)
+  {
+    if(ptr == nullptr)
+      return;
+    Header *hdr = static_cast< Header * >(ptr) - 1;
+    inuse.fetch_sub(hdr->size, std::memory_order_relaxed);
+    if(hdr->cls == Oversized)
+    {
+      reserved -= sizeof(Header) + hdr->size;
+      free(hdr);
+      return;
+    }
+    auto &c    = cache();
+    auto &list = c.lists[hdr->cls];
+    list.push_back(hdr);
+    if(list.size() > CacheMax)
+      c.spill(hdr->cls);
+  }
+
+  void
+  BufferPool::SetCap(size_t bytes)
+  {
+    cap.store(bytes);
+  }
+
+  BufferPoolStats
+  BufferPool::Stats()
+  {
+    BufferPoolStats st;
+    st.inuse     = inuse.load();
+    st.highwater = highwater.load();
+    st.reserved  = reserved.load();
+    st.cap       = cap.load();
+    st.allocs    = allocs.load();
+    st.failures  = failures.load();
+    return st;
+  }
+}  // namespace llarp
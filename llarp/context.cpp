@@ -6,6 +6,7 @@
 #include <sys/param.h>  // for MIN
 #endif
 #include <llarp.hpp>
+#include <llarp/buffer_pool.hpp>
 #include "logger.hpp"
 #include "math.h"
 #include "router.hpp"
@@ -82,6 +83,29 @@ namespace llarp
         if(ctx->singleThreaded)
           ctx->num_nethreads = 0;
       }
+      else if(!strcmp(key, "net-batch"))
+      {
+        int batch = atoi(val);
+        if(batch >= 0)
+          ctx->net_batch = batch;
+      }
+      else if(!strcmp(key, "net-flush"))
+      {
+        int flush = atoi(val);
+        if(flush >= 0)
+          ctx->net_flush = flush;
+      }
+      else if(!strcmp(key, "net-backend"))
+      {
+        ctx->net_backend = val;
+      }
+      else if(!strcmp(key, "net-buffer-cap"))
+      {
+        // megabytes of packet buffers, 0 for no limit
+        long cap = atol(val);
+        if(cap >= 0)
+          llarp::BufferPool::SetCap(size_t(cap) * 1024 * 1024);
+      }
     }
     if(!strcmp(section, "netdb"))
     {
@@ -110,7 +134,21 @@ namespace llarp
       return 0;
     }
     // llarp::LogInfo("nodedb_dir [", nodedb_dir, "] configured!");
-    ssize_t loaded = llarp_nodedb_load_dir(nodedb, nodedb_dir);
+    ssize_t loaded;
+    if(singleThreaded)
+      loaded = llarp_nodedb_load_dir(nodedb, nodedb_dir);
+    else
+    {
+      // verify on the workers we will run with, read on a disk thread that
+      // only lives for the load
+      if(!worker)
+        worker = llarp_init_threadpool(2, "llarp-worker");
+      llarp_threadpool *disk = llarp_init_threadpool(1, "llarp-diskio");
+      loaded = llarp_nodedb_load_dir_parallel(nodedb, nodedb_dir, disk, worker);
+      llarp_threadpool_stop(disk);
+      llarp_threadpool_join(disk);
+      llarp_free_threadpool(&disk);
+    }
     llarp::LogInfo("nodedb_dir loaded ", loaded, " RCs from [", nodedb_dir,
                    "]");
     if(loaded < 0)
@@ -146,7 +184,21 @@ namespace llarp
     llarp::LogInfo(LLARP_VERSION, " ", LLARP_RELEASE_MOTTO);
     llarp::LogInfo("starting up");
     this->LoadDatabase();
-    llarp_ev_loop_alloc(&mainloop);
+    llarp_ev_loop_alloc_backend(&mainloop, net_backend.c_str());
+    llarp_ev_loop_set_udp_batch(mainloop, net_batch, net_flush);
+#ifdef __linux__
+    // one event loop per net thread, inbound links get sharded over them
+    for(int i = 1; i < num_nethreads; ++i)
+    {
+      llarp_ev_loop *loop = nullptr;
+      llarp_ev_loop_alloc_backend(&loop, net_backend.c_str());
+      llarp_ev_loop_set_udp_batch(loop, net_batch, net_flush);
+      netloops.push_back(loop);
+    }
+#else
+    if(num_nethreads > 1)
+      llarp::LogWarn("net-threads is only supported on linux, using 1");
+#endif
 
     // ensure worker thread pool
     if(!worker && !singleThreaded)
@@ -165,6 +217,8 @@ namespace llarp
       logic = llarp_init_logic();
 
     router = llarp_init_router(worker, mainloop, logic);
+    for(auto loop : netloops)
+      llarp_router_add_netloop(router, loop);
 
     if(!llarp_configure_router(router, config))
     {
@@ -200,8 +254,12 @@ namespace llarp
     }
     else
     {
-
-      llarp::LogInfo("running mainloop");
+      for(auto loop : netloops)
+      {
+        netio_threads.emplace_back([loop]() { llarp_ev_loop_run_io(loop); });
+      }
+      llarp::LogInfo("running mainloop with ", netloops.size() + 1,
+                     " network threads");
       return llarp_ev_loop_run(mainloop, logic);
     }
     return 0;
@@ -234,6 +292,21 @@ namespace llarp
   void
   Context::Close()
   {
+    // stop extra network threads first so no shard socket is in use while
+    // the router closes its links
+    for(size_t i = 0; i < netio_threads.size(); ++i)
+    {
+      llarp::LogDebug("stopping event loop thread ", i);
+      llarp_ev_loop_stop(netloops[i]);
+    }
+
+    for(auto &t : netio_threads)
+    {
+      llarp::LogDebug("join netio thread");
+      t.join();
+    }
+    netio_threads.clear();
+
     llarp::LogDebug("stop router");
     if(router)
       llarp_stop_router(router);
@@ -251,6 +324,8 @@ namespace llarp
     if(logic)
       llarp_logic_stop(logic);
 
+    llarp::LogInfo("buffer pool ", llarp::BufferPool::Stats());
+
     llarp::LogDebug("free config");
     llarp_free_config(&config);
 
@@ -260,28 +335,16 @@ namespace llarp
     llarp::LogDebug("free nodedb");
     llarp_nodedb_free(&nodedb);
 
-    for(size_t i = 0; i < netio_threads.size(); ++i)
-    {
-      if(mainloop)
-      {
-        llarp::LogDebug("stopping event loop thread ", i);
-        llarp_ev_loop_stop(mainloop);
-      }
-    }
-
     llarp::LogDebug("free router");
     llarp_free_router(&router);
 
     llarp::LogDebug("free logic");
     llarp_free_logic(&logic);
 
-    for(auto &t : netio_threads)
-    {
-      llarp::LogDebug("join netio thread");
-      t.join();
-    }
+    for(auto &loop : netloops)
+      llarp_ev_loop_free(&loop);
+    netloops.clear();
 
-    netio_threads.clear();
     llarp::LogDebug("free mainloop");
     llarp_ev_loop_free(&mainloop);
   }
@@ -401,10 +464,10 @@ extern "C"
       static_cast< struct check_online_request * >(u);
   // llarp::LogDebug("checkOnline - running");
   // llarp::LogInfo("checkOnline - DHT nodes ",
-  // request->ptr->ctx->router->dht->impl.nodes->nodes.size());
+  // request->ptr->ctx->router->dht->impl.nodes->Size());
   request->online = false;
-  request->nodes  = request->ptr->ctx->router->dht->impl.nodes->nodes.size();
-  if(request->ptr->ctx->router->dht->impl.nodes->nodes.size())
+  request->nodes  = request->ptr->ctx->router->dht->impl.nodes->Size();
+  if(request->ptr->ctx->router->dht->impl.nodes->Size())
   {
     // llarp::LogInfo("checkOnline - Going to say we're online");
     request->online = true;
@@ -1,4 +1,4 @@
-#include <llarp/crypto_async.h>
+#include <llarp/crypto_async.hpp>
 #include <llarp/mem.h>
 #include <llarp/router_contact.h>
 #include <string.h>
@@ -325,7 +325,7 @@ namespace iwp
   {
     iwp_async_frame *frame = static_cast< iwp_async_frame * >(user);
     frame->hook(frame);
-    delete frame;
+    llarp::FreeIWPFrame(frame);
   }
 
   void
@@ -344,7 +344,7 @@ namespace iwp
     iwp_encrypt_frame(frame);
     // call result RIGHT HERE
     frame->hook(frame);
-    delete frame;
+    llarp::FreeIWPFrame(frame);
   }
 }  // namespace iwp
 
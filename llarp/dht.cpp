@@ -25,7 +25,8 @@ llarp_dht_put_peer(struct llarp_dht_context *ctx, struct llarp_rc *rc)
 {
   llarp::dht::RCNode n(rc);
   llarp::LogDebug("Adding ", n.ID, " to DHT");
-  ctx->impl.nodes->PutNode(n);
+  // we have a session with it, keep it until llarp_dht_remove_peer
+  ctx->impl.nodes->PutNode(n, true);
 }
 
 void
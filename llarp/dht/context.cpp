@@ -32,19 +32,13 @@ namespace llarp
       if(ctx->services)
       {
         // expire intro sets
-        auto now    = llarp_time_now_ms();
-        auto &nodes = ctx->services->nodes;
-        auto itr    = nodes.begin();
-        while(itr != nodes.end())
-        {
-          if(itr->second.introset.IsExpired(now))
-          {
-            llarp::LogInfo("introset expired ", itr->second.introset.A.Addr());
-            itr = nodes.erase(itr);
-          }
-          else
-            ++itr;
-        }
+        auto now = llarp_time_now_ms();
+        ctx->services->RemoveIf([now](const ISNode &node) -> bool {
+          if(!node.introset.IsExpired(now))
+            return false;
+          llarp::LogInfo("introset expired ", node.introset.A.Addr());
+          return true;
+        });
       }
       ctx->ScheduleCleanupTimer();
     }
@@ -115,7 +109,7 @@ namespace llarp
       pendingTX[ownerKey] = job;
       auto msg            = new llarp::DHTImmeidateMessage(peer);
       msg->msgs.push_back(new PublishIntroMessage(introset, id, S, E));
-      router->SendToOrQueue(peer, msg);
+      sendToPeer(peer, msg);
     }
 
     void
@@ -139,72 +133,42 @@ namespace llarp
       msg->msgs.push_back(dhtmsg);
       llarp::LogInfo("asking ", askpeer, " for tag ", tag.ToString(), " with ",
                      j->localIntroSets.size(), " local tags txid=", txid);
-      router->SendToOrQueue(askpeer, msg);
+      sendToPeer(askpeer, msg);
     }
 
     void
     Context::LookupIntroSetForPath(const service::Address &addr, uint64_t txid,
-                                   const llarp::PathID_t &path,
-                                   const Key_t &askpeer)
+                                   const llarp::PathID_t &path)
     {
-      auto id = ++ids;
-      TXOwner ownerKey;
-      ownerKey.node    = askpeer;
-      ownerKey.txid    = id;
       PathLookupJob *j = new PathLookupJob(router, path, txid);
       SearchJob job(
-          OurKey(), txid,
+          OurKey(), txid, addr, {},
           std::bind(&PathLookupJob::OnResult, j, std::placeholders::_1));
-      pendingTX[ownerKey] = job;
-
-      auto msg    = new llarp::DHTImmeidateMessage(askpeer);
-      auto dhtmsg = new FindIntroMessage(addr, id);
-      msg->msgs.push_back(dhtmsg);
-      router->SendToOrQueue(askpeer, msg);
+      StartLookup(job, IterativeLookup::eIntroSet, false);
     }
 
     std::set< service::IntroSet >
     Context::FindRandomIntroSetsWithTag(const service::Tag &tag, size_t max)
     {
       std::set< service::IntroSet > found;
-      auto &nodes = services->nodes;
-      if(nodes.size() == 0)
+      if(services->Size() == 0)
         return found;
-
-      auto itr = nodes.begin();
-      // start at random middle point
-      auto start = llarp_randint() % nodes.size();
-      std::advance(itr, start);
-      auto end            = itr;
       std::string tagname = tag.ToString();
-      while(itr != nodes.end())
-      {
-        if(itr->second.introset.topic.ToString() == tagname)
-        {
-          found.insert(itr->second.introset);
-          if(found.size() == max)
-            return found;
-        }
-        ++itr;
-      }
-      itr = nodes.begin();
-      while(itr != end)
-      {
-        if(itr->second.introset.topic.ToString() == tagname)
-        {
-          found.insert(itr->second.introset);
-          if(found.size() == max)
-            return found;
-        }
-        ++itr;
-      }
+      // start at random middle point
+      services->ForEach(
+          [&](const ISNode &node) -> bool {
+            if(node.introset.topic.ToString() == tagname)
+              found.insert(node.introset);
+            return found.size() != max;
+          },
+          llarp_randint() % services->Size());
       return found;
     }
 
     void
     Context::LookupRouterRelayed(const Key_t &requester, uint64_t txid,
                                  const Key_t &target, bool recursive,
-                                 std::vector< IMessage * > &replies)
+                                 MessageList &replies)
     {
       if(target == ourKey)
       {
@@ -220,7 +184,7 @@ namespace llarp
         {
           // we know it
           replies.push_back(
-              new GotRouterMessage(requester, txid, nodes->nodes[target].rc));
+              new GotRouterMessage(requester, txid, nodes->GetNode(target)->rc));
         }
         else if(recursive)  // are we doing a recursive lookup?
         {
@@ -234,11 +198,8 @@ namespace llarp
           }
           else
           {
-            // yeah, ask neighboor recursively
-            // FIXME: we may need to pass a job here...
-            // auto sj = FindPendingTX(requester, txid);
-            // LookupRouter(target, requester, txid, next, sj->job);
-            LookupRouter(target, requester, txid, next);
+            // yeah, ask neighboors recursively, we reply when done
+            LookupRouter(target, requester, txid, nullptr, false, excluding);
           }
         }
         else  // otherwise tell them we don't have it
@@ -263,10 +224,10 @@ namespace llarp
     Context::GetIntroSetByServiceAddress(
         const llarp::service::Address &addr) const
     {
-      auto itr = services->nodes.find(addr.data());
-      if(itr == services->nodes.end())
+      auto node = services->GetNode(addr.data());
+      if(node == nullptr)
         return nullptr;
-      return &itr->second.introset;
+      return &node->introset;
     }
 
     void
@@ -300,26 +261,323 @@ namespace llarp
       auto now = llarp_time_now_ms();
       llarp::LogDebug("DHT tick");
 
+      // timing out a lookup request can send new ones so collect first
+      std::vector< SearchJob > expired;
       auto itr = pendingTX.begin();
       while(itr != pendingTX.end())
       {
         if(itr->second.IsExpired(now))
         {
-          itr->second.Timeout();
+          expired.push_back(itr->second);
           itr = pendingTX.erase(itr);
         }
         else
           ++itr;
       }
+      for(const auto &job : expired)
+      {
+        // a request that timed out counts as a miss for its lookup
+        if(job.lookup)
+          LookupMissed(job.lookup);
+        else
+          job.Timeout();
+      }
+      routerCache.Expire(now);
+      introSetCache.Expire(now);
+      llarp::LogDebug("router lookup cache ", routerCache.stats,
+                      " introset lookup cache ", introSetCache.stats);
+    }
+
+    void
+    Context::StartLookup(const SearchJob &job, IterativeLookup::Kind kind,
+                         bool iterative)
+    {
+      if(LookupFromCache(job, kind))
+        return;
+      auto &lookups = LookupsFor(kind);
+      auto range    = lookups.equal_range(job.target);
+      for(auto itr = range.first; itr != range.second; ++itr)
+      {
+        auto lookup = itr->second;
+        if(lookup->iterative != iterative || lookup->exclude != job.exclude)
+          continue;
+        // already looking it up the same way, wait for that
+        lookup->waiters.push_back(job);
+        if(job.requester == ourKey && lookup->alpha < IterativeLookup::Alpha)
+        {
+          lookup->alpha = IterativeLookup::Alpha;
+          ContinueLookup(lookup);
+        }
+        return;
+      }
+      auto lookup       = std::make_shared< IterativeLookup >();
+      lookup->kind      = kind;
+      lookup->target    = job.target;
+      lookup->iterative = iterative;
+      lookup->exclude   = job.exclude;
+      if(job.requester != ourKey)
+        lookup->alpha = 1;
+      lookup->waiters.push_back(job);
+      std::set< Key_t > exclude = job.exclude;
+      exclude.insert(ourKey);
+      nodes->FindClosestK(job.target, IterativeLookup::ShortlistSize,
+                          lookup->shortlist, exclude);
+      lookups.emplace(job.target, lookup);
+      ContinueLookup(lookup);
+    }
+
+    void
+    Context::RemoveLookup(const Lookup_ptr &lookup)
+    {
+      auto &lookups = LookupsFor(lookup->kind);
+      auto range    = lookups.equal_range(lookup->target);
+      for(auto itr = range.first; itr != range.second; ++itr)
+      {
+        if(itr->second == lookup)
+        {
+          lookups.erase(itr);
+          return;
+        }
+      }
+    }
+
+    bool
+    Context::LookupFromCache(const SearchJob &job, IterativeLookup::Kind kind)
+    {
+      auto now = llarp_time_now_ms();
+      if(kind == IterativeLookup::eRouter)
+      {
+        auto cached = routerCache.Get(job.target, now);
+        if(cached == nullptr)
+          return false;
+        FoundRouter(job, cached->val.get());
+      }
+      else
+      {
+        auto cached = introSetCache.Get(job.target, now);
+        if(cached == nullptr)
+          return false;
+        job.FoundIntros(cached->val);
+      }
+      return true;
+    }
+
+    void
+    Context::ContinueLookup(const Lookup_ptr &lookup)
+    {
+      while(!lookup->done && lookup->inflight < lookup->alpha
+            && lookup->next < lookup->shortlist.size())
+        AskPeer(lookup->shortlist[lookup->next++], lookup);
+      if(lookup->done || lookup->inflight)
+        return;
+      llarp::LogInfo("lookup for ", lookup->target, " failed after asking ",
+                     lookup->next, " peers");
+      if(lookup->kind == IterativeLookup::eRouter)
+        FinishRouterLookup(lookup, nullptr);
+      else
+        FinishIntroSetLookup(lookup, {});
+    }
+
+    void
+    Context::AskPeer(const Key_t &peer, const Lookup_ptr &lookup)
+    {
+      auto id = ++ids;
+      TXOwner ownerKey;
+      ownerKey.node = peer;
+      ownerKey.txid = id;
+      // requests only need to find their lookup again
+      SearchJob &pending = pendingTX[ownerKey];
+      pending.started    = llarp_time_now_ms();
+      pending.target     = lookup->target;
+      pending.lookup     = lookup;
+      ++lookup->inflight;
+
+      auto msg = new llarp::DHTImmeidateMessage(peer);
+      if(lookup->kind == IterativeLookup::eRouter)
+      {
+        llarp::LogInfo("Asking ", peer, " for router ", lookup->target);
+        auto dhtmsg       = new FindRouterMessage(peer, lookup->target, id);
+        dhtmsg->iterative = lookup->iterative;
+        msg->msgs.push_back(dhtmsg);
+      }
+      else
+      {
+        auto dhtmsg =
+            new FindIntroMessage(service::Address(lookup->target.data()), id);
+        dhtmsg->iterative = lookup->iterative;
+        msg->msgs.push_back(dhtmsg);
+      }
+      sendToPeer(peer, msg);
+    }
+
+    void
+    Context::LookupMissed(const Lookup_ptr &lookup)
+    {
+      // someone else answered first
+      if(lookup->done)
+        return;
+      --lookup->inflight;
+      ContinueLookup(lookup);
+    }
+
+    bool
+    Context::ValidRouter(const Key_t &target, const llarp_rc *rc)
+    {
+      if(Key_t(rc->pubkey) != target)
+        return false;
+      // verifying zeroes the signature for a moment, use a copy
+      llarp_rc copy;
+      llarp_rc_clear(&copy);
+      llarp_rc_copy(&copy, rc);
+      bool valid = llarp_rc_verify_sig(crypto, &copy);
+      llarp_rc_free(&copy);
+      return valid;
+    }
+
+    void
+    Context::RouterLookupReply(const SearchJob &job, const llarp_rc *rc)
+    {
+      bool valid = rc == nullptr || ValidRouter(job.target, rc);
+      if(!valid)
+        llarp::LogWarn("got an invalid rc for ", job.target);
+      if(!job.lookup)
+      {
+        FoundRouter(job, valid ? rc : nullptr);
+        return;
+      }
+      if(!valid)
+        LookupMissed(job.lookup);
+      else if(rc == nullptr)
+      {
+        ++job.lookup->misses;
+        LookupMissed(job.lookup);
+      }
+      else if(!job.lookup->done)
+      {
+        --job.lookup->inflight;
+        FinishRouterLookup(job.lookup, rc);
+      }
+    }
+
+    void
+    Context::IntroSetLookupReply(
+        const SearchJob &job, const std::vector< service::IntroSet > &introsets)
+    {
+      if(!job.lookup)
+      {
+        job.FoundIntros(introsets);
+        return;
+      }
+      auto now = llarp_time_now_ms();
+      std::vector< service::IntroSet > valid;
+      for(const auto &introset : introsets)
+      {
+        if(Key_t(introset.A.Addr().data()) == job.lookup->target
+           && !introset.IsExpired(now))
+          valid.push_back(introset);
+      }
+      if(valid.size() != introsets.size())
+        llarp::LogWarn("ignored ", introsets.size() - valid.size(),
+                       " introsets that aren't for ", job.lookup->target);
+      if(introsets.empty())
+      {
+        ++job.lookup->misses;
+        LookupMissed(job.lookup);
+      }
+      else if(valid.empty())
+        LookupMissed(job.lookup);
+      else if(!job.lookup->done)
+      {
+        --job.lookup->inflight;
+        FinishIntroSetLookup(job.lookup, valid);
+      }
+    }
+
+    void
+    Context::FinishRouterLookup(const Lookup_ptr &lookup, const llarp_rc *rc)
+    {
+      lookup->done = true;
+      RemoveLookup(lookup);
+      auto now = llarp_time_now_ms();
+      if(rc)
+      {
+        std::shared_ptr< llarp_rc > copy(new llarp_rc, [](llarp_rc *r) {
+          llarp_rc_free(r);
+          delete r;
+        });
+        llarp_rc_clear(copy.get());
+        llarp_rc_copy(copy.get(), rc);
+        // good until the rc itself is
+        llarp_time_t expires = rc->last_updated + RC_LIFETIME;
+        if(expires > now)
+          routerCache.Put(lookup->target, copy, expires);
+      }
+      else if(lookup->misses)
+      {
+        // only believe it is missing if someone told us so
+        routerCache.PutMissing(lookup->target, now);
+      }
+      for(const auto &job : lookup->waiters)
+        FoundRouter(job, rc);
+      lookup->waiters.clear();
+    }
+
+    void
+    Context::FinishIntroSetLookup(
+        const Lookup_ptr &lookup,
+        const std::vector< service::IntroSet > &introsets)
+    {
+      lookup->done = true;
+      RemoveLookup(lookup);
+      auto now = llarp_time_now_ms();
+      if(introsets.size())
+      {
+        // good until the last intro in them expires
+        llarp_time_t expires = now;
+        for(const auto &introset : introsets)
+          for(const auto &intro : introset.I)
+            expires = std::max(expires, llarp_time_t(intro.expiresAt));
+        if(expires > now)
+          introSetCache.Put(lookup->target, introsets, expires);
+      }
+      else if(lookup->misses)
+        introSetCache.PutMissing(lookup->target, now);
+      for(const auto &job : lookup->waiters)
+        job.FoundIntros(introsets);
+      lookup->waiters.clear();
+    }
+
+    void
+    Context::FoundRouter(const SearchJob &job, const llarp_rc *rc)
+    {
+      job.FoundRouter(rc);
+      if(job.requester != ourKey)
+      {
+        auto msg = new llarp::DHTImmeidateMessage(job.requester);
+        msg->msgs.push_back(new GotRouterMessage(ourKey, job.requesterTX, rc));
+        sendToPeer(job.requester, msg);
+      }
     }
 
     void
     Context::Init(const Key_t &us, llarp_router *r)
     {
-      router   = r;
-      ourKey   = us;
-      nodes    = new Bucket< RCNode >(ourKey);
-      services = new Bucket< ISNode >(ourKey);
+      router = r;
+      Init(us, &r->crypto,
+           [r](const Key_t &peer, const ILinkMessage *msg) {
+             r->SendToOrQueue(peer, msg);
+           });
+    }
+
+    void
+    Context::Init(const Key_t &us, llarp_crypto *c, SendFunc send)
+    {
+      crypto     = c;
+      sendToPeer = send;
+      ourKey     = us;
+      nodes      = new Bucket< RCNode >(ourKey);
+      // introsets we hold for others are storage, never evict them
+      services = new Bucket< ISNode >(ourKey, 0);
       llarp::LogDebug("intialize dht with key ", ourKey);
     }
 
@@ -396,82 +654,54 @@ namespace llarp
       auto dhtmsg = new FindIntroMessage(tag, id);
       dhtmsg->R   = R;
       msg->msgs.push_back(dhtmsg);
-      router->SendToOrQueue(askpeer, msg);
+      sendToPeer(askpeer, msg);
     }
 
     void
     Context::LookupIntroSet(const service::Address &addr, const Key_t &whoasked,
-                            uint64_t txid, const Key_t &askpeer, bool iterative,
+                            uint64_t txid, bool iterative,
                             std::set< Key_t > excludes)
     {
-      auto id = ++ids;
       if(txid == 0)
-        txid = id;
-
-      TXOwner ownerKey;
-      ownerKey.node        = askpeer;
-      ownerKey.txid        = id;
+        txid = ++ids;
       IntroSetInformJob *j = new IntroSetInformJob(router, whoasked, txid);
       SearchJob job(
           whoasked, txid, addr, excludes,
           std::bind(&IntroSetInformJob::OnResult, j, std::placeholders::_1));
-      pendingTX[ownerKey] = job;
-
-      auto msg    = new llarp::DHTImmeidateMessage(askpeer);
-      auto dhtmsg = new FindIntroMessage(addr, id);
-      msg->msgs.push_back(dhtmsg);
-      router->SendToOrQueue(askpeer, msg);
+      StartLookup(job, IterativeLookup::eIntroSet, iterative);
     }
 
     void
     Context::LookupRouter(const Key_t &target, const Key_t &whoasked,
-                          uint64_t txid, const Key_t &askpeer,
-                          llarp_router_lookup_job *job, bool iterative,
-                          std::set< Key_t > excludes)
+                          uint64_t txid, llarp_router_lookup_job *job,
+                          bool iterative, std::set< Key_t > excludes)
     {
-      if(target.IsZero() || whoasked.IsZero() || askpeer.IsZero())
+      if(target.IsZero() || whoasked.IsZero())
       {
         return;
       }
-      auto id = ++ids;
-      TXOwner ownerKey;
-      ownerKey.node = askpeer;
-      ownerKey.txid = id;
       if(txid == 0)
-        txid = id;
-      SearchJob j(whoasked, txid, target, excludes, job);
-      pendingTX[ownerKey] = j;
-      llarp::LogInfo("Asking ", askpeer, " for router ", target, " for ",
-                     whoasked);
-      auto msg          = new llarp::DHTImmeidateMessage(askpeer);
-      auto dhtmsg       = new FindRouterMessage(askpeer, target, id);
-      dhtmsg->iterative = iterative;
-      msg->msgs.push_back(dhtmsg);
-      router->SendToOrQueue(askpeer, msg);
+        txid = ++ids;
+      StartLookup(SearchJob(whoasked, txid, target, excludes, job),
+                  IterativeLookup::eRouter, iterative);
     }
 
     void
     Context::LookupRouterViaJob(llarp_router_lookup_job *job)
     {
-      Key_t peer;
       /*
       llarp::LogInfo("LookupRouterViaJob dumping nodes");
-      for(const auto &item : nodes->nodes)
-      {
-        llarp::LogInfo("LookupRouterViaJob dumping node: ", item.first);
-      }
+      nodes->ForEach([](const RCNode &node) -> bool {
+        llarp::LogInfo("LookupRouterViaJob dumping node: ", node.ID);
+        return true;
+      });
       */
-      llarp::LogInfo("LookupRouterViaJob node count: ", nodes->nodes.size());
+      llarp::LogInfo("LookupRouterViaJob node count: ", nodes->Size());
       llarp::LogInfo("LookupRouterViaJob recursive: ",
                      job->iterative ? "yes" : "no");
 
-      if(nodes->FindClosest(job->target, peer))
-        LookupRouter(job->target, ourKey, 0, peer, job, job->iterative);
-      else if(job->hook)
-      {
-        job->found = false;
-        job->hook(job);
-      }
+      // with no peers to ask this calls the hook right away
+      LookupRouter(job->target, ourKey, 0, job, job->iterative);
     }
 
     void
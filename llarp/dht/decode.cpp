@@ -5,142 +5,88 @@ namespace llarp
 {
   namespace dht
   {
-    struct MessageDecoder
+    /// make a T in arena if we have one, otherwise on the heap
+    template < typename T, typename... Args >
+    static IMessage *
+    Make(Arena *arena, Args &&... args)
     {
-      const Key_t &From;
-      bool firstKey = true;
-      IMessage *msg = nullptr;
-      bool relayed  = false;
-
-      MessageDecoder(const Key_t &from) : From(from)
-      {
-      }
+      if(arena)
+        return arena->New< T >(std::forward< Args >(args)...);
+      return new T(std::forward< Args >(args)...);
+    }
 
-      static bool
-      on_key(dict_reader *r, llarp_buffer_t *key)
+    static IMessage *
+    CreateMessage(byte_t type, const Key_t &from, bool relayed, Arena *arena)
+    {
+      llarp::LogDebug("Handle DHT message ", type);
+      switch(type)
       {
-        llarp_buffer_t strbuf;
-        MessageDecoder *dec = static_cast< MessageDecoder * >(r->user);
-        // check for empty dict
-        if(!key)
-          return !dec->firstKey;
-
-        // first key
-        if(dec->firstKey)
-        {
-          if(!llarp_buffer_eq(*key, "A"))
-            return false;
-          if(!bencode_read_string(r->buffer, &strbuf))
-            return false;
-          // bad msg size?
-          if(strbuf.sz != 1)
-            return false;
-          llarp::LogInfo("Handle DHT message ", *strbuf.base);
-          switch(*strbuf.base)
+        case 'F':
+          return Make< FindIntroMessage >(arena, from, relayed);
+        case 'R':
+          if(relayed)
+            return Make< RelayedFindRouterMessage >(arena, from);
+          return Make< FindRouterMessage >(arena, from);
+        case 'S':
+          if(relayed)
           {
-            case 'F':
-              dec->msg = new FindIntroMessage(dec->From, dec->relayed);
-              break;
-            case 'R':
-              if(dec->relayed)
-                dec->msg = new RelayedFindRouterMessage(dec->From);
-              else
-                dec->msg = new FindRouterMessage(dec->From);
-              break;
-            case 'S':
-              if(dec->relayed)
-              {
-                llarp::LogWarn(
-                    "GotRouterMessage found when parsing relayed DHT "
-                    "message");
-                return false;
-              }
-              else
-                dec->msg = new GotRouterMessage(dec->From);
-              break;
-            case 'I':
-              dec->msg = new PublishIntroMessage();
-              break;
-            case 'G':
-              if(dec->relayed)
-              {
-                dec->msg = new RelayedGotIntroMessage();
-                break;
-              }
-              else
-              {
-                dec->msg = new GotIntroMessage(dec->From);
-                break;
-              }
-            default:
-              llarp::LogWarn("unknown dht message type: ", (char)*strbuf.base);
-              // bad msg type
-              return false;
+            llarp::LogWarn(
+                "GotRouterMessage found when parsing relayed DHT "
+                "message");
+            return nullptr;
           }
-          dec->firstKey = false;
-          return dec->msg != nullptr;
-        }
-        else
-          return dec->msg->DecodeKey(*key, r->buffer);
+          return Make< GotRouterMessage >(arena, from);
+        case 'I':
+          return Make< PublishIntroMessage >(arena);
+        case 'G':
+          if(relayed)
+            return Make< RelayedGotIntroMessage >(arena);
+          return Make< GotIntroMessage >(arena, from);
+        default:
+          llarp::LogWarn("unknown dht message type: ", (char)type);
+          // bad msg type
+          return nullptr;
       }
-    };
+    }
 
     IMessage *
-    DecodeMesssage(const Key_t &from, llarp_buffer_t *buf, bool relayed)
+    DecodeMessage(const Key_t &from, llarp_buffer_t *buf, bool relayed,
+                  Arena *arena)
     {
-      MessageDecoder dec(from);
-      dec.relayed = relayed;
-      dict_reader r;
-      r.user   = &dec;
-      r.on_key = &MessageDecoder::on_key;
-      if(bencode_read_dict(buf, &r))
-      {
-        return dec.msg;
-      }
-      else
-      {
-        if(dec.msg)
-          delete dec.msg;
-        return nullptr;
-      }
+      BencodeReader reader(buf);
+      llarp_buffer_t key, type;
+      IMessage *msg = nullptr;
+      // the first key is the message type
+      if(reader.EnterDict() && reader.NextKey(key) && llarp_buffer_eq(key, "A")
+         && reader.ReadString(type) && type.sz == 1)
+        msg = CreateMessage(*type.base, from, relayed, arena);
+      bool decoded = msg != nullptr;
+      while(decoded && reader.NextKey(key))
+        decoded = msg->DecodeKey(key, buf);
+      if(decoded && !reader.failed)
+        return msg;
+      // what the arena made goes away with its scope
+      if(arena == nullptr)
+        delete msg;
+      return nullptr;
     }
 
-    struct ListDecoder
+    bool
+    DecodeMesssageList(const Key_t &from, llarp_buffer_t *buf,
+                       MessageList &list, bool relayed)
     {
-      ListDecoder(const Key_t &from, std::vector< IMessage * > &list)
-          : From(from), l(list){};
-
-      bool relayed = false;
-      const Key_t &From;
-      std::vector< IMessage * > &l;
-
-      static bool
-      on_item(list_reader *r, bool has)
+      Arena *arena = list.get_allocator().arena;
+      BencodeReader reader(buf);
+      if(!reader.EnterList())
+        return false;
+      while(reader.NextItem())
       {
-        ListDecoder *dec = static_cast< ListDecoder * >(r->user);
-        if(!has)
-          return true;
-        auto msg = DecodeMesssage(dec->From, r->buffer, dec->relayed);
-        if(msg)
-        {
-          dec->l.push_back(msg);
-          return true;
-        }
-        else
+        auto msg = DecodeMessage(from, buf, relayed, arena);
+        if(msg == nullptr)
           return false;
+        list.push_back(msg);
       }
-    };
-
-    bool
-    DecodeMesssageList(const Key_t &from, llarp_buffer_t *buf,
-                       std::vector< IMessage * > &list, bool relayed)
-    {
-      ListDecoder dec(from, list);
-      dec.relayed = relayed;
-      list_reader r;
-      r.user    = &dec;
-      r.on_item = &ListDecoder::on_item;
-      return bencode_read_list(buf, &r);
+      return !reader.failed;
     }
   }  // namespace dht
-}  // namespace llarp
\ No newline at end of file
+}  // namespace llarp
@@ -5,8 +5,12 @@ namespace llarp
 {
   DHTImmeidateMessage::~DHTImmeidateMessage()
   {
-    for(auto &msg : msgs)
-      delete msg;
+    // messages from an arena are destroyed with it
+    if(msgs.get_allocator().arena == nullptr)
+    {
+      for(auto &msg : msgs)
+        delete msg;
+    }
     msgs.clear();
   }
 
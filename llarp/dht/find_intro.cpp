@@ -70,7 +70,6 @@ namespace llarp
         return false;
       if(N.IsZero())
       {
-        return false;
         // r5n counter
         if(!BEncodeWriteDictInt("R", R, buf))
           return false;
@@ -97,9 +96,8 @@ namespace llarp
     }
 
     bool
-    FindIntroMessage::HandleMessage(
-        llarp_dht_context* ctx,
-        std::vector< llarp::dht::IMessage* >& replies) const
+    FindIntroMessage::HandleMessage(llarp_dht_context* ctx,
+                                    MessageList& replies) const
     {
       if(R > 5)
       {
@@ -130,13 +128,13 @@ namespace llarp
             if(dht.nodes->FindCloseExcluding(S, peer, exclude))
             {
               if(relayed)
-                dht.LookupIntroSetForPath(S, T, pathID, peer);
+                dht.LookupIntroSetForPath(S, T, pathID);
               else if((peer ^ dht.OurKey())
                       > (peer
                          ^ From))  // peer is closer than us, recursive search
-                dht.LookupIntroSet(S, From, T, peer);
+                dht.LookupIntroSet(S, From, T, false, exclude);
               else  // we are closer than peer so do iterative search
-                dht.LookupIntroSet(S, From, T, peer, true);
+                dht.LookupIntroSet(S, From, T, true, exclude);
             }
             else
             {
@@ -64,8 +64,8 @@ namespace llarp
     };
 
     bool
-    RelayedFindRouterMessage::HandleMessage(
-        llarp_dht_context *ctx, std::vector< IMessage * > &replies) const
+    RelayedFindRouterMessage::HandleMessage(llarp_dht_context *ctx,
+                                            MessageList &replies) const
     {
       auto &dht = ctx->impl;
       /// lookup for us, send an immeidate reply
@@ -88,9 +88,7 @@ namespace llarp
       llarp_rc_clear(&job->result);
       job->dht = ctx;
       memcpy(job->target, K, sizeof(job->target));
-      Key_t peer;
-      if(dht.nodes->FindClosest(K, peer))
-        dht.LookupRouter(K, dht.OurKey(), txid, peer, job);
+      dht.LookupRouter(K, dht.OurKey(), txid, job);
       return false;
     }
 
@@ -174,7 +172,7 @@ namespace llarp
 
     bool
     FindRouterMessage::HandleMessage(llarp_dht_context *ctx,
-                                     std::vector< IMessage * > &replies) const
+                                     MessageList &replies) const
     {
       auto &dht = ctx->impl;
       if(!dht.allowTransit)
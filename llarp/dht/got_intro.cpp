@@ -20,7 +20,7 @@ namespace llarp
 
     bool
     GotIntroMessage::HandleMessage(llarp_dht_context *ctx,
-                                   std::vector< IMessage * > &replies) const
+                                   MessageList &replies) const
     {
       auto &dht   = ctx->impl;
       auto crypto = &dht.router->crypto;
@@ -39,8 +39,10 @@ namespace llarp
       auto pending = dht.FindPendingTX(From, T);
       if(pending)
       {
-        pending->FoundIntros(I);
+        // answering can send more requests, copy it out first
+        SearchJob job = *pending;
         dht.RemovePendingLookup(From, T);
+        dht.IntroSetLookupReply(job, I);
         return true;
       }
       else
@@ -52,8 +54,8 @@ namespace llarp
     }
 
     bool
-    RelayedGotIntroMessage::HandleMessage(
-        llarp_dht_context *ctx, std::vector< IMessage * > &replies) const
+    RelayedGotIntroMessage::HandleMessage(llarp_dht_context *ctx,
+                                          MessageList &replies) const
     {
       // TODO: implement me better?
       auto pathset = ctx->impl.router->paths.GetLocalPathSet(pathID);
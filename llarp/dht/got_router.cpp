@@ -59,53 +59,18 @@ namespace llarp
 
     bool
     GotRouterMessage::HandleMessage(llarp_dht_context *ctx,
-                                    std::vector< IMessage * > &replies) const
+                                    MessageList &replies) const
     {
       auto &dht          = ctx->impl;
       SearchJob *pending = dht.FindPendingTX(From, txid);
       if(pending)
       {
-        if(R.size())
-        {
-          pending->FoundRouter(&R[0]);
-          if(pending->requester != dht.OurKey())
-          {
-            replies.push_back(new GotRouterMessage(
-                pending->target, pending->requesterTX, &R[0]));
-          }
-        }
-        else
-        {
-          // iterate to next closest peer
-          Key_t nextPeer;
-          pending->exclude.insert(From);
-          if(pending->exclude.size() < 3
-             && dht.nodes->FindCloseExcluding(pending->target, nextPeer,
-                                              pending->exclude))
-          {
-            llarp::LogInfo(pending->target, " was not found via ", From,
-                           " iterating to next peer ", nextPeer,
-                           " already asked ", pending->exclude.size(),
-                           " other peers");
-            // REVIEW: is this ok to relay the pending->job as the current job
-            // (seems to make things work)
-            dht.LookupRouter(pending->target, pending->requester,
-                             pending->requesterTX, nextPeer, pending->job, true,
-                             pending->exclude);
-          }
-          else
-          {
-            llarp::LogInfo(pending->target, " was not found via ", From,
-                           " and we won't look it up");
-            pending->FoundRouter(nullptr);
-            if(pending->requester != dht.OurKey())
-            {
-              replies.push_back(new GotRouterMessage(
-                  pending->target, pending->requesterTX, nullptr));
-            }
-          }
-        }
+        // answering can send more requests, copy it out first
+        SearchJob job = *pending;
         dht.RemovePendingLookup(From, txid);
+        if(R.size() == 0)
+          llarp::LogInfo(job.target, " was not found via ", From);
+        dht.RouterLookupReply(job, R.size() ? &R[0] : nullptr);
         return true;
       }
       llarp::LogWarn(
@@ -41,7 +41,7 @@ namespace llarp
 
     bool
     PublishIntroMessage::HandleMessage(llarp_dht_context *ctx,
-                                       std::vector< IMessage * > &replies) const
+                                       MessageList &replies) const
     {
       if(S > 5)
       {
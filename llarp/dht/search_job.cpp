@@ -3,6 +3,10 @@ namespace llarp
 {
   namespace dht
   {
+    const size_t IterativeLookup::Alpha;
+    const size_t IterativeLookup::ShortlistSize;
+    const uint64_t IterativeLookup::RequestTimeout;
+
     SearchJob::SearchJob()
     {
       started = 0;
@@ -69,7 +73,8 @@ namespace llarp
     bool
     SearchJob::IsExpired(llarp_time_t now) const
     {
-      return now - started >= JobTimeout;
+      return now - started
+          >= (lookup ? IterativeLookup::RequestTimeout : JobTimeout);
     }
 
     void
@@ -21,8 +21,7 @@ namespace llarp
   }
   Encrypted::~Encrypted()
   {
-    if(_data)
-      delete[] _data;
+    Release();
   }
 
   Encrypted::Encrypted(size_t sz) : Encrypted(nullptr, sz)
@@ -4,6 +4,9 @@
 
 #ifdef __linux__
 #include "ev_epoll.hpp"
+#ifdef LLARP_IO_URING
+#include "ev_uring.hpp"
+#endif
 #endif
 #if defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__) || (__APPLE__ && __MACH__)
 #include "ev_kqueue.hpp"
@@ -33,6 +36,29 @@ llarp_ev_loop_alloc(struct llarp_ev_loop **ev)
   (*ev)->init();
 }
 
+void
+llarp_ev_loop_alloc_backend(struct llarp_ev_loop **ev, const char *backend)
+{
+  if(backend && !strcmp(backend, "io_uring"))
+  {
+#ifdef LLARP_IO_URING
+    llarp_uring_loop *loop = new llarp_uring_loop;
+    if(loop->init())
+    {
+      *ev = loop;
+      return;
+    }
+    delete loop;
+    llarp::LogWarn("io_uring unavailable, using default event loop");
+#else
+    llarp::LogWarn("built without io_uring, using default event loop");
+#endif
+  }
+  else if(backend && backend[0] && strcmp(backend, "epoll"))
+    llarp::LogWarn("unknown event loop backend ", backend);
+  llarp_ev_loop_alloc(ev);
+}
+
 void
 llarp_ev_loop_free(struct llarp_ev_loop **ev)
 {
@@ -52,6 +78,12 @@ llarp_ev_loop_run(struct llarp_ev_loop *ev, struct llarp_logic *logic)
   return 0;
 }
 
+int
+llarp_ev_loop_run_io(struct llarp_ev_loop *ev)
+{
+  return ev->run();
+}
+
 void
 llarp_ev_loop_run_single_process(struct llarp_ev_loop *ev,
                                  struct llarp_threadpool *tp,
@@ -76,6 +108,16 @@ llarp_ev_add_udp(struct llarp_ev_loop *ev, struct llarp_udp_io *udp,
   return -1;
 }
 
+int
+llarp_ev_add_udp_shared(struct llarp_ev_loop *ev, struct llarp_udp_io *udp,
+                        const struct sockaddr *src)
+{
+  udp->parent = ev;
+  if(ev->udp_listen_shared(udp, src))
+    return 0;
+  return -1;
+}
+
 int
 llarp_ev_close_udp(struct llarp_udp_io *udp)
 {
@@ -90,6 +132,14 @@ llarp_ev_loop_stop(struct llarp_ev_loop *loop)
   loop->stop();
 }
 
+void
+llarp_ev_loop_set_udp_batch(struct llarp_ev_loop *ev, size_t batch,
+                            size_t flush)
+{
+  ev->udp_batch = batch;
+  ev->udp_flush = flush;
+}
+
 int
 llarp_ev_udp_sendto(struct llarp_udp_io *udp, const sockaddr *to,
                     const void *buf, size_t sz)
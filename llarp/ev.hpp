@@ -50,6 +50,12 @@ struct llarp_ev_loop
 
   virtual bool
   udp_listen(llarp_udp_io* l, const sockaddr* src) = 0;
+  /// listen on an address shared with other sockets, if supported
+  virtual bool
+  udp_listen_shared(llarp_udp_io* l, const sockaddr* src)
+  {
+    return false;
+  }
   virtual bool
   udp_close(llarp_udp_io* l) = 0;
   virtual bool
@@ -58,6 +64,11 @@ struct llarp_ev_loop
   virtual ~llarp_ev_loop(){};
 
   std::list< llarp_udp_io* > udp_listeners;
+
+  /// datagrams per recvmmsg/sendmmsg, 0 for one syscall per datagram
+  size_t udp_batch = 0;
+  /// queued outbound datagrams that trigger a flush from the sender
+  size_t udp_flush = 0;
 };
 
 #endif
@@ -4,19 +4,133 @@
 #include <llarp/net.h>
 #include <signal.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 #include <cstdio>
+#include <llarp/threading.hpp>
+#include <memory>
+#include <vector>
 #include "ev.hpp"
 #include "llarp/net.hpp"
 #include "logger.hpp"
 
 namespace llarp
 {
+  static inline socklen_t
+  udp_addrlen(const sockaddr* addr)
+  {
+    switch(addr->sa_family)
+    {
+      case AF_INET:
+        return sizeof(struct sockaddr_in);
+      case AF_INET6:
+        return sizeof(struct sockaddr_in6);
+      default:
+        return 0;
+    }
+  }
+
+  /// a ring of pooled datagram buffers wired up for recvmmsg/sendmmsg
+  struct udp_batch
+  {
+    /// biggest datagram we put into a slot, matches the old stack readbuf
+    static constexpr size_t SlotSize = 2048;
+
+    udp_batch(size_t n)
+        : count(0)
+        , bufs(n * SlotSize)
+        , addrs(n)
+        , iovs(n)
+        , msgs(n)
+    {
+      for(size_t idx = 0; idx < n; ++idx)
+      {
+        iovs[idx].iov_base           = slot(idx);
+        iovs[idx].iov_len            = SlotSize;
+        msgs[idx].msg_hdr.msg_name   = &addrs[idx];
+        msgs[idx].msg_hdr.msg_iov    = &iovs[idx];
+        msgs[idx].msg_hdr.msg_iovlen = 1;
+      }
+    }
+
+    size_t
+    capacity() const
+    {
+      return msgs.size();
+    }
+
+    bool
+    full() const
+    {
+      return count == capacity();
+    }
+
+    byte_t*
+    slot(size_t idx)
+    {
+      return bufs.data() + (idx * SlotSize);
+    }
+
+    /// reset all slots to receive a full sized datagram
+    void
+    prepare_recv()
+    {
+      for(size_t idx = 0; idx < capacity(); ++idx)
+      {
+        iovs[idx].iov_len             = SlotSize;
+        msgs[idx].msg_hdr.msg_namelen = sizeof(sockaddr_in6);
+        msgs[idx].msg_len             = 0;
+      }
+    }
+
+    /// copy a datagram into the next free slot, returns false if full
+    bool
+    push(const sockaddr* to, socklen_t tolen, const void* data, size_t sz)
+    {
+      if(full())
+        return false;
+      memcpy(slot(count), data, sz);
+      memcpy(&addrs[count], to, tolen);
+      iovs[count].iov_len             = sz;
+      msgs[count].msg_hdr.msg_namelen = tolen;
+      msgs[count].msg_len             = 0;
+      ++count;
+      return true;
+    }
+
+    size_t count;
+    std::vector< byte_t > bufs;
+    std::vector< sockaddr_in6 > addrs;
+    std::vector< iovec > iovs;
+    std::vector< mmsghdr > msgs;
+  };
+
   struct udp_listener : public ev_io
   {
+    typedef std::mutex mtx_t;
+    typedef std::unique_lock< mtx_t > lock_t;
+
     llarp_udp_io* udp;
+    /// datagrams per syscall, 0 means no batching
+    size_t batch;
+    /// queued datagrams that trigger a flush from the sending thread
+    size_t flush;
+    /// eventfd used to wake the event loop when sends get queued
+    int wakefd;
 
-    udp_listener(int fd, llarp_udp_io* u) : ev_io(fd), udp(u){};
+    udp_listener(int fd, llarp_udp_io* u, size_t b = 0, size_t f = 0,
+                 int w = -1)
+        : ev_io(fd), udp(u), batch(b), flush(f), wakefd(w)
+    {
+      if(batch)
+      {
+        if(flush == 0 || flush > batch)
+          flush = batch;
+        inbound.reset(new udp_batch(batch));
+        pending.reset(new udp_batch(batch));
+        sending.reset(new udp_batch(batch));
+      }
+    };
 
     ~udp_listener()
     {
@@ -25,6 +139,8 @@ namespace llarp
     virtual int
     read(void* buf, size_t sz)
     {
+      if(batch)
+        return read_batch();
       sockaddr_in6 src;
       socklen_t slen = sizeof(sockaddr_in6);
       sockaddr* addr = (sockaddr*)&src;
@@ -35,21 +151,43 @@ namespace llarp
       return 0;
     }
 
-    virtual int
-    sendto(const sockaddr* to, const void* data, size_t sz)
+    /// drain the socket with recvmmsg into our buffer ring
+    int
+    read_batch()
     {
-      socklen_t slen;
-      switch(to->sa_family)
+      // bound how long one busy socket can hold the event loop
+      size_t rounds = 16;
+      while(rounds--)
       {
-        case AF_INET:
-          slen = sizeof(struct sockaddr_in);
-          break;
-        case AF_INET6:
-          slen = sizeof(struct sockaddr_in6);
-          break;
-        default:
+        inbound->prepare_recv();
+        int ret = ::recvmmsg(fd, inbound->msgs.data(), inbound->capacity(),
+                             MSG_DONTWAIT, nullptr);
+        if(ret == -1)
+        {
+          if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return 0;
           return -1;
+        }
+        for(int idx = 0; idx < ret; ++idx)
+        {
+          auto& hdr = inbound->msgs[idx];
+          udp->recvfrom(udp, (const sockaddr*)hdr.msg_hdr.msg_name,
+                        inbound->slot(idx), hdr.msg_len);
+        }
+        if(size_t(ret) < inbound->capacity())
+          break;
       }
+      return 0;
+    }
+
+    virtual int
+    sendto(const sockaddr* to, const void* data, size_t sz)
+    {
+      socklen_t slen = udp_addrlen(to);
+      if(slen == 0)
+        return -1;
+      if(batch && sz <= udp_batch::SlotSize)
+        return queue_send(to, slen, data, sz);
       ssize_t sent = ::sendto(fd, data, sz, SOCK_NONBLOCK, to, slen);
       if(sent == -1)
       {
@@ -57,6 +195,82 @@ namespace llarp
       }
       return sent;
     }
+
+    /// queue a datagram for the next sendmmsg, called from any thread
+    int
+    queue_send(const sockaddr* to, socklen_t slen, const void* data, size_t sz)
+    {
+      bool wakeup   = false;
+      bool flushnow = false;
+      {
+        lock_t lock(pendingMutex);
+        while(!pending->push(to, slen, data, sz))
+        {
+          // ring is full, we have to send it ourself
+          lock.unlock();
+          flush_sends();
+          lock.lock();
+        }
+        wakeup   = pending->count == 1;
+        flushnow = pending->count >= flush;
+      }
+      if(flushnow)
+        flush_sends();
+      else if(wakeup && wakefd != -1)
+      {
+        uint64_t one = 1;
+        auto val     = ::write(wakefd, &one, sizeof(one));
+        (void)val;
+      }
+      return sz;
+    }
+
+    /// send everything queued with as few sendmmsg calls as we can
+    void
+    flush_sends()
+    {
+      if(!batch)
+        return;
+      lock_t sendlock(sendingMutex);
+      {
+        lock_t lock(pendingMutex);
+        if(pending->count == 0)
+          return;
+        std::swap(pending, sending);
+      }
+      size_t idx = 0;
+      while(idx < sending->count)
+      {
+        int ret = ::sendmmsg(fd, sending->msgs.data() + idx,
+                             sending->count - idx, MSG_DONTWAIT);
+        if(ret == -1)
+        {
+          if(errno == EINTR)
+            continue;
+          if(errno == EAGAIN || errno == EWOULDBLOCK)
+          {
+            // socket buffer is full, the rest would fail the same way
+            llarp::LogWarn("sendmmsg: ", strerror(errno), ", dropped ",
+                           sending->count - idx, " datagrams");
+            break;
+          }
+          // drop the datagram that failed and carry on with the rest
+          llarp::LogWarn("sendmmsg: ", strerror(errno));
+          ret = 1;
+        }
+        idx += ret;
+      }
+      sending->count = 0;
+    }
+
+   private:
+    std::unique_ptr< udp_batch > inbound;
+    /// datagrams queued by senders
+    std::unique_ptr< udp_batch > pending;
+    /// datagrams being flushed right now
+    std::unique_ptr< udp_batch > sending;
+    mtx_t pendingMutex;
+    mtx_t sendingMutex;
   };
 };  // namespace llarp
 
@@ -64,7 +278,9 @@ struct llarp_epoll_loop : public llarp_ev_loop
 {
   int epollfd;
   int pipefds[2];
-  llarp_epoll_loop() : epollfd(-1)
+  /// wakes epoll_wait when batched sends are queued from another thread
+  int wakefd;
+  llarp_epoll_loop() : epollfd(-1), wakefd(-1)
   {
     pipefds[0] = -1;
     pipefds[1] = -1;
@@ -72,6 +288,9 @@ struct llarp_epoll_loop : public llarp_ev_loop
 
   ~llarp_epoll_loop()
   {
+    if(wakefd != -1)
+      close(wakefd);
+
     if(pipefds[0] != -1)
       close(pipefds[0]);
 
@@ -95,11 +314,42 @@ struct llarp_epoll_loop : public llarp_ev_loop
 
       sig_ev.data.fd = pipefds[0];
       sig_ev.events  = EPOLLIN;
-      return epoll_ctl(epollfd, EPOLL_CTL_ADD, pipefds[0], &sig_ev) != -1;
+      if(epoll_ctl(epollfd, EPOLL_CTL_ADD, pipefds[0], &sig_ev) == -1)
+        return false;
+
+      wakefd = eventfd(0, EFD_NONBLOCK);
+      if(wakefd == -1)
+        return false;
+      epoll_event wake_ev;
+      wake_ev.data.fd = wakefd;
+      wake_ev.events  = EPOLLIN;
+      return epoll_ctl(epollfd, EPOLL_CTL_ADD, wakefd, &wake_ev) != -1;
     }
     return false;
   }
 
+  /// drain the wakeup eventfd
+  void
+  clear_wakeup()
+  {
+    uint64_t val;
+    auto ret = ::read(wakefd, &val, sizeof(val));
+    (void)ret;
+  }
+
+  /// flush batched sends on all udp listeners, once per loop iteration
+  void
+  flush_udp()
+  {
+    for(auto& l : udp_listeners)
+    {
+      llarp::udp_listener* listener =
+          static_cast< llarp::udp_listener* >(l->impl);
+      if(listener)
+        listener->flush_sends();
+    }
+  }
+
   int
   tick(int ms)
   {
@@ -119,6 +369,12 @@ struct llarp_epoll_loop : public llarp_ev_loop
           llarp::LogDebug("exiting epoll loop");
           return 0;
         }
+        if(events[idx].data.fd == wakefd)
+        {
+          clear_wakeup();
+          ++idx;
+          continue;
+        }
         llarp::ev_io* ev = static_cast< llarp::ev_io* >(events[idx].data.ptr);
         if(events[idx].events & EPOLLIN)
         {
@@ -134,6 +390,7 @@ struct llarp_epoll_loop : public llarp_ev_loop
     for(auto& l : udp_listeners)
       if(l->tick)
         l->tick(l);
+    flush_udp();
     return result;
   }
 
@@ -157,6 +414,12 @@ struct llarp_epoll_loop : public llarp_ev_loop
             llarp::LogDebug("exiting epoll loop");
             return 0;
           }
+          if(events[idx].data.fd == wakefd)
+          {
+            clear_wakeup();
+            ++idx;
+            continue;
+          }
           llarp::ev_io* ev = static_cast< llarp::ev_io* >(events[idx].data.ptr);
           if(events[idx].events & EPOLLIN)
           {
@@ -172,25 +435,17 @@ struct llarp_epoll_loop : public llarp_ev_loop
       for(auto& l : udp_listeners)
         if(l->tick)
           l->tick(l);
+      flush_udp();
     } while(epollfd != -1);
     return result;
   }
 
   int
-  udp_bind(const sockaddr* addr)
+  udp_bind(const sockaddr* addr, bool reuseport = false)
   {
-    socklen_t slen;
-    switch(addr->sa_family)
-    {
-      case AF_INET:
-        slen = sizeof(struct sockaddr_in);
-        break;
-      case AF_INET6:
-        slen = sizeof(struct sockaddr_in6);
-        break;
-      default:
-        return -1;
-    }
+    socklen_t slen = llarp::udp_addrlen(addr);
+    if(slen == 0)
+      return -1;
     int fd = socket(addr->sa_family, SOCK_DGRAM, 0);
     if(fd == -1)
     {
@@ -210,6 +465,16 @@ struct llarp_epoll_loop : public llarp_ev_loop
         return -1;
       }
     }
+    if(reuseport)
+    {
+      int on = 1;
+      if(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == -1)
+      {
+        perror("setsockopt()");
+        close(fd);
+        return -1;
+      }
+    }
     llarp::Addr a(*addr);
     llarp::LogDebug("bind to ", a);
     if(bind(fd, addr, slen) == -1)
@@ -231,10 +496,22 @@ struct llarp_epoll_loop : public llarp_ev_loop
   bool
   udp_listen(llarp_udp_io* l, const sockaddr* src)
   {
-    int fd = udp_bind(src);
+    return udp_add(l, udp_bind(src));
+  }
+
+  bool
+  udp_listen_shared(llarp_udp_io* l, const sockaddr* src)
+  {
+    return udp_add(l, udp_bind(src, true));
+  }
+
+  bool
+  udp_add(llarp_udp_io* l, int fd)
+  {
     if(fd == -1)
       return false;
-    llarp::udp_listener* listener = new llarp::udp_listener(fd, l);
+    llarp::udp_listener* listener =
+        new llarp::udp_listener(fd, l, udp_batch, udp_flush, wakefd);
     epoll_event ev;
     ev.data.ptr = listener;
     ev.events   = EPOLLIN;
@@ -256,6 +533,7 @@ struct llarp_epoll_loop : public llarp_ev_loop
         static_cast< llarp::udp_listener* >(l->impl);
     if(listener)
     {
+      listener->flush_sends();
       close_ev(listener);
       l->impl = nullptr;
       delete listener;
@@ -0,0 +1,729 @@
+#ifndef EV_URING_HPP
+#define EV_URING_HPP
+#include <linux/io_uring.h>
+#include <llarp/buffer.h>
+#include <llarp/net.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <list>
+#include <llarp/threading.hpp>
+#include <vector>
+#include "ev_epoll.hpp"
+#include "llarp/net.hpp"
+#include "logger.hpp"
+
+struct llarp_uring_loop;
+
+namespace llarp
+{
+  struct uring_listener;
+
+  /// tags in the low bits of sqe user_data, our pointers are 8 byte aligned
+  enum uring_tag
+  {
+    eUringRecv   = 0,
+    eUringSend   = 1,
+    eUringWakeup = 2,
+    eUringCancel = 3
+  };
+
+  static constexpr uint64_t UringTagMask = 7;
+
+  /// one queued outbound datagram, pooled by the loop
+  struct uring_send
+  {
+    static constexpr size_t BufSize = 2048;
+    sockaddr_in6 addr;
+    iovec iov;
+    msghdr msg;
+    byte_t buf[BufSize];
+    /// who we send from
+    uring_listener* listener = nullptr;
+    uring_send* next         = nullptr;
+  };
+
+  struct uring_listener : public ev_io
+  {
+    llarp_udp_io* udp;
+    llarp_uring_loop* loop;
+    /// template for the multishot recvmsg, tells the kernel our name length
+    msghdr msg;
+    /// set once the multishot receive has been cancelled
+    bool closing = false;
+    /// set once the kernel posted the last completion for our receive
+    bool recvDone = false;
+
+    uring_listener(int fd, llarp_udp_io* u, llarp_uring_loop* l)
+        : ev_io(fd), udp(u), loop(l)
+    {
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_namelen = sizeof(sockaddr_in6);
+    }
+
+    virtual int
+    read(void* buf, size_t sz)
+    {
+      // receives are completed by the ring, never polled
+      return -1;
+    }
+
+    virtual int
+    sendto(const sockaddr* dst, const void* data, size_t sz);
+  };
+}  // namespace llarp
+
+/// linux io_uring event loop
+/// keeps one multishot recvmsg armed per socket against a ring of provided
+/// buffers, and queues sends so a loop iteration does one io_uring_enter
+struct llarp_uring_loop : public llarp_ev_loop
+{
+  typedef std::mutex mtx_t;
+  typedef std::unique_lock< mtx_t > lock_t;
+
+  static constexpr unsigned Entries = 512;
+  /// provided receive buffers, must be a power of 2
+  static constexpr unsigned NumBufs = 512;
+  static constexpr unsigned BufSize = 2048;
+  static constexpr uint16_t BufGroup = 0;
+
+  int ringfd = -1;
+  int wakefd = -1;
+  std::atomic< bool > _run;
+
+  // submission queue
+  void* sq_ptr      = MAP_FAILED;
+  size_t sq_sz      = 0;
+  unsigned* sq_head = nullptr;
+  unsigned* sq_tail = nullptr;
+  unsigned sq_mask  = 0;
+  unsigned sq_size  = 0;
+  unsigned* sq_array = nullptr;
+  io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+  size_t sqes_sz     = 0;
+  /// sqes filled in but not yet handed to the kernel
+  unsigned to_submit = 0;
+
+  // completion queue
+  void* cq_ptr      = MAP_FAILED;
+  size_t cq_sz      = 0;
+  unsigned* cq_head = nullptr;
+  unsigned* cq_tail = nullptr;
+  unsigned cq_mask  = 0;
+  io_uring_cqe* cqes = nullptr;
+
+  // provided buffer ring for receives
+  io_uring_buf_ring* bufring = (io_uring_buf_ring*)MAP_FAILED;
+  size_t bufring_sz          = 0;
+  std::vector< byte_t > bufs;
+
+  // send queue, filled from any thread
+  mtx_t sendMutex;
+  std::vector< llarp::uring_send* > pendingSends;
+  llarp::uring_send* freeSends = nullptr;
+  /// sends handed to the kernel and not completed yet
+  size_t inflightSends = 0;
+  /// every send we made, free, pending or in flight
+  std::vector< llarp::uring_send* > allSends;
+
+  uint64_t wakeval = 0;
+
+  llarp_uring_loop()
+  {
+    _run.store(true);
+  }
+
+  ~llarp_uring_loop()
+  {
+    if(bufring != MAP_FAILED)
+      munmap(bufring, bufring_sz);
+    if(sqes != MAP_FAILED)
+      munmap(sqes, sqes_sz);
+    if(cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+      munmap(cq_ptr, cq_sz);
+    if(sq_ptr != MAP_FAILED)
+      munmap(sq_ptr, sq_sz);
+    if(ringfd != -1)
+      close(ringfd);
+    if(wakefd != -1)
+      close(wakefd);
+    // the ring is gone so sends still in flight are ours to free too
+    lock_t lock(sendMutex);
+    for(auto send : allSends)
+      delete send;
+  }
+
+  static int
+  sys_setup(unsigned entries, io_uring_params* p)
+  {
+    return syscall(__NR_io_uring_setup, entries, p);
+  }
+
+  int
+  sys_enter(unsigned submit, unsigned wait, unsigned flags, void* arg,
+            size_t argsz)
+  {
+    return syscall(__NR_io_uring_enter, ringfd, submit, wait, flags, arg,
+                   argsz);
+  }
+
+  int
+  sys_register(unsigned op, void* arg, unsigned nargs)
+  {
+    return syscall(__NR_io_uring_register, ringfd, op, arg, nargs);
+  }
+
+  /// multishot recvmsg landed in the same kernel release (6.0) as
+  /// IORING_OP_SEND_ZC, which unlike the recv flag we can probe for
+  bool
+  has_multishot_recv()
+  {
+    const size_t nops = 256;
+    std::vector< byte_t > mem(sizeof(io_uring_probe)
+                              + (nops * sizeof(io_uring_probe_op)));
+    io_uring_probe* probe = (io_uring_probe*)mem.data();
+    if(sys_register(IORING_REGISTER_PROBE, probe, nops) == -1)
+      return false;
+    if(probe->last_op < IORING_OP_SEND_ZC)
+      return false;
+    return probe->ops[IORING_OP_RECVMSG].flags & IO_URING_OP_SUPPORTED
+        && probe->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED;
+  }
+
+  bool
+  init()
+  {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    // multishot receives can post many completions per submission
+    params.cq_entries = Entries * 4;
+    ringfd            = sys_setup(Entries, &params);
+    if(ringfd == -1)
+    {
+      llarp::LogWarn("io_uring_setup: ", strerror(errno));
+      return false;
+    }
+    if(!(params.features & IORING_FEAT_EXT_ARG)
+       || !(params.features & IORING_FEAT_NODROP) || !has_multishot_recv())
+    {
+      llarp::LogWarn("kernel io_uring is too old");
+      return false;
+    }
+
+    sq_sz = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+    cq_sz = params.cq_off.cqes + (params.cq_entries * sizeof(io_uring_cqe));
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+      sq_sz = std::max(sq_sz, cq_sz);
+      cq_sz = sq_sz;
+    }
+    sq_ptr = mmap(nullptr, sq_sz, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+    if(sq_ptr == MAP_FAILED)
+      return false;
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+      cq_ptr = sq_ptr;
+    else
+    {
+      cq_ptr = mmap(nullptr, cq_sz, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_CQ_RING);
+      if(cq_ptr == MAP_FAILED)
+        return false;
+    }
+    sqes_sz = params.sq_entries * sizeof(io_uring_sqe);
+    sqes    = (io_uring_sqe*)mmap(nullptr, sqes_sz, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, ringfd,
+                               IORING_OFF_SQES);
+    if(sqes == MAP_FAILED)
+      return false;
+
+    byte_t* sq = (byte_t*)sq_ptr;
+    sq_head    = (unsigned*)(sq + params.sq_off.head);
+    sq_tail    = (unsigned*)(sq + params.sq_off.tail);
+    sq_mask    = *(unsigned*)(sq + params.sq_off.ring_mask);
+    sq_size    = params.sq_entries;
+    sq_array   = (unsigned*)(sq + params.sq_off.array);
+
+    byte_t* cq = (byte_t*)cq_ptr;
+    cq_head    = (unsigned*)(cq + params.cq_off.head);
+    cq_tail    = (unsigned*)(cq + params.cq_off.tail);
+    cq_mask    = *(unsigned*)(cq + params.cq_off.ring_mask);
+    cqes       = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    if(!init_bufring())
+      return false;
+
+    wakefd = eventfd(0, EFD_NONBLOCK);
+    if(wakefd == -1)
+      return false;
+    arm_wakeup();
+    return true;
+  }
+
+  /// register our receive buffers with the kernel
+  bool
+  init_bufring()
+  {
+    bufring_sz = NumBufs * sizeof(io_uring_buf);
+    bufring    = (io_uring_buf_ring*)mmap(nullptr, bufring_sz,
+                                       PROT_READ | PROT_WRITE,
+                                       MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if(bufring == MAP_FAILED)
+      return false;
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr    = (uint64_t)bufring;
+    reg.ring_entries = NumBufs;
+    reg.bgid         = BufGroup;
+    if(sys_register(IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+    {
+      llarp::LogWarn("io_uring buffer ring: ", strerror(errno));
+      return false;
+    }
+    bufs.resize(NumBufs * BufSize);
+    bufring->tail = 0;
+    for(uint16_t bid = 0; bid < NumBufs; ++bid)
+      put_buffer(bid);
+    return true;
+  }
+
+  byte_t*
+  buffer(uint16_t bid)
+  {
+    return bufs.data() + (size_t(bid) * BufSize);
+  }
+
+  /// hand a receive buffer back to the kernel
+  void
+  put_buffer(uint16_t bid)
+  {
+    unsigned short tail = bufring->tail;
+    // index by hand, the kernel's flex array lands at the wrong offset in
+    // c++ where empty structs aren't zero sized
+    io_uring_buf* buf = (io_uring_buf*)bufring + (tail & (NumBufs - 1));
+    buf->addr           = (uint64_t)buffer(bid);
+    buf->len            = BufSize;
+    buf->bid            = bid;
+    __atomic_store_n(&bufring->tail, tail + 1, __ATOMIC_RELEASE);
+  }
+
+  /// give the kernel all queued sqes, optionally waiting for completions
+  int
+  submit(unsigned wait = 0, int ms = 0)
+  {
+    unsigned flags = 0;
+    io_uring_getevents_arg arg;
+    __kernel_timespec ts;
+    void* argp   = nullptr;
+    size_t argsz = 0;
+    if(wait)
+    {
+      flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+      memset(&arg, 0, sizeof(arg));
+      ts.tv_sec  = ms / 1000;
+      ts.tv_nsec = (ms % 1000) * 1000000L;
+      arg.ts     = (uint64_t)&ts;
+      argp       = &arg;
+      argsz      = sizeof(arg);
+    }
+    int ret = sys_enter(to_submit, wait, flags, argp, argsz);
+    if(ret >= 0)
+      to_submit -= std::min(unsigned(ret), to_submit);
+    else if(errno == ETIME || errno == EINTR || errno == EBUSY)
+      ret = 0;
+    return ret;
+  }
+
+  /// get a free sqe, submitting queued ones if the ring is full
+  io_uring_sqe*
+  get_sqe()
+  {
+    unsigned tail = *sq_tail;
+    if(tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_size)
+    {
+      submit();
+      if(tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_size)
+        return nullptr;
+    }
+    unsigned idx      = tail & sq_mask;
+    io_uring_sqe* sqe = &sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array[idx] = idx;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++to_submit;
+    return sqe;
+  }
+
+  void
+  arm_wakeup()
+  {
+    io_uring_sqe* sqe = get_sqe();
+    if(sqe == nullptr)
+      return;
+    sqe->opcode    = IORING_OP_READ;
+    sqe->fd        = wakefd;
+    sqe->addr      = (uint64_t)&wakeval;
+    sqe->len       = sizeof(wakeval);
+    sqe->user_data = llarp::eUringWakeup;
+  }
+
+  void
+  arm_recv(llarp::uring_listener* l)
+  {
+    io_uring_sqe* sqe = get_sqe();
+    if(sqe == nullptr)
+    {
+      llarp::LogError("io_uring submission queue full, can't arm recv");
+      return;
+    }
+    sqe->opcode    = IORING_OP_RECVMSG;
+    sqe->fd        = l->fd;
+    sqe->addr      = (uint64_t)&l->msg;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BufGroup;
+    sqe->user_data = (uint64_t)l | llarp::eUringRecv;
+  }
+
+  /// queue a datagram, called from any thread
+  int
+  queue_send(llarp::uring_listener* l, const sockaddr* to, socklen_t slen,
+             const void* data, size_t sz)
+  {
+    bool wakeup = false;
+    {
+      lock_t lock(sendMutex);
+      llarp::uring_send* send = freeSends;
+      if(send)
+        freeSends = send->next;
+      else
+      {
+        send = new llarp::uring_send;
+        allSends.push_back(send);
+      }
+      memcpy(&send->addr, to, slen);
+      memcpy(send->buf, data, sz);
+      send->iov.iov_base = send->buf;
+      send->iov.iov_len  = sz;
+      memset(&send->msg, 0, sizeof(send->msg));
+      send->msg.msg_name    = &send->addr;
+      send->msg.msg_namelen = slen;
+      send->msg.msg_iov     = &send->iov;
+      send->msg.msg_iovlen  = 1;
+      send->listener        = l;
+      pendingSends.push_back(send);
+      wakeup = pendingSends.size() == 1;
+    }
+    if(wakeup)
+    {
+      uint64_t one = 1;
+      auto val     = ::write(wakefd, &one, sizeof(one));
+      (void)val;
+    }
+    return sz;
+  }
+
+  /// turn queued sends into sqes
+  void
+  prepare_sends()
+  {
+    std::vector< llarp::uring_send* > sends;
+    {
+      lock_t lock(sendMutex);
+      if(pendingSends.empty())
+        return;
+      sends.swap(pendingSends);
+    }
+    for(auto send : sends)
+    {
+      io_uring_sqe* sqe = get_sqe();
+      if(sqe == nullptr)
+      {
+        llarp::LogWarn("io_uring submission queue full, dropping datagram");
+        release_send(send);
+        continue;
+      }
+      sqe->opcode    = IORING_OP_SENDMSG;
+      sqe->fd        = send->listener->fd;
+      sqe->addr      = (uint64_t)&send->msg;
+      sqe->user_data = (uint64_t)send | llarp::eUringSend;
+      ++inflightSends;
+    }
+  }
+
+  /// drop sends from l that haven't been made into sqes yet, the ones in
+  /// flight already hold a reference to its socket
+  void
+  purge_sends(llarp::uring_listener* l)
+  {
+    lock_t lock(sendMutex);
+    auto itr = pendingSends.begin();
+    while(itr != pendingSends.end())
+    {
+      llarp::uring_send* send = *itr;
+      if(send->listener != l)
+      {
+        ++itr;
+        continue;
+      }
+      send->next = freeSends;
+      freeSends  = send;
+      itr        = pendingSends.erase(itr);
+    }
+  }
+
+  void
+  release_send(llarp::uring_send* send)
+  {
+    lock_t lock(sendMutex);
+    send->next = freeSends;
+    freeSends  = send;
+  }
+
+  void
+  handle_recv(llarp::uring_listener* l, const io_uring_cqe* cqe)
+  {
+    bool more = cqe->flags & IORING_CQE_F_MORE;
+    if(cqe->res >= 0 && (cqe->flags & IORING_CQE_F_BUFFER))
+    {
+      uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+      byte_t* ptr  = buffer(bid);
+      auto out     = (const io_uring_recvmsg_out*)ptr;
+      if(size_t(cqe->res) >= sizeof(*out) + l->msg.msg_namelen
+         && !l->closing)
+      {
+        const sockaddr* from = (const sockaddr*)(ptr + sizeof(*out));
+        const byte_t* data =
+            ptr + sizeof(*out) + l->msg.msg_namelen + l->msg.msg_controllen;
+        size_t sz = std::min(size_t(out->payloadlen),
+                             size_t(cqe->res) - (data - ptr));
+        l->udp->recvfrom(l->udp, from, data, sz);
+      }
+      put_buffer(bid);
+    }
+    else if(cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED)
+      llarp::LogWarn("io_uring recvmsg: ", strerror(-cqe->res));
+
+    if(!more)
+    {
+      // the kernel dropped our multishot receive, rearm unless we're done
+      if(l->closing)
+        l->recvDone = true;
+      else
+        arm_recv(l);
+    }
+  }
+
+  /// dispatch all completions, returns how many there were
+  int
+  reap()
+  {
+    int count     = 0;
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    while(head != tail)
+    {
+      const io_uring_cqe* cqe = &cqes[head & cq_mask];
+      uint64_t tag            = cqe->user_data & llarp::UringTagMask;
+      void* ptr               = (void*)(cqe->user_data & ~llarp::UringTagMask);
+      switch(tag)
+      {
+        case llarp::eUringRecv:
+          handle_recv(static_cast< llarp::uring_listener* >(ptr), cqe);
+          break;
+        case llarp::eUringSend:
+          if(cqe->res < 0)
+            llarp::LogWarn("io_uring sendmsg: ", strerror(-cqe->res));
+          --inflightSends;
+          release_send(static_cast< llarp::uring_send* >(ptr));
+          break;
+        case llarp::eUringWakeup:
+          if(_run)
+            arm_wakeup();
+          break;
+        default:
+          break;
+      }
+      ++head;
+      ++count;
+      // let the kernel reuse the slot as soon as we can
+      __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+      tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    }
+    return count;
+  }
+
+  int
+  tick(int ms)
+  {
+    if(!_run)
+      return -1;
+    prepare_sends();
+    if(submit(1, ms) == -1)
+    {
+      llarp::LogError("io_uring_enter: ", strerror(errno));
+      return -1;
+    }
+    int result = reap();
+    for(auto& l : udp_listeners)
+      if(l->tick)
+        l->tick(l);
+    // sends queued by tick callbacks go out with the next io_uring_enter
+    prepare_sends();
+    return _run ? result : -1;
+  }
+
+  int
+  run()
+  {
+    int result = 0;
+    while(_run)
+      result = tick(10);
+    return result;
+  }
+
+  int
+  udp_bind(const sockaddr* addr, bool reuseport)
+  {
+    socklen_t slen = llarp::udp_addrlen(addr);
+    if(slen == 0)
+      return -1;
+    int fd = socket(addr->sa_family, SOCK_DGRAM, 0);
+    if(fd == -1)
+    {
+      perror("socket()");
+      return -1;
+    }
+    if(addr->sa_family == AF_INET6)
+    {
+      // enable dual stack explicitly
+      int dual = 1;
+      if(setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &dual, sizeof(dual)) == -1)
+      {
+        perror("setsockopt()");
+        close(fd);
+        return -1;
+      }
+    }
+    if(reuseport)
+    {
+      int on = 1;
+      if(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == -1)
+      {
+        perror("setsockopt()");
+        close(fd);
+        return -1;
+      }
+    }
+    llarp::Addr a(*addr);
+    llarp::LogDebug("bind to ", a);
+    if(bind(fd, addr, slen) == -1)
+    {
+      perror("bind()");
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  bool
+  udp_add(llarp_udp_io* l, int fd)
+  {
+    if(fd == -1)
+      return false;
+    auto listener = new llarp::uring_listener(fd, l, this);
+    l->impl       = listener;
+    udp_listeners.push_back(l);
+    arm_recv(listener);
+    submit();
+    return true;
+  }
+
+  bool
+  udp_listen(llarp_udp_io* l, const sockaddr* src)
+  {
+    return udp_add(l, udp_bind(src, false));
+  }
+
+  bool
+  udp_listen_shared(llarp_udp_io* l, const sockaddr* src)
+  {
+    return udp_add(l, udp_bind(src, true));
+  }
+
+  /// cancel the armed receive and wait for its final completion
+  bool
+  close_ev(llarp::ev_io* ev)
+  {
+    auto l = static_cast< llarp::uring_listener* >(ev);
+    if(l->closing)
+      return true;
+    l->closing        = true;
+    io_uring_sqe* sqe = get_sqe();
+    if(sqe == nullptr)
+      return false;
+    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+    sqe->addr      = (uint64_t)l | llarp::eUringRecv;
+    sqe->user_data = llarp::eUringCancel;
+    // bounded wait, the cancel completes right away in practice
+    size_t tries = 100;
+    while(!l->recvDone && tries--)
+    {
+      if(submit(1, 10) == -1)
+        return false;
+      reap();
+    }
+    return l->recvDone;
+  }
+
+  bool
+  udp_close(llarp_udp_io* l)
+  {
+    auto listener = static_cast< llarp::uring_listener* >(l->impl);
+    if(listener == nullptr)
+      return false;
+    purge_sends(listener);
+    bool ret = close_ev(listener);
+    l->impl  = nullptr;
+    udp_listeners.remove(l);
+    if(ret)
+      delete listener;
+    else
+      llarp::LogWarn("io_uring receive never cancelled, leaking listener");
+    return ret;
+  }
+
+  void
+  stop()
+  {
+    _run.store(false);
+    uint64_t one = 1;
+    auto val     = ::write(wakefd, &one, sizeof(one));
+    (void)val;
+  }
+};
+
+namespace llarp
+{
+  inline int
+  uring_listener::sendto(const sockaddr* to, const void* data, size_t sz)
+  {
+    socklen_t slen = udp_addrlen(to);
+    if(slen == 0)
+      return -1;
+    if(sz > uring_send::BufSize)
+    {
+      ssize_t sent = ::sendto(fd, data, sz, MSG_DONTWAIT, to, slen);
+      if(sent == -1)
+        llarp::LogWarn(strerror(errno));
+      return sent;
+    }
+    return loop->queue_send(this, to, slen, data, sz);
+  }
+}  // namespace llarp
+
+#endif
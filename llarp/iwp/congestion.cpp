@@ -0,0 +1,146 @@
+#include "llarp/iwp/congestion.hpp"
+
+#include <algorithm>
+
+constexpr llarp_time_t congestion_control::InitialRTO;
+constexpr llarp_time_t congestion_control::MinRTO;
+constexpr llarp_time_t congestion_control::MaxRTO;
+constexpr llarp_time_t congestion_control::MinRTTWindow;
+constexpr size_t congestion_control::MinWindow;
+constexpr size_t congestion_control::InitialWindow;
+constexpr size_t congestion_control::MaxWindow;
+
+/// window gain while probing for more bandwidth on startup, 2/ln(2)
+static constexpr double StartupGain = 2.89;
+/// steady state window is this many bdp
+static constexpr double WindowGain = 2.0;
+/// bandwidth probing cycle, one phase per round
+static constexpr double ProbeGains[] = {1.25, 0.75, 1, 1, 1, 1, 1, 1};
+static constexpr size_t ProbePhases =
+    sizeof(ProbeGains) / sizeof(ProbeGains[0]);
+
+void
+congestion_control::on_rtt_sample(llarp_time_t rtt, llarp_time_t now)
+{
+  if(rtt == 0)
+    rtt = 1;
+  if(srtt == 0)
+  {
+    srtt   = rtt;
+    rttvar = rtt / 2;
+  }
+  else
+  {
+    llarp_time_t delta = srtt > rtt ? srtt - rtt : rtt - srtt;
+    rttvar             = ((3 * rttvar) + delta) / 4;
+    srtt               = ((7 * srtt) + rtt) / 8;
+  }
+  baseRTO = std::max(MinRTO, std::min(MaxRTO, srtt + (4 * rttvar)));
+  rto     = baseRTO;
+
+  if(minRTT == 0 || rtt <= minRTT || now - minRTTStamp > MinRTTWindow)
+  {
+    minRTT      = rtt;
+    minRTTStamp = now;
+  }
+}
+
+void
+congestion_control::on_delivered(size_t bytes, llarp_time_t sentAt,
+                                 uint64_t deliveredAtSend, llarp_time_t now)
+{
+  inflight -= std::min(inflight, bytes);
+  delivered += bytes;
+  // progress, undo any backoff
+  rto = baseRTO;
+
+  if(deliveredAtSend >= roundDelivered)
+  {
+    roundDelivered = delivered;
+    ++rounds;
+    if(mode == eStartup)
+    {
+      // bandwidth has to grow 25% a round to stay in startup
+      if(btlBw >= fullBw + (fullBw / 4))
+      {
+        fullBw       = btlBw;
+        fullBwRounds = 0;
+      }
+      else if(++fullBwRounds >= 3)
+        mode = eDrain;
+    }
+    else if(mode == eProbeBW)
+      cycleIndex = (cycleIndex + 1) % ProbePhases;
+  }
+
+  // delivery rate over the lifetime of this message
+  llarp_time_t elapsed = std::max(llarp_time_t(1), now - sentAt);
+  uint64_t rate        = ((delivered - deliveredAtSend) * 1000) / elapsed;
+  bwSamples.emplace_back(now, rate);
+  // keep about 10 round trips worth of samples
+  llarp_time_t window = std::max(llarp_time_t(1000), 10 * srtt);
+  while(bwSamples.size() > 1 && now - bwSamples.front().first > window)
+    bwSamples.pop_front();
+  btlBw = 0;
+  for(const auto &sample : bwSamples)
+    btlBw = std::max(btlBw, sample.second);
+
+  if(mode == eDrain && inflight <= bdp())
+    mode = eProbeBW;
+  update_window();
+}
+
+void
+congestion_control::on_timeout()
+{
+  ++timeouts;
+  rto  = std::min(MaxRTO, rto * 2);
+  cwnd = std::max(MinWindow, cwnd / 2);
+}
+
+size_t
+congestion_control::bdp() const
+{
+  return (btlBw * (minRTT ? minRTT : InitialRTO)) / 1000;
+}
+
+void
+congestion_control::update_window()
+{
+  if(btlBw == 0 || minRTT == 0)
+    return;
+  double gain;
+  switch(mode)
+  {
+    case eStartup:
+      gain = StartupGain;
+      break;
+    case eDrain:
+      gain = 1;
+      break;
+    default:
+      gain = WindowGain * ProbeGains[cycleIndex];
+      break;
+  }
+  size_t target = bdp() * gain;
+  if(mode == eStartup)
+    target = std::max(target, InitialWindow);
+  cwnd = std::max(MinWindow, std::min(MaxWindow, target));
+}
+
+void
+congestion_control::fill_stats(iwp_session_stats &st) const
+{
+  static const char *modes[] = {"startup", "drain", "probebw"};
+  st.srtt        = srtt;
+  st.rttvar      = rttvar;
+  st.rto         = rto;
+  st.minrtt      = minRTT;
+  st.btlbw       = btlBw;
+  st.cwnd        = cwnd;
+  st.inflight    = inflight;
+  st.delivered   = delivered;
+  st.retransmits = retransmits;
+  st.timeouts    = timeouts;
+  st.mode        = modes[mode];
+}
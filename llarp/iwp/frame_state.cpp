@@ -72,6 +72,7 @@ frame_state::clear()
     delete item.second;
   rx.clear();
   tx.clear();
+  txPending.clear();
 }
 
 bool
@@ -106,14 +107,20 @@ frame_state::got_xmit(frame_header hdr, size_t sz)
     auto itr = rx.find(h);
     if(itr == rx.end())
     {
-      auto msg  = new transit_message(x);
+      auto msg = new transit_message(x);
+      // inserted, put last fragment
+      msg->put_lastfrag(hdr.data() + sizeof(x.buffer), x.lastfrag());
+      if(!msg->allocated)
+      {
+        llarp::LogWarn("buffer pool full, dropping XMIT");
+        delete msg;
+        return false;
+      }
       rx[h]     = msg;
       rxIDs[id] = h;
       llarp::LogDebug("got message XMIT with ", (int)x.numfrags(),
                       " fragment"
                       "s");
-      // inserted, put last fragment
-      msg->put_lastfrag(hdr.data() + sizeof(x.buffer), x.lastfrag());
       push_ackfor(id, 0);
       if(x.numfrags() == 0)
       {
@@ -193,7 +200,9 @@ void
 frame_state::push_ackfor(uint64_t id, uint32_t bitmask)
 {
   llarp::LogDebug("ACK for msgid=", id, " mask=", bitmask);
-  auto pkt      = new sendbuf_t(12 + 6);
+  auto pkt = sendbuf_t::alloc(12 + 6);
+  if(pkt == nullptr)
+    return;
   auto body_ptr = init_sendbuf(pkt, eACKS, 12, txflags);
   htobe64buf(body_ptr, id);
   htobe32buf(body_ptr + 8, bitmask);
@@ -244,7 +253,7 @@ frame_state::inbound_frame_complete(uint64_t id)
     }
     else
     {
-      recvqueue.Put(new InboundMessage(id, msg));
+      recvqueue.Put(new InboundMessage(id, std::move(msg)));
       success = true;
     }
   }
@@ -288,27 +297,34 @@ frame_state::got_acks(frame_header hdr, size_t sz)
   auto now = llarp_time_now_ms();
 
   transit_message *msg = itr->second;
+  if(msg->sentAt == 0)
+  {
+    llarp::LogDebug("ACK for unsent TX frame msgid=", msgid);
+    return true;
+  }
 
-  if(bitmask == ~(0U))
+  // karn's algorithm, only time the xmit if it went out once
+  if(msg->lastAck == 0 && !msg->retransmitted && now >= msg->sentAt)
+    cc.on_rtt_sample(now - msg->sentAt, now);
+
+  if(bitmask != ~(0U))
+    msg->ack(bitmask);
+
+  // all ones means the remote already has it
+  if(bitmask == ~(0U) || msg->completed())
   {
+    llarp::LogDebug("message transmitted msgid=", msgid);
+    cc.on_delivered(msg->wire_size(), msg->sentAt, msg->deliveredAtSend, now);
     tx.erase(msgid);
     delete msg;
+    flush_tx(now);
   }
-  else
+  else if(msg->should_resend_frags(now, cc.rto))
   {
-    msg->ack(bitmask);
-
-    if(msg->completed())
-    {
-      llarp::LogDebug("message transmitted msgid=", msgid);
-      tx.erase(msgid);
-      delete msg;
-    }
-    else if(msg->should_resend_frags(now))
-    {
-      llarp::LogDebug("message ", msgid, " retransmit fragments");
-      msg->retransmit_frags(sendqueue, txflags);
-    }
+    llarp::LogDebug("message ", msgid, " retransmit fragments");
+    msg->retransmit_frags(sendqueue, txflags);
+    msg->retransmitted = true;
+    cc.on_retransmit();
   }
   return true;
 }
@@ -377,21 +393,69 @@ void
 frame_state::queue_tx(uint64_t id, transit_message *msg)
 {
   tx.insert(std::make_pair(id, msg));
-  msg->generate_xmit(sendqueue, txflags);
-  // msg->retransmit_frags(sendqueue, txflags);
+  txPending.push_back(id);
+  flush_tx(llarp_time_now_ms());
+}
+
+void
+frame_state::flush_tx(llarp_time_t now)
+{
+  while(txPending.size())
+  {
+    auto itr = tx.find(txPending.front());
+    if(itr == tx.end())
+    {
+      txPending.pop_front();
+      continue;
+    }
+    transit_message *msg = itr->second;
+    auto sz              = msg->wire_size();
+    if(!cc.can_send(sz))
+      break;
+    msg->sentAt          = now;
+    msg->deliveredAtSend = cc.delivered;
+    msg->generate_xmit(sendqueue, txflags);
+    msg->retransmit_frags(sendqueue, txflags);
+    cc.on_send(sz);
+    txPending.pop_front();
+  }
 }
 
 void
 frame_state::retransmit(llarp_time_t now)
 {
+  bool timedout = false;
   for(auto &item : tx)
   {
-    if(item.second->should_resend_xmit(now))
+    transit_message *msg = item.second;
+    if(msg->sentAt == 0)
+      continue;
+    if(msg->should_resend_xmit(now, cc.rto))
     {
-      item.second->generate_xmit(sendqueue, txflags);
+      // nothing heard back at all, resend everything
+      msg->generate_xmit(sendqueue, txflags);
+      msg->retransmit_frags(sendqueue, txflags);
+      msg->retransmitted = true;
+      timedout           = true;
+    }
+    else if(msg->should_resend_frags(now, cc.rto))
+    {
+      msg->retransmit_frags(sendqueue, txflags);
+      msg->retransmitted = true;
+      cc.on_retransmit();
     }
-    item.second->retransmit_frags(sendqueue, txflags);
   }
+  // back off once per tick, not once per message
+  if(timedout)
+    cc.on_timeout();
+  flush_tx(now);
+}
+
+void
+frame_state::get_stats(iwp_session_stats &st) const
+{
+  cc.fill_stats(st);
+  st.pending = txPending.size();
 }
 
 void
@@ -1,4 +1,5 @@
 #include <llarp/iwp/server.hpp>
+#include "ev.hpp"
 #include "str.hpp"
 
 llarp_link::llarp_link(const llarp_iwp_args& args)
@@ -72,16 +73,17 @@ llarp_link::TickSessions()
         ++itr;
     }
   }
+  for(auto& shard : m_shards)
   {
-    lock_t lock(m_sessions_Mutex);
-    auto itr = m_sessions.begin();
-    while(itr != m_sessions.end())
+    lock_t lock(shard->mutex);
+    auto itr = shard->sessions.begin();
+    while(itr != shard->sessions.end())
     {
       if(itr->second->Tick(now))
       {
         itr->second->done();
         delete itr->second;
-        itr = m_sessions.erase(itr);
+        itr = shard->sessions.erase(itr);
       }
       else
         ++itr;
@@ -92,20 +94,16 @@ llarp_link::TickSessions()
 bool
 llarp_link::sendto(const byte_t* pubkey, llarp_buffer_t buf)
 {
-  llarp_link_session* link = nullptr;
+  llarp::Addr remote;
   {
     lock_t lock(m_Connected_Mutex);
     auto itr = m_Connected.find(pubkey);
-    if(itr != m_Connected.end())
-    {
-      lock_t innerlock(m_sessions_Mutex);
-      auto inner_itr = m_sessions.find(itr->second);
-      if(inner_itr != m_sessions.end())
-      {
-        link = inner_itr->second;
-      }
-    }
+    if(itr == m_Connected.end())
+      return false;
+    remote = itr->second;
   }
+  // don't hold both locks at once, RemoveSession takes them in reverse
+  llarp_link_session* link = find_session(remote);
   return link && link->sendto(buf);
 }
 
@@ -137,16 +135,26 @@ llarp_link::create_session(const llarp::Addr& src)
 bool
 llarp_link::has_session_via(const llarp::Addr& dst)
 {
-  lock_t lock(m_sessions_Mutex);
-  return m_sessions.find(dst) != m_sessions.end();
+  auto& shard = shard_for(dst);
+  lock_t lock(shard.mutex);
+  return shard.sessions.find(dst) != shard.sessions.end();
+}
+
+llarp_link::Shard&
+llarp_link::shard_for(const llarp::Addr& addr)
+{
+  // the same pick the kernel makes for datagrams from addr, so a net
+  // thread only locks the shard it owns
+  return *m_shards[llarp::ReusePortIndex(addr, m_shards.size())];
 }
 
 llarp_link_session*
 llarp_link::find_session(const llarp::Addr& addr)
 {
-  lock_t lock(m_sessions_Mutex);
-  auto itr = m_sessions.find(addr);
-  if(itr == m_sessions.end())
+  auto& shard = shard_for(addr);
+  lock_t lock(shard.mutex);
+  auto itr = shard.sessions.find(addr);
+  if(itr == shard.sessions.end())
     return nullptr;
   else
     return itr->second;
@@ -155,20 +163,24 @@ llarp_link::find_session(const llarp::Addr& addr)
 void
 llarp_link::put_session(const llarp::Addr& src, llarp_link_session* impl)
 {
-  lock_t lock(m_sessions_Mutex);
+  auto& shard = shard_for(src);
+  lock_t lock(shard.mutex);
   impl->our_router = &router->rc;
-  m_sessions.insert(std::make_pair(src, impl));
+  shard.sessions.insert(std::make_pair(src, impl));
 }
 
 void
 llarp_link::clear_sessions()
 {
-  lock_t lock(m_sessions_Mutex);
-  auto itr = m_sessions.begin();
-  while(itr != m_sessions.end())
+  for(auto& shard : m_shards)
   {
-    delete itr->second;
-    itr = m_sessions.erase(itr);
+    lock_t lock(shard->mutex);
+    auto itr = shard->sessions.begin();
+    while(itr != shard->sessions.end())
+    {
+      delete itr->second;
+      itr = shard->sessions.erase(itr);
+    }
   }
 }
 
@@ -177,10 +189,11 @@ llarp_link::iterate_sessions(std::function< bool(llarp_link_session*) > visitor)
 {
   auto now = llarp_time_now_ms();
   std::list< llarp_link_session* > slist;
+  for(auto& shard : m_shards)
   {
-    lock_t lock(m_sessions_Mutex);
-    auto itr = m_sessions.begin();
-    while(itr != m_sessions.end())
+    lock_t lock(shard->mutex);
+    auto itr = shard->sessions.begin();
+    while(itr != shard->sessions.end())
     {
       // if not timing out soon add to list to iterate on
       if(!itr->second->timedout(now, 11500))
@@ -193,6 +206,14 @@ llarp_link::iterate_sessions(std::function< bool(llarp_link_session*) > visitor)
       return;
 }
 
+void
+llarp_link::handle_logic_pump(void* user)
+{
+  llarp_link* self = static_cast< llarp_link* >(user);
+  self->PumpLogic();
+  self->pumpingLogic.store(false);
+}
+
 void
 llarp_link::PumpLogic()
 {
@@ -206,15 +227,72 @@ llarp_link::PumpLogic()
 void
 llarp_link::RemoveSession(llarp_link_session* s)
 {
-  lock_t lock(m_sessions_Mutex);
-  auto itr = m_sessions.find(s->addr);
-  if(itr != m_sessions.end())
+  auto& shard = shard_for(s->addr);
   {
-    UnmapAddr(s->addr);
-    s->done();
-    m_sessions.erase(itr);
-    delete s;
+    lock_t lock(shard.mutex);
+    auto itr = shard.sessions.find(s->addr);
+    if(itr == shard.sessions.end())
+      return;
+    shard.sessions.erase(itr);
   }
+  UnmapAddr(s->addr);
+  s->done();
+  delete s;
+}
+
+void
+llarp_link::put_outbound_frame(llarp_link_session* s, iwp_async_frame* frame)
+{
+  shard_for(s->addr).outboundFrames.Put(frame);
+}
+
+void
+llarp_link::pump_crypto_outbound(llarp_link_session* s)
+{
+  auto& shard = shard_for(s->addr);
+  if(shard.outboundFrames.Size() == 0 || shard.encrypting.exchange(true))
+    return;
+  llarp_threadpool_queue_job(worker, {&shard, &handle_crypto_outbound});
+}
+
+void
+llarp_link::purge_outbound_frames(llarp_link_session* s)
+{
+  auto& shard = shard_for(s->addr);
+  lock_t lock(shard.encryptMutex);
+  shard.outboundFrames.RemoveIf(
+      [s](iwp_async_frame* frame) -> bool { return frame->user == s; });
+}
+
+void
+llarp_link::handle_crypto_outbound(void* user)
+{
+  Shard* shard = static_cast< Shard* >(user);
+  do
+  {
+    while(true)
+    {
+      // take a few at a time so sessions that queue while we send still
+      // get their turn soon
+      std::queue< iwp_async_frame* > q;
+      lock_t lock(shard->encryptMutex);
+      if(shard->outboundFrames.Process(q, 64) == 0)
+        break;
+      while(q.size())
+      {
+        auto frame = q.front();
+        q.pop();
+        llarp_link_session* s = static_cast< llarp_link_session* >(frame->user);
+        if(iwp_encrypt_frame(frame)
+           && llarp_ev_udp_sendto(&shard->udp, s->addr, frame->buf, frame->sz)
+               == -1)
+          llarp::LogWarn("sendto failed");
+        llarp::FreeIWPFrame(frame);
+      }
+    }
+    shard->encrypting.store(false);
+    // something may have been queued after we saw the queue empty
+  } while(shard->outboundFrames.Size() && !shard->encrypting.exchange(true));
 }
 
 uint8_t*
@@ -267,22 +345,73 @@ llarp_link::handle_cleanup_timer(void* l, uint64_t orig, uint64_t left)
   link->issue_cleanup_timer(orig);
 }
 
+/// a handshake datagram copied off a shard thread
+struct iwp_handshake_packet
+{
+  llarp_link* link;
+  llarp::Addr src;
+  std::vector< byte_t > buf;
+};
+
 void
 llarp_link::handle_recvfrom(struct llarp_udp_io* udp,
                             const struct sockaddr* saddr, const void* buf,
                             ssize_t sz)
 {
   llarp_link* link = static_cast< llarp_link* >(udp->user);
+  llarp::Addr src(*saddr);
+  {
+    // the owning shard's lock is held so the logic thread can't expire the
+    // session from under us
+    auto& shard = link->shard_for(src);
+    lock_t lock(shard.mutex);
+    auto itr = shard.sessions.find(src);
+    if(itr != shard.sessions.end() && !itr->second->IsHandshaking())
+    {
+      // data frames are safe to queue from any shard
+      itr->second->recv(buf, sz);
+      return;
+    }
+  }
+  // handshake state is owned by the logic thread, which the main event loop
+  // runs on
+  if(udp->parent == link->netloop)
+  {
+    link->recv_from(src, buf, sz);
+    return;
+  }
+  const byte_t* ptr = static_cast< const byte_t* >(buf);
+  iwp_handshake_packet* pkt = new iwp_handshake_packet{
+      link, src, std::vector< byte_t >(ptr, ptr + sz)};
+  llarp_logic_queue_job(link->logic,
+                        {pkt, &llarp_link::handle_handshake_packet});
+}
 
-  llarp_link_session* s = link->find_session(*saddr);
-  if(s == nullptr)
+void
+llarp_link::recv_from(const llarp::Addr& src, const void* buf, size_t sz)
+{
+  auto& shard = shard_for(src);
+  lock_t lock(shard.mutex);
+  llarp_link_session* s = nullptr;
+  auto itr              = shard.sessions.find(src);
+  if(itr == shard.sessions.end())
   {
     // new inbound session
-    s = link->create_session(*saddr);
+    s = create_session(src);
   }
+  else
+    s = itr->second;
   s->recv(buf, sz);
 }
 
+void
+llarp_link::handle_handshake_packet(void* user)
+{
+  iwp_handshake_packet* pkt = static_cast< iwp_handshake_packet* >(user);
+  pkt->link->recv_from(pkt->src, pkt->buf.data(), pkt->buf.size());
+  delete pkt;
+}
+
 void
 llarp_link::cancel_timer()
 {
@@ -314,7 +443,35 @@ void
 llarp_link::after_recv(llarp_udp_io* udp)
 {
   llarp_link* self = static_cast< llarp_link* >(udp->user);
-  self->PumpLogic();
+  if(udp->parent == self->netloop)
+  {
+    // the main event loop also runs our logic
+    self->PumpLogic();
+    return;
+  }
+  // shard loops hand the session pump over to the logic thread
+  if(self->pumpingLogic.exchange(true))
+    return;
+  llarp_logic_queue_job(self->logic, {self, &llarp_link::handle_logic_pump});
+}
+
+bool
+llarp_link::add_shard(llarp_ev_loop* loop, bool shared)
+{
+  std::unique_ptr< Shard > shard(new Shard());
+  shard->netloop      = loop;
+  shard->udp.recvfrom = &llarp_link::handle_recvfrom;
+  shard->udp.user     = this;
+  shard->udp.tick     = &llarp_link::after_recv;
+  int ret;
+  if(shared)
+    ret = llarp_ev_add_udp_shared(loop, &shard->udp, addr);
+  else
+    ret = llarp_ev_add_udp(loop, &shard->udp, addr);
+  if(ret == -1)
+    return false;
+  m_shards.emplace_back(std::move(shard));
+  return true;
 }
 
 bool
@@ -376,15 +533,38 @@ llarp_link::configure(struct llarp_ev_loop* netloop, const char* ifname, int af,
 
   this->addr    = *addr;
   this->netloop = netloop;
-  udp.recvfrom  = &llarp_link::handle_recvfrom;
-  udp.user      = this;
-  udp.tick      = &llarp_link::after_recv;
   llarp::LogDebug("bind IWP link to ", addr);
-  if(llarp_ev_add_udp(netloop, &udp, addr) == -1)
+  m_shards.clear();
+  bool shared = shardloops.size() > 0;
+  if(shared && !add_shard(netloop, true))
+  {
+    llarp::LogWarn("cannot share ", this->addr,
+                   " between event loops, using just one");
+    shared = false;
+  }
+  if(!shared && !add_shard(netloop, false))
   {
-    llarp::LogError("failed to bind to ", addr);
+    llarp::LogError("failed to bind to ", this->addr);
     return false;
   }
+  if(shared)
+  {
+    for(auto loop : shardloops)
+    {
+      if(!add_shard(loop, true))
+      {
+        llarp::LogWarn("failed to bind shard ", m_shards.size(), " to ",
+                       this->addr);
+        break;
+      }
+    }
+    int fd = static_cast< llarp::ev_io* >(m_shards[0]->udp.impl)->fd;
+    if(!llarp::SteerReusePort(fd, m_shards.size()))
+      llarp::LogWarn("net threads will contend for ", this->addr,
+                     " sessions, cannot steer datagrams to their shard");
+    llarp::LogInfo("link ", this->addr, " sharded over ", m_shards.size(),
+                   " event loops");
+  }
   return true;
 }
 
@@ -404,7 +584,8 @@ bool
 llarp_link::stop_link()
 {
   cancel_timer();
-  llarp_ev_close_udp(&udp);
+  for(auto& shard : m_shards)
+    llarp_ev_close_udp(&shard->udp);
   clear_sessions();
   return true;
 }
@@ -9,33 +9,16 @@
 #include "address_info.hpp"
 #include "buffer.hpp"
 #include "link/encoder.hpp"
-#include "llarp/ev.h"  // for handle_frame_encrypt
-
-static void
-handle_crypto_outbound(void *u)
-{
-  llarp_link_session *self = static_cast< llarp_link_session * >(u);
-  self->EncryptOutboundFrames();
-  self->working = false;
-}
-
-// TODO: move this orphan function?
-static void
-handle_frame_encrypt(iwp_async_frame *frame)
-{
-  llarp_link_session *self = static_cast< llarp_link_session * >(frame->user);
-  if(llarp_ev_udp_sendto(self->udp, self->addr, frame->buf, frame->sz) == -1)
-    llarp::LogWarn("sendto failed");
-}
+#include "llarp/ev.h"  // for llarp_ev_udp_sendto
 
 llarp_link_session::llarp_link_session(llarp_link *l, const byte_t *seckey,
                                        const llarp::Addr &a)
-    : udp(&l->udp)
+    : udp(&l->shard_for(a).udp)
     , crypto(&l->router->crypto)
     , iwp(l->iwp)
     , serv(l)
-    , outboundFrames("iwp_outbound")
-    , decryptedFrames("iwp_inbound")
+    , inboundBacklog(0)
+    , inboundDropped(0)
     , addr(a)
     , state(eInitial)
     , frame(this)
@@ -53,8 +36,16 @@ llarp_link_session::llarp_link_session(llarp_link *l, const byte_t *seckey,
 
 llarp_link_session::~llarp_link_session()
 {
+  serv->purge_outbound_frames(this);
   llarp_rc_free(&remote_router);
   frame.clear();
+  for(auto f : inboundFrames)
+    llarp::FreeIWPFrame(f);
+  while(decryptedFrames.size())
+  {
+    llarp::FreeIWPFrame(decryptedFrames.front());
+    decryptedFrames.pop();
+  }
 }
 
 llarp_router *
@@ -63,6 +54,15 @@ llarp_link_session::Router()
   return serv->router;
 }
 
+iwp_session_stats
+llarp_link_session::get_stats() const
+{
+  iwp_session_stats st;
+  frame.get_stats(st);
+  st.rxdropped = inboundDropped;
+  return st;
+}
+
 bool
 llarp_link_session::sendto(llarp_buffer_t msg)
 {
@@ -74,6 +74,12 @@ llarp_link_session::sendto(llarp_buffer_t msg)
   llarp::ShortHash digest;
   crypto->shorthash(digest, msg);
   transit_message *m = new transit_message(msg, digest, id);
+  if(!m->allocated)
+  {
+    llarp::LogWarn("buffer pool full, dropping outbound message");
+    delete m;
+    return false;
+  }
   add_outbound_message(id, m);
   return true;
 }
@@ -81,9 +87,10 @@ llarp_link_session::sendto(llarp_buffer_t msg)
 bool
 llarp_link_session::timedout(llarp_time_t now, llarp_time_t timeout)
 {
-  if(now <= frame.lastEvent)
+  llarp_time_t last = frame.lastEvent;
+  if(now <= last)
     return false;
-  auto diff = now - frame.lastEvent;
+  auto diff = now - last;
   return diff >= timeout;
 }
 
@@ -184,6 +191,20 @@ llarp_link_session::IsEstablished()
   return state == eEstablished;
 }
 
+bool
+llarp_link_session::IsHandshaking() const
+{
+  switch(state)
+  {
+    case eSessionStartSent:
+    case eLIMSent:
+    case eEstablished:
+      return false;
+    default:
+      return true;
+  }
+}
+
 void
 llarp_link_session::send_LIM()
 {
@@ -202,6 +223,12 @@ llarp_link_session::send_LIM()
     crypto->shorthash(digest, buf);
     auto id  = frame.txids++;
     auto msg = new transit_message(buf, digest, id);
+    if(!msg->allocated)
+    {
+      llarp::LogError("buffer pool full, cannot send LIM");
+      delete msg;
+      return;
+    }
     // put into outbound send queue
     add_outbound_message(id, msg);
     // enter state
@@ -291,10 +318,7 @@ llarp_link_session::done()
 void
 llarp_link_session::PumpCryptoOutbound()
 {
-  if(working)
-    return;
-  working = true;
-  llarp_threadpool_queue_job(serv->worker, {this, &handle_crypto_outbound});
+  serv->pump_crypto_outbound(this);
 }
 
 // void llarp_link_session::PumpCodelInbound()
@@ -403,12 +427,16 @@ void
 llarp_link_session::TickLogic(llarp_time_t now)
 {
   std::queue< iwp_async_frame * > q;
-  decryptedFrames.Process(q);
+  {
+    std::unique_lock< std::mutex > lock(m_DecryptedFramesMutex);
+    q.swap(decryptedFrames);
+  }
+  inboundBacklog -= q.size();
   while(q.size())
   {
     auto &front = q.front();
     handle_frame_decrypt(front);
-    delete front;
+    llarp::FreeIWPFrame(front);
     q.pop();
   }
   frame.process_inbound_queue();
@@ -426,7 +454,7 @@ llarp_link_session::Tick(llarp_time_t now)
     // workers we are done
     llarp::LogWarn("Tick - ", addr, " timed out with ", frames,
                    " frames left, working=", working);
-    return !working;
+    return !working && !crypto_busy();
   }
   if(is_invalidated())
   {
@@ -435,7 +463,7 @@ llarp_link_session::Tick(llarp_time_t now)
     // are done
     llarp::LogWarn("Tick - ", addr, " invaldiated session with ", frames,
                    " frames left");
-    return !working;
+    return !working && !crypto_busy();
   }
   if(state == eLIMSent || state == eEstablished)
   {
@@ -445,24 +473,6 @@ llarp_link_session::Tick(llarp_time_t now)
   return false;
 }
 
-void
-llarp_link_session::EncryptOutboundFrames()
-{
-  std::queue< iwp_async_frame * > outq;
-  outboundFrames.Process(outq);
-  while(outq.size())
-  {
-    auto &front = outq.front();
-
-    // if(iwp_encrypt_frame(&front))
-    // q.push(front);
-    if(iwp_encrypt_frame(front))
-      handle_frame_encrypt(front);
-    delete front;
-    outq.pop();
-  }
-}
-
 static void
 handle_verify_session_start(iwp_async_session_start *s)
 {
@@ -597,26 +607,86 @@ llarp_link_session::handle_frame_decrypt(iwp_async_frame *frame)
     llarp::LogError("decrypt frame fail from ", self->addr);
 }
 
+bool
+llarp_link_session::crypto_busy()
+{
+  std::unique_lock< std::mutex > lock(m_InboundFramesMutex);
+  return decrypting;
+}
+
+void
+llarp_link_session::handle_decrypt_inbound(void *user)
+{
+  llarp_link_session *self = static_cast< llarp_link_session * >(user);
+  std::vector< iwp_async_frame * > batch;
+  for(;;)
+  {
+    {
+      std::unique_lock< std::mutex > lock(self->m_InboundFramesMutex);
+      if(self->inboundFrames.empty())
+      {
+        // the session may be deleted as soon as we let go of this
+        self->decrypting = false;
+        return;
+      }
+      batch.swap(self->inboundFrames);
+    }
+    size_t failed = 0;
+    for(auto f : batch)
+    {
+      if(iwp_decrypt_frame(f))
+        continue;
+      ++failed;
+    }
+    {
+      // hand over in arrival order
+      std::unique_lock< std::mutex > lock(self->m_DecryptedFramesMutex);
+      for(auto f : batch)
+      {
+        if(f->success)
+          self->decryptedFrames.push(f);
+        else
+          llarp::FreeIWPFrame(f);
+      }
+    }
+    if(failed)
+    {
+      self->inboundBacklog -= failed;
+      llarp::LogWarn("decrypt frame fail from ", self->addr, " x", failed);
+    }
+    batch.clear();
+  }
+}
+
+// this is called from the net thread
 void
 llarp_link_session::decrypt_frame(const void *buf, size_t sz)
 {
   if(sz > 64)
   {
-    // auto frame = alloc_frame(inboundFrames, buf, sz);
-    // inboundFrames.Put(frame);
-    auto f = alloc_frame(buf, sz);
-
-    if(iwp_decrypt_frame(f))
+    // drop instead of queueing without bound when workers are behind
+    if(inboundBacklog >= MAX_INBOUND_BACKLOG)
     {
-      decryptedFrames.Put(f);
+      if(inboundDropped++ % MAX_INBOUND_BACKLOG == 0)
+        llarp::LogWarn("inbound crypto backlog full for ", addr,
+                       ", dropping frames");
+      return;
     }
-    else
+    auto f = alloc_frame(buf, sz);
+    if(f == nullptr)
+      return;
+    ++inboundBacklog;
+    bool queue = false;
     {
-      llarp::LogWarn("decrypt frame fail");
-      delete f;
+      std::unique_lock< std::mutex > lock(m_InboundFramesMutex);
+      inboundFrames.push_back(f);
+      // one worker job per session at a time keeps frames in order, it
+      // picks up everything queued while it runs
+      if(!decrypting)
+        decrypting = queue = true;
     }
-    // f->hook = &handle_frame_decrypt;
-    // iwp_call_async_frame_decrypt(iwp, f);
+    if(queue)
+      llarp_threadpool_queue_job(serv->worker, {this, &handle_decrypt_inbound});
   }
   else
     llarp::LogWarn("short packet of ", sz, " bytes");
@@ -706,7 +776,8 @@ llarp_link_session::intro_ack()
   iwp_call_async_gen_introack(iwp, &introack);
 }
 
-// this is called from net thread
+// called from a shard thread once the session start is sent, from the logic
+// thread while handshaking
 void
 llarp_link_session::recv(const void *buf, size_t sz)
 {
@@ -764,7 +835,12 @@ llarp_link_session::alloc_frame(const void *buf, size_t sz)
     return nullptr;
   }
 
-  iwp_async_frame *frame = new iwp_async_frame;
+  iwp_async_frame *frame = llarp::AllocIWPFrame();
+  if(frame == nullptr)
+  {
+    llarp::LogWarn("alloc frame - buffer pool full");
+    return nullptr;
+  }
   if(buf)
     memcpy(frame->buf, buf, sz);
   frame->iwp        = iwp;
@@ -783,6 +859,8 @@ llarp_link_session::encrypt_frame_async_send(const void *buf, size_t sz)
 {
   // 64 bytes frame overhead for nonce and hmac
   iwp_async_frame *frame = alloc_frame(nullptr, sz + 64);
+  if(frame == nullptr)
+    return;
   memcpy(frame->buf + 64, buf, sz);
   // maybe add upto 128 random bytes to the packet
   auto padding = llarp_randint() % MAX_PAD;
@@ -790,7 +868,7 @@ llarp_link_session::encrypt_frame_async_send(const void *buf, size_t sz)
     crypto->randbytes(frame->buf + 64 + sz, padding);
   frame->sz += padding;
   // frame is modified, so now we can push it to queue
-  outboundFrames.Put(frame);
+  serv->put_outbound_frame(this, frame);
 }
 
 void
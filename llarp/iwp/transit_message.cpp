@@ -4,11 +4,17 @@
 #include "llarp/iwp/sendbuf.hpp"
 #include "llarp/time.h"
 
+#include <algorithm>
+
 void
 transit_message::clear()
 {
+  for(auto frag : frags)
+    llarp::BufferPool::Free(frag);
   frags.clear();
-  lastfrag.clear();
+  llarp::BufferPool::Free(lastfrag);
+  lastfrag   = nullptr;
+  lastfragsz = 0;
 }
 
 // calculate acked bitmask
@@ -37,16 +43,25 @@ transit_message::transit_message(llarp_buffer_t buf, const byte_t *hash,
 transit_message::transit_message(const xmit &x) : msginfo(x)
 {
   started           = llarp_time_now_ms();
-  byte_t fragidx    = 0;
   uint16_t fragsize = x.fragsize();
-  while(fragidx < x.numfrags())
+  frags.resize(x.numfrags(), nullptr);
+  for(auto &frag : frags)
   {
-    frags[fragidx].resize(fragsize);
-    ++fragidx;
+    frag = static_cast< byte_t * >(llarp::BufferPool::Alloc(fragsize));
+    if(frag == nullptr)
+    {
+      allocated = false;
+      break;
+    }
   }
   status.reset();
 }
 
+transit_message::~transit_message()
+{
+  clear();
+}
+
 /// ack packets based off a bitmask
 void
 transit_message::ack(uint32_t bitmask)
@@ -78,19 +93,28 @@ transit_message::should_send_ack(llarp_time_t now) const
 }
 
 bool
-transit_message::should_resend_xmit(llarp_time_t now) const
+transit_message::should_resend_xmit(llarp_time_t now, llarp_time_t rto) const
 {
-  if(now < started)
+  auto last = std::max(sentAt, lastRetransmit);
+  if(sentAt == 0 || now < last)
     return false;
-  return lastAck == 0 && now - started > 1000;
+  return lastAck == 0 && now - last > rto;
 }
 
 bool
-transit_message::should_resend_frags(llarp_time_t now) const
+transit_message::should_resend_frags(llarp_time_t now, llarp_time_t rto) const
 {
-  if(now < started || now < lastAck)
+  auto last = std::max(lastAck, lastRetransmit);
+  if(now < started || now < last)
     return false;
-  return lastAck > 0 && now - lastAck > 500 && !completed();
+  return lastAck > 0 && now - last > rto && !completed();
+}
+
+size_t
+transit_message::wire_size() const
+{
+  return sizeof(msginfo.buffer) + msginfo.totalsize()
+      + (msginfo.numfrags() * 9);
 }
 
 bool
@@ -108,12 +132,15 @@ transit_message::completed() const
 void
 transit_message::generate_xmit(sendqueue_t &queue, byte_t flags)
 {
-  uint16_t sz   = lastfrag.size() + sizeof(msginfo.buffer);
-  auto pkt      = new sendbuf_t(sz + 6);
+  uint16_t sz = lastfragsz + sizeof(msginfo.buffer);
+  auto pkt    = sendbuf_t::alloc(sz + 6);
+  if(pkt == nullptr)
+    return;
   auto body_ptr = init_sendbuf(pkt, eXMIT, sz, flags);
   memcpy(body_ptr, msginfo.buffer, sizeof(msginfo.buffer));
   body_ptr += sizeof(msginfo.buffer);
-  memcpy(body_ptr, lastfrag.data(), lastfrag.size());
+  if(lastfragsz)
+    memcpy(body_ptr, lastfrag, lastfragsz);
   queue.Put(pkt);
 }
 
@@ -123,16 +150,18 @@ transit_message::retransmit_frags(sendqueue_t &queue, byte_t flags)
 {
   auto msgid    = msginfo.msgid();
   auto fragsize = msginfo.fragsize();
-  for(auto &frag : frags)
+  for(byte_t idx = 0; idx < frags.size(); ++idx)
   {
-    if(status.test(frag.first))
+    if(status.test(idx))
       continue;
-    uint16_t sz   = 9 + fragsize;
-    auto pkt      = new sendbuf_t(sz + 6);
+    uint16_t sz = 9 + fragsize;
+    auto pkt    = sendbuf_t::alloc(sz + 6);
+    if(pkt == nullptr)
+      break;
     auto body_ptr = init_sendbuf(pkt, eFRAG, sz, flags);
     htobe64buf(body_ptr, msgid);
-    body_ptr[8] = frag.first;
-    memcpy(body_ptr + 9, frag.second.data(), fragsize);
+    body_ptr[8] = idx;
+    memcpy(body_ptr + 9, frags[idx], fragsize);
     queue.Put(pkt);
   }
   lastRetransmit = llarp_time_now_ms();
@@ -149,10 +178,11 @@ transit_message::reassemble(std::vector< byte_t > &buffer)
   {
     if(!status.test(idx))
       return false;
-    memcpy(ptr, frags[idx].data(), fragsz);
+    memcpy(ptr, frags[idx], fragsz);
     ptr += fragsz;
   }
-  memcpy(ptr, lastfrag.data(), lastfrag.size());
+  if(lastfragsz)
+    memcpy(ptr, lastfrag, lastfragsz);
   return true;
 }
 
@@ -164,35 +194,51 @@ transit_message::put_message(llarp_buffer_t buf, const byte_t *hash,
   uint8_t fragid    = 0;
   uint16_t fragsize = mtu;
   size_t left       = buf.sz;
+  clear();
   while(left > fragsize)
   {
-    auto &frag = frags[fragid];
-    frag.resize(fragsize);
-    memcpy(frag.data(), buf.cur, fragsize);
+    auto frag = static_cast< byte_t * >(llarp::BufferPool::Alloc(fragsize));
+    if(frag == nullptr)
+    {
+      allocated = false;
+      return;
+    }
+    frags.push_back(frag);
+    memcpy(frag, buf.cur, fragsize);
     buf.cur += fragsize;
     fragid++;
     left -= fragsize;
   }
-  uint16_t lastfrag = buf.sz - (buf.cur - buf.base);
+  uint16_t lastsz = buf.sz - (buf.cur - buf.base);
   // set info for xmit
-  msginfo.set_info(hash, id, fragsize, lastfrag, fragid);
-  put_lastfrag(buf.cur, lastfrag);
+  msginfo.set_info(hash, id, fragsize, lastsz, fragid);
+  put_lastfrag(buf.cur, lastsz);
 }
 
 void
 transit_message::put_lastfrag(byte_t *buf, size_t sz)
 {
-  lastfrag.resize(sz);
-  memcpy(lastfrag.data(), buf, sz);
+  llarp::BufferPool::Free(lastfrag);
+  lastfrag   = nullptr;
+  lastfragsz = 0;
+  if(sz == 0)
+    return;
+  lastfrag = static_cast< byte_t * >(llarp::BufferPool::Alloc(sz));
+  if(lastfrag == nullptr)
+  {
+    allocated = false;
+    return;
+  }
+  lastfragsz = sz;
+  memcpy(lastfrag, buf, sz);
 }
 
 bool
 transit_message::put_frag(byte_t fragno, byte_t *buf)
 {
-  auto itr = frags.find(fragno);
-  if(itr == frags.end())
+  if(fragno >= frags.size() || frags[fragno] == nullptr)
     return false;
-  memcpy(itr->second.data(), buf, msginfo.fragsize());
+  memcpy(frags[fragno], buf, msginfo.fragsize());
   status.set(fragno);
   return true;
 }
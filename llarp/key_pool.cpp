@@ -0,0 +1,67 @@
+#include <llarp/key_pool.hpp>
+
+namespace llarp
+{
+  constexpr size_t KeyPool::DefaultTarget;
+
+  KeyPool::KeyPool(llarp_crypto* crypto, size_t target)
+      : hits(0)
+      , misses(0)
+      , m_Crypto(crypto)
+      , m_Target(target)
+      , m_Refilling(false)
+  {
+  }
+
+  void
+  KeyPool::Take(SecretKey& key)
+  {
+    {
+      std::unique_lock< std::mutex > lock(m_Access);
+      if(m_Keys.size())
+      {
+        key = m_Keys.back();
+        m_Keys.pop_back();
+        ++hits;
+        return;
+      }
+    }
+    ++misses;
+    m_Crypto->encryption_keygen(key);
+  }
+
+  void
+  KeyPool::MaybeRefill(llarp_threadpool* worker)
+  {
+    {
+      std::unique_lock< std::mutex > lock(m_Access);
+      if(m_Keys.size() * 2 >= m_Target)
+        return;
+    }
+    bool expected = false;
+    if(m_Refilling.compare_exchange_strong(expected, true))
+      llarp_threadpool_queue_job(worker, {this, &HandleRefill});
+  }
+
+  size_t
+  KeyPool::Size()
+  {
+    std::unique_lock< std::mutex > lock(m_Access);
+    return m_Keys.size();
+  }
+
+  void
+  KeyPool::HandleRefill(void* user)
+  {
+    KeyPool* self = static_cast< KeyPool* >(user);
+    SecretKey key;
+    while(self->Size() < self->m_Target)
+    {
+      // keygen outside the lock so takers never wait on it
+      self->m_Crypto->encryption_keygen(key);
+      std::unique_lock< std::mutex > lock(self->m_Access);
+      self->m_Keys.push_back(key);
+    }
+    self->m_Refilling = false;
+  }
+}  // namespace llarp
@@ -14,75 +14,39 @@ namespace llarp
   InboundMessageParser::InboundMessageParser(llarp_router* _router)
       : router(_router)
   {
-    reader.user   = this;
-    reader.on_key = &OnKey;
   }
 
   bool
-  InboundMessageParser::OnKey(dict_reader* r, llarp_buffer_t* key)
+  InboundMessageParser::CreateMessage(byte_t type, Arena& arena)
   {
-    InboundMessageParser* handler =
-        static_cast< InboundMessageParser* >(r->user);
-    llarp_buffer_t strbuf;
-
-    // we are reading the first key
-    if(handler->firstkey)
+    // create the message to parse based off message type
+    llarp::LogDebug("inbound message ", type);
+    switch(type)
     {
-      // check for empty dict
-      if(!key)
-        return false;
-      // we are expecting the first key to be 'a'
-      if(!llarp_buffer_eq(*key, "a"))
-      {
-        llarp::LogWarn("message has no message type");
-        return false;
-      }
-
-      if(!bencode_read_string(r->buffer, &strbuf))
-      {
-        llarp::LogWarn("could not read value of message type");
-        return false;
-      }
-      // bad key size
-      if(strbuf.sz != 1)
-      {
-        llarp::LogWarn("bad mesage type size: ", strbuf.sz);
+      case 'i':
+        msg = arena.New< LinkIntroMessage >(from->get_remote_router());
+        break;
+      case 'd':
+        msg = arena.New< RelayDownstreamMessage >(GetCurrentFrom());
+        break;
+      case 'u':
+        msg = arena.New< RelayUpstreamMessage >(GetCurrentFrom());
+        break;
+      case 'm':
+        msg = arena.New< DHTImmeidateMessage >(GetCurrentFrom(), &arena);
+        break;
+      case 'a':
+        msg = arena.New< LR_AckMessage >(GetCurrentFrom());
+        break;
+      case 'c':
+        msg = arena.New< LR_CommitMessage >(GetCurrentFrom());
+        break;
+      default:
         return false;
-      }
-      // create the message to parse based off message type
-      llarp::LogDebug("inbound message ", *strbuf.cur);
-      switch(*strbuf.cur)
-      {
-        case 'i':
-          handler->msg =
-              new LinkIntroMessage(handler->from->get_remote_router());
-          break;
-        case 'd':
-          handler->msg = new RelayDownstreamMessage(handler->GetCurrentFrom());
-          break;
-        case 'u':
-          handler->msg = new RelayUpstreamMessage(handler->GetCurrentFrom());
-          break;
-        case 'm':
-          handler->msg = new DHTImmeidateMessage(handler->GetCurrentFrom());
-          break;
-        case 'a':
-          handler->msg = new LR_AckMessage(handler->GetCurrentFrom());
-          break;
-        case 'c':
-          handler->msg = new LR_CommitMessage(handler->GetCurrentFrom());
-          break;
-        default:
-          return false;
-      }
-      handler->firstkey = false;
-      return handler->msg != nullptr;
     }
-    // check for last element
-    if(!key)
-      return handler->MessageDone();
-
-    return handler->msg->DecodeKey(*key, r->buffer);
+    if(msg == nullptr)
+      llarp::LogWarn("no room to decode message of type ", type);
+    return msg != nullptr;
   }
 
   RouterID
@@ -99,17 +63,80 @@ namespace llarp
     if(msg)
     {
       result = msg->HandleMessage(router);
-      delete msg;
-      msg = nullptr;
+      msg    = nullptr;
     }
     return result;
   }
 
+  path::TransitHop*
+  InboundMessageParser::GetForwardingHop(llarp_buffer_t buf, RelayView& view)
+  {
+    // cheap check before parsing, relay messages start with their type
+    static const char upstream[]   = "d1:a1:u";
+    static const char downstream[] = "d1:a1:d";
+    if(buf.sz < sizeof(upstream)
+       || (memcmp(buf.base, upstream, sizeof(upstream) - 1)
+           && memcmp(buf.base, downstream, sizeof(downstream) - 1)))
+      return nullptr;
+    auto rc = from->get_remote_router();
+    if(rc == nullptr || !ParseRelayInPlace(buf, view))
+      return nullptr;
+    bool isUpstream = view.type == 'u';
+    // upstream messages come from the hop's downstream and vice versa
+    auto hop = router->paths.GetTransitHop(rc->pubkey, PathID_t(view.pathid),
+                                           !isUpstream);
+    // the end of the path handles the message itself
+    if(hop && isUpstream && hop->IsEndpoint(router->pubkey()))
+      return nullptr;
+    return hop;
+  }
+
   bool
   InboundMessageParser::ProcessFrom(llarp_link_session* src, llarp_buffer_t buf)
   {
-    from     = src;
-    firstkey = true;
-    return bencode_read_dict(&buf, &reader);
+    from = src;
+    // relay through transit hops without allocating or copying, our own
+    // paths and anything unusual go through the full decode
+    RelayView view;
+    auto hop = GetForwardingHop(buf, view);
+    if(hop)
+      return hop->ForwardInPlace(buf, view, router);
+
+    // everything we decode is gone once we are done with it
+    Arena& arena = Arena::ThisThread();
+    Arena::Scope scope(arena);
+    BencodeReader reader(&buf);
+    llarp_buffer_t key, type;
+    // check for empty dict
+    if(!reader.EnterDict() || !reader.NextKey(key))
+      return false;
+    // we are expecting the first key to be 'a'
+    if(!llarp_buffer_eq(key, "a"))
+    {
+      llarp::LogWarn("message has no message type");
+      return false;
+    }
+    if(!reader.ReadString(type))
+    {
+      llarp::LogWarn("could not read value of message type");
+      return false;
+    }
+    // bad key size
+    if(type.sz != 1)
+    {
+      llarp::LogWarn("bad mesage type size: ", type.sz);
+      return false;
+    }
+    if(!CreateMessage(*type.base, arena))
+      return false;
+    bool decoded = true;
+    while(decoded && reader.NextKey(key))
+      decoded = msg->DecodeKey(key, &buf);
+    if(!decoded || reader.failed)
+    {
+      msg = nullptr;
+      return false;
+    }
+    return MessageDone();
   }
 }  // namespace llarp
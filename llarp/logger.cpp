@@ -1,15 +1,492 @@
 #include "logger.hpp"
 #include <llarp/logger.h>
 
+#include <algorithm>
+#include <chrono>
+
 namespace llarp
 {
+  constexpr size_t LogRecord::Size;
+  constexpr llarp_time_t LogLimiter::Interval;
+  constexpr uint32_t LogLimiter::Burst;
+
+  /// bounded queue of records from any thread to the log thread. producers
+  /// claim a cell with one compare and swap and never wait on each other
+  struct LogRing
+  {
+    static constexpr size_t Cells = 1024;
+
+    struct Cell
+    {
+      /// pos when free, pos + 1 once the record in it is ready
+      std::atomic< size_t > seq;
+      size_t pos;
+      LogRecord rec;
+    };
+
+    LogRing() : head(0), written(0), stop(false), sleeping(false)
+    {
+      for(size_t idx = 0; idx < Cells; ++idx)
+        cells[idx].seq.store(idx, std::memory_order_relaxed);
+    }
+
+    /// a free cell, nullptr if the log thread is a whole ring behind
+    Cell*
+    Claim()
+    {
+      size_t pos = head.load(std::memory_order_relaxed);
+      for(;;)
+      {
+        Cell& cell = cells[pos % Cells];
+        size_t seq = cell.seq.load(std::memory_order_acquire);
+        if(seq == pos)
+        {
+          if(head.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed))
+          {
+            cell.pos = pos;
+            return &cell;
+          }
+        }
+        else if(seq < pos)
+          return nullptr;
+        else
+          pos = head.load(std::memory_order_relaxed);
+      }
+    }
+
+    Cell*
+    CellOf(LogRecord* rec)
+    {
+      size_t idx = (reinterpret_cast< uint8_t* >(rec)
+                    - reinterpret_cast< uint8_t* >(&cells[0].rec))
+          / sizeof(Cell);
+      return &cells[idx];
+    }
+
+    void
+    Commit(Cell* cell)
+    {
+      cell->seq.store(cell->pos + 1, std::memory_order_release);
+      // pairs with the fence in Run so we either see it sleeping or it
+      // sees our record
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if(sleeping.load(std::memory_order_relaxed))
+      {
+        std::unique_lock< std::mutex > lock(wakeLock);
+        wake.notify_one();
+      }
+    }
+
+    /// the next record for the log thread, nullptr if it isn't ready
+    LogRecord*
+    Front()
+    {
+      Cell& cell = cells[tail % Cells];
+      if(cell.seq.load(std::memory_order_acquire) != tail + 1)
+        return nullptr;
+      return &cell.rec;
+    }
+
+    /// done with Front
+    void
+    Pop()
+    {
+      cells[tail % Cells].seq.store(tail + Cells, std::memory_order_release);
+      ++tail;
+    }
+
+    Cell cells[Cells];
+    std::atomic< size_t > head;
+    /// log thread only
+    size_t tail = 0;
+    /// records written so far
+    std::atomic< size_t > written;
+    std::atomic< bool > stop;
+    std::atomic< bool > sleeping;
+    std::mutex wakeLock;
+    std::condition_variable wake;
+  };
+
+  constexpr size_t LogRing::Cells;
+
+  namespace
+  {
+    /// streambuf over the free space at the end of a record
+    struct RecordBuf : public std::streambuf
+    {
+      void
+      Reset(uint8_t* begin, uint8_t* end)
+      {
+        setp((char*)begin, (char*)end);
+      }
+
+      size_t
+      Written() const
+      {
+        return pptr() - pbase();
+      }
+    };
+
+    struct RecordStream
+    {
+      RecordBuf buf;
+      std::ostream out;
+
+      RecordStream() : out(&buf)
+      {
+      }
+    };
+
+    RecordStream&
+    Stream()
+    {
+      static thread_local RecordStream stream;
+      return stream;
+    }
+
+    /// where records go when they aren't queued, one per thread
+    LogRecord&
+    SyncRecord()
+    {
+      static thread_local LogRecord rec;
+      return rec;
+    }
+
+    void
+    WriteArgs(std::ostream& out, const LogRecord& rec)
+    {
+      size_t idx = 0;
+      while(idx < rec.used)
+      {
+        const uint8_t* val = rec.data + idx + 1;
+        switch(rec.data[idx])
+        {
+          case LogRecord::eArgInt:
+          {
+            int64_t i;
+            memcpy(&i, val, sizeof(i));
+            out << i;
+            idx += 1 + sizeof(i);
+            break;
+          }
+          case LogRecord::eArgUInt:
+          {
+            uint64_t i;
+            memcpy(&i, val, sizeof(i));
+            out << i;
+            idx += 1 + sizeof(i);
+            break;
+          }
+          case LogRecord::eArgDouble:
+          {
+            double d;
+            memcpy(&d, val, sizeof(d));
+            out << d;
+            idx += 1 + sizeof(d);
+            break;
+          }
+          case LogRecord::eArgChar:
+            out << char(*val);
+            idx += 2;
+            break;
+          case LogRecord::eArgBool:
+            out << bool(*val);
+            idx += 2;
+            break;
+          case LogRecord::eArgText:
+          {
+            uint16_t len;
+            memcpy(&len, val, sizeof(len));
+            out.write((const char*)val + sizeof(len), len);
+            idx += 1 + sizeof(len) + len;
+            break;
+          }
+          default:
+            return;
+        }
+      }
+      if(rec.truncated)
+        out << "...";
+    }
+  }  // namespace
+
+  void
+  LogRecord::PutText(const char* str, size_t len)
+  {
+    uint16_t sz = 0;
+    Put(eArgText, &sz, sizeof(sz));
+    if(truncated)
+      return;
+    if(len > Size - used)
+    {
+      len       = Size - used;
+      truncated = true;
+    }
+    sz = len;
+    memcpy(data + used - sizeof(sz), &sz, sizeof(sz));
+    memcpy(data + used, str, len);
+    used += len;
+  }
+
+  std::ostream&
+  LogRecord::BeginFormat()
+  {
+    RecordStream& stream = Stream();
+    stream.buf.Reset(data + used, data + Size);
+    // each call starts out like a fresh stream
+    stream.out.clear();
+    stream.out.flags(std::ios_base::dec | std::ios_base::skipws);
+    stream.out.fill(' ');
+    stream.out.precision(6);
+    stream.out.width(0);
+    return stream.out;
+  }
+
+  void
+  LogRecord::EndFormat(size_t start)
+  {
+    RecordStream& stream = Stream();
+    uint16_t len         = stream.buf.Written();
+    // the stream goes bad when it runs out of room
+    if(!stream.out.good())
+      truncated = true;
+    memcpy(data + start + 1, &len, sizeof(len));
+    used += len;
+  }
+
   Logger _glog;
 
+  Logger::Logger() : Logger(std::cout, "unnamed")
+  {
+#ifdef _WIN32
+    DWORD mode_flags;
+    HANDLE fd1 = GetStdHandle(STD_OUTPUT_HANDLE);
+    GetConsoleMode(fd1, &mode_flags);
+    // since release SDKs don't have ANSI escape support yet
+    mode_flags |= 0x0004;
+    SetConsoleMode(fd1, mode_flags);
+#endif
+  }
+
+  Logger::Logger(std::ostream& o, const std::string& name)
+      : nodeName(name), out(o), dropped(0), m_Ring(nullptr), m_Stopped(false)
+  {
+  }
+
+  Logger::~Logger()
+  {
+    // anything logged from here on is written right away
+    m_Stopped     = true;
+    LogRing* ring = m_Ring.load();
+    if(ring == nullptr)
+      return;
+    // the log thread drains what is queued before it exits
+    ring->stop = true;
+    {
+      std::unique_lock< std::mutex > lock(ring->wakeLock);
+      ring->wake.notify_one();
+    }
+    m_Thread.join();
+    m_Ring = nullptr;
+    delete ring;
+  }
+
+  LogRing*
+  Logger::Start()
+  {
+    // not access, that is held while writing
+    static std::mutex starting;
+    std::unique_lock< std::mutex > lock(starting);
+    LogRing* ring = m_Ring.load();
+    if(ring == nullptr)
+    {
+      ring = new LogRing();
+      m_Ring.store(ring);
+      m_Thread = std::thread(&Logger::Run, this, ring);
+    }
+    return ring;
+  }
+
+  LogRecord*
+  Logger::Claim(LogLevel lvl)
+  {
+#ifndef SHADOW_TESTNET
+    if(!m_Stopped.load(std::memory_order_acquire))
+    {
+      LogRing* ring = m_Ring.load(std::memory_order_acquire);
+      if(ring == nullptr)
+        ring = Start();
+      LogRing::Cell* cell = ring->Claim();
+      if(cell)
+        return &cell->rec;
+      // errors still get out, the rest waits for the log thread to catch
+      // up
+      if(lvl < eLogError)
+      {
+        ++dropped;
+        return nullptr;
+      }
+    }
+#endif
+    return &SyncRecord();
+  }
+
+  void
+  Logger::Commit(LogRecord* rec)
+  {
+    if(rec == &SyncRecord())
+      Write(*rec, true);
+    else
+    {
+      LogRing* ring = m_Ring.load(std::memory_order_relaxed);
+      ring->Commit(ring->CellOf(rec));
+    }
+  }
+
+  void
+  Logger::Flush()
+  {
+    LogRing* ring = m_Ring.load();
+    if(ring == nullptr)
+      return;
+    size_t target = ring->head.load();
+    while(ring->written.load() < target && !ring->stop.load())
+    {
+      {
+        std::unique_lock< std::mutex > lock(ring->wakeLock);
+        ring->wake.notify_one();
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  void
+  Logger::Run(LogRing* ring)
+  {
+    uint64_t reported = 0;
+    for(;;)
+    {
+      size_t batch = 0;
+      while(LogRecord* rec = ring->Front())
+      {
+        Write(*rec, false);
+        ring->Pop();
+        ++batch;
+      }
+      uint64_t drops = dropped.load();
+      if(drops != reported)
+      {
+        LogRecord rec;
+        rec.level      = eLogWarn;
+        rec.tag        = "logger";
+        rec.line       = __LINE__;
+        rec.when       = llarp_time_now_ms();
+        rec.suppressed = 0;
+        rec.used       = 0;
+        rec.truncated  = false;
+        std::string msg =
+            "dropped " + std::to_string(drops - reported) + " log messages";
+        rec.PutText(msg.data(), msg.size());
+        Write(rec, false);
+        reported = drops;
+      }
+      if(batch)
+      {
+        {
+          std::unique_lock< std::mutex > lock(access);
+          out.flush();
+        }
+        ring->written += batch;
+        continue;
+      }
+      if(ring->stop)
+        return;
+      std::unique_lock< std::mutex > lock(ring->wakeLock);
+      ring->sleeping = true;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      // the timeout is only there in case stop was set without a wake
+      if(ring->Front() == nullptr && !ring->stop)
+        ring->wake.wait_for(lock, std::chrono::seconds(1));
+      ring->sleeping = false;
+    }
+  }
+
+  void
+  Logger::Write(const LogRecord& rec, bool flush)
+  {
+#ifdef ANDROID
+    std::stringstream ss;
+    switch(rec.level)
+    {
+      case eLogDebug:
+        ss << "[DBG] ";
+        break;
+      case eLogInfo:
+        ss << "[NFO] ";
+        break;
+      case eLogWarn:
+        ss << "[WRN] ";
+        break;
+      case eLogError:
+        ss << "[ERR] ";
+        break;
+    }
+#else
+    std::unique_lock< std::mutex > lock(access);
+    std::ostream& ss = out;
+    switch(rec.level)
+    {
+      case eLogDebug:
+        ss << (char)27 << "[0m";
+        ss << "[DBG] ";
+        break;
+      case eLogInfo:
+        ss << (char)27 << "[1m";
+        ss << "[NFO] ";
+        break;
+      case eLogWarn:
+        ss << (char)27 << "[1;33m";
+        ss << "[WRN] ";
+        break;
+      case eLogError:
+        ss << (char)27 << "[1;31m";
+        ss << "[ERR] ";
+        break;
+    }
+#endif
+    ss << nodeName << " " << rec.when << " " << rec.tag << ":" << rec.line;
+    ss << "\t";
+    WriteArgs(ss, rec);
+    if(rec.suppressed)
+      ss << " (" << rec.suppressed << " more like this suppressed)";
+#ifdef ANDROID
+    {
+      std::unique_lock< std::mutex > lock(access);
+      __android_log_write(ANDROID_LOG_INFO, "LOKINET", ss.str().c_str());
+    }
+#else
+    ss << (char)27 << "[0;0m" << '\n';
+#ifdef SHADOW_TESTNET
+    ss << "\n";
+    flush = true;
+#endif
+    if(flush)
+      ss.flush();
+#endif
+  }
+
   void
   SetLogLevel(LogLevel lvl)
   {
     _glog.minlevel = lvl;
   }
+
+  void
+  LogFlush()
+  {
+    _glog.Flush();
+  }
 }  // namespace llarp
 
 extern "C"
@@ -25,4 +502,4 @@ extern "C"
   {
     llarp::_glog.nodeName = name;
   }
-}
\ No newline at end of file
+}
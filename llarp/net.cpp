@@ -8,7 +8,13 @@
 #include <arpa/inet.h>
 #include <net/if.h>
 #endif
+#ifdef __linux__
+#include <linux/filter.h>
+#include <sys/socket.h>
+#endif
+#include <llarp/endian.h>
 #include <cstdio>
+#include <cstring>
 #include "logger.hpp"
 
 bool
@@ -810,4 +816,70 @@ namespace llarp
       freeifaddrs(ifa);
     return found;
   }
-}  // namespace llarp
\ No newline at end of file
+
+  /// multiplier for the reuseport hash, the kernel computes it again in 32
+  /// bit classic bpf so everything here has to wrap the same way
+  static constexpr uint32_t ReusePortMul = 0x9e3779b1U;
+
+  size_t
+  ReusePortIndex(const Addr& addr, size_t num)
+  {
+    if(num <= 1)
+      return 0;
+    // ipv4 addresses live in the last 4 bytes either way
+    uint32_t h = bufbe32toh(&addr.addr6()->s6_addr[12]) * ReusePortMul;
+    h          = (h ^ addr.port()) * ReusePortMul;
+    return (h >> 16) % num;
+  }
+
+  bool
+  SteerReusePort(int fd, size_t num)
+  {
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    if(num <= 1)
+      return true;
+    // ReusePortIndex over the source address and port. anything but plain
+    // ipv4 with no options or ipv6 with no extension headers gets an index
+    // past the end, which leaves the pick to the kernel
+    sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, uint32_t(SKF_NET_OFF)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x45, 0, 4),
+        // ipv4
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, uint32_t(SKF_NET_OFF + 20)),
+        BPF_STMT(BPF_ST, 0),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, uint32_t(SKF_NET_OFF + 12)),
+        BPF_JUMP(BPF_JMP | BPF_JA, 5, 0, 0),
+        BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 4),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 6, 0, 10),
+        // ipv6
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, uint32_t(SKF_NET_OFF + 40)),
+        BPF_STMT(BPF_ST, 0),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, uint32_t(SKF_NET_OFF + 20)),
+        // hash
+        BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, ReusePortMul),
+        BPF_STMT(BPF_LDX | BPF_MEM, 0),
+        BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+        BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, ReusePortMul),
+        BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 16),
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, uint32_t(num)),
+        BPF_STMT(BPF_RET | BPF_A, 0),
+        // not ours to steer
+        BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+    };
+    sock_fprog prog;
+    prog.len    = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+    if(setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+                  sizeof(prog))
+       == -1)
+    {
+      llarp::LogWarn("cannot steer reuseport group: ", strerror(errno));
+      return false;
+    }
+    return true;
+#else
+    (void)fd;
+    return num <= 1;
+#endif
+  }
+}  // namespace llarp
@@ -2,9 +2,12 @@
 #include <llarp/nodedb.h>
 #include <llarp/router_contact.h>
 
+#include <chrono>
 #include <fstream>
 #include <llarp/crypto.hpp>
+#include <llarp/threading.hpp>
 #include <unordered_map>
+#include <vector>
 #include "buffer.hpp"
 #include "encode.hpp"
 #include "fs.hpp"
@@ -13,6 +16,40 @@
 
 static const char skiplist_subdirs[] = "0123456789abcdef";
 static const std::string RC_FILE_EXT = ".signed";
+/// rc files handed to one disk job and then one verify job
+static const size_t LOAD_BATCH_SIZE = 128;
+
+struct llarp_nodedb_load;
+
+/// files read on the disk pool, then decoded and verified on the worker pool
+struct llarp_nodedb_load_batch
+{
+  llarp_nodedb_load *load;
+  std::vector< fs::path > files;
+  std::vector< std::vector< byte_t > > contents;
+  /// verified rc, owned by the batch until merged
+  std::vector< llarp_rc > rcs;
+};
+
+/// state for one parallel load, lives on the loading thread's stack
+struct llarp_nodedb_load
+{
+  llarp_crypto *crypto;
+  llarp_threadpool *worker;
+  std::vector< llarp_nodedb_load_batch > batches;
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  size_t batchesDone = 0;
+  size_t filesDone   = 0;
+  size_t invalid     = 0;
+
+  static void
+  read_batch(void *user);
+
+  static void
+  verify_batch(void *user);
+};
 
 struct llarp_nodedb
 {
@@ -180,18 +217,105 @@ struct llarp_nodedb
     return loaded;
   }
 
+  /// rc files in the skiplist at path
+  static void
+  listFiles(const fs::path &path, std::vector< fs::path > &files)
+  {
+    for(const char &ch : skiplist_subdirs)
+    {
+      if(!ch)
+        continue;
+      std::string p;
+      p += ch;
+      fs::path sub = path / p;
+      std::error_code ec;
+      if(!fs::exists(sub, ec))
+        continue;
+      // compare against a default end iterator, the backport's end()
+      // rescans the directory on every call
+      fs::directory_iterator itr(sub), end;
+      while(itr != end)
+      {
+        const fs::path &fpath = itr->path();
+        if(fpath.extension() == RC_FILE_EXT && fs::is_regular_file(fpath))
+          files.push_back(fpath);
+        ++itr;
+      }
+    }
+  }
+
+  /// like Load but reads files on disk and checks signatures on worker,
+  /// blocks until every file is done
+  ssize_t
+  LoadParallel(const fs::path &path, llarp_threadpool *disk,
+               llarp_threadpool *worker)
+  {
+    std::error_code ec;
+    if(!fs::exists(path, ec))
+    {
+      return -1;
+    }
+    auto started = std::chrono::steady_clock::now();
+    std::vector< fs::path > files;
+    listFiles(path, files);
+
+    llarp_nodedb_load load;
+    load.crypto = crypto;
+    load.worker = worker;
+    load.batches.resize(
+        (files.size() + LOAD_BATCH_SIZE - 1) / LOAD_BATCH_SIZE);
+    std::vector< llarp_thread_job > jobs;
+    for(size_t idx = 0; idx < load.batches.size(); ++idx)
+    {
+      auto &batch = load.batches[idx];
+      batch.load  = &load;
+      auto begin  = files.begin() + (idx * LOAD_BATCH_SIZE);
+      auto end    = idx + 1 == load.batches.size()
+          ? files.end()
+          : begin + LOAD_BATCH_SIZE;
+      batch.files.assign(begin, end);
+      jobs.emplace_back(&batch, &llarp_nodedb_load::read_batch);
+    }
+    llarp_threadpool_queue_jobs(disk, jobs.data(), jobs.size());
+
+    {
+      std::unique_lock< std::mutex > lock(load.mutex);
+      while(load.batchesDone < load.batches.size())
+      {
+        if(load.cond.wait_for(lock, std::chrono::seconds(1))
+           == std::cv_status::timeout)
+          llarp::LogInfo("nodedb loading, ", load.filesDone, " of ",
+                         files.size(), " RCs checked");
+      }
+    }
+
+    ssize_t loaded = 0;
+    for(auto &batch : load.batches)
+    {
+      for(auto &rc : batch.rcs)
+      {
+        llarp::PubKey pk(rc.pubkey);
+        auto itr = entries.find(pk);
+        if(itr != entries.end())
+          llarp_rc_free(&itr->second);
+        entries[pk] = rc;
+        ++loaded;
+      }
+    }
+    auto ms = std::chrono::duration_cast< std::chrono::milliseconds >(
+                  std::chrono::steady_clock::now() - started)
+                  .count();
+    llarp::LogInfo("nodedb checked ", files.size(), " RCs in ", ms, "ms, ",
+                   loaded, " valid, ", load.invalid, " invalid");
+    return loaded;
+  }
+
   ssize_t
   loadSubdir(const fs::path &dir)
   {
     ssize_t sz = 0;
-    fs::directory_iterator i(dir);
-#if defined(CPP17) && defined(USE_CXX17_FILESYSTEM)
-    auto itr = fs::begin(i);
-    while(itr != fs::end(i))
-#else
-    auto itr = i.begin();
-    while(itr != itr.end())
-#endif
+    fs::directory_iterator itr(dir), end;
+    while(itr != end)
     {
       if(fs::is_regular_file(itr->path()) && loadfile(*itr))
         sz++;
@@ -257,6 +381,73 @@ struct llarp_nodedb
   */
 };
 
+void
+llarp_nodedb_load::read_batch(void *user)
+{
+  llarp_nodedb_load_batch *batch =
+      static_cast< llarp_nodedb_load_batch * >(user);
+  batch->contents.resize(batch->files.size());
+  for(size_t idx = 0; idx < batch->files.size(); ++idx)
+  {
+    std::ifstream f(batch->files[idx].string(), std::ios::binary);
+    if(!f.is_open())
+      continue;
+    f.seekg(0, std::ios::end);
+    size_t sz = f.tellg();
+    f.seekg(0, std::ios::beg);
+    // anything bigger can't be an rc, leave it empty so it fails decode
+    if(sz > MAX_RC_SIZE)
+      continue;
+    auto &data = batch->contents[idx];
+    data.resize(sz);
+    if(!f.read((char *)data.data(), sz))
+      data.clear();
+  }
+  llarp_threadpool_queue_job(batch->load->worker,
+                             {batch, &llarp_nodedb_load::verify_batch});
+}
+
+void
+llarp_nodedb_load::verify_batch(void *user)
+{
+  llarp_nodedb_load_batch *batch =
+      static_cast< llarp_nodedb_load_batch * >(user);
+  llarp_nodedb_load *load = batch->load;
+  size_t invalid          = 0;
+  for(size_t idx = 0; idx < batch->files.size(); ++idx)
+  {
+    auto &data = batch->contents[idx];
+    llarp_rc rc;
+    llarp::Zero(&rc, sizeof(llarp_rc));
+    llarp_buffer_t buf;
+    buf.base = data.data();
+    buf.cur  = buf.base;
+    buf.sz   = data.size();
+    if(data.empty() || !llarp_rc_bdecode(&rc, &buf))
+    {
+      llarp::LogError("Signature read failed", batch->files[idx]);
+      llarp_rc_free(&rc);
+      ++invalid;
+    }
+    else if(!llarp_rc_verify_sig(load->crypto, &rc))
+    {
+      llarp::LogError("Signature verify failed", batch->files[idx]);
+      llarp_rc_free(&rc);
+      ++invalid;
+    }
+    else
+      batch->rcs.push_back(rc);
+  }
+  // done with the file contents
+  batch->contents.clear();
+  batch->contents.shrink_to_fit();
+  std::unique_lock< std::mutex > lock(load->mutex);
+  load->filesDone += batch->files.size();
+  load->invalid += invalid;
+  ++load->batchesDone;
+  load->cond.notify_one();
+}
+
 // call request hook
 void
 logic_threadworker_callback(void *user)
@@ -386,6 +577,20 @@ llarp_nodedb_load_dir(struct llarp_nodedb *n, const char *dir)
   return n->Load(dir);
 }
 
+ssize_t
+llarp_nodedb_load_dir_parallel(struct llarp_nodedb *n, const char *dir,
+                               struct llarp_threadpool *disk,
+                               struct llarp_threadpool *worker)
+{
+  std::error_code ec;
+  if(!fs::exists(dir, ec))
+  {
+    return -1;
+  }
+  n->nodePath = dir;
+  return n->LoadParallel(dir, disk, worker);
+}
+
 /// c api for nodedb::setRC
 /// maybe better to use llarp_nodedb_async_verify
 bool
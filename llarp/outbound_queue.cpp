@@ -0,0 +1,178 @@
+#include <llarp/outbound_queue.hpp>
+
+namespace llarp
+{
+  constexpr size_t OutboundQueue::DefaultPeerMessages;
+  constexpr size_t OutboundQueue::DefaultPeerBytes;
+  constexpr size_t OutboundQueue::DefaultTotalMessages;
+  constexpr size_t OutboundQueue::DefaultTotalBytes;
+  constexpr size_t OutboundQueue::RelayQuarters;
+
+  OutboundQueue::OutboundQueue(size_t peerMessages, size_t peerBytes,
+                               size_t totalMessages, size_t totalBytes)
+      : m_PeerMessages(peerMessages)
+      , m_PeerBytes(peerBytes)
+      , m_TotalMessages(totalMessages)
+      , m_TotalBytes(totalBytes)
+  {
+  }
+
+  bool
+  OutboundQueue::FitsPeer(const Peer* peer, size_t sz, MessageClass cls) const
+  {
+    size_t quarters = cls == eRelay ? RelayQuarters : 4;
+    size_t messages = peer ? peer->entries.size() : 0;
+    size_t bytes    = peer ? peer->bytes : 0;
+    return (messages + 1) * 4 <= m_PeerMessages * quarters
+        && (bytes + sz) * 4 <= m_PeerBytes * quarters;
+  }
+
+  bool
+  OutboundQueue::FitsTotal(size_t sz, MessageClass cls) const
+  {
+    size_t quarters = cls == eRelay ? RelayQuarters : 4;
+    return (m_Messages + 1) * 4 <= m_TotalMessages * quarters
+        && (m_Bytes + sz) * 4 <= m_TotalBytes * quarters;
+  }
+
+  bool
+  OutboundQueue::Fits(const Peer* peer, size_t sz, MessageClass cls) const
+  {
+    return FitsPeer(peer, sz, cls) && FitsTotal(sz, cls);
+  }
+
+  bool
+  OutboundQueue::EvictRelay(Peer& peer)
+  {
+    for(auto itr = peer.entries.begin(); itr != peer.entries.end(); ++itr)
+    {
+      if(itr->cls != eRelay)
+        continue;
+      peer.bytes -= itr->data.size();
+      m_Bytes -= itr->data.size();
+      --m_Messages;
+      ++dropped;
+      peer.entries.erase(itr);
+      return true;
+    }
+    return false;
+  }
+
+  bool
+  OutboundQueue::MakeRoom(Peer& peer, size_t sz)
+  {
+    // only this router's own relay traffic can make room under its limit
+    while(!FitsPeer(&peer, sz, eControl))
+    {
+      if(!EvictRelay(peer))
+        return false;
+    }
+    while(!FitsTotal(sz, eControl))
+    {
+      // this router's relay traffic goes first, then anyone's
+      if(EvictRelay(peer))
+        continue;
+      bool evicted = false;
+      for(auto& item : m_Peers)
+      {
+        if(EvictRelay(item.second))
+        {
+          evicted = true;
+          break;
+        }
+      }
+      if(!evicted)
+        return false;
+    }
+    return true;
+  }
+
+  bool
+  OutboundQueue::Push(const RouterID& remote, llarp_buffer_t buf,
+                      MessageClass cls)
+  {
+    auto itr   = m_Peers.find(remote);
+    Peer* peer = itr == m_Peers.end() ? nullptr : &itr->second;
+    if(!Fits(peer, buf.sz, cls))
+    {
+      if(cls == eRelay)
+      {
+        ++dropped;
+        return false;
+      }
+      bool added = peer == nullptr;
+      if(added)
+        peer = &m_Peers[remote];
+      if(!MakeRoom(*peer, buf.sz))
+      {
+        // nobody is waiting on a session to a router we only just added
+        if(added)
+          m_Peers.erase(remote);
+        ++dropped;
+        return false;
+      }
+    }
+    if(peer == nullptr)
+      peer = &m_Peers[remote];
+    peer->entries.emplace_back();
+    peer->entries.back().data.assign(buf.base, buf.base + buf.sz);
+    peer->entries.back().cls = cls;
+    peer->bytes += buf.sz;
+    m_Bytes += buf.sz;
+    ++m_Messages;
+    ++queued;
+    return true;
+  }
+
+  size_t
+  OutboundQueue::Flush(const RouterID& remote, Send_t send)
+  {
+    auto itr = m_Peers.find(remote);
+    if(itr == m_Peers.end())
+      return 0;
+    Peer peer;
+    std::swap(peer, itr->second);
+    m_Peers.erase(itr);
+    m_Messages -= peer.entries.size();
+    m_Bytes -= peer.bytes;
+    size_t sent = 0;
+    for(auto& entry : peer.entries)
+    {
+      llarp_buffer_t buf;
+      buf.base = entry.data.data();
+      buf.cur  = buf.base;
+      buf.sz   = entry.data.size();
+      if(send(buf))
+        ++sent;
+      else
+        ++dropped;
+    }
+    flushed += sent;
+    return sent;
+  }
+
+  void
+  OutboundQueue::Discard(const RouterID& remote)
+  {
+    auto itr = m_Peers.find(remote);
+    if(itr == m_Peers.end())
+      return;
+    m_Messages -= itr->second.entries.size();
+    m_Bytes -= itr->second.bytes;
+    dropped += itr->second.entries.size();
+    m_Peers.erase(itr);
+  }
+
+  bool
+  OutboundQueue::Has(const RouterID& remote) const
+  {
+    return m_Peers.find(remote) != m_Peers.end();
+  }
+
+  bool
+  OutboundQueue::Congested(const RouterID& remote, size_t sz) const
+  {
+    auto itr = m_Peers.find(remote);
+    return !Fits(itr == m_Peers.end() ? nullptr : &itr->second, sz, eRelay);
+  }
+}  // namespace llarp
@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <deque>
 #include <llarp/encrypted_frame.hpp>
 #include <llarp/path.hpp>
 #include <llarp/pathbuilder.hpp>
+#include <llarp/relay_batch.hpp>
 #include "buffer.hpp"
 #include "router.hpp"
 
@@ -16,6 +18,8 @@ namespace llarp
 
     PathContext::~PathContext()
     {
+      for(auto hop : m_RetiredHops)
+        delete hop;
     }
 
     void
@@ -134,6 +138,81 @@ namespace llarp
       }
     }
 
+    constexpr size_t TransitHopTable::NumShards;
+
+    bool
+    TransitHopTable::Index(const PathID_t& id, TransitHop* hop)
+    {
+      Shard& shard = ShardFor(id);
+      std::unique_lock< util::SharedMutex > lock(shard.mutex);
+      auto up = shard.hops.emplace(Key{id, hop->info.upstream, true}, hop);
+      auto down =
+          shard.hops.emplace(Key{id, hop->info.downstream, false}, hop);
+      if(up.second && down.second)
+        return true;
+      // leave whatever was there before alone
+      if(up.second)
+        shard.hops.erase(up.first);
+      if(down.second)
+        shard.hops.erase(down.first);
+      return false;
+    }
+
+    void
+    TransitHopTable::Unindex(const PathID_t& id, TransitHop* hop)
+    {
+      Shard& shard = ShardFor(id);
+      std::unique_lock< util::SharedMutex > lock(shard.mutex);
+      for(const auto& k : {Key{id, hop->info.upstream, true},
+                           Key{id, hop->info.downstream, false}})
+      {
+        auto itr = shard.hops.find(k);
+        if(itr != shard.hops.end() && itr->second == hop)
+          shard.hops.erase(itr);
+      }
+    }
+
+    bool
+    TransitHopTable::Put(TransitHop* hop)
+    {
+      if(!Index(hop->info.txID, hop))
+        return false;
+      if(!Index(hop->info.rxID, hop))
+      {
+        Unindex(hop->info.txID, hop);
+        return false;
+      }
+      return true;
+    }
+
+    void
+    TransitHopTable::Remove(TransitHop* hop)
+    {
+      Unindex(hop->info.txID, hop);
+      Unindex(hop->info.rxID, hop);
+    }
+
+    TransitHop*
+    TransitHopTable::Get(const PathID_t& id, const RouterID& remote,
+                         bool upstream)
+    {
+      Shard& shard = ShardFor(id);
+      util::SharedLock lock(shard.mutex);
+      auto itr = shard.hops.find(Key{id, remote, upstream});
+      if(itr == shard.hops.end())
+        return nullptr;
+      return itr->second;
+    }
+
+    bool
+    TransitHopTable::Has(const TransitHopInfo& info)
+    {
+      Shard& shard = ShardFor(info.txID);
+      util::SharedLock lock(shard.mutex);
+      auto itr = shard.hops.find(Key{info.txID, info.upstream, true});
+      return itr != shard.hops.end() && itr->second->info == info;
+    }
+
     void
     PathContext::AddOwnPath(PathSet* set, Path* path)
     {
@@ -145,9 +224,7 @@ namespace llarp
     bool
     PathContext::HasTransitHop(const TransitHopInfo& info)
     {
-      return MapHas(m_TransitPaths, info.txID, [info](TransitHop* hop) -> bool {
-        return info == hop->info;
-      });
+      return m_TransitPaths.Has(info);
     }
 
     IHopHandler*
@@ -164,21 +241,20 @@ namespace llarp
       if(own)
         return own;
 
-      return MapGet(m_TransitPaths, id,
-                    [remote](const TransitHop* hop) -> bool {
-                      return hop->info.upstream == remote;
-                    },
-                    [](TransitHop* h) -> IHopHandler* { return h; });
+      return m_TransitPaths.Get(id, remote, true);
     }
 
     IHopHandler*
     PathContext::GetByDownstream(const RouterID& remote, const PathID_t& id)
     {
-      return MapGet(m_TransitPaths, id,
-                    [remote](const TransitHop* hop) -> bool {
-                      return hop->info.downstream == remote;
-                    },
-                    [](TransitHop* h) -> IHopHandler* { return h; });
+      return m_TransitPaths.Get(id, remote, false);
+    }
+
+    TransitHop*
+    PathContext::GetTransitHop(const RouterID& remote, const PathID_t& id,
+                               bool upstream)
+    {
+      return m_TransitPaths.Get(id, remote, upstream);
     }
 
     PathSet*
@@ -206,36 +282,41 @@ namespace llarp
       return m_Router;
     }
 
-    void
+    bool
     PathContext::PutTransitHop(TransitHop* hop)
     {
-      MapPut(m_TransitPaths, hop->info.txID, hop);
-      MapPut(m_TransitPaths, hop->info.rxID, hop);
+      if(!m_TransitPaths.Put(hop))
+        return false;
+      std::unique_lock< std::mutex > lock(m_TransitExpiryMutex);
+      m_TransitExpiry.emplace(hop->started + hop->lifetime, hop);
+      return true;
     }
 
     void
     PathContext::ExpirePaths()
     {
-      std::unique_lock< std::mutex > lock(m_TransitPaths.first);
-      auto now  = llarp_time_now_ms();
-      auto& map = m_TransitPaths.second;
-      auto itr  = map.begin();
-      std::set< TransitHop* > removePaths;
-      while(itr != map.end())
+      auto now = llarp_time_now_ms();
+      std::vector< TransitHop* > expired;
       {
-        if(itr->second->Expired(now))
+        // only look at the hops that are due
+        std::unique_lock< std::mutex > lock(m_TransitExpiryMutex);
+        auto itr = m_TransitExpiry.begin();
+        while(itr != m_TransitExpiry.end() && itr->second->Expired(now))
         {
-          TransitHop* path = itr->second;
-          llarp::LogDebug("transit path expired ", path->info);
-          removePaths.insert(path);
+          expired.push_back(itr->second);
+          itr = m_TransitExpiry.erase(itr);
         }
-        ++itr;
       }
-      for(auto& p : removePaths)
+      // hops unindexed last tick can't still be in use by a reader that
+      // looked them up before they were removed
+      for(auto hop : m_RetiredHops)
+        delete hop;
+      m_RetiredHops.clear();
+      for(auto hop : expired)
       {
-        map.erase(p->info.txID);
-        map.erase(p->info.rxID);
-        delete p;
+        llarp::LogDebug("transit path expired ", hop->info);
+        m_TransitPaths.Remove(hop);
+        m_RetiredHops.push_back(hop);
       }
       for(auto& builder : m_PathBuilders)
       {
@@ -279,6 +360,104 @@ namespace llarp
       llarp_rc_free(&router);
     }
 
+    constexpr llarp_time_t RateMeter::Window;
+
+    void
+    RateMeter::Add(size_t sz, llarp_time_t now)
+    {
+      if(now - m_WindowStart >= Window)
+      {
+        // a long idle gap spreads the last window out over it
+        auto elapsed  = std::max(Window, now - m_WindowStart);
+        m_LastRate    = m_WindowBytes * 1000 / elapsed;
+        m_WindowStart = now;
+        m_WindowBytes = 0;
+      }
+      m_WindowBytes += sz;
+      total += sz;
+    }
+
+    uint64_t
+    RateMeter::Rate(llarp_time_t now) const
+    {
+      if(now - m_WindowStart >= Window * 2)
+        return 0;
+      return m_LastRate;
+    }
+
+    constexpr uint64_t PathStats::DegradedFactor;
+    constexpr llarp_time_t PathStats::DegradedMargin;
+    constexpr llarp_time_t PathStats::BackoffTime;
+
+    void
+    PathStats::OnLatency(llarp_time_t sample)
+    {
+      latency = sample;
+      if(smoothedLatency == 0)
+        smoothedLatency = sample;
+      else
+        smoothedLatency = (smoothedLatency * 7 + sample) / 8;
+      if(bestLatency == 0 || sample < bestLatency)
+        bestLatency = sample;
+    }
+
+    void
+    PathStats::OnRefused(llarp_time_t now)
+    {
+      ++txRefused;
+      lastRefused = now;
+    }
+
+    bool
+    PathStats::Backoff(llarp_time_t now) const
+    {
+      return txRefused && now - lastRefused < BackoffTime;
+    }
+
+    void
+    PathStats::OnSend(size_t sz, llarp_time_t now)
+    {
+      tx.Add(sz, now);
+      ++txMessages;
+    }
+
+    void
+    PathStats::OnRecv(size_t sz, llarp_time_t now)
+    {
+      rx.Add(sz, now);
+      ++rxMessages;
+    }
+
+    uint64_t
+    PathStats::InFlight(llarp_time_t now) const
+    {
+      // what we sent during the last round trip
+      return tx.Rate(now) * smoothedLatency / 1000;
+    }
+
+    bool
+    PathStats::Degraded() const
+    {
+      if(bestLatency == 0)
+        return false;
+      return smoothedLatency > bestLatency * DegradedFactor
+          && smoothedLatency > bestLatency + DegradedMargin;
+    }
+
+    std::ostream&
+    operator<<(std::ostream& out, const PathStats& stats)
+    {
+      auto now = llarp_time_now_ms();
+      return out << "[latency=" << stats.latency
+                 << " smoothed=" << stats.smoothedLatency
+                 << " best=" << stats.bestLatency
+                 << " tx=" << stats.tx.Rate(now) << "B/s"
+                 << " rx=" << stats.rx.Rate(now) << "B/s"
+                 << " txmsgs=" << stats.txMessages
+                 << " rxmsgs=" << stats.rxMessages
+                 << " refused=" << stats.txRefused << "]";
+    }
+
     Path::Path(llarp_path_hops* h) : hops(h->numHops)
     {
       for(size_t idx = 0; idx < h->numHops; ++idx)
@@ -356,17 +535,21 @@ namespace llarp
     Path::HandleUpstream(llarp_buffer_t buf, const TunnelNonce& Y,
                          llarp_router* r)
     {
+      RelayUpstreamMessage msg;
+      msg.X.Borrow(buf);
+      msg.Y      = Y;
+      msg.pathid = TXID();
+      auto job   = RelayJob::Encode(msg, RelayMessageSize(buf.sz));
+      if(job == nullptr)
+        return false;
+      // every hop's layer, done on the workers
       TunnelNonce n = Y;
       for(const auto& hop : hops)
       {
-        r->crypto.xchacha20(buf, hop.shared, n);
+        job->AddLayer(hop.shared, n);
         n ^= hop.nonceXOR;
       }
-      RelayUpstreamMessage* msg = new RelayUpstreamMessage;
-      msg->X                    = buf;
-      msg->Y                    = Y;
-      msg->pathid               = TXID();
-      return r->SendToOrQueue(Upstream(), msg);
+      return r->QueueRelay(Upstream(), job);
     }
 
     bool
@@ -384,6 +567,7 @@ namespace llarp
     Path::HandleDownstream(llarp_buffer_t buf, const TunnelNonce& Y,
                            llarp_router* r)
     {
+      stats.OnRecv(buf.sz, llarp_time_now_ms());
       TunnelNonce n = Y;
       for(const auto& hop : hops)
       {
@@ -423,8 +607,15 @@ namespace llarp
         r->crypto.randbytes(buf.cur, MESSAGE_PAD_SIZE - buf.sz);
         buf.sz = MESSAGE_PAD_SIZE;
       }
-      buf.cur = buf.base;
-      return HandleUpstream(buf, N, r);
+      buf.cur  = buf.base;
+      auto now = llarp_time_now_ms();
+      if(!HandleUpstream(buf, N, r))
+      {
+        stats.OnRefused(now);
+        return false;
+      }
+      stats.OnSend(buf.sz, now);
+      return true;
     }
 
     bool
@@ -477,6 +668,7 @@ namespace llarp
       if(msg->L == m_LastLatencyTestID && status == ePathEstablished)
       {
         intro.latency = llarp_time_now_ms() - m_LastLatencyTestTime;
+        stats.OnLatency(intro.latency);
         llarp::LogInfo("path latency is ", intro.latency, " ms for tx=", TXID(),
                        " rx=", RXID());
         m_LastLatencyTestID = 0;
@@ -492,7 +684,7 @@ namespace llarp
     bool
     Path::HandleDHTMessage(const llarp::dht::IMessage* msg, llarp_router* r)
     {
-      std::vector< llarp::dht::IMessage* > discard;
+      llarp::dht::MessageList discard;
       auto result = msg->HandleMessage(r->dht, discard);
       for(auto& msg : discard)
         delete msg;
@@ -1,3 +1,4 @@
+#include <llarp/key_pool.hpp>
 #include <llarp/nodedb.h>
 #include <llarp/path.hpp>
 
@@ -5,6 +6,9 @@
 #include "buffer.hpp"
 #include "router.hpp"
 
+#include <atomic>
+#include <vector>
+
 namespace llarp
 {
   template < typename User >
@@ -17,45 +21,72 @@ namespace llarp
     typedef void (*Handler)(AsyncPathKeyExchangeContext< User >*);
     User* user               = nullptr;
     Handler result           = nullptr;
-    size_t idx               = 0;
     llarp_threadpool* worker = nullptr;
     llarp_logic* logic       = nullptr;
     llarp_crypto* crypto     = nullptr;
+    KeyPool* keys            = nullptr;
     LR_CommitMessage* LRCM   = nullptr;
 
+    /// one hop's key exchange, every hop runs at once on the workers
+    struct HopJob
+    {
+      AsyncPathKeyExchangeContext< User >* ctx;
+      size_t idx;
+    };
+    std::vector< HopJob > hopJobs;
+    /// hops not done yet, the last one done joins
+    std::atomic< size_t > remaining;
+    std::atomic< bool > failed;
+
     static void
     HandleDone(void* u)
     {
       AsyncPathKeyExchangeContext< User >* ctx =
           static_cast< AsyncPathKeyExchangeContext< User >* >(u);
+      if(ctx->failed)
+      {
+        llarp::LogError("path build failed, could not generate hop keys");
+        delete ctx->LRCM;
+        delete ctx->path;
+        // hand the job back, it is done with
+        ctx->user->pathBuildStarted(ctx->user);
+        delete ctx;
+        return;
+      }
       ctx->result(ctx);
     }
 
     static void
-    GenerateNextKey(void* u)
+    GenerateHopKey(void* u)
     {
-      AsyncPathKeyExchangeContext< User >* ctx =
-          static_cast< AsyncPathKeyExchangeContext< User >* >(u);
+      HopJob* job = static_cast< HopJob* >(u);
+      auto ctx    = job->ctx;
+      if(!ctx->GenerateKey(job->idx))
+        ctx->failed = true;
+      if(--ctx->remaining == 0)
+        llarp_logic_queue_job(ctx->logic, {ctx, &HandleDone});
+    }
 
+    bool
+    GenerateKey(size_t idx)
+    {
       // current hop
-      auto& hop   = ctx->path->hops[ctx->idx];
-      auto& frame = ctx->LRCM->frames[ctx->idx];
+      auto& hop   = path->hops[idx];
+      auto& frame = LRCM->frames[idx];
       // generate key
-      ctx->crypto->encryption_keygen(hop.commkey);
+      keys->Take(hop.commkey);
       hop.nonce.Randomize();
       // do key exchange
-      if(!ctx->crypto->dh_client(hop.shared, hop.router.enckey, hop.commkey,
-                                 hop.nonce))
+      if(!crypto->dh_client(hop.shared, hop.router.enckey, hop.commkey,
+                            hop.nonce))
       {
         llarp::LogError("Failed to generate shared key for path build");
-        abort();
-        return;
+        return false;
       }
       // generate nonceXOR valueself->hop->pathKey
-      ctx->crypto->shorthash(hop.nonceXOR, llarp::Buffer(hop.shared));
-      ++ctx->idx;
+      crypto->shorthash(hop.nonceXOR, llarp::Buffer(hop.shared));
 
-      bool isFarthestHop = ctx->idx == ctx->path->hops.size();
+      bool isFarthestHop = idx + 1 == path->hops.size();
 
       if(isFarthestHop)
       {
@@ -63,7 +94,7 @@ namespace llarp
       }
       else
       {
-        hop.upstream = ctx->path->hops[ctx->idx].router.pubkey;
+        hop.upstream = path->hops[idx + 1].router.pubkey;
       }
 
       // build record
@@ -82,30 +113,21 @@ namespace llarp
       {
         // failed to encode?
         llarp::LogError("Failed to generate Commit Record");
-        return;
+        return false;
       }
       // use ephameral keypair for frame
       SecretKey framekey;
-      ctx->crypto->encryption_keygen(framekey);
-      if(!frame.EncryptInPlace(framekey, hop.router.enckey, ctx->crypto))
+      keys->Take(framekey);
+      if(!frame.EncryptInPlace(framekey, hop.router.enckey, crypto))
       {
         llarp::LogError("Failed to encrypt LRCR");
-        return;
-      }
-
-      if(isFarthestHop)
-      {
-        // farthest hop
-        llarp_logic_queue_job(ctx->logic, {ctx, &HandleDone});
-      }
-      else
-      {
-        // next hop
-        llarp_threadpool_queue_job(ctx->worker, {ctx, &GenerateNextKey});
+        return false;
       }
+      return true;
     }
 
-    AsyncPathKeyExchangeContext(llarp_crypto* c) : crypto(c)
+    AsyncPathKeyExchangeContext(llarp_crypto* c, KeyPool* k)
+        : crypto(c), keys(k), remaining(0), failed(false)
     {
     }
 
@@ -126,7 +148,16 @@ namespace llarp
         LRCM->frames.emplace_back();
         LRCM->frames.back().Randomize();
       }
-      llarp_threadpool_queue_job(pool, {this, &GenerateNextKey});
+      // hops don't depend on each other, do them all at once
+      size_t numHops = path->hops.size();
+      remaining      = numHops;
+      std::vector< llarp_thread_job > jobs;
+      for(size_t idx = 0; idx < numHops; ++idx)
+        hopJobs.push_back({this, idx});
+      for(auto& job : hopJobs)
+        jobs.push_back({&job, &GenerateHopKey});
+      llarp_threadpool_queue_jobs(pool, jobs.data(), jobs.size());
+      keys->MaybeRefill(pool);
     }
   };
 
@@ -139,12 +170,17 @@ namespace llarp
     if(!router->SendToOrQueue(remote, ctx->LRCM))
     {
       llarp::LogError("failed to send LRCM");
+      // SendToOrQueue took the LRCM either way
+      delete ctx->path;
+      ctx->user->pathBuildStarted(ctx->user);
+      delete ctx;
       return;
     }
     ctx->path->status       = llarp::path::ePathBuilding;
     ctx->path->buildStarted = llarp_time_now_ms();
     router->paths.AddOwnPath(ctx->pathset, ctx->path);
     ctx->user->pathBuildStarted(ctx->user);
+    delete ctx;
   }
 
   void
@@ -171,10 +207,10 @@ namespace llarp
     // async generate keys
     AsyncPathKeyExchangeContext< llarp_pathbuild_job >* ctx =
         new AsyncPathKeyExchangeContext< llarp_pathbuild_job >(
-            &job->router->crypto);
+            &job->router->crypto, &job->router->keyPool);
     ctx->pathset = job->context;
     auto path    = new llarp::path::Path(&job->hops);
-    path->SetBuildResultHook(std::bind(&llarp::path::PathSet::HandlePathBuilt,
+    path->SetBuildResultHook(std::bind(&llarp::path::PathSet::PathConfirmed,
                                        ctx->pathset, std::placeholders::_1));
     ctx->AsyncGenerateKeys(path, job->router->logic, job->router->tp, job,
                            &pathbuilder_generated_keys);
@@ -183,8 +219,11 @@ namespace llarp
 
 llarp_pathbuilder_context::llarp_pathbuilder_context(
     llarp_router* p_router, struct llarp_dht_context* p_dht, size_t pathNum,
-    size_t hops)
-    : llarp::path::PathSet(pathNum), router(p_router), dht(p_dht), numHops(hops)
+    size_t hops, size_t spareNum)
+    : llarp::path::PathSet(pathNum, spareNum)
+    , router(p_router)
+    , dht(p_dht)
+    , numHops(hops)
 {
   p_router->paths.AddPathBuilder(this);
   p_router->crypto.encryption_keygen(enckey);
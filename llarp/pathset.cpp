@@ -1,20 +1,51 @@
+#include <llarp/crypto.h>
 #include <llarp/dht/messages/pubintro.hpp>
 #include <llarp/messages/dht.hpp>
 #include <llarp/path.hpp>
 #include <llarp/pathset.hpp>
 
+#include <algorithm>
+
 namespace llarp
 {
   namespace path
   {
-    PathSet::PathSet(size_t num) : m_NumPaths(num)
+    constexpr llarp_time_t PathSet::RefreshMargin;
+
+    PathSet::PathSet(size_t num, size_t spares)
+        : m_NumPaths(num), m_NumSpares(spares)
+    {
+    }
+
+    bool
+    PathSet::IsUsable(const Path* path)
     {
+      return path->role == ePathActive && path->IsReady();
+    }
+
+    bool
+    PathSet::IsFresh(const Path* path, llarp_time_t now)
+    {
+      return path->status == ePathEstablished && now < path->refreshAt
+          && !path->stats.Degraded();
     }
 
     bool
     PathSet::ShouldBuildMore() const
     {
-      return m_Paths.size() < m_NumPaths;
+      // count what will still be around after the next refresh, paths due
+      // for one get their replacement built while they keep working
+      auto now    = llarp_time_now_ms();
+      size_t live = 0;
+      for(const auto& item : m_Paths)
+      {
+        const Path* path = item.second;
+        if(path->role == ePathRetired)
+          continue;
+        if(path->status == ePathBuilding || IsFresh(path, now))
+          ++live;
+      }
+      return live < m_NumPaths + m_NumSpares;
     }
 
     void
@@ -27,6 +58,7 @@ namespace llarp
           item.second->Tick(now, r);
         }
       }
+      RotatePaths(now);
     }
 
     void
@@ -43,6 +75,99 @@ namespace llarp
         else
           ++itr;
       }
+      // fill in for whatever went away without waiting on a build
+      PromoteSpares(now);
+    }
+
+    void
+    PathSet::PathConfirmed(Path* path)
+    {
+      auto now      = llarp_time_now_ms();
+      auto lifetime = path->hops[0].lifetime;
+      // refresh somewhere in the last quarter before the margin
+      llarp_time_t jitter = 0;
+      if(lifetime > RefreshMargin * 4)
+        jitter = llarp_randint() % (lifetime / 4);
+      path->refreshAt = lifetime > RefreshMargin
+          ? path->buildStarted + lifetime - RefreshMargin - jitter
+          : path->buildStarted;
+      path->role = NumInRole(ePathActive) < m_NumPaths ? ePathActive
+                                                        : ePathSpare;
+      llarp::LogDebug("path tx=", path->TXID(), " built as ",
+                      path->role == ePathActive ? "active" : "spare",
+                      " refresh in ", path->refreshAt - now, "ms");
+      HandlePathBuilt(path);
+    }
+
+    size_t
+    PathSet::NumInRole(PathRole role) const
+    {
+      size_t count = 0;
+      for(const auto& item : m_Paths)
+      {
+        const Path* path = item.second;
+        if(path->role == role && path->status == ePathEstablished)
+          ++count;
+      }
+      return count;
+    }
+
+    Path*
+    PathSet::GetBestSpare(llarp_time_t now) const
+    {
+      Path* best = nullptr;
+      for(const auto& item : m_Paths)
+      {
+        Path* path = item.second;
+        if(path->role != ePathSpare || path->status != ePathEstablished
+           || path->Expired(now))
+          continue;
+        // ready ones first, then the newest
+        if(best == nullptr || (path->IsReady() && !best->IsReady())
+           || (path->IsReady() == best->IsReady()
+               && path->buildStarted > best->buildStarted))
+          best = path;
+      }
+      return best;
+    }
+
+    void
+    PathSet::PromoteSpares(llarp_time_t now)
+    {
+      size_t active = NumInRole(ePathActive);
+      while(active < m_NumPaths)
+      {
+        Path* spare = GetBestSpare(now);
+        if(spare == nullptr)
+          return;
+        llarp::LogInfo("promoting spare path tx=", spare->TXID());
+        spare->role = ePathActive;
+        ++active;
+      }
+    }
+
+    void
+    PathSet::RotatePaths(llarp_time_t now)
+    {
+      for(auto& item : m_Paths)
+      {
+        Path* path = item.second;
+        if(path->role != ePathActive || IsFresh(path, now))
+          continue;
+        if(path->status != ePathEstablished)
+          continue;
+        Path* spare = GetBestSpare(now);
+        if(spare == nullptr || !IsFresh(spare, now))
+          return;
+        if(path->stats.Degraded())
+          llarp::LogInfo("moving off degraded path tx=", path->TXID(), " ",
+                         path->stats);
+        llarp::LogDebug("rotating path tx=", path->TXID(), " to tx=",
+                        spare->TXID());
+        spare->role = ePathActive;
+        path->role  = ePathRetired;
+      }
+      PromoteSpares(now);
     }
 
     Path*
@@ -53,7 +178,7 @@ namespace llarp
       dist.Fill(0xff);
       for(const auto& item : m_Paths)
       {
-        if(!item.second->IsReady())
+        if(!IsUsable(item.second))
           continue;
         AlignedBuffer< 32 > localDist = item.second->Endpoint() ^ id;
         if(localDist < dist)
@@ -68,17 +193,13 @@ namespace llarp
     Path*
     PathSet::GetPathByRouter(const RouterID& id) const
     {
-      auto itr = m_Paths.begin();
-      while(itr != m_Paths.end())
+      std::vector< Path* > candidates;
+      for(const auto& item : m_Paths)
       {
-        if(itr->second->IsReady())
-        {
-          if(itr->second->Endpoint() == id)
-            return itr->second;
-        }
-        ++itr;
+        if(IsUsable(item.second) && item.second->Endpoint() == id)
+          candidates.push_back(item.second);
       }
-      return nullptr;
+      return PickWeighted(candidates, llarp_time_now_ms());
     }
 
     size_t
@@ -134,7 +255,7 @@ namespace llarp
       auto itr     = m_Paths.begin();
       while(itr != m_Paths.end())
       {
-        if(itr->second->IsReady())
+        if(IsUsable(itr->second))
         {
           intros.insert(itr->second->intro);
           ++count;
@@ -145,23 +266,90 @@ namespace llarp
     }
 
     Path*
-    PathSet::PickRandomEstablishedPath() const
+    PathSet::PickEstablishedPath() const
     {
-      std::vector< Path* > established;
-      auto itr = m_Paths.begin();
-      while(itr != m_Paths.end())
+      std::vector< Path* > candidates;
+      for(const auto& item : m_Paths)
       {
-        if(itr->second->IsReady())
-          established.push_back(itr->second);
-        ++itr;
+        if(IsUsable(item.second))
+          candidates.push_back(item.second);
       }
-      auto sz = established.size();
-      if(sz)
+      return PickWeighted(candidates, llarp_time_now_ms());
+    }
+
+    void
+    PathSet::ForEachPath(std::function< void(const Path*) > visit) const
+    {
+      for(const auto& item : m_Paths)
+        visit(item.second);
+    }
+
+    constexpr uint64_t PathSet::LoadUnit;
+    constexpr llarp_time_t PathSet::DefaultLatency;
+
+    llarp_time_t
+    PathSet::Latency(const Path* path)
+    {
+      // the build time in intro.latency includes hop crypto, it doesn't
+      // compare with probed round trips
+      return path->stats.smoothedLatency;
+    }
+
+    double
+    PathSet::Weight(const Path* path, llarp_time_t now, llarp_time_t unprobed)
+    {
+      llarp_time_t latency = Latency(path);
+      if(latency == 0)
+        latency = unprobed;
+      // expected delay grows with what is already queued on the path
+      double load = 1.0 + double(path->stats.InFlight(now)) / LoadUnit;
+      return 1.0 / (double(latency) * load);
+    }
+
+    Path*
+    PathSet::PickWeighted(const std::vector< Path* >& candidates,
+                          llarp_time_t now)
+    {
+      // stay off degraded and backed up paths unless that's all we have
+      std::vector< Path* > healthy;
+      for(const auto& path : candidates)
       {
-        return established[llarp_randint() % sz];
+        if(!path->stats.Degraded() && !path->stats.Backoff(now))
+          healthy.push_back(path);
       }
-      else
+      const auto& pick = healthy.empty() ? candidates : healthy;
+      if(pick.empty())
         return nullptr;
+      // paths not probed yet count as the median of the ones that were, so
+      // a fresh path doesn't take all the traffic before we know anything
+      std::vector< llarp_time_t > measured;
+      for(const auto& path : pick)
+      {
+        if(Latency(path))
+          measured.push_back(Latency(path));
+      }
+      llarp_time_t unprobed = DefaultLatency;
+      if(measured.size())
+      {
+        auto mid = measured.begin() + measured.size() / 2;
+        std::nth_element(measured.begin(), mid, measured.end());
+        unprobed = *mid;
+      }
+      std::vector< double > weights;
+      double total = 0.0;
+      for(const auto& path : pick)
+      {
+        weights.push_back(Weight(path, now, unprobed));
+        total += weights.back();
+      }
+      double r = total * double(llarp_randint() % 1000000) / 1000000.0;
+      for(size_t idx = 0; idx < pick.size(); ++idx)
+      {
+        if(r < weights[idx])
+          return pick[idx];
+        r -= weights[idx];
+      }
+      return pick.back();
     }
 
   }  // namespace path
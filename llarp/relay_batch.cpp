@@ -0,0 +1,223 @@
+#include <llarp/buffer_pool.hpp>
+#include <llarp/messages/relay.hpp>
+#include <llarp/relay_batch.hpp>
+#include "logger.hpp"
+
+#include <algorithm>
+#include <new>
+
+namespace llarp
+{
+  namespace path
+  {
+    RelayJob*
+    RelayJob::New(size_t sz)
+    {
+      void* ptr = BufferPool::Alloc(sizeof(RelayJob) + sz);
+      if(ptr == nullptr)
+        return nullptr;
+      return new(ptr) RelayJob(sz);
+    }
+
+    RelayJob*
+    RelayJob::Copy(llarp_buffer_t msg)
+    {
+      RelayJob* job = New(msg.sz);
+      if(job)
+        memcpy(job->data(), msg.base, msg.sz);
+      return job;
+    }
+
+    RelayJob*
+    RelayJob::Encode(const ILinkMessage& msg, size_t maxsz)
+    {
+      RelayJob* job = New(maxsz);
+      if(job == nullptr)
+        return nullptr;
+      auto buf = job->Buffer();
+      RelayView view;
+      if(!msg.BEncode(&buf))
+      {
+        llarp::LogWarn("failed to encode relay message");
+        delete job;
+        return nullptr;
+      }
+      job->sz = buf.cur - buf.base;
+      if(!ParseRelayInPlace(job->Buffer(), view))
+      {
+        delete job;
+        return nullptr;
+      }
+      job->SetPayload(view.X.base - job->data(), view.X.sz);
+      return job;
+    }
+
+    void
+    RelayJob::operator delete(void* ptr)
+    {
+      BufferPool::Free(ptr);
+    }
+
+    llarp_buffer_t
+    RelayJob::Buffer()
+    {
+      llarp_buffer_t buf;
+      buf.base = data();
+      buf.cur  = buf.base;
+      buf.sz   = sz;
+      return buf;
+    }
+
+    void
+    RelayJob::SetPayload(size_t offset, size_t size)
+    {
+      payloadOffset = offset;
+      payloadSize   = size;
+    }
+
+    bool
+    RelayJob::AddLayer(const SharedSecret& key, const TunnelNonce& nonce)
+    {
+      if(numLayers == layers.size())
+        return false;
+      layers[numLayers].key   = key;
+      layers[numLayers].nonce = nonce;
+      ++numLayers;
+      return true;
+    }
+
+    void
+    RelayJob::Apply(llarp_crypto* crypto)
+    {
+      llarp_buffer_t x;
+      x.base = data() + payloadOffset;
+      x.cur  = x.base;
+      x.sz   = payloadSize;
+      for(size_t idx = 0; idx < numLayers; ++idx)
+        crypto->xchacha20(x, layers[idx].key, layers[idx].nonce);
+    }
+
+    constexpr size_t RelayBatcher::MaxBatch;
+    constexpr size_t RelayBatcher::ChunkSize;
+    constexpr llarp_time_t RelayBatcher::Window;
+
+    RelayBatcher::RelayBatcher(llarp_logic* logic, llarp_threadpool* worker,
+                               llarp_crypto* crypto, Send_t send)
+        : m_Logic(logic), m_Worker(worker), m_Crypto(crypto), m_Send(send)
+    {
+    }
+
+    RelayBatcher::~RelayBatcher()
+    {
+      if(m_WindowSet)
+        llarp_logic_remove_call(m_Logic, m_WindowJob);
+      for(auto& item : m_Peers)
+      {
+        for(auto job : item.second.pending)
+          delete job;
+      }
+    }
+
+    void
+    RelayBatcher::Queue(const RouterID& next, RelayJob* job)
+    {
+      Peer& peer = m_Peers[next];
+      peer.pending.push_back(job);
+      ++m_Pending;
+      if(peer.busy)
+        return;
+      if(peer.pending.size() >= MaxBatch)
+        Dispatch(next, peer);
+      else if(!m_WindowSet)
+      {
+        m_WindowSet = true;
+        m_WindowJob =
+            llarp_logic_call_later(m_Logic, {Window, this, &HandleWindow});
+      }
+    }
+
+    void
+    RelayBatcher::Flush()
+    {
+      for(auto& item : m_Peers)
+      {
+        if(!item.second.busy && item.second.pending.size())
+          Dispatch(item.first, item.second);
+      }
+    }
+
+    void
+    RelayBatcher::Dispatch(const RouterID& next, Peer& peer)
+    {
+      Batch* batch = new Batch;
+      batch->self  = this;
+      batch->next  = next;
+      batch->jobs.swap(peer.pending);
+      peer.busy = true;
+      ++batches;
+      size_t num = batch->jobs.size();
+      for(size_t begin = 0; begin < num; begin += ChunkSize)
+        batch->chunks.push_back(
+            {batch, begin, std::min(begin + ChunkSize, num)});
+      batch->remaining = batch->chunks.size();
+      std::vector< llarp_thread_job > work;
+      work.reserve(batch->chunks.size());
+      for(auto& chunk : batch->chunks)
+        work.push_back({&chunk, &HandleChunk});
+      llarp_threadpool_queue_jobs(m_Worker, work.data(), work.size());
+    }
+
+    void
+    RelayBatcher::HandleChunk(void* user)
+    {
+      Chunk* chunk = static_cast< Chunk* >(user);
+      Batch* batch = chunk->batch;
+      auto crypto  = batch->self->m_Crypto;
+      for(size_t idx = chunk->begin; idx < chunk->end; ++idx)
+        batch->jobs[idx]->Apply(crypto);
+      // the last chunk done hands the batch back to the logic thread
+      if(--batch->remaining == 0)
+        llarp_logic_queue_job(batch->self->m_Logic, {batch, &HandleBatchDone});
+    }
+
+    void
+    RelayBatcher::HandleBatchDone(void* user)
+    {
+      Batch* batch = static_cast< Batch* >(user);
+      batch->self->Finish(batch);
+    }
+
+    void
+    RelayBatcher::Finish(Batch* batch)
+    {
+      for(auto job : batch->jobs)
+      {
+        m_Send(batch->next, job->Buffer());
+        delete job;
+      }
+      m_Pending -= batch->jobs.size();
+      relayed += batch->jobs.size();
+      auto itr = m_Peers.find(batch->next);
+      delete batch;
+      if(itr == m_Peers.end())
+        return;
+      Peer& peer = itr->second;
+      peer.busy  = false;
+      // whatever queued up while we were busy goes now, it already waited
+      if(peer.pending.size())
+        Dispatch(itr->first, peer);
+      else
+        m_Peers.erase(itr);
+    }
+
+    void
+    RelayBatcher::HandleWindow(void* user, uint64_t orig, uint64_t left)
+    {
+      if(left)
+        return;
+      RelayBatcher* self = static_cast< RelayBatcher* >(user);
+      self->m_WindowSet  = false;
+      self->Flush();
+    }
+  }  // namespace path
+}  // namespace llarp
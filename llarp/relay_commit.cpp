@@ -267,7 +267,14 @@ namespace llarp
       // TODO: check if we really want to accept it
       self->hop->started = llarp_time_now_ms();
       llarp::LogDebug("Accepted ", self->hop->info);
-      self->context->PutTransitHop(self->hop);
+      if(!self->context->PutTransitHop(self->hop))
+      {
+        // raced with another LRCM for the same path ids
+        llarp::LogError("duplicate transit hop ", info);
+        delete self->hop;
+        delete self;
+        return;
+      }
 
       size_t sz = self->frames.front().size();
       // we pop the front element it was ours
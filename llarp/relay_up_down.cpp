@@ -5,6 +5,80 @@
 
 namespace llarp
 {
+  namespace
+  {
+    /// read a 1 byte key and check it is k
+    bool
+    ReadRelayKey(llarp_buffer_t* buf, char k)
+    {
+      llarp_buffer_t key;
+      if(!bencode_read_string(buf, &key) || key.sz != 1 || *key.base != k)
+        return false;
+      // the value must start inside the buffer
+      return llarp_buffer_size_left(*buf) > 0;
+    }
+  }  // namespace
+
+  bool
+  ParseRelayInPlace(llarp_buffer_t buf, RelayView& view)
+  {
+    llarp_buffer_t str;
+    uint64_t ver;
+    if(llarp_buffer_size_left(buf) == 0 || *buf.cur != 'd')
+      return false;
+    buf.cur++;
+    if(!ReadRelayKey(&buf, 'a') || !bencode_read_string(&buf, &str)
+       || str.sz != 1)
+      return false;
+    view.type = *str.base;
+    if(view.type != 'u' && view.type != 'd')
+      return false;
+    if(!ReadRelayKey(&buf, 'p') || !bencode_read_string(&buf, &str)
+       || str.sz != PATHIDSIZE)
+      return false;
+    view.pathid = str.base;
+    if(!ReadRelayKey(&buf, 'v') || !bencode_read_integer(&buf, &ver)
+       || ver != LLARP_PROTO_VERSION)
+      return false;
+    if(!ReadRelayKey(&buf, 'x') || !bencode_read_string(&buf, &view.X))
+      return false;
+    if(!ReadRelayKey(&buf, 'y') || !bencode_read_string(&buf, &str)
+       || str.sz != TUNNONCESIZE)
+      return false;
+    view.Y = str.base;
+    return llarp_buffer_size_left(buf) > 0 && *buf.cur == 'e';
+  }
+
+  size_t
+  RelayMessageSize(size_t sz)
+  {
+    // 1 byte keys, each as a string
+    const size_t key = bencode_size_bytestring(1);
+    return 1 + key + bencode_size_bytestring(1) + key
+        + bencode_size_bytestring(PATHIDSIZE) + key
+        + bencode_size_uint64(LLARP_PROTO_VERSION) + key
+        + bencode_size_bytestring(sz) + key
+        + bencode_size_bytestring(TUNNONCESIZE) + 1;
+  }
+
+  ILinkMessage*
+  RelayView::NewMessage() const
+  {
+    if(type == 'u')
+    {
+      RelayUpstreamMessage* msg = new RelayUpstreamMessage;
+      msg->pathid               = pathid;
+      msg->Y                    = Y;
+      msg->X                    = X;
+      return msg;
+    }
+    RelayDownstreamMessage* msg = new RelayDownstreamMessage;
+    msg->pathid                 = pathid;
+    msg->Y                      = Y;
+    msg->X                      = X;
+    return msg;
+  }
+
   RelayUpstreamMessage::RelayUpstreamMessage(const RouterID &from)
       : ILinkMessage(from)
   {
@@ -46,7 +120,8 @@ namespace llarp
     if(!BEncodeMaybeReadVersion("v", version, LLARP_PROTO_VERSION, read, key,
                                 buf))
       return false;
-    if(!BEncodeMaybeReadDictEntry("x", X, read, key, buf))
+    // X stays in the link buffer, we are handled before it goes away
+    if(!BEncodeMaybeReadDictBorrowed("x", X, read, key, buf))
       return false;
     if(!BEncodeMaybeReadDictEntry("y", Y, read, key, buf))
       return false;
@@ -108,7 +183,8 @@ namespace llarp
     if(!BEncodeMaybeReadVersion("v", version, LLARP_PROTO_VERSION, read, key,
                                 buf))
       return false;
-    if(!BEncodeMaybeReadDictEntry("x", X, read, key, buf))
+    // X stays in the link buffer, we are handled before it goes away
+    if(!BEncodeMaybeReadDictBorrowed("x", X, read, key, buf))
       return false;
     if(!BEncodeMaybeReadDictEntry("y", Y, read, key, buf))
       return false;
@@ -30,6 +30,7 @@ namespace llarp
 
 llarp_router::llarp_router()
     : ready(false)
+    , keyPool(&crypto)
     , paths(this)
     , dht(llarp_dht_context_new(this))
     , inbound_link_msg_parser(this)
@@ -80,20 +81,44 @@ llarp_router::SendToOrQueue(const llarp::RouterID &remote,
     delete msg;
     return true;
   }
-  // this will create an entry in the obmq if it's not already there
-  auto itr = outboundMesssageQueue.find(remote);
-  if(itr == outboundMesssageQueue.end())
+  // no session yet, queue it encoded
+  auto buf = llarp::StackBuffer< decltype(linkmsg_buffer) >(linkmsg_buffer);
+
+  bool encoded = msg->BEncode(&buf);
+  delete msg;
+  if(!encoded)
   {
-    outboundMesssageQueue.insert(std::make_pair(remote, MessageQueue()));
+    llarp::LogWarn("failed to encode outbound message, buffer size left: ",
+                   llarp_buffer_size_left(buf));
+    return false;
   }
-  outboundMesssageQueue[remote].push(msg);
+  buf.sz  = buf.cur - buf.base;
+  buf.cur = buf.base;
+  return QueueOutbound(remote, buf, llarp::OutboundQueue::eControl);
+}
+
+bool
+llarp_router::QueueOutbound(const llarp::RouterID &remote, llarp_buffer_t buf,
+                            llarp::OutboundQueue::MessageClass cls)
+{
+  // anything already queued means we are already getting a session
+  bool first = !outboundQueue.Has(remote);
+  if(!outboundQueue.Push(remote, buf, cls))
+  {
+    llarp::LogWarn("outbound queue full, dropped ",
+                   cls == llarp::OutboundQueue::eRelay ? "relay" : "control",
+                   " message to ", remote);
+    return false;
+  }
+  if(!first)
+    return true;
 
   // we don't have an open session to that router right now
   auto rc = llarp_nodedb_get_rc(nodedb, remote);
   if(rc)
   {
     // try connecting directly as the rc is loaded from disk
-    llarp_router_try_connect(this, rc, 10);
+    TryConnectOrDiscard(rc);
     return true;
   }
 
@@ -152,7 +177,7 @@ llarp_router::HandleDHTLookupForSendTo(llarp_router_lookup_job *job)
   llarp_router *self = static_cast< llarp_router * >(job->user);
   if(job->found)
   {
-    llarp_router_try_connect(self, &job->result, 10);
+    self->TryConnectOrDiscard(&job->result);
   }
   else
   {
@@ -367,6 +392,11 @@ llarp_router::Tick()
   // llarp::LogDebug("tick router");
 
   paths.ExpirePaths();
+  keyPool.MaybeRefill(tp);
+  llarp::LogDebug("outbound queue has ", outboundQueue.Messages(),
+                  " messages, ", outboundQueue.Bytes(), " bytes. queued ",
+                  outboundQueue.queued, " dropped ", outboundQueue.dropped,
+                  " flushed ", outboundQueue.flushed);
   // TODO: don't do this if we have enough paths already
   // FIXME: build paths even if we have inbound links
   if(inboundLinks.size() == 0)
@@ -420,6 +450,40 @@ llarp_router::SendTo(llarp::RouterID remote, const llarp::ILinkMessage *msg,
   }
 }
 
+bool
+llarp_router::SendRawTo(const llarp::RouterID &remote, llarp_buffer_t buf)
+{
+  llarp_link *link = GetLinkWithSessionByPubkey(remote);
+  if(link == nullptr)
+    return false;
+  buf.cur = buf.base;
+  return link->sendto(remote, buf);
+}
+
+bool
+llarp_router::SendRelayTo(const llarp::RouterID &remote, llarp_buffer_t buf)
+{
+  if(SendRawTo(remote, buf))
+    return true;
+  return QueueOutbound(remote, buf, llarp::OutboundQueue::eRelay);
+}
+
+bool
+llarp_router::QueueRelay(const llarp::RouterID &remote,
+                         llarp::path::RelayJob *job)
+{
+  // push back on the sender rather than queue what we would drop later
+  if(outboundQueue.Congested(remote, job->sz)
+     && GetLinkWithSessionByPubkey(remote) == nullptr)
+  {
+    ++outboundQueue.dropped;
+    delete job;
+    return false;
+  }
+  relayBatcher->Queue(remote, job);
+  return true;
+}
+
 void
 llarp_router::ScheduleTicker(uint64_t ms)
 {
@@ -458,40 +522,18 @@ llarp_router::FlushOutboundFor(const llarp::RouterID &remote,
                                llarp_link *chosen)
 {
   llarp::LogDebug("Flush outbound for ", remote);
-  auto itr = outboundMesssageQueue.find(remote);
-  if(itr == outboundMesssageQueue.end())
-  {
-    return;
-  }
   if(!chosen)
   {
     DiscardOutboundFor(remote);
     return;
   }
-  while(itr->second.size())
-  {
-    auto buf = llarp::StackBuffer< decltype(linkmsg_buffer) >(linkmsg_buffer);
-
-    auto &msg = itr->second.front();
-
-    if(!msg->BEncode(&buf))
-    {
-      llarp::LogWarn("failed to encode outbound message, buffer size left: ",
-                     llarp_buffer_size_left(buf));
-      delete msg;
-      itr->second.pop();
-      continue;
-    }
-    // set size of message
-    buf.sz  = buf.cur - buf.base;
-    buf.cur = buf.base;
-    if(!chosen->sendto(remote, buf))
-      llarp::LogWarn("failed to send outboud message to ", remote, " via ",
-                     chosen->name());
-
-    delete msg;
-    itr->second.pop();
-  }
+  outboundQueue.Flush(remote, [&](llarp_buffer_t buf) -> bool {
+    if(chosen->sendto(remote, buf))
+      return true;
+    llarp::LogWarn("failed to send outboud message to ", remote, " via ",
+                   chosen->name());
+    return false;
+  });
 }
 
 void
@@ -527,16 +569,20 @@ llarp_router::on_try_connect_result(llarp_link_establish_job *job)
   }
 }
 
+void
+llarp_router::TryConnectOrDiscard(llarp_rc *rc)
+{
+  if(llarp_router_try_connect(this, rc, 10))
+    return;
+  // a connect already underway flushes or discards the queue when it ends
+  if(!HasPendingConnectJob(rc->pubkey))
+    DiscardOutboundFor(rc->pubkey);
+}
+
 void
 llarp_router::DiscardOutboundFor(const llarp::RouterID &remote)
 {
-  auto &queue = outboundMesssageQueue[remote];
-  while(queue.size())
-  {
-    delete queue.front();
-    queue.pop();
-  }
-  outboundMesssageQueue.erase(remote);
+  outboundQueue.Discard(remote);
 }
 
 bool
@@ -669,6 +715,7 @@ llarp_router::Run()
       llarp::seckey_topublic(identity), ftmp);
   llarp::LogInfo("Your Identity pubkey ", hexKey);
 
+  rc.last_updated = llarp_time_now_ms();
   llarp_rc_sign(&crypto, identity, &rc);
 
   if(!SaveRC())
@@ -786,6 +833,11 @@ llarp_init_router(struct llarp_threadpool *tp, struct llarp_ev_loop *netloop,
     router->netloop = netloop;
     router->tp      = tp;
     router->logic   = logic;
+    router->relayBatcher.reset(new llarp::path::RelayBatcher(
+        logic, tp, &router->crypto,
+        [router](const llarp::RouterID &remote, llarp_buffer_t buf) {
+          router->SendRelayTo(remote, buf);
+        }));
 // TODO: make disk io threadpool count configurable
 #ifdef TESTNET
     router->disk = tp;
@@ -1007,6 +1059,13 @@ llarp_free_router(struct llarp_router **router)
   *router = nullptr;
 }
 
+void
+llarp_router_add_netloop(struct llarp_router *router,
+                         struct llarp_ev_loop *netloop)
+{
+  router->shardloops.push_back(netloop);
+}
+
 void
 llarp_router_override_path_selection(struct llarp_router *router,
                                      llarp_pathbuilder_select_hop_func func)
@@ -1132,6 +1191,7 @@ namespace llarp
         if(link)
         {
           llarp::LogInfo("link ", key, " initialized");
+          link->shardloops = self->shardloops;
           if(link->configure(self->netloop, key, af, proto))
           {
             self->AddInboundLink(link);
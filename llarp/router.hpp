@@ -8,10 +8,15 @@
 #include <functional>
 #include <list>
 #include <map>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include <llarp/dht.hpp>
+#include <llarp/key_pool.hpp>
 #include <llarp/link_message.hpp>
+#include <llarp/outbound_queue.hpp>
+#include <llarp/relay_batch.hpp>
 #include <llarp/routing/handler.hpp>
 #include <llarp/service.hpp>
 #include "llarp/iwp/establish_job.hpp"
@@ -69,9 +74,13 @@ struct llarp_router
   llarp_ai addrInfo;
 
   llarp_ev_loop *netloop;
+  /// extra event loops that inbound links shard their sockets over
+  std::vector< llarp_ev_loop * > shardloops;
   llarp_threadpool *tp;
   llarp_logic *logic;
   llarp_crypto crypto;
+  /// ephemeral keys for path builds
+  llarp::KeyPool keyPool;
   llarp::path::PathContext paths;
   llarp::SecretKey identity;
   llarp::SecretKey encryption;
@@ -89,6 +98,8 @@ struct llarp_router
   uint32_t ticker_job_id = 0;
 
   llarp::InboundMessageParser inbound_link_msg_parser;
+  /// onion crypto for relayed messages, on the worker pool
+  std::unique_ptr< llarp::path::RelayBatcher > relayBatcher;
   llarp::routing::InboundMessageParser inbound_routing_msg_parser;
 
   llarp_pathbuilder_select_hop_func selectHopFunc = nullptr;
@@ -99,10 +110,8 @@ struct llarp_router
   llarp_link *outboundLink = nullptr;
   std::list< llarp_link * > inboundLinks;
 
-  typedef std::queue< const llarp::ILinkMessage * > MessageQueue;
-
-  /// outbound message queue
-  std::map< llarp::RouterID, MessageQueue > outboundMesssageQueue;
+  /// encoded messages waiting on a session, bounded
+  llarp::OutboundQueue outboundQueue;
 
   /// loki verified routers
   std::map< llarp::RouterID, llarp_rc > validRouters;
@@ -177,6 +186,27 @@ struct llarp_router
   SendTo(llarp::RouterID remote, const llarp::ILinkMessage *msg,
          llarp_link *chosen = nullptr);
 
+  /// send an already encoded link message if we have a session to remote
+  /// returns false without queuing anything if we don't
+  bool
+  SendRawTo(const llarp::RouterID &remote, llarp_buffer_t buf);
+
+  /// send an encoded relay message or queue it if we have no session
+  bool
+  SendRelayTo(const llarp::RouterID &remote, llarp_buffer_t buf);
+
+  /// do job's onion layers on the workers then send it to remote
+  /// takes ownership of job
+  /// returns false and drops job if the queue to remote is congested
+  bool
+  QueueRelay(const llarp::RouterID &remote, llarp::path::RelayJob *job);
+
+  /// queue an encoded message until we have a session to remote and start
+  /// getting one if we aren't already, returns false if it was dropped
+  bool
+  QueueOutbound(const llarp::RouterID &remote, llarp_buffer_t buf,
+                llarp::OutboundQueue::MessageClass cls);
+
   /// manually flush outbound message queue for just 1 router
   void
   FlushOutboundFor(const llarp::RouterID &remote, llarp_link *chosen);
@@ -185,6 +215,11 @@ struct llarp_router
   void
   DiscardOutboundFor(const llarp::RouterID &remote);
 
+  /// connect to rc for messages queued to it, dropping them if no connect
+  /// attempt could be started
+  void
+  TryConnectOrDiscard(llarp_rc *rc);
+
   /// flush outbound message queue
   void
   FlushOutbound();
@@ -7,8 +7,12 @@ namespace llarp
   {
     DHTMessage::~DHTMessage()
     {
-      for(auto& msg : M)
-        delete msg;
+      // messages from an arena are destroyed with it
+      if(M.get_allocator().arena == nullptr)
+      {
+        for(auto& msg : M)
+          delete msg;
+      }
     }
 
     bool
@@ -11,57 +11,24 @@ namespace llarp
   {
     InboundMessageParser::InboundMessageParser()
     {
-      reader.user   = this;
-      reader.on_key = &OnKey;
-      firstKey      = false;
     }
 
-    bool
-    InboundMessageParser::OnKey(dict_reader* r, llarp_buffer_t* key)
+    IMessage*
+    InboundMessageParser::CreateMessage(byte_t type, Arena& arena) const
     {
-      InboundMessageParser* self =
-          static_cast< InboundMessageParser* >(r->user);
-
-      if(key == nullptr && self->firstKey)
-      {
-        // empty dict
-        return false;
-      }
-      if(!key)
-        return true;
-      if(self->firstKey)
+      switch(type)
       {
-        llarp_buffer_t strbuf;
-        if(!llarp_buffer_eq(*key, "A"))
-          return false;
-        if(!bencode_read_string(r->buffer, &strbuf))
-          return false;
-        if(strbuf.sz != 1)
-          return false;
-        self->key = *strbuf.cur;
-        switch(self->key)
-        {
-          case 'L':
-            self->msg = new PathLatencyMessage();
-            break;
-          case 'M':
-            self->msg = new DHTMessage();
-            break;
-          case 'P':
-            self->msg = new PathConfirmMessage();
-            break;
-          case 'T':
-            self->msg = new PathTransferMessage();
-            break;
-          default:
-            llarp::LogError("invalid routing message id: ", *strbuf.cur);
-        }
-        self->firstKey = false;
-        return self->msg != nullptr;
-      }
-      else
-      {
-        return self->msg->DecodeKey(*key, r->buffer);
+        case 'L':
+          return arena.New< PathLatencyMessage >();
+        case 'M':
+          return arena.New< DHTMessage >(&arena);
+        case 'P':
+          return arena.New< PathConfirmMessage >();
+        case 'T':
+          return arena.New< PathTransferMessage >();
+        default:
+          llarp::LogError("invalid routing message id: ", type);
+          return nullptr;
       }
     }
 
@@ -71,22 +38,29 @@ namespace llarp
                                              const PathID_t& from,
                                              llarp_router* r)
     {
-      bool result = false;
-      msg         = nullptr;
-      firstKey    = true;
-      if(bencode_read_dict(&buf, &reader))
-      {
-        msg->from = from;
-        result    = msg->HandleMessage(h, r);
-        if(!result)
-          llarp::LogWarn("Failed to handle inbound routing message ", key);
-        delete msg;
-      }
-      else
+      // what we decode lives until we return
+      Arena& arena = Arena::ThisThread();
+      Arena::Scope scope(arena);
+      BencodeReader reader(&buf);
+      llarp_buffer_t key, type;
+      IMessage* msg = nullptr;
+      if(reader.EnterDict() && reader.NextKey(key) && llarp_buffer_eq(key, "A")
+         && reader.ReadString(type) && type.sz == 1)
+        msg = CreateMessage(*type.base, arena);
+      bool decoded = msg != nullptr;
+      while(decoded && reader.NextKey(key))
+        decoded = msg->DecodeKey(key, &buf);
+      if(!decoded || reader.failed)
       {
         llarp::LogError("read dict failed in routing layer");
         llarp::DumpBuffer< llarp_buffer_t, 128 >(buf);
+        return false;
       }
+      msg->from   = from;
+      bool result = msg->HandleMessage(h, r);
+      if(!result)
+        llarp::LogWarn("Failed to handle inbound routing message ",
+                       *type.base);
       return result;
     }
   }  // namespace routing
@@ -11,7 +11,9 @@ namespace llarp
   namespace service
   {
     Endpoint::Endpoint(const std::string& name, llarp_router* r)
-        : llarp_pathbuilder_context(r, r->dht, 2, 4), m_Router(r), m_Name(name)
+        : llarp_pathbuilder_context(r, r->dht, 2, 4, 1)
+        , m_Router(r)
+        , m_Name(name)
     {
       m_Tag.Zero();
     }
@@ -28,6 +30,15 @@ namespace llarp
         m_Tag = v;
         llarp::LogInfo("Setting tag to ", v);
       }
+      if(k == "spare-paths")
+      {
+        int spares = atoi(v.c_str());
+        if(spares >= 0)
+        {
+          SetNumSpares(spares);
+          llarp::LogInfo("keeping ", spares, " spare paths");
+        }
+      }
       if(k == "prefetch-tag")
       {
         m_PrefetchTags.insert(v);
@@ -160,7 +171,7 @@ namespace llarp
         itr->second.Expire(now);
         if(itr->second.ShouldRefresh(now))
         {
-          auto path = PickRandomEstablishedPath();
+          auto path = PickEstablishedPath();
           if(path)
           {
             itr->second.txid = GenTXID();
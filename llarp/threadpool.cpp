@@ -2,9 +2,11 @@
 #ifndef _MSC_VER
 #include <pthread.h>
 #endif
+#include <cstdlib>
 #include <cstring>
 
 #include <llarp/time.h>
+#include <new>
 #include <queue>
 
 #include "logger.hpp"
@@ -14,6 +16,7 @@
 #endif
 
 #ifdef _MSC_VER
+#include <malloc.h>
 #include <windows.h>
 extern "C" void
 SetThreadName(DWORD dwThreadID, LPCSTR szThreadName);
@@ -23,24 +26,30 @@ namespace llarp
 {
   namespace thread
   {
-    Pool::Pool(size_t workers, const char *name)
+    static void
+    SetName(const char *name)
     {
-      stop = false;
-      while(workers--)
+      if(name)
       {
-        threads.emplace_back([this, name] {
-          if(name)
-          {
 #if(__APPLE__ && __MACH__)
-            pthread_setname_np(name);
+        pthread_setname_np(name);
 #elif(__FreeBSD__) || (__OpenBSD__) || (__NetBSD__)
-            pthread_set_name_np(pthread_self(), name);
+        pthread_set_name_np(pthread_self(), name);
 #elif !defined(_MSC_VER) || !defined(_WIN32)
-            pthread_setname_np(pthread_self(), name);
+        pthread_setname_np(pthread_self(), name);
 #else
-            SetThreadName(GetCurrentThreadId(), name);
+        SetThreadName(GetCurrentThreadId(), name);
 #endif
-          }
+      }
+    }
+
+    Pool::Pool(size_t workers, const char *name)
+    {
+      stop = false;
+      while(workers--)
+      {
+        threads.emplace_back([this, name] {
+          SetName(name);
           for(;;)
           {
             llarp_thread_job *job;
@@ -96,18 +105,271 @@ namespace llarp
       condition.notify_one();
     }
 
+    JobRing::JobRing() : cells(new Cell[Size]), tail(0), head(0)
+    {
+      for(size_t idx = 0; idx < Size; ++idx)
+        cells[idx].seq.store(idx, std::memory_order_relaxed);
+    }
+
+    void *
+    JobRing::operator new(size_t sz)
+    {
+      void *ptr = nullptr;
+#ifdef _MSC_VER
+      ptr = _aligned_malloc(sz, alignof(JobRing));
+#else
+      if(posix_memalign(&ptr, alignof(JobRing), sz))
+        ptr = nullptr;
+#endif
+      if(ptr == nullptr)
+        throw std::bad_alloc();
+      return ptr;
+    }
+
+    void
+    JobRing::operator delete(void *ptr)
+    {
+#ifdef _MSC_VER
+      _aligned_free(ptr);
+#else
+      free(ptr);
+#endif
+    }
+
+    bool
+    JobRing::Push(const llarp_thread_job &job)
+    {
+      size_t pos = tail.load(std::memory_order_relaxed);
+      for(;;)
+      {
+        Cell &cell   = cells[pos & (Size - 1)];
+        size_t seq   = cell.seq.load(std::memory_order_acquire);
+        intptr_t dif = intptr_t(seq) - intptr_t(pos);
+        if(dif == 0)
+        {
+          if(tail.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed))
+          {
+            cell.job = job;
+            cell.seq.store(pos + 1, std::memory_order_release);
+            return true;
+          }
+        }
+        else if(dif < 0)
+          return false;
+        else
+          pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+
+    bool
+    JobRing::Pop(llarp_thread_job &job)
+    {
+      size_t pos = head.load(std::memory_order_relaxed);
+      for(;;)
+      {
+        Cell &cell   = cells[pos & (Size - 1)];
+        size_t seq   = cell.seq.load(std::memory_order_acquire);
+        intptr_t dif = intptr_t(seq) - intptr_t(pos + 1);
+        if(dif == 0)
+        {
+          if(head.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed))
+          {
+            job = cell.job;
+            cell.seq.store(pos + Size, std::memory_order_release);
+            return true;
+          }
+        }
+        else if(dif < 0)
+          return false;
+        else
+          pos = head.load(std::memory_order_relaxed);
+      }
+    }
+
+    /// set in worker threads so jobs they queue go to their own ring
+    static thread_local StealingPool *tl_pool = nullptr;
+    static thread_local size_t tl_worker      = 0;
+
+    StealingPool::StealingPool(size_t workers, const char *name)
+        : overflowed(0), next(0), sleepers(0), stop(false)
+    {
+      for(size_t idx = 0; idx < workers; ++idx)
+        rings.emplace_back(new JobRing);
+      for(size_t idx = 0; idx < workers; ++idx)
+        threads.emplace_back([this, idx, name] { Worker(idx, name); });
+    }
+
+    StealingPool::~StealingPool()
+    {
+      if(threads.size())
+      {
+        Stop();
+        Join();
+      }
+    }
+
+    bool
+    StealingPool::Push(size_t idx, const llarp_thread_job &job)
+    {
+      // try the chosen ring then its neighbours before taking the lock
+      for(size_t n = 0; n < rings.size(); ++n)
+      {
+        if(rings[(idx + n) % rings.size()]->Push(job))
+          return true;
+      }
+      lock_t lock(overflow_mutex);
+      if(stop)
+        return false;
+      overflow.push_back(job);
+      overflowed.fetch_add(1);
+      return true;
+    }
+
+    bool
+    StealingPool::Pop(size_t idx, llarp_thread_job &job)
+    {
+      if(rings[idx]->Pop(job))
+        return true;
+      if(overflowed.load(std::memory_order_acquire))
+      {
+        lock_t lock(overflow_mutex);
+        if(overflow.size())
+        {
+          job = overflow.front();
+          overflow.pop_front();
+          overflowed.fetch_sub(1);
+          return true;
+        }
+      }
+      // steal
+      for(size_t n = 1; n < rings.size(); ++n)
+      {
+        if(rings[(idx + n) % rings.size()]->Pop(job))
+          return true;
+      }
+      return false;
+    }
+
+    bool
+    StealingPool::HasWork() const
+    {
+      if(overflowed.load())
+        return true;
+      for(const auto &ring : rings)
+        if(!ring->Empty())
+          return true;
+      return false;
+    }
+
+    void
+    StealingPool::Wakeup(bool all)
+    {
+      // workers bump sleepers before their last look at the rings so either
+      // they see our job or we see them, the fences pair up so neither
+      // side's load can be ordered before its store
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if(sleepers.load() == 0)
+        return;
+      lock_t lock(sleep_mutex);
+      if(all)
+        wakeup.notify_all();
+      else
+        wakeup.notify_one();
+    }
+
+    void
+    StealingPool::Worker(size_t idx, const char *name)
+    {
+      SetName(name);
+      tl_pool   = this;
+      tl_worker = idx;
+      llarp_thread_job job;
+      size_t spins = 0;
+      for(;;)
+      {
+        if(Pop(idx, job))
+        {
+          spins = 0;
+          job.work(job.user);
+          continue;
+        }
+        if(stop.load() && !HasWork())
+          return;
+        // spin briefly, sleeping costs more than a short gap between jobs
+        if(++spins < 64)
+        {
+          std::this_thread::yield();
+          continue;
+        }
+        spins = 0;
+        lock_t lock(sleep_mutex);
+        sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(!HasWork() && !stop.load())
+          wakeup.wait_for(lock, std::chrono::milliseconds(100));
+        sleepers.fetch_sub(1);
+      }
+    }
+
+    void
+    StealingPool::QueueJob(const llarp_thread_job &job)
+    {
+      // don't allow enqueueing after stopping the pool
+      if(stop.load())
+        return;
+      size_t idx;
+      if(tl_pool == this)
+        idx = tl_worker;
+      else
+        idx = next.fetch_add(1, std::memory_order_relaxed) % rings.size();
+      if(Push(idx, job))
+        Wakeup(false);
+    }
+
+    void
+    StealingPool::QueueJobs(const llarp_thread_job *jobs, size_t num)
+    {
+      if(stop.load() || num == 0)
+        return;
+      size_t idx = next.fetch_add(num, std::memory_order_relaxed);
+      for(size_t n = 0; n < num; ++n)
+        Push((idx + n) % rings.size(), jobs[n]);
+      Wakeup(num > 1);
+    }
+
+    void
+    StealingPool::Stop()
+    {
+      {
+        lock_t lock(sleep_mutex);
+        stop.store(true);
+      }
+      wakeup.notify_all();
+    }
+
+    void
+    StealingPool::Join()
+    {
+      for(auto &t : threads)
+        t.join();
+      threads.clear();
+      done.notify_all();
+    }
+
   }  // namespace thread
 }  // namespace llarp
 
 struct llarp_threadpool
 {
-  llarp::thread::Pool *impl;
+  llarp::thread::StealingPool *impl;
 
   std::mutex m_access;
   std::queue< llarp_thread_job * > jobs;
 
   llarp_threadpool(int workers, const char *name)
-      : impl(new llarp::thread::Pool(workers, name))
+      : impl(new llarp::thread::StealingPool(workers, name))
   {
   }
 
@@ -182,6 +444,19 @@ llarp_threadpool_queue_job(struct llarp_threadpool *pool,
   }
 }
 
+void
+llarp_threadpool_queue_jobs(struct llarp_threadpool *pool,
+                            const struct llarp_thread_job *jobs, size_t num)
+{
+  if(pool->impl)
+    pool->impl->QueueJobs(jobs, num);
+  else
+  {
+    for(size_t idx = 0; idx < num; ++idx)
+      llarp_threadpool_queue_job(pool, jobs[idx]);
+  }
+}
+
 void
 llarp_threadpool_tick(struct llarp_threadpool *pool)
 {
@@ -4,6 +4,9 @@
 #include <llarp/threadpool.h>
 #include <llarp/threading.hpp>
 
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <queue>
 
 #include <thread>
@@ -51,6 +54,97 @@ namespace llarp
       bool stop;
     };
 
+    /// bounded lock free multi producer multi consumer job queue
+    struct JobRing
+    {
+      static constexpr size_t Size = 4096;
+
+      struct Cell
+      {
+        std::atomic< size_t > seq;
+        llarp_thread_job job;
+      };
+
+      JobRing();
+
+      /// plain new only guarantees 16 byte alignment before c++17
+      static void*
+      operator new(size_t sz);
+
+      static void
+      operator delete(void* ptr);
+
+      bool
+      Push(const llarp_thread_job& job);
+
+      bool
+      Pop(llarp_thread_job& job);
+
+      bool
+      Empty() const
+      {
+        return head.load(std::memory_order_acquire)
+            == tail.load(std::memory_order_acquire);
+      }
+
+      std::unique_ptr< Cell[] > cells;
+      // keep producers and consumers off each other's cache lines
+      alignas(64) std::atomic< size_t > tail;
+      alignas(64) std::atomic< size_t > head;
+    };
+
+    /// work stealing pool, each worker owns a ring that submitters spread
+    /// jobs over, idle workers steal from the other rings before sleeping
+    struct StealingPool
+    {
+      StealingPool(size_t sz, const char* name);
+      ~StealingPool();
+
+      void
+      QueueJob(const llarp_thread_job& job);
+
+      /// queue many jobs with one wakeup
+      void
+      QueueJobs(const llarp_thread_job* jobs, size_t num);
+
+      void
+      Join();
+
+      void
+      Stop();
+
+      std::vector< std::thread > threads;
+      std::condition_variable done;
+
+     private:
+      bool
+      Push(size_t idx, const llarp_thread_job& job);
+
+      bool
+      Pop(size_t idx, llarp_thread_job& job);
+
+      bool
+      HasWork() const;
+
+      void
+      Wakeup(bool all);
+
+      void
+      Worker(size_t idx, const char* name);
+
+      std::vector< std::unique_ptr< JobRing > > rings;
+      /// jobs that didn't fit into any ring
+      mtx_t overflow_mutex;
+      std::deque< llarp_thread_job > overflow;
+      std::atomic< size_t > overflowed;
+      /// round robin for submissions from outside the pool
+      std::atomic< size_t > next;
+      std::atomic< size_t > sleepers;
+      mtx_t sleep_mutex;
+      std::condition_variable wakeup;
+      std::atomic< bool > stop;
+    };
+
   }  // namespace thread
 }  // namespace llarp
 
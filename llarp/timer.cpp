@@ -3,67 +3,324 @@
 #include <atomic>
 #include <condition_variable>
 #include <list>
-#include <queue>
-#include <unordered_map>
+#include <memory>
+#include <vector>
 
 #include "logger.hpp"
 
 namespace llarp
 {
-  struct timer
+  /// intrusive doubly linked list hook, wheel slots are circular lists with
+  /// a sentinel so unlinking never needs to know which slot we are in
+  struct timer_node
   {
+    timer_node* prev = this;
+    timer_node* next = this;
+
+    bool
+    empty() const
+    {
+      return next == this;
+    }
+
+    void
+    unlink()
+    {
+      prev->next = next;
+      next->prev = prev;
+      prev = next = this;
+    }
+
+    void
+    push_back(timer_node* n)
+    {
+      n->prev    = prev;
+      n->next    = this;
+      prev->next = n;
+      prev       = n;
+    }
+
+    /// move all nodes in other onto the end of this list
+    void
+    splice(timer_node& other)
+    {
+      if(other.empty())
+        return;
+      other.next->prev = prev;
+      prev->next       = other.next;
+      other.prev->next = this;
+      prev             = other.prev;
+      other.prev = other.next = &other;
+    }
+  };
+
+  struct timer : public timer_node
+  {
+    enum State
+    {
+      eFree,
+      eScheduled,
+      /// expired or canceled, waiting for the tick to call it
+      ePending,
+      eCalling
+    };
+
     void* user;
     uint64_t called_at;
     uint64_t started;
     uint64_t timeout;
+    uint64_t expires;
     llarp_timer_handler_func func;
     bool done;
     bool canceled;
+    State state     = eFree;
+    /// wheel level we are scheduled in, 0 is the root wheel
+    int level       = 0;
+    uint32_t id     = 0;
+    timer* nextFree = nullptr;
 
-    timer(uint64_t ms = 0, void* _user = nullptr,
-          llarp_timer_handler_func _func = nullptr)
-        : user(_user)
-        , called_at(0)
-        , started(llarp_time_now_ms())
-        , timeout(ms)
-        , func(_func)
-        , done(false)
-        , canceled(false)
+    void
+    reset(uint64_t now, uint64_t ms, void* _user,
+          llarp_timer_handler_func _func)
     {
+      user      = _user;
+      called_at = 0;
+      started   = now;
+      timeout   = ms;
+      expires   = now + ms;
+      func      = _func;
+      done      = false;
+      canceled  = false;
     }
 
-    ~timer()
+    void
+    exec();
+  };
+
+  /// hierarchical timing wheel with 1ms resolution
+  /// one 256 slot wheel for the next 256ms and four 64 slot wheels above
+  /// it, each covering 64 times the one below, so timers are O(1) to add and
+  /// remove and a tick only touches slots that expired
+  struct timer_wheel
+  {
+    static constexpr int RootBits   = 8;
+    static constexpr int LevelBits  = 6;
+    static constexpr int NumLevels  = 4;
+    static constexpr size_t RootSize  = 1 << RootBits;
+    static constexpr size_t LevelSize = 1 << LevelBits;
+    static constexpr uint64_t RootMask  = RootSize - 1;
+    static constexpr uint64_t LevelMask = LevelSize - 1;
+    /// furthest a timer can be scheduled from now, longer ones get clamped
+    /// and rescheduled when they cascade down
+    static constexpr uint64_t MaxSpan =
+        (uint64_t(1) << (RootBits + (NumLevels * LevelBits))) - 1;
+
+    timer_node root[RootSize];
+    timer_node levels[NumLevels][LevelSize];
+    /// last time processed, everything at or before it has expired
+    uint64_t current = 0;
+    size_t scheduled = 0;
+    /// timers in the root wheel
+    size_t rootCount = 0;
+
+    void
+    add(timer* t)
     {
+      uint64_t expires = t->expires;
+      if(expires <= current)
+        expires = current + 1;
+      uint64_t delta = expires - current;
+      if(delta > MaxSpan)
+      {
+        delta   = MaxSpan;
+        expires = current + MaxSpan;
+      }
+      timer_node* slot;
+      if(delta < RootSize)
+      {
+        slot     = &root[expires & RootMask];
+        t->level = 0;
+        ++rootCount;
+      }
+      else
+      {
+        int level = 0;
+        while(delta >= (uint64_t(1) << (RootBits + ((level + 1) * LevelBits))))
+          ++level;
+        int shift = RootBits + (level * LevelBits);
+        slot      = &levels[level][(expires >> shift) & LevelMask];
+        t->level  = level + 1;
+      }
+      slot->push_back(t);
+      t->state = timer::eScheduled;
+      ++scheduled;
     }
 
     void
-    exec();
+    remove(timer* t)
+    {
+      t->unlink();
+      --scheduled;
+      if(t->level == 0)
+        --rootCount;
+    }
 
-    static void
-    call(void* user)
+    /// move timers from an upper level slot to the level below
+    void
+    cascade(int level, timer_node& expired)
     {
-      static_cast< timer* >(user)->exec();
+      int shift         = RootBits + (level * LevelBits);
+      timer_node& slot  = levels[level][(current >> shift) & LevelMask];
+      timer_node pending;
+      pending.splice(slot);
+      while(!pending.empty())
+      {
+        timer* t = static_cast< timer* >(pending.next);
+        t->unlink();
+        --scheduled;
+        if(t->expires <= current)
+        {
+          t->state = timer::ePending;
+          expired.push_back(t);
+        }
+        else
+          add(t);
+      }
     }
 
-    bool
-    operator<(const timer& other) const
+    /// advance to now, appending every expired timer to expired
+    void
+    advance(uint64_t now, timer_node& expired)
+    {
+      while(current < now)
+      {
+        if(scheduled == 0)
+        {
+          current = now;
+          return;
+        }
+        ++current;
+        if((current & RootMask) == 0)
+        {
+          // cascade the upper wheels whose slot just rolled over
+          for(int level = 0; level < NumLevels; ++level)
+          {
+            cascade(level, expired);
+            int shift = RootBits + ((level + 1) * LevelBits);
+            if(current & ((uint64_t(1) << shift) - 1))
+              break;
+          }
+        }
+        timer_node& slot = root[current & RootMask];
+        while(!slot.empty())
+        {
+          timer* t = static_cast< timer* >(slot.next);
+          remove(t);
+          t->state = timer::ePending;
+          expired.push_back(t);
+        }
+        // nothing will expire before the root wheel wraps, skip ahead
+        if(rootCount == 0 && now - current >= RootSize)
+          current |= RootMask;
+      }
+    }
+  };
+
+  /// slab of timers handed out by id, ids carry a generation so a stale id
+  /// can't cancel a timer that reused its slot
+  struct timer_pool
+  {
+    static constexpr int IndexBits      = 20;
+    static constexpr uint32_t IndexMask = (1 << IndexBits) - 1;
+    static constexpr size_t ChunkSize   = 1024;
+
+    std::vector< std::unique_ptr< timer[] > > chunks;
+    timer* freeHead = nullptr;
+    timer* freeTail = nullptr;
+    size_t allocated = 0;
+
+    timer*
+    get(uint32_t idx)
+    {
+      return &chunks[idx / ChunkSize][idx % ChunkSize];
+    }
+
+    timer*
+    alloc()
+    {
+      if(freeHead == nullptr)
+      {
+        if(allocated >= IndexMask)
+          return nullptr;
+        // grow by a chunk, index 0 is never used so ids are never 0
+        chunks.emplace_back(new timer[ChunkSize]);
+        size_t base = (chunks.size() - 1) * ChunkSize;
+        for(size_t idx = 0; idx < ChunkSize; ++idx)
+        {
+          if(base + idx == 0)
+            continue;
+          timer* t = get(base + idx);
+          t->id    = base + idx;
+          release(t);
+        }
+        allocated += ChunkSize;
+      }
+      timer* t = freeHead;
+      freeHead = t->nextFree;
+      if(freeHead == nullptr)
+        freeTail = nullptr;
+      t->nextFree = nullptr;
+      return t;
+    }
+
+    /// put back on the tail of the free list so slot reuse is spread out
+    void
+    release(timer* t)
+    {
+      t->state    = timer::eFree;
+      t->func     = nullptr;
+      t->user     = nullptr;
+      t->nextFree = nullptr;
+      // bump the generation
+      t->id += (1 << IndexBits);
+      if(freeTail)
+        freeTail->nextFree = t;
+      else
+        freeHead = t;
+      freeTail = t;
+    }
+
+    timer*
+    find(uint32_t id)
     {
-      return (started + timeout) < (other.started + other.timeout);
+      uint32_t idx = id & IndexMask;
+      if(idx == 0 || idx / ChunkSize >= chunks.size())
+        return nullptr;
+      timer* t = get(idx);
+      if(t->id != id || t->state == timer::eFree)
+        return nullptr;
+      return t;
     }
   };
-};  // namespace llarp
+}  // namespace llarp
 
 struct llarp_timer_context
 {
   std::mutex timersMutex;
-  std::unordered_map< uint32_t, llarp::timer* > timers;
-  std::priority_queue< llarp::timer* > calling;
+  llarp::timer_pool pool;
+  llarp::timer_wheel wheel;
+  /// timers waiting to be called by the next tick
+  llarp::timer_node pending;
   std::mutex tickerMutex;
   std::condition_variable* ticker       = nullptr;
   std::chrono::milliseconds nextTickLen = std::chrono::milliseconds(100);
 
-  uint32_t ids = 0;
-  bool _run    = true;
+  bool _run = true;
+
+  llarp_timer_context()
+  {
+    wheel.current = llarp_time_now_ms();
+  }
 
   ~llarp_timer_context()
   {
@@ -87,49 +344,98 @@ struct llarp_timer_context
   cancel(uint32_t id)
   {
     std::unique_lock< std::mutex > lock(timersMutex);
-    auto itr = timers.find(id);
-    if(itr == timers.end())
+    llarp::timer* t = pool.find(id);
+    if(t == nullptr)
       return;
-    itr->second->canceled = true;
+    t->canceled = true;
+    // canceled timers get called early on the next tick
+    if(t->state == llarp::timer::eScheduled)
+    {
+      wheel.remove(t);
+      t->state = llarp::timer::ePending;
+      pending.push_back(t);
+    }
   }
 
   void
   remove(uint32_t id)
   {
     std::unique_lock< std::mutex > lock(timersMutex);
-    auto itr = timers.find(id);
-    if(itr == timers.end())
+    llarp::timer* t = pool.find(id);
+    if(t == nullptr)
       return;
-    itr->second->func     = nullptr;
-    itr->second->canceled = true;
+    t->func     = nullptr;
+    t->canceled = true;
+    switch(t->state)
+    {
+      case llarp::timer::eScheduled:
+        wheel.remove(t);
+        pool.release(t);
+        break;
+      case llarp::timer::ePending:
+        t->unlink();
+        pool.release(t);
+        break;
+      default:
+        // being called right now, released once the call returns
+        break;
+    }
   }
 
   uint32_t
   call_later(void* user, llarp_timer_handler_func func, uint64_t timeout_ms)
   {
+    auto now = llarp_time_now_ms();
     std::unique_lock< std::mutex > lock(timersMutex);
-    uint32_t id = ++ids;
-    timers[id]  = new llarp::timer(timeout_ms, user, func);
-    return id;
+    llarp::timer* t = pool.alloc();
+    if(t == nullptr)
+    {
+      llarp::LogError("timer pool exhausted");
+      return 0;
+    }
+    t->reset(now, timeout_ms, user, func);
+    wheel.add(t);
+    return t->id;
   }
 
+  /// call every timer that expired or was canceled
   void
-  cancel_all()
+  tick(uint64_t now)
   {
-    std::list< uint32_t > ids;
-
+    std::unique_lock< std::mutex > lock(timersMutex);
+    wheel.advance(now, pending);
+    // callbacks may add or remove timers, so don't hold the lock over them
+    while(!pending.empty())
     {
-      std::unique_lock< std::mutex > lock(timersMutex);
-
-      for(auto& item : timers)
-      {
-        ids.push_back(item.first);
-      }
+      llarp::timer* t = static_cast< llarp::timer* >(pending.next);
+      t->unlink();
+      t->state     = llarp::timer::eCalling;
+      t->called_at = now;
+      lock.unlock();
+      t->exec();
+      lock.lock();
+      pool.release(t);
     }
+  }
 
-    for(auto id : ids)
+  /// drop every timer without calling it
+  void
+  clear()
+  {
+    std::unique_lock< std::mutex > lock(timersMutex);
+    for(auto& chunk : pool.chunks)
     {
-      cancel(id);
+      for(size_t idx = 0; idx < llarp::timer_pool::ChunkSize; ++idx)
+      {
+        llarp::timer* t = &chunk[idx];
+        if(t->state == llarp::timer::eScheduled)
+          wheel.remove(t);
+        else if(t->state == llarp::timer::ePending)
+          t->unlink();
+        else
+          continue;
+        pool.release(t);
+      }
     }
   }
 };
@@ -166,7 +472,7 @@ llarp_timer_stop(struct llarp_timer_context* t)
 {
   // destroy all timers
   // don't call callbacks on timers
-  t->timers.clear();
+  t->clear();
   t->stop();
   if(t->ticker)
     t->ticker->notify_all();
@@ -184,26 +490,7 @@ llarp_timer_tick_all(struct llarp_timer_context* t,
 {
   if(!t->run())
     return;
-  auto now = llarp_time_now_ms();
-  auto itr = t->timers.begin();
-  while(itr != t->timers.end())
-  {
-    if(now - itr->second->started >= itr->second->timeout
-       || itr->second->canceled)
-    {
-      if(itr->second->func && itr->second->called_at == 0)
-      {
-        // timer hit
-        itr->second->called_at = now;
-        itr->second->exec();
-        llarp::timer* timer = itr->second;
-        itr                 = t->timers.erase(itr);
-        delete timer;
-        continue;
-      }
-    }
-    ++itr;
-  }
+  t->tick(llarp_time_now_ms());
 }
 
 void
@@ -221,7 +508,6 @@ llarp_timer_run(struct llarp_timer_context* t, struct llarp_threadpool* pool)
 
     if(t->run())
     {
-      std::unique_lock< std::mutex > lock(t->timersMutex);
       // we woke up
       llarp_timer_tick_all(t, pool);
     }
@@ -1,4 +1,5 @@
 #include <llarp/path.hpp>
+#include <llarp/relay_batch.hpp>
 #include <llarp/routing/handler.hpp>
 #include "buffer.hpp"
 #include "router.hpp"
@@ -73,36 +74,75 @@ namespace llarp
     TransitHop::HandleDownstream(llarp_buffer_t buf, const TunnelNonce& Y,
                                  llarp_router* r)
     {
-      RelayDownstreamMessage* msg = new RelayDownstreamMessage;
-      msg->pathid                 = info.rxID;
-      msg->Y                      = Y ^ nonceXOR;
-      r->crypto.xchacha20(buf, pathKey, Y);
-      msg->X = buf;
-      llarp::LogDebug("relay ", msg->X.size(), " bytes downstream from ",
+      RelayDownstreamMessage msg;
+      msg.X.Borrow(buf);
+      msg.pathid = info.rxID;
+      msg.Y      = Y ^ nonceXOR;
+      auto job   = RelayJob::Encode(msg, RelayMessageSize(buf.sz));
+      if(job == nullptr)
+        return false;
+      job->AddLayer(pathKey, Y);
+      llarp::LogDebug("relay ", buf.sz, " bytes downstream from ",
                       info.upstream, " to ", info.downstream);
-      return r->SendToOrQueue(info.downstream, msg);
+      return r->QueueRelay(info.downstream, job);
     }
 
     bool
     TransitHop::HandleUpstream(llarp_buffer_t buf, const TunnelNonce& Y,
                                llarp_router* r)
     {
-      r->crypto.xchacha20(buf, pathKey, Y);
-      if(info.upstream == RouterID(r->pubkey()))
+      if(IsEndpoint(r->pubkey()))
       {
+        r->crypto.xchacha20(buf, pathKey, Y);
         return m_MessageParser.ParseMessageBuffer(buf, this, info.rxID, r);
       }
-      else
-      {
-        RelayUpstreamMessage* msg = new RelayUpstreamMessage;
-        msg->pathid               = info.txID;
-        msg->Y                    = Y ^ nonceXOR;
-
-        msg->X = buf;
-        llarp::LogDebug("relay ", msg->X.size(), " bytes upstream from ",
-                        info.downstream, " to ", info.upstream);
-        return r->SendToOrQueue(info.upstream, msg);
-      }
+      RelayUpstreamMessage msg;
+      msg.X.Borrow(buf);
+      msg.pathid = info.txID;
+      msg.Y      = Y ^ nonceXOR;
+      auto job   = RelayJob::Encode(msg, RelayMessageSize(buf.sz));
+      if(job == nullptr)
+        return false;
+      job->AddLayer(pathKey, Y);
+      llarp::LogDebug("relay ", buf.sz, " bytes upstream from ",
+                      info.downstream, " to ", info.upstream);
+      return r->QueueRelay(info.upstream, job);
+    }
+
+    TunnelNonce
+    TransitHop::NextHopInPlace(RelayView& view) const
+    {
+      TunnelNonce Y(view.Y);
+      memcpy(view.Y, Y ^ nonceXOR, TUNNONCESIZE);
+      const PathID_t& id = view.type == 'u' ? info.txID : info.rxID;
+      memcpy(view.pathid, id, PATHIDSIZE);
+      return Y;
+    }
+
+    void
+    TransitHop::RelayInPlace(RelayView& view, llarp_crypto* crypto) const
+    {
+      TunnelNonce Y = NextHopInPlace(view);
+      crypto->xchacha20(view.X, pathKey, Y);
+    }
+
+    bool
+    TransitHop::ForwardInPlace(llarp_buffer_t buf, RelayView& view,
+                               llarp_router* r)
+    {
+      bool upstream        = view.type == 'u';
+      const RouterID& next = upstream ? info.upstream : info.downstream;
+      TunnelNonce Y        = NextHopInPlace(view);
+      // the inbound buffer goes away when we return, the workers decrypt a
+      // pooled copy
+      auto job = RelayJob::Copy(buf);
+      if(job == nullptr)
+        return false;
+      job->SetPayload(view.X.base - buf.base, view.X.sz);
+      job->AddLayer(pathKey, Y);
+      llarp::LogDebug("relay ", view.X.sz, " bytes ",
+                      upstream ? "upstream" : "downstream", " to ", next);
+      return r->QueueRelay(next, job);
     }
 
     bool
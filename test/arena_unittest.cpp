@@ -0,0 +1,253 @@
+#include <gtest/gtest.h>
+#include <llarp/arena.hpp>
+#include <llarp/dht/messages/findintro.hpp>
+#include <llarp/dht/messages/findrouter.hpp>
+#include <llarp/messages/dht.hpp>
+#include <llarp/messages/dht_immediate.hpp>
+#include <llarp/messages/relay.hpp>
+#include <llarp/routing/handler.hpp>
+
+#include <cstdlib>
+#include <vector>
+#include "buffer.hpp"
+
+// count heap allocations made by this thread, replaces the global operator
+// new for the whole test binary
+static thread_local size_t heapAllocs = 0;
+
+void*
+operator new(size_t sz)
+{
+  ++heapAllocs;
+  void* ptr = malloc(sz ? sz : 1);
+  if(ptr == nullptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void
+operator delete(void* ptr) noexcept
+{
+  free(ptr);
+}
+
+void
+operator delete(void* ptr, size_t) noexcept
+{
+  free(ptr);
+}
+
+struct Tracked
+{
+  std::vector< int >& destroyed;
+  int id;
+
+  Tracked(std::vector< int >& d, int i) : destroyed(d), id(i)
+  {
+  }
+
+  ~Tracked()
+  {
+    destroyed.push_back(id);
+  }
+};
+
+/// routing handler that only remembers latency messages
+struct LatencyHandler : public llarp::routing::IMessageHandler
+{
+  uint64_t T = 0;
+
+  bool
+  HandlePathTransferMessage(const llarp::routing::PathTransferMessage*,
+                            llarp_router*)
+  {
+    return false;
+  }
+
+  bool
+  HandleHiddenServiceFrame(const llarp::service::ProtocolFrame*)
+  {
+    return false;
+  }
+
+  bool
+  HandlePathConfirmMessage(const llarp::routing::PathConfirmMessage*,
+                           llarp_router*)
+  {
+    return false;
+  }
+
+  bool
+  HandlePathLatencyMessage(const llarp::routing::PathLatencyMessage* msg,
+                           llarp_router*)
+  {
+    T = msg->T;
+    return true;
+  }
+
+  bool
+  HandleDHTMessage(const llarp::dht::IMessage*, llarp_router*)
+  {
+    return false;
+  }
+};
+
+struct ArenaTest : public ::testing::Test
+{
+  byte_t tmp[1024];
+  llarp::RouterID from;
+
+  ArenaTest()
+  {
+    from.Fill(1);
+  }
+
+  /// encode msg into tmp
+  llarp_buffer_t
+  Encode(const llarp::IBEncodeMessage& msg)
+  {
+    auto buf = llarp::StackBuffer< decltype(tmp) >(tmp);
+    EXPECT_TRUE(msg.BEncode(&buf));
+    buf.sz  = buf.cur - buf.base;
+    buf.cur = buf.base;
+    return buf;
+  }
+
+  /// decode buf into msg past its message type like the parsers do
+  static bool
+  Decode(llarp::IBEncodeMessage* msg, llarp_buffer_t buf, const char* type)
+  {
+    llarp::BencodeReader reader(&buf);
+    llarp_buffer_t key;
+    if(!reader.EnterDict())
+      return false;
+    while(reader.NextKey(key))
+    {
+      if(llarp_buffer_eq(key, type))
+      {
+        if(!reader.Skip())
+          return false;
+      }
+      else if(!msg->DecodeKey(key, &buf))
+        return false;
+    }
+    return !reader.failed;
+  }
+};
+
+TEST_F(ArenaTest, ScopeDestroysNewestFirst)
+{
+  llarp::Arena arena;
+  std::vector< int > destroyed;
+  {
+    llarp::Arena::Scope outer(arena);
+    ASSERT_NE(arena.New< Tracked >(destroyed, 1), nullptr);
+    {
+      llarp::Arena::Scope inner(arena);
+      ASSERT_NE(arena.New< Tracked >(destroyed, 2), nullptr);
+      ASSERT_NE(arena.New< Tracked >(destroyed, 3), nullptr);
+    }
+    ASSERT_EQ(destroyed, std::vector< int >({3, 2}));
+    ASSERT_NE(arena.Used(), 0u);
+  }
+  ASSERT_EQ(destroyed, std::vector< int >({3, 2, 1}));
+  ASSERT_EQ(arena.Used(), 0u);
+
+  auto ptr = arena.Alloc(1, 1);
+  ASSERT_NE(ptr, nullptr);
+  ASSERT_EQ(uintptr_t(arena.Alloc(8, 8)) % 8, 0u);
+  ASSERT_TRUE(arena.Owns(ptr));
+  ASSERT_FALSE(arena.Owns(&destroyed));
+}
+
+TEST_F(ArenaTest, FullArenaFails)
+{
+  llarp::Arena arena;
+  llarp::Arena::Scope scope(arena);
+  ASSERT_EQ(arena.Alloc(llarp::Arena::Capacity + 1), nullptr);
+  ASSERT_NE(arena.Alloc(llarp::Arena::Capacity - 4), nullptr);
+  ASSERT_EQ(arena.New< uint64_t >(1), nullptr);
+  ASSERT_EQ(arena.overflows, 2u);
+
+  // containers go to the heap once it is full and free what they took
+  std::vector< int, llarp::ArenaAllocator< int > > ints(&arena);
+  heapAllocs = 0;
+  ints.resize(1024);
+  ASSERT_EQ(heapAllocs, 1u);
+  ASSERT_FALSE(arena.Owns(ints.data()));
+}
+
+TEST_F(ArenaTest, LinkDecodeWithoutHeap)
+{
+  llarp::dht::Key_t key(from.data());
+  llarp::DHTImmeidateMessage sent(from);
+  sent.msgs.push_back(new llarp::dht::FindRouterMessage(key, key, 7));
+  sent.msgs.push_back(new llarp::dht::FindRouterMessage(key, key, 8));
+  auto buf = Encode(sent);
+
+  llarp::Arena& arena = llarp::Arena::ThisThread();
+  heapAllocs          = 0;
+  {
+    llarp::Arena::Scope scope(arena);
+    auto msg = arena.New< llarp::DHTImmeidateMessage >(from, &arena);
+    ASSERT_NE(msg, nullptr);
+    ASSERT_TRUE(Decode(msg, buf, "a"));
+    ASSERT_EQ(msg->msgs.size(), 2u);
+    for(const auto& dhtmsg : msg->msgs)
+      ASSERT_TRUE(arena.Owns(dhtmsg));
+    auto find = static_cast< llarp::dht::FindRouterMessage* >(msg->msgs[1]);
+    ASSERT_EQ(find->txid, 8u);
+  }
+  ASSERT_EQ(heapAllocs, 0u);
+  ASSERT_EQ(arena.Used(), 0u);
+
+  llarp::RelayUpstreamMessage relay(from);
+  std::vector< byte_t > payload(512, 'x');
+  relay.X.Borrow(llarp::Buffer(payload));
+  relay.Y.Randomize();
+  relay.pathid.Randomize();
+  buf        = Encode(relay);
+  heapAllocs = 0;
+  {
+    llarp::Arena::Scope scope(arena);
+    auto msg = arena.New< llarp::RelayUpstreamMessage >(from);
+    ASSERT_TRUE(Decode(msg, buf, "a"));
+    ASSERT_EQ(msg->X.size(), payload.size());
+  }
+  ASSERT_EQ(heapAllocs, 0u);
+}
+
+TEST_F(ArenaTest, RoutingDecodeWithoutHeap)
+{
+  llarp::routing::DHTMessage sent;
+  llarp::service::Tag tag;
+  tag.Zero();
+  sent.M.push_back(new llarp::dht::FindIntroMessage(tag, 42));
+  auto buf = Encode(sent);
+
+  llarp::Arena& arena = llarp::Arena::ThisThread();
+  heapAllocs          = 0;
+  {
+    llarp::Arena::Scope scope(arena);
+    auto msg = arena.New< llarp::routing::DHTMessage >(&arena);
+    ASSERT_TRUE(Decode(msg, buf, "A"));
+    ASSERT_EQ(msg->M.size(), 1u);
+    auto find = static_cast< llarp::dht::FindIntroMessage* >(msg->M[0]);
+    ASSERT_EQ(find->T, 42u);
+  }
+  ASSERT_EQ(heapAllocs, 0u);
+
+  // and through the parser
+  llarp::routing::PathLatencyMessage latency;
+  latency.T = 1234;
+  buf       = Encode(latency);
+  llarp::routing::InboundMessageParser parser;
+  LatencyHandler handler;
+  llarp::PathID_t pathid;
+  pathid.Zero();
+  heapAllocs = 0;
+  ASSERT_TRUE(parser.ParseMessageBuffer(buf, &handler, pathid, nullptr));
+  ASSERT_EQ(heapAllocs, 0u);
+  ASSERT_EQ(handler.T, 1234u);
+  ASSERT_EQ(arena.Used(), 0u);
+}
@@ -0,0 +1,321 @@
+#include <gtest/gtest.h>
+#include <llarp/address_info.h>
+#include <llarp/bencode.hpp>
+#include <llarp/messages/path_latency.hpp>
+#include <llarp/router_contact.h>
+#include <llarp/time.h>
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "buffer.hpp"
+
+struct BencodeTest : public ::testing::Test
+{
+  static constexpr size_t Rounds = 200000;
+
+  /// a view of str
+  static llarp_buffer_t
+  View(const std::string& str)
+  {
+    llarp_buffer_t buf;
+    buf.base = (byte_t*)str.data();
+    buf.cur  = buf.base;
+    buf.sz   = str.size();
+    return buf;
+  }
+
+  /// a dict shaped like our messages, 1 byte keys with ints and strings
+  static std::string
+  Message()
+  {
+    std::string str = "d";
+    for(char k = 'a'; k <= 'p'; ++k)
+    {
+      str += "1:";
+      str += k;
+      if(k % 2)
+        str += "i1234567890e";
+      else
+        str += "32:" + std::string(32, k);
+    }
+    return str + "1:vi0ee";
+  }
+
+  /// the integer reader we had, copies digits out and uses strtoul
+  static bool
+  OldReadInteger(llarp_buffer_t* buffer, uint64_t* result)
+  {
+    if(*buffer->cur != 'i')
+      return false;
+    char numbuf[32];
+    buffer->cur++;
+    size_t len = llarp_buffer_read_until(buffer, 'e', (byte_t*)numbuf,
+                                         sizeof(numbuf) - 1);
+    if(!len)
+      return false;
+    buffer->cur++;
+    numbuf[len] = 0;
+    *result     = strtoul(numbuf, nullptr, 10);
+    return true;
+  }
+
+  /// the string reader we had, copies digits out and uses atoi
+  static bool
+  OldReadString(llarp_buffer_t* buffer, llarp_buffer_t* result)
+  {
+    char numbuf[10];
+    size_t len = llarp_buffer_read_until(buffer, ':', (byte_t*)numbuf,
+                                         sizeof(numbuf) - 1);
+    if(!len)
+      return false;
+    numbuf[len] = 0;
+    int num     = atoi(numbuf);
+    if(num < 0)
+      return false;
+    buffer->cur++;
+    if(llarp_buffer_size_left(*buffer) < size_t(num))
+      return false;
+    result->base = buffer->cur;
+    result->cur  = buffer->cur;
+    result->sz   = num;
+    buffer->cur += num;
+    return true;
+  }
+
+  /// the callback reader we had over the old int and string readers
+  static bool
+  OldOnKey(dict_reader* r, llarp_buffer_t* key)
+  {
+    if(key == nullptr)
+      return true;
+    uint64_t* sum = static_cast< uint64_t* >(r->user);
+    if(*r->buffer->cur == 'i')
+    {
+      uint64_t i;
+      if(!OldReadInteger(r->buffer, &i))
+        return false;
+      *sum += i;
+      return true;
+    }
+    llarp_buffer_t str;
+    if(!OldReadString(r->buffer, &str))
+      return false;
+    *sum += str.sz;
+    return true;
+  }
+
+  static bool
+  OldRead(llarp_buffer_t buf, uint64_t& sum)
+  {
+    dict_reader r;
+    r.user   = &sum;
+    r.on_key = &OldOnKey;
+    return bencode_read_dict(&buf, &r);
+  }
+
+  static bool
+  PullRead(llarp_buffer_t buf, uint64_t& sum)
+  {
+    llarp::BencodeReader reader(&buf);
+    llarp_buffer_t key, str;
+    uint64_t i;
+    if(!reader.EnterDict())
+      return false;
+    while(reader.NextKey(key))
+    {
+      if(reader.Peek() == 'i')
+      {
+        if(!reader.ReadInteger(i))
+          return false;
+        sum += i;
+      }
+      else if(!reader.ReadString(str))
+        return false;
+      else
+        sum += str.sz;
+    }
+    return !reader.failed;
+  }
+};
+
+constexpr size_t BencodeTest::Rounds;
+
+TEST_F(BencodeTest, ReadInteger)
+{
+  uint64_t i = 0;
+  std::string str = "i18446744073709551615e";
+  auto buf        = View(str);
+  ASSERT_TRUE(bencode_read_integer(&buf, &i));
+  ASSERT_EQ(i, UINT64_MAX);
+  ASSERT_EQ(buf.cur, buf.base + buf.sz);
+  // overflow, no digits, no end, other junk
+  for(const char* bad : {"i18446744073709551616e", "ie", "i12", "i-1e",
+                         "i1x2e", "i", "12e"})
+  {
+    str = bad;
+    buf = View(str);
+    ASSERT_FALSE(bencode_read_integer(&buf, &i)) << bad;
+    ASSERT_EQ(buf.cur, buf.base) << bad;
+  }
+  // never reads past the end of the buffer
+  str    = "i123e";
+  buf    = View(str);
+  buf.sz = 4;
+  ASSERT_FALSE(bencode_read_integer(&buf, &i));
+}
+
+TEST_F(BencodeTest, ReadString)
+{
+  llarp_buffer_t result;
+  std::string str = "5:hello";
+  auto buf        = View(str);
+  ASSERT_TRUE(bencode_read_string(&buf, &result));
+  ASSERT_EQ(result.sz, 5u);
+  ASSERT_EQ(memcmp(result.base, "hello", 5), 0);
+  // the string is a view into the buffer
+  ASSERT_EQ(result.base, buf.base + 2);
+  for(const char* bad : {"6:hello", ":hello", "5hello", "99999999999999999999:",
+                         "-1:"})
+  {
+    str = bad;
+    buf = View(str);
+    ASSERT_FALSE(bencode_read_string(&buf, &result)) << bad;
+    ASSERT_EQ(buf.cur, buf.base) << bad;
+  }
+}
+
+TEST_F(BencodeTest, PullReader)
+{
+  std::string str = "d1:ai7e1:bl1:xi1ed1:yleee1:c3:abce";
+  auto buf        = View(str);
+  llarp::BencodeReader reader(&buf);
+  llarp_buffer_t key, val;
+  uint64_t i;
+  ASSERT_TRUE(reader.EnterDict());
+  ASSERT_TRUE(reader.NextKey(key));
+  ASSERT_TRUE(llarp_buffer_eq(key, "a"));
+  ASSERT_EQ(reader.Peek(), 'i');
+  ASSERT_TRUE(reader.ReadInteger(i));
+  ASSERT_EQ(i, 7u);
+  ASSERT_TRUE(reader.NextKey(key));
+  ASSERT_EQ(reader.Peek(), 'l');
+  ASSERT_TRUE(reader.Skip());
+  ASSERT_TRUE(reader.NextKey(key));
+  ASSERT_TRUE(llarp_buffer_eq(key, "c"));
+  ASSERT_TRUE(reader.ReadString(val));
+  ASSERT_EQ(val.sz, 3u);
+  ASSERT_FALSE(reader.NextKey(key));
+  ASSERT_FALSE(reader.failed);
+  ASSERT_EQ(buf.cur, buf.base + buf.sz);
+
+  // every truncation fails without reading past the end
+  for(size_t sz = 0; sz < str.size(); ++sz)
+  {
+    buf    = View(str);
+    buf.sz = sz;
+    llarp::BencodeReader skipper(&buf);
+    ASSERT_FALSE(skipper.Skip()) << sz;
+    ASSERT_TRUE(skipper.failed);
+  }
+
+  // nesting is bounded
+  std::string deep(llarp::BencodeReader::MaxDepth + 2, 'l');
+  deep += std::string(deep.size(), 'e');
+  buf = View(deep);
+  llarp::BencodeReader deepReader(&buf);
+  ASSERT_FALSE(deepReader.Skip());
+}
+
+TEST_F(BencodeTest, BenchRead)
+{
+  std::string str = Message();
+  auto buf        = View(str);
+  uint64_t oldSum = 0, pullSum = 0;
+
+  auto started = llarp_time_now_ms();
+  for(size_t idx = 0; idx < Rounds; ++idx)
+    ASSERT_TRUE(OldRead(buf, oldSum));
+  auto oldTime = llarp_time_now_ms() - started;
+
+  started = llarp_time_now_ms();
+  for(size_t idx = 0; idx < Rounds; ++idx)
+    ASSERT_TRUE(PullRead(buf, pullSum));
+  auto pullTime = llarp_time_now_ms() - started;
+
+  ASSERT_EQ(oldSum, pullSum);
+  std::cout << "read " << Rounds << " x " << str.size()
+            << " byte dicts, callbacks with strtoul/atoi: " << oldTime
+            << "ms pull: " << pullTime << "ms" << std::endl;
+}
+
+TEST_F(BencodeTest, BenchWrite)
+{
+  llarp_rc rc;
+  llarp_rc_new(&rc);
+  for(uint16_t idx = 0; idx < 2; ++idx)
+  {
+    llarp_ai ai;
+    memset(&ai, 0, sizeof(ai));
+    strncpy(ai.dialect, "iwp", sizeof(ai.dialect));
+    ai.rank = idx;
+    ai.port = 1090 + idx;
+    llarp_ai_list_pushback(rc.addrs, &ai);
+  }
+  llarp_rc_set_nickname(&rc, "benchmark");
+  rc.last_updated = llarp_time_now_ms();
+
+  llarp::routing::PathLatencyMessage latency;
+  latency.T = 12345678901234ULL;
+  latency.L = 98765432109876ULL;
+  latency.S = 42;
+
+  byte_t tmp[2048];
+  auto buf = llarp::StackBuffer< decltype(tmp) >(tmp);
+
+  auto started = llarp_time_now_ms();
+  for(size_t idx = 0; idx < Rounds; ++idx)
+  {
+    buf.cur = buf.base;
+    ASSERT_TRUE(llarp_rc_bencode(&rc, &buf));
+  }
+  auto rcTime = llarp_time_now_ms() - started;
+  size_t rcSize = buf.cur - buf.base;
+
+  started = llarp_time_now_ms();
+  for(size_t idx = 0; idx < Rounds; ++idx)
+  {
+    buf.cur = buf.base;
+    ASSERT_TRUE(latency.BEncode(&buf));
+  }
+  auto latencyTime = llarp_time_now_ms() - started;
+
+  std::cout << "encoded " << Rounds << " x " << rcSize
+            << " byte rcs: " << rcTime << "ms and " << Rounds
+            << " latency messages: " << latencyTime << "ms" << std::endl;
+  llarp_rc_free(&rc);
+}
+
+TEST_F(BencodeTest, WriteMatchesSize)
+{
+  byte_t tmp[64];
+  for(uint64_t i : {0ULL, 9ULL, 10ULL, 12345ULL, 18446744073709551615ULL})
+  {
+    auto buf = llarp::StackBuffer< decltype(tmp) >(tmp);
+    ASSERT_TRUE(bencode_write_uint64(&buf, i));
+    ASSERT_EQ(size_t(buf.cur - buf.base), bencode_size_uint64(i));
+    std::string expected = "i" + std::to_string(i) + "e";
+    ASSERT_EQ(std::string((char*)buf.base, buf.cur - buf.base), expected);
+  }
+  auto buf = llarp::StackBuffer< decltype(tmp) >(tmp);
+  ASSERT_TRUE(bencode_write_bytestring(&buf, "abc", 3));
+  ASSERT_EQ(std::string((char*)buf.base, buf.cur - buf.base), "3:abc");
+  ASSERT_EQ(size_t(buf.cur - buf.base), bencode_size_bytestring(3));
+
+  // nothing is written if it doesn't all fit
+  buf    = llarp::StackBuffer< decltype(tmp) >(tmp);
+  buf.sz = 4;
+  ASSERT_FALSE(bencode_write_uint64(&buf, 1234));
+  ASSERT_FALSE(bencode_write_bytestring(&buf, "abcd", 4));
+  ASSERT_EQ(buf.cur, buf.base);
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <llarp/buffer_pool.hpp>
+#include <llarp/iwp/sendbuf.hpp>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+struct BufferPoolTest : public ::testing::Test
+{
+  void
+  TearDown()
+  {
+    llarp::BufferPool::SetCap(0);
+  }
+};
+
+TEST_F(BufferPoolTest, AllocFree)
+{
+  auto before = llarp::BufferPool::Stats();
+  std::vector< void * > blocks;
+  for(size_t sz : {1, 200, 256, 257, 1000, 1500, 2048, 4000})
+  {
+    void *ptr = llarp::BufferPool::Alloc(sz);
+    ASSERT_NE(ptr, nullptr);
+    // whole block is usable
+    memset(ptr, 0xaa, sz);
+    blocks.push_back(ptr);
+  }
+  auto during = llarp::BufferPool::Stats();
+  ASSERT_GE(during.inuse, before.inuse + 1 + 200 + 256 + 257 + 1500 + 4000);
+  ASSERT_GE(during.highwater, during.inuse);
+  ASSERT_EQ(during.allocs, before.allocs + blocks.size());
+
+  for(auto ptr : blocks)
+    llarp::BufferPool::Free(ptr);
+  auto after = llarp::BufferPool::Stats();
+  ASSERT_EQ(after.inuse, before.inuse);
+  ASSERT_GE(after.highwater, during.inuse);
+}
+
+TEST_F(BufferPoolTest, Reuse)
+{
+  void *first = llarp::BufferPool::Alloc(100);
+  llarp::BufferPool::Free(first);
+  auto reserved = llarp::BufferPool::Stats().reserved;
+  // same thread and class gets blocks back off its freelist
+  for(int n = 0; n < 1000; ++n)
+  {
+    void *ptr = llarp::BufferPool::Alloc(100);
+    ASSERT_NE(ptr, nullptr);
+    llarp::BufferPool::Free(ptr);
+  }
+  ASSERT_EQ(llarp::BufferPool::Stats().reserved, reserved);
+}
+
+TEST_F(BufferPoolTest, Cap)
+{
+  auto st = llarp::BufferPool::Stats();
+  // room for what is reserved already and nothing more
+  llarp::BufferPool::SetCap(st.reserved);
+  ASSERT_EQ(llarp::BufferPool::Alloc(64 * 1024), nullptr);
+
+  std::vector< void * > blocks;
+  void *ptr;
+  while((ptr = llarp::BufferPool::Alloc(1024)) != nullptr)
+    blocks.push_back(ptr);
+  auto full = llarp::BufferPool::Stats();
+  ASSERT_GE(full.failures, st.failures + 2);
+  ASSERT_LE(full.reserved, full.cap);
+  ASSERT_EQ(sendbuf_t::alloc(1000), nullptr);
+
+  for(auto block : blocks)
+    llarp::BufferPool::Free(block);
+  ASSERT_NE((ptr = llarp::BufferPool::Alloc(1024)), nullptr);
+  llarp::BufferPool::Free(ptr);
+
+  llarp::BufferPool::SetCap(0);
+  sendbuf_t *buf = sendbuf_t::alloc(1000);
+  ASSERT_NE(buf, nullptr);
+  ASSERT_EQ(buf->size(), 1000u);
+  memset(buf->data(), 0, buf->size());
+  delete buf;
+}
+
+TEST_F(BufferPoolTest, CrossThreadFree)
+{
+  auto before = llarp::BufferPool::Stats();
+  const size_t num = 10000;
+  std::vector< void * > blocks(num);
+  std::thread producer([&]() {
+    for(auto &block : blocks)
+      block = llarp::BufferPool::Alloc(1400);
+  });
+  producer.join();
+  std::thread consumer([&]() {
+    for(auto block : blocks)
+      llarp::BufferPool::Free(block);
+  });
+  consumer.join();
+  auto after = llarp::BufferPool::Stats();
+  ASSERT_EQ(after.inuse, before.inuse);
+  ASSERT_GE(after.highwater, before.inuse + (num * 1400));
+
+  // blocks freed on the consumer went back to the depot when it exited
+  auto reserved = after.reserved;
+  for(auto &block : blocks)
+    block = llarp::BufferPool::Alloc(1400);
+  ASSERT_EQ(llarp::BufferPool::Stats().reserved, reserved);
+  for(auto block : blocks)
+    llarp::BufferPool::Free(block);
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <llarp/iwp/congestion.hpp>
+
+struct CongestionTest : public ::testing::Test
+{
+  congestion_control cc;
+  llarp_time_t now = 100000;
+
+  /// send and ack one message per ms over a link with a fixed rtt and rate
+  void
+  run_link(llarp_time_t rtt, size_t bytesPerMs, llarp_time_t duration)
+  {
+    std::deque< std::pair< llarp_time_t, uint64_t > > sent;
+    llarp_time_t end = now + duration;
+    while(now < end)
+    {
+      if(cc.can_send(bytesPerMs))
+      {
+        sent.emplace_back(now, cc.delivered);
+        cc.on_send(bytesPerMs);
+      }
+      while(sent.size() && now - sent.front().first >= rtt)
+      {
+        cc.on_rtt_sample(now - sent.front().first, now);
+        cc.on_delivered(bytesPerMs, sent.front().first, sent.front().second,
+                        now);
+        sent.pop_front();
+      }
+      ++now;
+    }
+  }
+};
+
+TEST_F(CongestionTest, InitialState)
+{
+  iwp_session_stats st;
+  cc.fill_stats(st);
+  ASSERT_EQ(st.rto, congestion_control::InitialRTO);
+  ASSERT_EQ(st.cwnd, congestion_control::InitialWindow);
+  ASSERT_TRUE(cc.can_send(congestion_control::MaxWindow));
+}
+
+TEST_F(CongestionTest, RTTEstimate)
+{
+  for(int n = 0; n < 50; ++n)
+    cc.on_rtt_sample(100, now++);
+  ASSERT_EQ(cc.srtt, 100u);
+  ASSERT_EQ(cc.minRTT, 100u);
+  ASSERT_LE(cc.rttvar, 5u);
+  // clamped to the minimum
+  ASSERT_EQ(cc.rto, congestion_control::MinRTO);
+
+  // jitter raises rttvar and the rto with it
+  for(int n = 0; n < 50; ++n)
+    cc.on_rtt_sample(n % 2 ? 50 : 350, now++);
+  ASSERT_GT(cc.rttvar, 50u);
+  ASSERT_GT(cc.rto, cc.srtt);
+  ASSERT_EQ(cc.minRTT, 50u);
+}
+
+TEST_F(CongestionTest, TimeoutBacksOff)
+{
+  cc.on_rtt_sample(400, now);
+  auto rto = cc.rto;
+  cc.on_timeout();
+  ASSERT_EQ(cc.rto, rto * 2);
+  for(int n = 0; n < 10; ++n)
+    cc.on_timeout();
+  ASSERT_EQ(cc.rto, congestion_control::MaxRTO);
+  ASSERT_GE(cc.cwnd, congestion_control::MinWindow);
+  ASSERT_EQ(cc.timeouts, 11u);
+}
+
+TEST_F(CongestionTest, WindowTracksBDP)
+{
+  // 1MB/s with a 50ms rtt is a 50KB bdp
+  run_link(50, 1000, 5000);
+  iwp_session_stats st;
+  cc.fill_stats(st);
+  ASSERT_NE(cc.mode, congestion_control::eStartup);
+  ASSERT_GE(st.btlbw, 900000u);
+  ASSERT_LE(st.btlbw, 1100000u);
+  ASSERT_GE(st.cwnd, 50000u);
+  ASSERT_LE(st.cwnd, 150000u);
+  ASSERT_LE(st.inflight, st.cwnd + 1000);
+}
@@ -1,5 +1,15 @@
 #include <gtest/gtest.h>
+#include <llarp/crypto.hpp>
 #include <llarp/dht.hpp>
+#include <llarp/dht/context.hpp>
+#include <llarp/dht/messages/findrouter.hpp>
+#include <llarp/messages/dht_immediate.hpp>
+#include <llarp/time.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iostream>
 
 using Key_t = llarp::dht::Key_t;
 
@@ -69,3 +79,424 @@ TEST_F(KademliaDHTTest, TestBucketRandomzied)
   target.Randomize();
   ASSERT_TRUE(nodes->FindClosest(target, result));
 };
+
+TEST_F(KademliaDHTTest, TestBucketEvictsLeastRecentlySeen)
+{
+  llarp::dht::Bucket< llarp::dht::RCNode > table(us, 4);
+  // all differ from us in the first bit so they share bucket 0
+  std::vector< Key_t > keys;
+  for(byte_t fill = 0x80; fill < 0x86; ++fill)
+  {
+    llarp::dht::RCNode n;
+    n.ID.Fill(fill);
+    keys.push_back(n.ID);
+  }
+  for(size_t idx = 0; idx < 4; ++idx)
+  {
+    llarp::dht::RCNode n;
+    n.ID = keys[idx];
+    table.PutNode(n);
+  }
+  // seeing the oldest again saves it
+  llarp::dht::RCNode seen;
+  seen.ID = keys[0];
+  table.PutNode(seen);
+  llarp::dht::RCNode n;
+  n.ID = keys[4];
+  table.PutNode(n);
+  ASSERT_EQ(table.Size(), 4u);
+  ASSERT_TRUE(table.HasNode(keys[0]));
+  ASSERT_FALSE(table.HasNode(keys[1]));
+  ASSERT_TRUE(table.HasNode(keys[4]));
+  // split once, then bucket 0 can't hold us so it evicts
+  ASSERT_EQ(table.NumBuckets(), 2u);
+}
+
+TEST_F(KademliaDHTTest, TestBucketKeepsPinned)
+{
+  llarp::dht::Bucket< llarp::dht::RCNode > table(us, 4);
+  std::vector< Key_t > keys;
+  for(byte_t fill = 0x80; fill < 0x88; ++fill)
+  {
+    llarp::dht::RCNode n;
+    n.ID.Fill(fill);
+    keys.push_back(n.ID);
+  }
+  // the two oldest are pinned, so the next two go first
+  for(size_t idx = 0; idx < 4; ++idx)
+  {
+    llarp::dht::RCNode n;
+    n.ID = keys[idx];
+    table.PutNode(n, idx < 2);
+  }
+  for(size_t idx = 4; idx < 6; ++idx)
+  {
+    llarp::dht::RCNode n;
+    n.ID = keys[idx];
+    table.PutNode(n, true);
+  }
+  ASSERT_EQ(table.Size(), 4u);
+  ASSERT_TRUE(table.HasNode(keys[0]));
+  ASSERT_TRUE(table.HasNode(keys[1]));
+  ASSERT_FALSE(table.HasNode(keys[2]));
+  ASSERT_FALSE(table.HasNode(keys[3]));
+  // all pinned, pinned entries still get in and others don't
+  llarp::dht::RCNode n;
+  n.ID = keys[6];
+  table.PutNode(n);
+  ASSERT_FALSE(table.HasNode(keys[6]));
+  n.ID = keys[7];
+  table.PutNode(n, true);
+  ASSERT_EQ(table.Size(), 5u);
+  // until there is room under k again
+  table.DelNode(keys[0]);
+  table.DelNode(keys[1]);
+  n.ID = keys[6];
+  table.PutNode(n);
+  ASSERT_TRUE(table.HasNode(keys[6]));
+}
+
+TEST_F(KademliaDHTTest, TestBucketSplitsAndFindsClosestK)
+{
+  llarp::dht::Bucket< llarp::dht::RCNode > table(us);
+  for(size_t idx = 0; idx < 2000; ++idx)
+  {
+    llarp::dht::RCNode n;
+    n.ID.Randomize();
+    table.PutNode(n);
+  }
+  ASSERT_GT(table.NumBuckets(), 1u);
+  ASSERT_LE(table.Size(), table.NumBuckets() * table.DefaultK);
+
+  std::vector< Key_t > all;
+  table.ForEach([&](const llarp::dht::RCNode &node) -> bool {
+    all.push_back(node.ID);
+    return true;
+  });
+  ASSERT_EQ(all.size(), table.Size());
+
+  for(size_t n = 0; n < 100; ++n)
+  {
+    Key_t target;
+    target.Randomize();
+    // half the time somewhere near us
+    if(n % 2)
+      memcpy(target.data(), us.data(), 1 + (n % 8));
+    std::set< Key_t > exclude = {all[n]};
+    std::vector< Key_t > expect;
+    for(const auto &key : all)
+      if(key != all[n])
+        expect.push_back(key);
+    std::sort(expect.begin(), expect.end(),
+              [&target](const Key_t &a, const Key_t &b) {
+                return (a ^ target) < (b ^ target);
+              });
+    expect.resize(8);
+
+    std::vector< Key_t > closest;
+    ASSERT_TRUE(table.FindClosestK(target, 8, closest, exclude));
+    ASSERT_EQ(closest, expect);
+    Key_t result;
+    ASSERT_TRUE(table.FindCloseExcluding(target, result, exclude));
+    ASSERT_EQ(result, expect[0]);
+  }
+}
+
+TEST_F(KademliaDHTTest, TestBucketRandomAndRemove)
+{
+  llarp::dht::Bucket< llarp::dht::RCNode > table(us, 0);
+  for(size_t idx = 0; idx < 1000; ++idx)
+  {
+    llarp::dht::RCNode n;
+    n.ID.Randomize();
+    n.ID.data()[31] = idx % 2;
+    table.PutNode(n);
+  }
+  // k of 0 keeps everything
+  ASSERT_EQ(table.Size(), 1000u);
+  auto odd = [](const llarp::dht::RCNode &node) -> bool {
+    return node.ID.data()[31] == 1;
+  };
+  ASSERT_EQ(table.RemoveIf(odd), 500u);
+  ASSERT_EQ(table.Size(), 500u);
+
+  std::set< Key_t > exclude;
+  table.ForEach([&](const llarp::dht::RCNode &node) -> bool {
+    exclude.insert(node.ID);
+    return exclude.size() < 499;
+  });
+  Key_t result;
+  for(size_t n = 0; n < 20; ++n)
+  {
+    ASSERT_TRUE(table.GetRandomNodeExcluding(result, exclude));
+    ASSERT_EQ(exclude.count(result), 0u);
+    ASSERT_EQ(result.data()[31], 0);
+  }
+  table.DelNode(result);
+  ASSERT_FALSE(table.GetRandomNodeExcluding(result, exclude));
+}
+
+TEST_F(KademliaDHTTest, BenchBucketFindClosest)
+{
+  const size_t numNodes   = 20000;
+  const size_t numLookups = 2000;
+  llarp::dht::Bucket< llarp::dht::RCNode > table(us);
+  // what the flat bucket did, scan everything
+  std::vector< Key_t > flat;
+  for(size_t idx = 0; idx < numNodes; ++idx)
+  {
+    llarp::dht::RCNode n;
+    n.ID.Randomize();
+    table.PutNode(n);
+    flat.push_back(n.ID);
+  }
+  std::vector< Key_t > targets(numLookups);
+  for(auto &target : targets)
+    target.Randomize();
+
+  auto started = llarp_time_now_ms();
+  Key_t result;
+  for(const auto &target : targets)
+  {
+    Key_t mindist;
+    mindist.Fill(0xff);
+    for(const auto &key : flat)
+    {
+      auto dist = key ^ target;
+      if(dist < mindist)
+      {
+        mindist = dist;
+        result  = key;
+      }
+    }
+  }
+  auto flatTime = llarp_time_now_ms() - started;
+
+  started = llarp_time_now_ms();
+  std::vector< Key_t > closest;
+  for(const auto &target : targets)
+    ASSERT_TRUE(table.FindClosestK(target, 8, closest));
+  auto tableTime = llarp_time_now_ms() - started;
+  std::cout << numNodes << " nodes, " << table.Size() << " kept in "
+            << table.NumBuckets() << " buckets, " << numLookups
+            << " lookups flat: " << flatTime << "ms closest 8: " << tableTime
+            << "ms" << std::endl;
+}
+
+TEST_F(KademliaDHTTest, TestLookupCache)
+{
+  llarp::dht::LookupCache< int > cache(4);
+  llarp_time_t now = 100000;
+  Key_t keys[6];
+  for(auto &key : keys)
+    key.Randomize();
+
+  ASSERT_EQ(cache.Get(keys[0], now), nullptr);
+  cache.Put(keys[0], 42, now + 1000);
+  cache.PutMissing(keys[1], now);
+  auto found = cache.Get(keys[0], now);
+  ASSERT_NE(found, nullptr);
+  ASSERT_TRUE(found->found);
+  ASSERT_EQ(found->val, 42);
+  auto missing = cache.Get(keys[1], now);
+  ASSERT_NE(missing, nullptr);
+  ASSERT_FALSE(missing->found);
+  ASSERT_EQ(cache.stats.hits, 1u);
+  ASSERT_EQ(cache.stats.negativeHits, 1u);
+  ASSERT_EQ(cache.stats.misses, 1u);
+
+  // entries expire on their own ttl
+  ASSERT_EQ(cache.Get(keys[0], now + 1000), nullptr);
+  ASSERT_NE(cache.Get(keys[1], now + 1000), nullptr);
+  ASSERT_EQ(
+      cache.Get(keys[1], now + llarp::dht::LookupCache< int >::NegativeTTL),
+      nullptr);
+
+  cache.Expire(now + llarp::dht::LookupCache< int >::NegativeTTL);
+  ASSERT_EQ(cache.Size(), 0u);
+  ASSERT_GT(cache.stats.HitRate(), 0.0);
+
+  // full, the least recently used goes first
+  for(size_t idx = 0; idx < 4; ++idx)
+    cache.Put(keys[idx], idx, now + 1000);
+  ASSERT_NE(cache.Get(keys[0], now), nullptr);
+  cache.Put(keys[5], 5, now + 1000);
+  ASSERT_EQ(cache.Size(), 4u);
+  ASSERT_NE(cache.Get(keys[0], now), nullptr);
+  ASSERT_EQ(cache.Get(keys[1], now), nullptr);
+  ASSERT_NE(cache.Get(keys[5], now), nullptr);
+}
+
+struct DHTLookupTest : public ::testing::Test
+{
+  /// a find router request we sent
+  struct Sent
+  {
+    Key_t peer;
+    uint64_t txid;
+  };
+
+  llarp_crypto crypto;
+  llarp::dht::Context ctx;
+  Key_t us;
+  llarp::SecretKey identity;
+  llarp_rc target;
+  std::vector< Sent > sent;
+  llarp_router_lookup_job jobs[2];
+  size_t answered = 0;
+
+  DHTLookupTest()
+  {
+    llarp_crypto_libsodium_init(&crypto);
+  }
+
+  void
+  SetUp()
+  {
+    us.Randomize();
+    ctx.Init(us, &crypto, std::bind(&DHTLookupTest::Send, this,
+                                    std::placeholders::_1,
+                                    std::placeholders::_2));
+    for(size_t idx = 0; idx < 8; ++idx)
+    {
+      llarp::dht::RCNode n;
+      n.ID.Randomize();
+      ctx.nodes->PutNode(n);
+    }
+    llarp_rc_clear(&target);
+    llarp::SecretKey encryption;
+    crypto.identity_keygen(identity);
+    crypto.encryption_keygen(encryption);
+    llarp_rc_set_pubsigkey(&target, llarp::seckey_topublic(identity));
+    llarp_rc_set_pubenckey(&target, llarp::seckey_topublic(encryption));
+    target.last_updated = llarp_time_now_ms();
+    llarp_rc_sign(&crypto, identity, &target);
+    for(auto &job : jobs)
+    {
+      job.user  = this;
+      job.hook  = &Answered;
+      job.found = false;
+      llarp_rc_clear(&job.result);
+      memcpy(job.target, target.pubkey, PUBKEYSIZE);
+    }
+  }
+
+  void
+  TearDown()
+  {
+    for(auto &job : jobs)
+      llarp_rc_free(&job.result);
+    llarp_rc_free(&target);
+  }
+
+  void
+  Send(const Key_t &peer, const llarp::ILinkMessage *msg)
+  {
+    typedef llarp::DHTImmeidateMessage Immediate_t;
+    typedef llarp::dht::FindRouterMessage Find_t;
+    auto imm = dynamic_cast< const Immediate_t * >(msg);
+    ASSERT_NE(imm, nullptr);
+    auto find = dynamic_cast< const Find_t * >(imm->msgs[0]);
+    ASSERT_NE(find, nullptr);
+    sent.push_back({peer, find->txid});
+    delete msg;
+  }
+
+  static void
+  Answered(llarp_router_lookup_job *job)
+  {
+    ++static_cast< DHTLookupTest * >(job->user)->answered;
+  }
+
+  void
+  Lookup(llarp_router_lookup_job *job)
+  {
+    ctx.LookupRouter(target.pubkey, us, 0, job);
+  }
+
+  /// answer our idx'th request like GotRouterMessage does
+  void
+  Reply(size_t idx, const llarp_rc *rc)
+  {
+    auto pending = ctx.FindPendingTX(sent[idx].peer, sent[idx].txid);
+    ASSERT_NE(pending, nullptr);
+    llarp::dht::SearchJob job = *pending;
+    ctx.RemovePendingLookup(sent[idx].peer, sent[idx].txid);
+    ctx.RouterLookupReply(job, rc);
+  }
+};
+
+TEST_F(DHTLookupTest, AlphaInFlightRefilledOnMiss)
+{
+  Lookup(&jobs[0]);
+  ASSERT_EQ(sent.size(), llarp::dht::IterativeLookup::Alpha);
+  Reply(0, nullptr);
+  ASSERT_EQ(sent.size(), llarp::dht::IterativeLookup::Alpha + 1);
+  ASSERT_EQ(answered, 0u);
+  // every peer misses, then we give up
+  for(size_t idx = 1; idx < sent.size(); ++idx)
+    Reply(idx, nullptr);
+  ASSERT_EQ(sent.size(), 8u);
+  ASSERT_EQ(answered, 1u);
+  ASSERT_FALSE(jobs[0].found);
+}
+
+TEST_F(DHTLookupTest, TimeoutCountsAsMiss)
+{
+  Lookup(&jobs[0]);
+  ctx.FindPendingTX(sent[0].peer, sent[0].txid)->started = 0;
+  ctx.CleanupTX();
+  ASSERT_EQ(ctx.FindPendingTX(sent[0].peer, sent[0].txid), nullptr);
+  ASSERT_EQ(sent.size(), llarp::dht::IterativeLookup::Alpha + 1);
+  ASSERT_EQ(answered, 0u);
+}
+
+TEST_F(DHTLookupTest, FirstValidAnswerFinishesEveryWaiter)
+{
+  Lookup(&jobs[0]);
+  Lookup(&jobs[1]);
+  // the second waits on the first
+  ASSERT_EQ(sent.size(), llarp::dht::IterativeLookup::Alpha);
+  Reply(1, &target);
+  ASSERT_EQ(answered, 2u);
+  ASSERT_TRUE(jobs[0].found);
+  ASSERT_TRUE(jobs[1].found);
+  // late answers change nothing
+  Reply(0, nullptr);
+  ASSERT_EQ(sent.size(), llarp::dht::IterativeLookup::Alpha);
+  ASSERT_EQ(answered, 2u);
+  // and the cache answers the next one
+  jobs[0].found = false;
+  Lookup(&jobs[0]);
+  ASSERT_EQ(answered, 3u);
+  ASSERT_TRUE(jobs[0].found);
+  ASSERT_EQ(sent.size(), llarp::dht::IterativeLookup::Alpha);
+}
+
+TEST_F(DHTLookupTest, InvalidAnswerIsMiss)
+{
+  Lookup(&jobs[0]);
+  // someone else's rc
+  llarp_rc other;
+  llarp_rc_clear(&other);
+  llarp::SecretKey otherIdentity;
+  crypto.identity_keygen(otherIdentity);
+  llarp_rc_set_pubsigkey(&other, llarp::seckey_topublic(otherIdentity));
+  llarp_rc_sign(&crypto, otherIdentity, &other);
+  Reply(0, &other);
+  llarp_rc_free(&other);
+  ASSERT_EQ(answered, 0u);
+  ASSERT_EQ(sent.size(), llarp::dht::IterativeLookup::Alpha + 1);
+  // the target's rc, but not as it signed it
+  llarp_rc forged;
+  llarp_rc_clear(&forged);
+  llarp_rc_copy(&forged, &target);
+  forged.last_updated += 1;
+  Reply(1, &forged);
+  llarp_rc_free(&forged);
+  ASSERT_EQ(answered, 0u);
+  ASSERT_EQ(sent.size(), llarp::dht::IterativeLookup::Alpha + 2);
+  Reply(2, &target);
+  ASSERT_EQ(answered, 1u);
+  ASSERT_TRUE(jobs[0].found);
+}
@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+#include <llarp/ev.h>
+#include <llarp/net.hpp>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include "ev.hpp"
+#ifdef LLARP_IO_URING
+#include "ev_uring.hpp"
+#endif
+
+struct EventLoopTest : public ::testing::TestWithParam< const char* >
+{
+  static constexpr size_t NumPackets = 1000;
+
+  llarp_ev_loop* loop = nullptr;
+  /// the backend asked for can't run here, llarp fell back to the default
+  bool unavailable    = false;
+  llarp_udp_io sender = {};
+  llarp_udp_io recver = {};
+  size_t received     = 0;
+  size_t receivedBytes = 0;
+
+  void
+  SetUp()
+  {
+    llarp_ev_loop_alloc_backend(&loop, GetParam());
+    ASSERT_NE(loop, nullptr);
+    if(!strcmp(GetParam(), "io_uring"))
+    {
+#ifdef LLARP_IO_URING
+      // make sure we really test the uring loop whenever it can run
+      llarp_uring_loop probe;
+      if(probe.init())
+        ASSERT_NE(dynamic_cast< llarp_uring_loop* >(loop), nullptr);
+      else
+        unavailable = true;
+#else
+      unavailable = true;
+#endif
+    }
+    sender.user     = this;
+    sender.recvfrom = &noop_recv;
+    recver.user     = this;
+    recver.recvfrom = &handle_recv;
+  }
+
+  void
+  TearDown()
+  {
+    if(sender.impl)
+      llarp_ev_close_udp(&sender);
+    if(recver.impl)
+      llarp_ev_close_udp(&recver);
+    llarp_ev_loop_free(&loop);
+  }
+
+  static void
+  noop_recv(llarp_udp_io*, const sockaddr*, const void*, ssize_t)
+  {
+  }
+
+  static void
+  handle_recv(llarp_udp_io* udp, const sockaddr*, const void* buf, ssize_t sz)
+  {
+    EventLoopTest* self = static_cast< EventLoopTest* >(udp->user);
+    ++self->received;
+    self->receivedBytes += sz;
+  }
+
+  /// bind to an ephemeral port on loopback and return the bound address
+  bool
+  bind(llarp_udp_io* udp, llarp::Addr& bound)
+  {
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(llarp_ev_add_udp(loop, udp, (const sockaddr*)&addr) == -1)
+      return false;
+    socklen_t slen = sizeof(addr);
+    int fd         = static_cast< llarp::ev_io* >(udp->impl)->fd;
+    if(getsockname(fd, (sockaddr*)&addr, &slen) == -1)
+      return false;
+    bound = llarp::Addr(*(const sockaddr*)&addr);
+    return true;
+  }
+};
+
+constexpr size_t EventLoopTest::NumPackets;
+
+TEST_P(EventLoopTest, UDPLoopback)
+{
+  if(unavailable)
+  {
+    std::cout << "skipped, " << GetParam() << " unavailable" << std::endl;
+    return;
+  }
+  llarp::Addr senderAddr, recverAddr;
+  ASSERT_TRUE(bind(&sender, senderAddr));
+  ASSERT_TRUE(bind(&recver, recverAddr));
+
+  byte_t buf[1024];
+  memset(buf, 'x', sizeof(buf));
+  auto started = std::chrono::steady_clock::now();
+  size_t sent  = 0;
+  // send in bursts small enough for the socket buffer
+  while(sent < NumPackets)
+  {
+    for(size_t idx = 0; idx < 50 && sent < NumPackets; ++idx, ++sent)
+      ASSERT_EQ(llarp_ev_udp_sendto(&sender, recverAddr, buf, sizeof(buf)),
+                ssize_t(sizeof(buf)));
+    for(size_t idx = 0; idx < 100 && received < sent; ++idx)
+      loop->tick(1);
+  }
+  for(size_t idx = 0; idx < 100 && received < NumPackets; ++idx)
+    loop->tick(10);
+  auto elapsed = std::chrono::duration_cast< std::chrono::microseconds >(
+                     std::chrono::steady_clock::now() - started)
+                     .count();
+
+  ASSERT_EQ(received, NumPackets);
+  ASSERT_EQ(receivedBytes, NumPackets * sizeof(buf));
+  std::cout << GetParam() << ": " << received << " datagrams in " << elapsed
+            << "us" << std::endl;
+}
+
+TEST_P(EventLoopTest, CloseWithQueuedSends)
+{
+  if(unavailable)
+  {
+    std::cout << "skipped, " << GetParam() << " unavailable" << std::endl;
+    return;
+  }
+  llarp::Addr senderAddr, recverAddr;
+  ASSERT_TRUE(bind(&sender, senderAddr));
+  ASSERT_TRUE(bind(&recver, recverAddr));
+  byte_t buf[64];
+  memset(buf, 'x', sizeof(buf));
+  for(size_t idx = 0; idx < 10; ++idx)
+    llarp_ev_udp_sendto(&sender, recverAddr, buf, sizeof(buf));
+  llarp_ev_close_udp(&sender);
+  ASSERT_EQ(sender.impl, nullptr);
+  // likely gets the closed socket's fd back
+  ASSERT_TRUE(bind(&sender, senderAddr));
+  for(size_t idx = 0; idx < 10; ++idx)
+    loop->tick(1);
+  // epoll flushes on close, io_uring drops what never reached the ring
+  // rather than send it from whatever socket has the fd now
+  if(!strcmp(GetParam(), "io_uring"))
+  {
+    ASSERT_EQ(received, 0u);
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Backends, EventLoopTest,
+                        ::testing::Values("epoll", "io_uring"));
+
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+TEST(ReusePortTest, KernelPicksOurShard)
+{
+  static constexpr size_t NumSockets = 4;
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int fds[NumSockets];
+  for(size_t idx = 0; idx < NumSockets; ++idx)
+  {
+    fds[idx] = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    int on   = 1;
+    ASSERT_EQ(setsockopt(fds[idx], SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)),
+              0);
+    ASSERT_EQ(bind(fds[idx], (const sockaddr*)&addr, sizeof(addr)), 0);
+    // the rest share the port the first one got
+    socklen_t slen = sizeof(addr);
+    ASSERT_EQ(getsockname(fds[idx], (sockaddr*)&addr, &slen), 0);
+  }
+  ASSERT_TRUE(llarp::SteerReusePort(fds[0], NumSockets));
+
+  size_t checked = 0;
+  for(size_t n = 0; n < 32; ++n)
+  {
+    // bound so we know the source address the kernel sees
+    sockaddr_in from = addr;
+    from.sin_port    = 0;
+    int sender       = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_NE(sender, -1);
+    ASSERT_EQ(bind(sender, (const sockaddr*)&from, sizeof(from)), 0);
+    ASSERT_EQ(sendto(sender, "x", 1, 0, (const sockaddr*)&addr, sizeof(addr)),
+              1);
+    socklen_t slen = sizeof(from);
+    ASSERT_EQ(getsockname(sender, (sockaddr*)&from, &slen), 0);
+    size_t expect = llarp::ReusePortIndex(
+        llarp::Addr(*(const sockaddr*)&from), NumSockets);
+    char buf[8];
+    // loopback delivers before sendto returns
+    for(size_t idx = 0; idx < NumSockets; ++idx)
+    {
+      if(recv(fds[idx], buf, sizeof(buf), 0) == 1)
+      {
+        ASSERT_EQ(idx, expect);
+        ++checked;
+      }
+    }
+    close(sender);
+  }
+  ASSERT_EQ(checked, 32u);
+  for(auto fd : fds)
+    close(fd);
+}
+#endif
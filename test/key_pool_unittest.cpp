@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <llarp/key_pool.hpp>
+#include <llarp/time.h>
+
+#include <chrono>
+#include <set>
+#include <thread>
+
+struct KeyPoolTest : public ::testing::Test
+{
+  llarp_crypto crypto;
+  llarp_threadpool *worker;
+
+  KeyPoolTest()
+  {
+    llarp_crypto_libsodium_init(&crypto);
+  }
+
+  void
+  SetUp()
+  {
+    worker = llarp_init_threadpool(1, "test-keygen");
+  }
+
+  void
+  TearDown()
+  {
+    llarp_threadpool_stop(worker);
+    llarp_threadpool_join(worker);
+    llarp_free_threadpool(&worker);
+  }
+
+  /// wait for a refill to get pool to target keys
+  static void
+  WaitFor(llarp::KeyPool &pool, size_t target)
+  {
+    auto started = llarp_time_now_ms();
+    while(pool.Size() < target && llarp_time_now_ms() - started < 5000)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+};
+
+TEST_F(KeyPoolTest, EmptyPoolStillGivesKeys)
+{
+  llarp::KeyPool pool(&crypto, 16);
+  llarp::SecretKey key;
+  key.Zero();
+  pool.Take(key);
+  ASSERT_FALSE(key.IsZero());
+  ASSERT_EQ(pool.misses, 1u);
+  ASSERT_EQ(pool.hits, 0u);
+}
+
+TEST_F(KeyPoolTest, RefillsInBackground)
+{
+  llarp::KeyPool pool(&crypto, 16);
+  pool.MaybeRefill(worker);
+  WaitFor(pool, 16);
+  ASSERT_EQ(pool.Size(), 16u);
+  // at or above half the target there is nothing to do
+  llarp::SecretKey key;
+  std::set< llarp::SecretKey > seen;
+  for(size_t idx = 0; idx < 8; ++idx)
+  {
+    pool.Take(key);
+    ASSERT_TRUE(seen.insert(key).second);
+    pool.MaybeRefill(worker);
+  }
+  ASSERT_EQ(pool.hits, 8u);
+  ASSERT_EQ(pool.misses, 0u);
+  // below half it tops back up
+  pool.Take(key);
+  ASSERT_TRUE(seen.insert(key).second);
+  pool.MaybeRefill(worker);
+  WaitFor(pool, 16);
+  ASSERT_EQ(pool.Size(), 16u);
+}
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include <llarp/logger.hpp>
+#include <llarp/time.h>
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+struct Point
+{
+  int x, y;
+
+  friend std::ostream&
+  operator<<(std::ostream& out, const Point& p)
+  {
+    return out << std::hex << "(" << p.x << "," << p.y << ")";
+  }
+};
+
+struct LoggerTest : public ::testing::Test
+{
+  static constexpr size_t Rounds = 100000;
+  static constexpr size_t Batch  = 500;
+
+  std::stringstream written;
+
+  /// log args to log like the macros do
+  template < typename... TArgs >
+  static void
+  Log(llarp::Logger& log, llarp::LogLevel lvl, const TArgs&... args)
+  {
+    llarp::_LogEmit(log, lvl, "test", 1, llarp_time_now_ms(), 0, args...);
+  }
+
+  /// the synchronous log call we had
+  template < typename... TArgs >
+  static void
+  OldLog(std::ostream& out, std::mutex& access, const TArgs&... args)
+  {
+    std::stringstream ss;
+    ss << (char)27 << "[1m";
+    ss << "[NFO] ";
+    ss << "test " << llarp_time_now_ms() << " test:1\t";
+    using expand = int[];
+    (void)expand{0, ((ss << args), 0)...};
+    ss << (char)27 << "[0;0m";
+    std::unique_lock< std::mutex > lock(access);
+    out << ss.str() << std::endl;
+  }
+};
+
+constexpr size_t LoggerTest::Rounds;
+constexpr size_t LoggerTest::Batch;
+
+TEST_F(LoggerTest, FormatsOnLogThread)
+{
+  llarp::Logger log(written, "node");
+  char scratch[16];
+  strncpy(scratch, "stack", sizeof(scratch));
+  Log(log, llarp::eLogInfo, "text ", 42, " ", -7, " ", 'c', " ", true, " ",
+      1.5, " ", std::string("string"), " ", scratch, " ", Point{10, 11}, " ",
+      12);
+  // what we logged was copied, not referenced
+  strncpy(scratch, "gone", sizeof(scratch));
+  log.Flush();
+  std::string line = written.str();
+  ASSERT_NE(line.find("[NFO] node "), std::string::npos) << line;
+  ASSERT_NE(line.find("test:1\ttext 42 -7 c 1 1.5 string stack (a,b) 12"),
+            std::string::npos)
+      << line;
+}
+
+TEST_F(LoggerTest, TruncatesLongLines)
+{
+  llarp::Logger log(written, "node");
+  std::string big(4 * llarp::LogRecord::Size, 'x');
+  Log(log, llarp::eLogWarn, "big ", big);
+  Log(log, llarp::eLogWarn, "formatted ", 1, Point{1, 2}, big);
+  log.Flush();
+  std::string line;
+  ASSERT_TRUE(std::getline(written, line));
+  ASSERT_LT(line.size(), 2 * llarp::LogRecord::Size);
+  ASSERT_NE(line.find("xxx..."), std::string::npos);
+  ASSERT_TRUE(std::getline(written, line));
+  ASSERT_NE(line.find("formatted 1(1,2)x"), std::string::npos);
+}
+
+TEST_F(LoggerTest, DropsWhenBehind)
+{
+  llarp::Logger log(written, "node");
+  {
+    // hold the log thread up on its first write
+    std::unique_lock< std::mutex > lock(log.access);
+    for(size_t idx = 0; idx < 2000; ++idx)
+      Log(log, llarp::eLogInfo, "message ", idx);
+  }
+  ASSERT_GT(log.dropped.load(), 0u);
+  log.Flush();
+  Log(log, llarp::eLogInfo, "after");
+  log.Flush();
+  ASSERT_NE(written.str().find("log messages"), std::string::npos);
+  ASSERT_NE(written.str().find("after"), std::string::npos);
+}
+
+TEST_F(LoggerTest, RateLimitsCallSite)
+{
+  llarp::LogLimiter site;
+  llarp_time_t now    = 5000;
+  uint32_t suppressed = 0;
+  size_t allowed      = 0;
+  for(size_t idx = 0; idx < 25; ++idx)
+  {
+    if(site.Allow(now, suppressed))
+      ++allowed;
+  }
+  ASSERT_EQ(allowed, llarp::LogLimiter::Burst);
+  ASSERT_EQ(suppressed, 0u);
+  // the next window reports what was held back
+  ASSERT_TRUE(site.Allow(now + llarp::LogLimiter::Interval, suppressed));
+  ASSERT_EQ(suppressed, 25 - llarp::LogLimiter::Burst);
+}
+
+TEST_F(LoggerTest, BenchLog)
+{
+  std::mutex access;
+  std::stringstream old;
+  auto started = llarp_time_now_ms();
+  for(size_t idx = 0; idx < Rounds; ++idx)
+    OldLog(old, access, "relayed ", idx, " bytes on path ", Point{1, 2});
+  auto oldTime = llarp_time_now_ms() - started;
+
+  // what the caller pays, flushing between batches so nothing is dropped
+  llarp::Logger log(written, "node");
+  llarp_time_t queueTime = 0;
+  for(size_t idx = 0; idx < Rounds; idx += Batch)
+  {
+    started = llarp_time_now_ms();
+    for(size_t n = idx; n < idx + Batch; ++n)
+      Log(log, llarp::eLogInfo, "relayed ", n, " bytes on path ", Point{1, 2});
+    queueTime += llarp_time_now_ms() - started;
+    log.Flush();
+  }
+  ASSERT_EQ(log.dropped.load(), 0u);
+
+  std::cout << "logged " << Rounds << " lines, synchronous: " << oldTime
+            << "ms queued for the log thread: " << queueTime << "ms"
+            << std::endl;
+}
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include <llarp/crypto.hpp>
+#include <llarp/nodedb.h>
+#include <llarp/threadpool.h>
+#include <llarp/time.h>
+
+#include <fstream>
+#include "fs.hpp"
+
+struct NodeDBTest : public ::testing::Test
+{
+  static constexpr size_t NumRCs = 4000;
+
+  llarp_crypto crypto;
+  fs::path dir;
+
+  NodeDBTest()
+  {
+    llarp_crypto_libsodium_init(&crypto);
+  }
+
+  void
+  SetUp()
+  {
+    char tmpl[] = "/tmp/llarp-nodedb-XXXXXX";
+    ASSERT_NE(mkdtemp(tmpl), nullptr);
+    dir = tmpl;
+    ASSERT_TRUE(llarp_nodedb_ensure_dir(dir.string().c_str()));
+  }
+
+  void
+  TearDown()
+  {
+    fs::remove_all(dir);
+  }
+
+  /// sign and store num rcs through a nodedb pointed at dir
+  void
+  Generate(size_t num)
+  {
+    llarp_nodedb *db = llarp_nodedb_new(&crypto);
+    ASSERT_EQ(llarp_nodedb_load_dir(db, dir.string().c_str()), 0);
+    llarp::SecretKey identity, encryption;
+    for(size_t idx = 0; idx < num; ++idx)
+    {
+      llarp_rc rc;
+      llarp_rc_clear(&rc);
+      crypto.identity_keygen(identity);
+      crypto.encryption_keygen(encryption);
+      llarp_rc_set_pubsigkey(&rc, llarp::seckey_topublic(identity));
+      llarp_rc_set_pubenckey(&rc, llarp::seckey_topublic(encryption));
+      rc.last_updated = llarp_time_now_ms();
+      llarp_rc_sign(&crypto, identity, &rc);
+      ASSERT_TRUE(llarp_nodedb_put_rc(db, &rc));
+      llarp_rc_free(&rc);
+    }
+    llarp_nodedb_free(&db);
+  }
+
+  /// files that must not load
+  void
+  AddJunk()
+  {
+    std::ofstream garbage((dir / "0" / "garbage.signed").string());
+    garbage << "not an rc";
+    std::ofstream other((dir / "1" / "readme.txt").string());
+    other << "ignored";
+  }
+};
+
+constexpr size_t NodeDBTest::NumRCs;
+
+TEST_F(NodeDBTest, ParallelLoad)
+{
+  Generate(NumRCs);
+  AddJunk();
+
+  llarp_nodedb *serial = llarp_nodedb_new(&crypto);
+  auto started         = llarp_time_now_ms();
+  ASSERT_EQ(llarp_nodedb_load_dir(serial, dir.string().c_str()),
+            ssize_t(NumRCs));
+  auto serialTime = llarp_time_now_ms() - started;
+
+  llarp_threadpool *disk   = llarp_init_threadpool(1, "test-disk");
+  llarp_threadpool *worker = llarp_init_threadpool(4, "test-worker");
+  llarp_nodedb *parallel   = llarp_nodedb_new(&crypto);
+  started                  = llarp_time_now_ms();
+  ASSERT_EQ(llarp_nodedb_load_dir_parallel(parallel, dir.string().c_str(),
+                                           disk, worker),
+            ssize_t(NumRCs));
+  auto parallelTime = llarp_time_now_ms() - started;
+  std::cout << "loaded " << NumRCs << " RCs serial: " << serialTime
+            << "ms parallel: " << parallelTime << "ms" << std::endl;
+
+  ASSERT_EQ(llarp_nodedb_num_loaded(parallel), NumRCs);
+  struct llarp_nodedb_iter iter;
+  iter.user  = parallel;
+  iter.visit = [](llarp_nodedb_iter *i) -> bool {
+    llarp_nodedb *db = static_cast< llarp_nodedb * >(i->user);
+    auto rc          = llarp_nodedb_get_rc(db, i->rc->pubkey);
+    EXPECT_NE(rc, nullptr);
+    if(rc)
+    {
+      EXPECT_EQ(rc->last_updated, i->rc->last_updated);
+    }
+    return true;
+  };
+  // everything loaded serially is in the parallel load too
+  llarp_nodedb_iterate_all(serial, iter);
+
+  llarp_threadpool_stop(disk);
+  llarp_threadpool_join(disk);
+  llarp_free_threadpool(&disk);
+  llarp_threadpool_stop(worker);
+  llarp_threadpool_join(worker);
+  llarp_free_threadpool(&worker);
+  llarp_nodedb_free(&serial);
+  llarp_nodedb_free(&parallel);
+}
+
+TEST_F(NodeDBTest, ParallelLoadRejectsBadSignature)
+{
+  Generate(10);
+  // flip a byte in every file's signature
+  size_t corrupted = 0;
+  for(const char *sub : {"0", "1", "2", "3", "4", "5", "6", "7", "8", "9", "a",
+                         "b", "c", "d", "e", "f"})
+  {
+    fs::directory_iterator itr(dir / sub), end;
+    for(; itr != end; ++itr)
+    {
+      std::fstream f(itr->path().string(),
+                     std::ios::in | std::ios::out | std::ios::binary);
+      // the signature is near the end, before the version and closing "e"
+      f.seekg(-20, std::ios::end);
+      char c = f.get();
+      f.seekp(-20, std::ios::end);
+      // flip bits so the byte always changes
+      f.put(c ^ 0x55);
+      ++corrupted;
+    }
+  }
+  ASSERT_EQ(corrupted, 10u);
+
+  llarp_threadpool *disk   = llarp_init_threadpool(1, "test-disk");
+  llarp_threadpool *worker = llarp_init_threadpool(2, "test-worker");
+  llarp_nodedb *db         = llarp_nodedb_new(&crypto);
+  ASSERT_EQ(
+      llarp_nodedb_load_dir_parallel(db, dir.string().c_str(), disk, worker),
+      0);
+  ASSERT_EQ(llarp_nodedb_num_loaded(db), 0u);
+  llarp_threadpool_stop(disk);
+  llarp_threadpool_join(disk);
+  llarp_free_threadpool(&disk);
+  llarp_threadpool_stop(worker);
+  llarp_threadpool_join(worker);
+  llarp_free_threadpool(&worker);
+  llarp_nodedb_free(&db);
+}
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include <llarp/outbound_queue.hpp>
+
+#include <vector>
+
+struct OutboundQueueTest : public ::testing::Test
+{
+  // 8 messages or 8 of our messages worth of bytes per router, 16 total
+  llarp::OutboundQueue queue;
+  byte_t msg[64];
+  llarp::RouterID peers[3];
+
+  OutboundQueueTest() : queue(8, 8 * sizeof(msg), 16, 16 * sizeof(msg))
+  {
+    for(auto& peer : peers)
+      peer.Randomize();
+  }
+
+  bool
+  Push(const llarp::RouterID& peer, llarp::OutboundQueue::MessageClass cls,
+       byte_t tag)
+  {
+    msg[0] = tag;
+    llarp_buffer_t buf;
+    buf.base = msg;
+    buf.cur  = msg;
+    buf.sz   = sizeof(msg);
+    return queue.Push(peer, buf, cls);
+  }
+
+  /// the tags flushed to peer in order
+  std::vector< byte_t >
+  Flush(const llarp::RouterID& peer)
+  {
+    std::vector< byte_t > tags;
+    queue.Flush(peer, [&](llarp_buffer_t buf) -> bool {
+      tags.push_back(buf.base[0]);
+      return true;
+    });
+    return tags;
+  }
+};
+
+TEST_F(OutboundQueueTest, RelayGetsPartOfLimit)
+{
+  for(byte_t idx = 0; idx < 6; ++idx)
+    ASSERT_TRUE(Push(peers[0], llarp::OutboundQueue::eRelay, idx));
+  ASSERT_TRUE(queue.Congested(peers[0]));
+  ASSERT_FALSE(queue.Congested(peers[1]));
+  ASSERT_FALSE(Push(peers[0], llarp::OutboundQueue::eRelay, 6));
+  // control still has room
+  ASSERT_TRUE(Push(peers[0], llarp::OutboundQueue::eControl, 7));
+  ASSERT_TRUE(Push(peers[0], llarp::OutboundQueue::eControl, 8));
+  ASSERT_EQ(queue.Messages(), 8u);
+  ASSERT_EQ(queue.Bytes(), 8 * sizeof(msg));
+  ASSERT_EQ(queue.queued, 8u);
+  ASSERT_EQ(queue.dropped, 1u);
+}
+
+TEST_F(OutboundQueueTest, ControlEvictsOldestRelay)
+{
+  for(byte_t idx = 0; idx < 6; ++idx)
+    ASSERT_TRUE(Push(peers[0], llarp::OutboundQueue::eRelay, idx));
+  for(byte_t idx = 10; idx < 14; ++idx)
+    ASSERT_TRUE(Push(peers[0], llarp::OutboundQueue::eControl, idx));
+  std::vector< byte_t > expected = {2, 3, 4, 5, 10, 11, 12, 13};
+  ASSERT_EQ(Flush(peers[0]), expected);
+  ASSERT_EQ(queue.dropped, 2u);
+  ASSERT_EQ(queue.flushed, 8u);
+  ASSERT_EQ(queue.Messages(), 0u);
+  ASSERT_EQ(queue.Bytes(), 0u);
+  ASSERT_FALSE(queue.Has(peers[0]));
+}
+
+TEST_F(OutboundQueueTest, GlobalLimit)
+{
+  for(byte_t idx = 0; idx < 6; ++idx)
+    ASSERT_TRUE(Push(peers[0], llarp::OutboundQueue::eRelay, idx));
+  for(byte_t idx = 0; idx < 6; ++idx)
+    ASSERT_TRUE(Push(peers[1], llarp::OutboundQueue::eRelay, idx));
+  // 12 of 16 is all relay traffic gets
+  ASSERT_TRUE(queue.Congested(peers[2]));
+  ASSERT_FALSE(Push(peers[2], llarp::OutboundQueue::eRelay, 0));
+  for(byte_t idx = 0; idx < 4; ++idx)
+    ASSERT_TRUE(Push(peers[2], llarp::OutboundQueue::eControl, idx));
+  // full, control pushes out someone else's relay traffic
+  ASSERT_TRUE(Push(peers[2], llarp::OutboundQueue::eControl, 4));
+  ASSERT_EQ(queue.Messages(), 16u);
+  queue.Discard(peers[0]);
+  queue.Discard(peers[1]);
+  ASSERT_EQ(Flush(peers[2]).size(), 5u);
+  ASSERT_EQ(queue.Messages(), 0u);
+  ASSERT_EQ(queue.queued, 17u);
+  ASSERT_EQ(queue.dropped + queue.flushed, queue.queued + 1);
+}
+
+TEST_F(OutboundQueueTest, DropsControlWhenAllControl)
+{
+  for(byte_t idx = 0; idx < 8; ++idx)
+    ASSERT_TRUE(Push(peers[0], llarp::OutboundQueue::eControl, idx));
+  ASSERT_FALSE(Push(peers[0], llarp::OutboundQueue::eControl, 8));
+  ASSERT_EQ(Flush(peers[0]).size(), 8u);
+}
+
+TEST_F(OutboundQueueTest, FullPeerLeavesOthersAlone)
+{
+  for(byte_t idx = 0; idx < 4; ++idx)
+    ASSERT_TRUE(Push(peers[1], llarp::OutboundQueue::eRelay, idx));
+  for(byte_t idx = 0; idx < 8; ++idx)
+    ASSERT_TRUE(Push(peers[0], llarp::OutboundQueue::eControl, idx));
+  // only peers[0]'s own limit is hit, dropping peers[1]'s traffic can't help
+  ASSERT_FALSE(Push(peers[0], llarp::OutboundQueue::eControl, 8));
+  ASSERT_EQ(Flush(peers[1]), std::vector< byte_t >({0, 1, 2, 3}));
+  ASSERT_EQ(Flush(peers[0]).size(), 8u);
+}
+
+TEST_F(OutboundQueueTest, EvictedPeerStillWaiting)
+{
+  ASSERT_TRUE(Push(peers[0], llarp::OutboundQueue::eRelay, 0));
+  for(byte_t idx = 0; idx < 8; ++idx)
+    ASSERT_TRUE(Push(peers[1], llarp::OutboundQueue::eControl, idx));
+  for(byte_t idx = 0; idx < 8; ++idx)
+    ASSERT_TRUE(Push(peers[2], llarp::OutboundQueue::eControl, idx));
+  // its only message went to make room but its session is still coming
+  ASSERT_EQ(queue.Messages(), 16u);
+  ASSERT_TRUE(queue.Has(peers[0]));
+  ASSERT_TRUE(Flush(peers[0]).empty());
+  ASSERT_FALSE(queue.Has(peers[0]));
+  // a router that never got anything queued isn't waited on
+  ASSERT_FALSE(Push(peers[0], llarp::OutboundQueue::eControl, 1));
+  ASSERT_FALSE(queue.Has(peers[0]));
+}
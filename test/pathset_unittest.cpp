@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+#include <llarp/path.hpp>
+#include <llarp/pathset.hpp>
+#include <llarp/time.h>
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+struct TestPathSet : public llarp::path::PathSet
+{
+  TestPathSet(size_t paths, size_t spares) : PathSet(paths, spares)
+  {
+  }
+
+  bool
+  SelectHop(llarp_nodedb*, llarp_rc*, llarp_rc*, size_t)
+  {
+    return false;
+  }
+
+  using PathSet::RotatePaths;
+};
+
+struct PathSetTest : public ::testing::Test
+{
+  TestPathSet paths;
+  std::vector< llarp::path::Path* > owned;
+  llarp_time_t now;
+
+  PathSetTest() : paths(2, 1), now(llarp_time_now_ms())
+  {
+  }
+
+  ~PathSetTest()
+  {
+    for(auto path : owned)
+      delete path;
+  }
+
+  /// a path that finished building at started
+  llarp::path::Path*
+  Build(llarp_time_t started)
+  {
+    llarp_path_hops hops;
+    hops.numHops = 2;
+    for(size_t idx = 0; idx < hops.numHops; ++idx)
+      llarp_rc_clear(&hops.hops[idx].router);
+    auto path           = new llarp::path::Path(&hops);
+    path->buildStarted  = started;
+    path->status        = llarp::path::ePathEstablished;
+    path->intro.latency = 10;
+    paths.AddPath(path);
+    paths.PathConfirmed(path);
+    owned.push_back(path);
+    return path;
+  }
+
+  /// expire and forget about path
+  void
+  Expire(llarp::path::Path* path)
+  {
+    path->buildStarted = now - path->hops[0].lifetime - 1;
+    owned.erase(std::find(owned.begin(), owned.end(), path));
+    paths.ExpirePaths(now);
+  }
+};
+
+TEST_F(PathSetTest, SpareKeptOutOfService)
+{
+  auto first  = Build(now);
+  auto second = Build(now);
+  ASSERT_TRUE(paths.ShouldBuildMore());
+  auto spare = Build(now);
+  ASSERT_FALSE(paths.ShouldBuildMore());
+  ASSERT_EQ(first->role, llarp::path::ePathActive);
+  ASSERT_EQ(second->role, llarp::path::ePathActive);
+  ASSERT_EQ(spare->role, llarp::path::ePathSpare);
+  ASSERT_EQ(paths.NumInRole(llarp::path::ePathActive), 2u);
+  // spares are never handed out
+  for(size_t idx = 0; idx < 100; ++idx)
+    ASSERT_NE(paths.PickEstablishedPath(), spare);
+  std::set< llarp::service::Introduction > intros;
+  ASSERT_TRUE(paths.GetCurrentIntroductions(intros));
+  ASSERT_EQ(intros.size(), 2u);
+}
+
+TEST_F(PathSetTest, SparePromotedOnExpiry)
+{
+  auto first = Build(now);
+  Build(now);
+  auto spare = Build(now);
+  Expire(first);
+  // the spare takes over right away and a new spare is wanted
+  ASSERT_EQ(spare->role, llarp::path::ePathActive);
+  ASSERT_EQ(paths.NumInRole(llarp::path::ePathActive), 2u);
+  ASSERT_EQ(paths.NumInRole(llarp::path::ePathSpare), 0u);
+  ASSERT_TRUE(paths.ShouldBuildMore());
+}
+
+TEST_F(PathSetTest, RotatesBeforeExpiry)
+{
+  llarp_time_t lifetime = DEFAULT_PATH_LIFETIME;
+  auto old              = Build(now - lifetime + 1000);
+  auto other            = Build(now);
+  // refresh is due well before the path would expire
+  ASSERT_LT(old->refreshAt, old->buildStarted + lifetime);
+  ASSERT_GE(old->refreshAt,
+            old->buildStarted + (lifetime * 3) / 4
+                - llarp::path::PathSet::RefreshMargin);
+  // a path due for refresh doesn't count toward what we keep
+  Build(now);
+  ASSERT_TRUE(paths.ShouldBuildMore());
+  Build(now);
+  ASSERT_FALSE(paths.ShouldBuildMore());
+
+  paths.RotatePaths(now);
+  ASSERT_EQ(old->role, llarp::path::ePathRetired);
+  ASSERT_EQ(other->role, llarp::path::ePathActive);
+  ASSERT_EQ(paths.NumInRole(llarp::path::ePathActive), 2u);
+  ASSERT_EQ(paths.NumInRole(llarp::path::ePathSpare), 1u);
+  // retired paths stay around for what is in flight until they expire
+  ASSERT_FALSE(old->Expired(now));
+  for(size_t idx = 0; idx < 100; ++idx)
+    ASSERT_NE(paths.PickEstablishedPath(), old);
+}
+
+TEST_F(PathSetTest, PrefersLowLatency)
+{
+  auto fast = Build(now);
+  auto slow = Build(now);
+  fast->stats.OnLatency(100);
+  slow->stats.OnLatency(400);
+  size_t picked = 0;
+  for(size_t idx = 0; idx < 1000; ++idx)
+  {
+    if(paths.PickEstablishedPath() == fast)
+      ++picked;
+  }
+  // 4 to 1, the slow path still gets some
+  ASSERT_GT(picked, 700u);
+  ASSERT_LT(picked, 900u);
+
+  // a busy path counts as slower
+  for(size_t idx = 0; idx < 10; ++idx)
+    fast->stats.OnSend(64 * 1024, now - 1000 + idx * 100);
+  fast->stats.OnSend(1, now);
+  ASSERT_GT(fast->stats.InFlight(now), 0u);
+  picked = 0;
+  for(size_t idx = 0; idx < 1000; ++idx)
+  {
+    if(paths.PickEstablishedPath() == fast)
+      ++picked;
+  }
+  ASSERT_LT(picked, 700u);
+}
+
+TEST_F(PathSetTest, UnprobedPathGetsFairShare)
+{
+  auto probed = Build(now);
+  auto fresh  = Build(now);
+  probed->stats.OnLatency(100);
+  size_t picked = 0;
+  for(size_t idx = 0; idx < 1000; ++idx)
+  {
+    if(paths.PickEstablishedPath() == fresh)
+      ++picked;
+  }
+  // counts as the median of the probed paths, not as the fastest
+  ASSERT_GT(picked, 350u);
+  ASSERT_LT(picked, 650u);
+}
+
+TEST_F(PathSetTest, MovesOffDegradedPath)
+{
+  auto bad  = Build(now);
+  auto good = Build(now);
+  Build(now);
+  bad->stats.OnLatency(100);
+  good->stats.OnLatency(100);
+  ASSERT_FALSE(paths.ShouldBuildMore());
+  for(size_t idx = 0; idx < 20; ++idx)
+    bad->stats.OnLatency(1000);
+  ASSERT_TRUE(bad->stats.Degraded());
+  // never picked while something better is up
+  for(size_t idx = 0; idx < 100; ++idx)
+    ASSERT_EQ(paths.PickEstablishedPath(), good);
+  // and replaced by the spare
+  ASSERT_TRUE(paths.ShouldBuildMore());
+  paths.RotatePaths(now);
+  ASSERT_EQ(bad->role, llarp::path::ePathRetired);
+  ASSERT_EQ(paths.NumInRole(llarp::path::ePathActive), 2u);
+
+  size_t visited = 0;
+  paths.ForEachPath([&](const llarp::path::Path*) { ++visited; });
+  ASSERT_EQ(visited, 3u);
+}
+
+TEST_F(PathSetTest, BacksOffRefusedPath)
+{
+  auto full  = Build(now);
+  auto other = Build(now);
+  full->stats.OnRefused(llarp_time_now_ms());
+  for(size_t idx = 0; idx < 100; ++idx)
+    ASSERT_EQ(paths.PickEstablishedPath(), other);
+  ASSERT_FALSE(full->stats.Backoff(now + 2000));
+}
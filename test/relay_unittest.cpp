@@ -0,0 +1,310 @@
+#include <gtest/gtest.h>
+#include <llarp/logic.h>
+#include <llarp/path.hpp>
+#include <llarp/relay_batch.hpp>
+#include <llarp/threadpool.h>
+#include <llarp/time.h>
+
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "buffer.hpp"
+
+struct RelayTest : public ::testing::Test
+{
+  static constexpr size_t PayloadSize = 1024;
+  static constexpr size_t Rounds      = 20000;
+
+  llarp_crypto crypto;
+  llarp::path::TransitHop hop;
+
+  RelayTest()
+  {
+    llarp_crypto_libsodium_init(&crypto);
+    hop.info.txID.Randomize();
+    hop.info.rxID.Randomize();
+    hop.info.upstream.Randomize();
+    hop.info.downstream.Randomize();
+    hop.pathKey.Randomize();
+    hop.nonceXOR.Randomize();
+  }
+
+  /// encode a relay message with a random payload into out
+  template < typename Msg_t >
+  void
+  Encode(std::vector< byte_t >& out)
+  {
+    Msg_t msg;
+    msg.pathid.Randomize();
+    msg.Y.Randomize();
+    std::vector< byte_t > payload(PayloadSize);
+    crypto.randbytes(payload.data(), payload.size());
+    msg.X = llarp::Buffer< decltype(payload) >(payload);
+    out.resize(PayloadSize + 128);
+    auto buf = llarp::Buffer< std::vector< byte_t > >(out);
+    ASSERT_TRUE(msg.BEncode(&buf));
+    out.resize(buf.cur - buf.base);
+  }
+
+  /// decode the way InboundMessageParser does, it reads the type itself
+  static bool
+  OnKey(dict_reader* r, llarp_buffer_t* key)
+  {
+    if(key == nullptr)
+      return true;
+    if(llarp_buffer_eq(*key, "a"))
+    {
+      llarp_buffer_t type;
+      return bencode_read_string(r->buffer, &type);
+    }
+    return static_cast< llarp::ILinkMessage* >(r->user)->DecodeKey(
+        *key, r->buffer);
+  }
+
+  /// what a transit hop did before forwarding in place: decode, decrypt,
+  /// make a new message for the next hop and encode it
+  template < typename Msg_t >
+  bool
+  Forward(llarp_buffer_t in, llarp_buffer_t* out)
+  {
+    bool upstream = in.base[6] == 'u';
+    Msg_t* msg    = new Msg_t;
+    dict_reader r;
+    r.user   = msg;
+    r.on_key = &OnKey;
+    if(!bencode_read_dict(&in, &r))
+    {
+      delete msg;
+      return false;
+    }
+    llarp_buffer_t X = *msg->X.Buffer();
+    crypto.xchacha20(X, hop.pathKey, msg->Y);
+    Msg_t* next  = new Msg_t;
+    next->pathid = upstream ? hop.info.txID : hop.info.rxID;
+    next->Y      = msg->Y ^ hop.nonceXOR;
+    next->X      = X;
+    out->cur     = out->base;
+    bool result  = next->BEncode(out);
+    delete msg;
+    delete next;
+    return result;
+  }
+
+  /// a job forwarding msg through hop the way a transit hop does
+  llarp::path::RelayJob *
+  MakeJob(std::vector< byte_t > &msg)
+  {
+    auto buf = llarp::Buffer< std::vector< byte_t > >(msg);
+    llarp::RelayView view;
+    if(!ParseRelayInPlace(buf, view))
+      return nullptr;
+    llarp::TunnelNonce Y = hop.NextHopInPlace(view);
+    auto job             = llarp::path::RelayJob::Copy(buf);
+    job->SetPayload(view.X.base - buf.base, view.X.sz);
+    job->AddLayer(hop.pathKey, Y);
+    return job;
+  }
+
+  /// run logic until batcher has nothing pending
+  static void
+  Drain(llarp_logic *logic, llarp::path::RelayBatcher &batcher)
+  {
+    auto started = llarp_time_now_ms();
+    while(batcher.Pending() && llarp_time_now_ms() - started < 5000)
+    {
+      llarp_logic_tick(logic);
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+
+  template < typename Msg_t >
+  void
+  CheckSameAsDecode()
+  {
+    std::vector< byte_t > encoded;
+    Encode< Msg_t >(encoded);
+    ASSERT_EQ(encoded.size(), llarp::RelayMessageSize(PayloadSize));
+
+    byte_t tmp[PayloadSize + 128];
+    auto expected = llarp::StackBuffer< decltype(tmp) >(tmp);
+    std::vector< byte_t > copy = encoded;
+    ASSERT_TRUE(
+        Forward< Msg_t >(llarp::Buffer< decltype(copy) >(copy), &expected));
+
+    llarp::RelayView view;
+    ASSERT_TRUE(ParseRelayInPlace(
+        llarp::Buffer< decltype(encoded) >(encoded), view));
+    ASSERT_EQ(view.X.sz, PayloadSize);
+    hop.RelayInPlace(view, &crypto);
+    ASSERT_EQ(size_t(expected.cur - expected.base), encoded.size());
+    ASSERT_EQ(memcmp(expected.base, encoded.data(), encoded.size()), 0);
+  }
+};
+
+constexpr size_t RelayTest::PayloadSize;
+constexpr size_t RelayTest::Rounds;
+
+TEST_F(RelayTest, ParseRejectsOthers)
+{
+  llarp::RelayView view;
+  std::vector< byte_t > encoded;
+  Encode< llarp::RelayUpstreamMessage >(encoded);
+  auto buf = llarp::Buffer< decltype(encoded) >(encoded);
+  ASSERT_TRUE(ParseRelayInPlace(buf, view));
+  ASSERT_EQ(view.type, 'u');
+  // every truncation fails
+  for(size_t sz = 0; sz < encoded.size(); ++sz)
+  {
+    buf.sz = sz;
+    ASSERT_FALSE(ParseRelayInPlace(buf, view));
+  }
+  // other message types
+  const char* other = "d1:a1:m1:mlee";
+  llarp_buffer_t otherbuf;
+  otherbuf.base = (byte_t*)other;
+  otherbuf.cur  = otherbuf.base;
+  otherbuf.sz   = strlen(other);
+  ASSERT_FALSE(ParseRelayInPlace(otherbuf, view));
+  // a version we can't re-emit as is
+  std::string str(encoded.begin(), encoded.end());
+  auto pos = str.find("1:vi");
+  ASSERT_NE(pos, std::string::npos);
+  encoded[pos + 4] = '9';
+  buf              = llarp::Buffer< decltype(encoded) >(encoded);
+  ASSERT_FALSE(ParseRelayInPlace(buf, view));
+}
+
+TEST_F(RelayTest, InPlaceSameAsDecode)
+{
+  CheckSameAsDecode< llarp::RelayUpstreamMessage >();
+  CheckSameAsDecode< llarp::RelayDownstreamMessage >();
+}
+
+TEST_F(RelayTest, BenchForward)
+{
+  std::vector< byte_t > encoded;
+  Encode< llarp::RelayUpstreamMessage >(encoded);
+  auto buf = llarp::Buffer< decltype(encoded) >(encoded);
+  byte_t tmp[PayloadSize + 128];
+  auto out = llarp::StackBuffer< decltype(tmp) >(tmp);
+
+  auto started = llarp_time_now_ms();
+  for(size_t idx = 0; idx < Rounds; ++idx)
+    ASSERT_TRUE(Forward< llarp::RelayUpstreamMessage >(buf, &out));
+  auto decodeTime = llarp_time_now_ms() - started;
+
+  started = llarp_time_now_ms();
+  for(size_t idx = 0; idx < Rounds; ++idx)
+  {
+    llarp::RelayView view;
+    ASSERT_TRUE(ParseRelayInPlace(buf, view));
+    hop.RelayInPlace(view, &crypto);
+  }
+  auto inPlaceTime = llarp_time_now_ms() - started;
+
+  auto rate = [](llarp_time_t ms) -> double {
+    return ms ? double(Rounds * PayloadSize) / (ms * 1000.0) : 0.0;
+  };
+  std::cout << "relayed " << Rounds << " x " << PayloadSize
+            << " bytes decode: " << decodeTime << "ms (" << rate(decodeTime)
+            << " MB/s) in place: " << inPlaceTime << "ms ("
+            << rate(inPlaceTime) << " MB/s)" << std::endl;
+}
+
+TEST_F(RelayTest, BatchKeepsOrderPerNextHop)
+{
+  typedef std::map< llarp::RouterID, std::vector< std::vector< byte_t > > >
+      Sent_t;
+  llarp_logic *logic       = llarp_init_logic();
+  llarp_threadpool *worker = llarp_init_threadpool(4, "test-relay");
+  Sent_t sent, expected;
+  llarp::path::RelayBatcher batcher(
+      logic, worker, &crypto,
+      [&sent](const llarp::RouterID &next, llarp_buffer_t buf) {
+        sent[next].emplace_back(buf.base, buf.base + buf.sz);
+      });
+  llarp::RouterID peers[3];
+  for(auto &peer : peers)
+    peer.Randomize();
+
+  const size_t num = 500;
+  for(size_t idx = 0; idx < num; ++idx)
+  {
+    std::vector< byte_t > msg;
+    Encode< llarp::RelayUpstreamMessage >(msg);
+    auto job = MakeJob(msg);
+    ASSERT_NE(job, nullptr);
+    // what it should send, decrypted here
+    llarp::RelayView view;
+    ASSERT_TRUE(
+        ParseRelayInPlace(llarp::Buffer< decltype(msg) >(msg), view));
+    crypto.xchacha20(view.X, hop.pathKey, job->layers[0].nonce);
+    auto &next = peers[idx % 3];
+    expected[next].push_back(msg);
+    batcher.Queue(next, job);
+  }
+  // whatever is short of a full batch goes when the window closes
+  Drain(logic, batcher);
+  ASSERT_EQ(batcher.Pending(), 0u);
+  ASSERT_EQ(batcher.relayed, num);
+  ASSERT_GE(batcher.batches, 3u);
+  ASSERT_TRUE(sent == expected);
+
+  llarp_threadpool_stop(worker);
+  llarp_threadpool_join(worker);
+  llarp_free_threadpool(&worker);
+  llarp_logic_stop(logic);
+  llarp_free_logic(&logic);
+}
+
+TEST_F(RelayTest, BenchBatch)
+{
+  llarp_logic *logic       = llarp_init_logic();
+  llarp_threadpool *worker = llarp_init_threadpool(4, "test-relay");
+  size_t sent              = 0;
+  llarp::path::RelayBatcher batcher(
+      logic, worker, &crypto,
+      [&sent](const llarp::RouterID &, llarp_buffer_t) { ++sent; });
+  llarp::RouterID peers[4];
+  for(auto &peer : peers)
+    peer.Randomize();
+  std::vector< byte_t > msg;
+  Encode< llarp::RelayUpstreamMessage >(msg);
+
+  // everything inline on this thread
+  auto started = llarp_time_now_ms();
+  for(size_t idx = 0; idx < Rounds; ++idx)
+  {
+    auto job = MakeJob(msg);
+    job->Apply(&crypto);
+    delete job;
+  }
+  auto inlineTime = llarp_time_now_ms() - started;
+
+  started = llarp_time_now_ms();
+  for(size_t idx = 0; idx < Rounds; ++idx)
+  {
+    batcher.Queue(peers[idx % 4], MakeJob(msg));
+    // let finished batches out as the logic thread would
+    if(idx % llarp::path::RelayBatcher::MaxBatch == 0)
+      llarp_logic_tick(logic);
+  }
+  batcher.Flush();
+  Drain(logic, batcher);
+  auto batchTime = llarp_time_now_ms() - started;
+  ASSERT_EQ(sent, Rounds);
+  std::cout << "relayed " << Rounds << " x " << PayloadSize
+            << " bytes inline: " << inlineTime << "ms batched on "
+            << std::thread::hardware_concurrency()
+            << " cores: " << batchTime << "ms in " << batcher.batches
+            << " batches" << std::endl;
+
+  llarp_threadpool_stop(worker);
+  llarp_threadpool_join(worker);
+  llarp_free_threadpool(&worker);
+  llarp_logic_stop(logic);
+  llarp_free_logic(&logic);
+}
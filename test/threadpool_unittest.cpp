@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "threadpool.hpp"
+
+struct ThreadPoolTest : public ::testing::Test
+{
+  static constexpr size_t Workers   = 4;
+  static constexpr size_t Producers = 4;
+  static constexpr size_t JobsPerProducer = 50000;
+
+  std::atomic< size_t > counter;
+
+  ThreadPoolTest() : counter(0)
+  {
+  }
+
+  static void
+  count(void* user)
+  {
+    static_cast< ThreadPoolTest* >(user)->counter.fetch_add(1);
+  }
+
+  bool
+  wait_for(size_t n, int ms = 5000)
+  {
+    auto started = std::chrono::steady_clock::now();
+    while(counter.load() < n)
+    {
+      if(std::chrono::steady_clock::now() - started
+         > std::chrono::milliseconds(ms))
+        return false;
+      std::this_thread::yield();
+    }
+    return true;
+  }
+
+  /// hammer a pool from several producer threads, returns microseconds
+  template < typename Pool_t >
+  int64_t
+  contend(Pool_t& pool)
+  {
+    counter.store(0);
+    auto started = std::chrono::steady_clock::now();
+    std::vector< std::thread > producers;
+    for(size_t p = 0; p < Producers; ++p)
+    {
+      producers.emplace_back([&] {
+        for(size_t n = 0; n < JobsPerProducer; ++n)
+          pool.QueueJob({this, &count});
+      });
+    }
+    for(auto& t : producers)
+      t.join();
+    EXPECT_TRUE(wait_for(Producers * JobsPerProducer, 30000));
+    return std::chrono::duration_cast< std::chrono::microseconds >(
+               std::chrono::steady_clock::now() - started)
+        .count();
+  }
+};
+
+constexpr size_t ThreadPoolTest::Workers;
+constexpr size_t ThreadPoolTest::Producers;
+constexpr size_t ThreadPoolTest::JobsPerProducer;
+
+TEST_F(ThreadPoolTest, RunsAllJobs)
+{
+  llarp::thread::StealingPool pool(Workers, "test-worker");
+  for(size_t n = 0; n < 10000; ++n)
+    pool.QueueJob({this, &count});
+  ASSERT_TRUE(wait_for(10000));
+  pool.Stop();
+  pool.Join();
+}
+
+TEST_F(ThreadPoolTest, RingsCacheAligned)
+{
+  for(size_t n = 0; n < Workers; ++n)
+  {
+    std::unique_ptr< llarp::thread::JobRing > ring(new llarp::thread::JobRing);
+    ASSERT_EQ(uintptr_t(&ring->tail) % 64, 0u);
+    ASSERT_EQ(uintptr_t(&ring->head) % 64, 0u);
+  }
+}
+
+TEST_F(ThreadPoolTest, QueueJobs)
+{
+  llarp::thread::StealingPool pool(Workers, "test-worker");
+  // more than fits in the rings so the overflow gets used
+  std::vector< llarp_thread_job > jobs(
+      (Workers * llarp::thread::JobRing::Size) + 1000,
+      llarp_thread_job(this, &count));
+  pool.QueueJobs(jobs.data(), jobs.size());
+  ASSERT_TRUE(wait_for(jobs.size()));
+  pool.Stop();
+  pool.Join();
+}
+
+struct Spawner
+{
+  llarp::thread::StealingPool* pool;
+  ThreadPoolTest* test;
+  size_t depth;
+};
+
+static void
+spawn(void* user)
+{
+  Spawner* s = static_cast< Spawner* >(user);
+  if(s->depth)
+  {
+    --s->depth;
+    s->pool->QueueJob({s, &spawn});
+  }
+  else
+    ThreadPoolTest::count(s->test);
+}
+
+TEST_F(ThreadPoolTest, QueueFromWorker)
+{
+  llarp::thread::StealingPool pool(Workers, "test-worker");
+  Spawner s{&pool, this, 1000};
+  pool.QueueJob({&s, &spawn});
+  ASSERT_TRUE(wait_for(1));
+  pool.Stop();
+  pool.Join();
+}
+
+TEST_F(ThreadPoolTest, StopDrainsQueued)
+{
+  llarp::thread::StealingPool pool(1, "test-worker");
+  for(size_t n = 0; n < 1000; ++n)
+    pool.QueueJob({this, &count});
+  pool.Stop();
+  pool.Join();
+  ASSERT_EQ(counter.load(), 1000u);
+  // queueing after stop is dropped
+  pool.QueueJob({this, &count});
+  ASSERT_EQ(counter.load(), 1000u);
+}
+
+TEST_F(ThreadPoolTest, ContentionBenchmark)
+{
+  int64_t mutexTime, stealingTime;
+  {
+    llarp::thread::Pool pool(Workers, "bench-mutex");
+    mutexTime = contend(pool);
+    pool.Stop();
+    pool.Join();
+  }
+  {
+    llarp::thread::StealingPool pool(Workers, "bench-steal");
+    stealingTime = contend(pool);
+    pool.Stop();
+    pool.Join();
+  }
+  size_t total = Producers * JobsPerProducer;
+  std::cout << total << " jobs from " << Producers << " producers on "
+            << Workers << " workers" << std::endl;
+  std::cout << "mutex pool:    " << mutexTime << "us" << std::endl;
+  std::cout << "stealing pool: " << stealingTime << "us" << std::endl;
+}
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include <llarp/time.h>
+#include <llarp/timer.h>
+#include <thread>
+#include <vector>
+
+struct TimerTest : public ::testing::Test
+{
+  struct Call
+  {
+    TimerTest* test;
+    int tag;
+    uint64_t left = 0;
+
+    Call(TimerTest* t, int n) : test(t), tag(n)
+    {
+    }
+  };
+
+  llarp_timer_context* timer = nullptr;
+  std::vector< int > called;
+
+  void
+  SetUp()
+  {
+    timer = llarp_init_timer();
+  }
+
+  void
+  TearDown()
+  {
+    llarp_timer_stop(timer);
+    llarp_free_timer(&timer);
+  }
+
+  static void
+  handle_timer(void* user, uint64_t orig, uint64_t left)
+  {
+    Call* call = static_cast< Call* >(user);
+    call->left = left;
+    call->test->called.push_back(call->tag);
+  }
+
+  uint32_t
+  call_later(Call& call, uint64_t ms)
+  {
+    return llarp_timer_call_later(timer, {ms, &call, &handle_timer});
+  }
+
+  /// tick until count timers were called or we give up
+  void
+  tick_until(size_t count, uint64_t maxms)
+  {
+    auto started = llarp_time_now_ms();
+    while(called.size() < count && llarp_time_now_ms() - started < maxms)
+    {
+      llarp_timer_tick_all(timer, nullptr);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+};
+
+TEST_F(TimerTest, Ordering)
+{
+  // spans the root wheel and the first cascading level
+  std::vector< Call > calls = {
+      {this, 3}, {this, 1}, {this, 4}, {this, 2}, {this, 0}};
+  const uint64_t timeouts[] = {300, 50, 400, 120, 5};
+  for(size_t idx = 0; idx < calls.size(); ++idx)
+    ASSERT_NE(call_later(calls[idx], timeouts[idx]), 0u);
+
+  tick_until(calls.size(), 2000);
+  ASSERT_EQ(called.size(), calls.size());
+  for(int idx = 0; idx < int(called.size()); ++idx)
+    ASSERT_EQ(called[idx], idx);
+  for(const auto& call : calls)
+    ASSERT_EQ(call.left, 0u);
+}
+
+TEST_F(TimerTest, NotEarly)
+{
+  Call call{this, 0};
+  auto started = llarp_time_now_ms();
+  call_later(call, 30);
+  tick_until(1, 1000);
+  ASSERT_EQ(called.size(), 1u);
+  ASSERT_GE(llarp_time_now_ms() - started, 30u);
+}
+
+TEST_F(TimerTest, Cancel)
+{
+  Call canceled{this, 0}, kept{this, 1};
+  uint32_t id = call_later(canceled, 10000);
+  call_later(kept, 20);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  llarp_timer_cancel_job(timer, id);
+
+  // canceled timers are called on the next tick, before their timeout
+  llarp_timer_tick_all(timer, nullptr);
+  ASSERT_EQ(called.size(), 1u);
+  ASSERT_EQ(called[0], 0);
+  ASSERT_NE(canceled.left, 0u);
+
+  tick_until(2, 1000);
+  ASSERT_EQ(called.size(), 2u);
+  ASSERT_EQ(called[1], 1);
+
+  // canceling again is a no op
+  llarp_timer_cancel_job(timer, id);
+  llarp_timer_tick_all(timer, nullptr);
+  ASSERT_EQ(called.size(), 2u);
+}
+
+TEST_F(TimerTest, Remove)
+{
+  Call removed{this, 0}, kept{this, 1};
+  uint32_t id = call_later(removed, 10);
+  call_later(kept, 20);
+  llarp_timer_remove_job(timer, id);
+  tick_until(1, 1000);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  llarp_timer_tick_all(timer, nullptr);
+  ASSERT_EQ(called.size(), 1u);
+  ASSERT_EQ(called[0], 1);
+}
+
+TEST_F(TimerTest, StaleIdDoesNotCancel)
+{
+  Call first{this, 0}, second{this, 1};
+  uint32_t id = call_later(first, 1);
+  tick_until(1, 1000);
+  ASSERT_EQ(called.size(), 1u);
+  // the pool may hand the same slot to the next timer
+  uint32_t next = call_later(second, 1);
+  ASSERT_NE(id, next);
+  llarp_timer_remove_job(timer, id);
+  tick_until(2, 1000);
+  ASSERT_EQ(called.size(), 2u);
+}
+
+TEST_F(TimerTest, ManyTimers)
+{
+  const size_t num = 10000;
+  std::vector< Call > calls;
+  calls.reserve(num);
+  std::vector< uint32_t > ids;
+  for(size_t idx = 0; idx < num; ++idx)
+  {
+    calls.emplace_back(this, int(idx));
+    ids.push_back(call_later(calls.back(), 1 + (idx % 50)));
+  }
+  // remove every other one
+  for(size_t idx = 0; idx < num; idx += 2)
+    llarp_timer_remove_job(timer, ids[idx]);
+  tick_until(num / 2, 2000);
+  ASSERT_EQ(called.size(), num / 2);
+  for(auto tag : called)
+    ASSERT_EQ(tag % 2, 1);
+}
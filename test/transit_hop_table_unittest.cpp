@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include <llarp/path.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+struct TransitHopTableTest : public ::testing::Test
+{
+  llarp::path::TransitHopTable table;
+  std::vector< llarp::path::TransitHop * > hops;
+
+  llarp::path::TransitHop *
+  MakeHop()
+  {
+    auto hop = new llarp::path::TransitHop;
+    hop->info.txID.Randomize();
+    hop->info.rxID.Randomize();
+    hop->info.upstream.Randomize();
+    hop->info.downstream.Randomize();
+    hops.push_back(hop);
+    return hop;
+  }
+
+  void
+  TearDown()
+  {
+    for(auto hop : hops)
+      delete hop;
+  }
+};
+
+TEST_F(TransitHopTableTest, PutGetRemove)
+{
+  auto hop   = MakeHop();
+  auto other = MakeHop();
+  table.Put(hop);
+  table.Put(other);
+  const auto &info = hop->info;
+  // either path id, matched with the router on the side asked about
+  ASSERT_EQ(table.Get(info.txID, info.upstream, true), hop);
+  ASSERT_EQ(table.Get(info.rxID, info.upstream, true), hop);
+  ASSERT_EQ(table.Get(info.txID, info.downstream, false), hop);
+  ASSERT_EQ(table.Get(info.rxID, info.downstream, false), hop);
+  ASSERT_EQ(table.Get(info.txID, info.downstream, true), nullptr);
+  ASSERT_EQ(table.Get(info.txID, info.upstream, false), nullptr);
+  ASSERT_EQ(table.Get(other->info.txID, info.upstream, true), nullptr);
+  ASSERT_TRUE(table.Has(info));
+
+  llarp::path::TransitHopInfo changed(info);
+  changed.rxID.Randomize();
+  ASSERT_FALSE(table.Has(changed));
+
+  table.Remove(hop);
+  ASSERT_EQ(table.Get(info.txID, info.upstream, true), nullptr);
+  ASSERT_FALSE(table.Has(info));
+  ASSERT_EQ(table.Get(other->info.rxID, other->info.downstream, false), other);
+}
+
+TEST_F(TransitHopTableTest, DuplicatePutKeepsFirst)
+{
+  auto hop = MakeHop();
+  ASSERT_TRUE(table.Put(hop));
+  // same rx id and routers as hop, so only its rx id keys collide
+  auto dupe             = MakeHop();
+  dupe->info.rxID       = hop->info.rxID;
+  dupe->info.upstream   = hop->info.upstream;
+  dupe->info.downstream = hop->info.downstream;
+  ASSERT_FALSE(table.Put(dupe));
+  const auto &info = hop->info;
+  ASSERT_EQ(table.Get(info.rxID, info.upstream, true), hop);
+  ASSERT_EQ(table.Get(info.rxID, info.downstream, false), hop);
+  // nothing of the rejected hop is left behind
+  ASSERT_EQ(table.Get(dupe->info.txID, info.upstream, true), nullptr);
+  ASSERT_FALSE(table.Has(dupe->info));
+  table.Remove(hop);
+  ASSERT_TRUE(table.Put(dupe));
+}
+
+TEST_F(TransitHopTableTest, ReadersDuringWrites)
+{
+  for(size_t idx = 0; idx < 256; ++idx)
+    table.Put(MakeHop());
+  std::vector< llarp::path::TransitHop * > churn;
+  for(size_t idx = 0; idx < 64; ++idx)
+    churn.push_back(MakeHop());
+
+  std::atomic< bool > stop(false);
+  std::atomic< size_t > misses(0);
+  std::vector< std::thread > readers;
+  for(size_t n = 0; n < 4; ++n)
+  {
+    readers.emplace_back([&]() {
+      while(!stop)
+      {
+        // the first 256 hops stay put the whole time
+        for(size_t idx = 0; idx < 256; ++idx)
+        {
+          const auto &info = hops[idx]->info;
+          if(table.Get(info.rxID, info.downstream, false) != hops[idx])
+            ++misses;
+        }
+      }
+    });
+  }
+  for(size_t round = 0; round < 100; ++round)
+  {
+    for(auto hop : churn)
+      table.Put(hop);
+    for(auto hop : churn)
+      table.Remove(hop);
+  }
+  stop = true;
+  for(auto &reader : readers)
+    reader.join();
+  ASSERT_EQ(misses, 0u);
+  for(auto hop : churn)
+    ASSERT_FALSE(table.Has(hop->info));
+}